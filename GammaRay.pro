@@ -236,7 +236,28 @@ SOURCES += main.cpp\
     imagejockey/gabor/gaborutils.cpp \
     imagejockey/gabor/gaborfrequencyazimuthselections.cpp \
     imagejockey/wavelet/wavelettransformdialog.cpp \
-    imagejockey/wavelet/waveletutils.cpp
+    imagejockey/wavelet/waveletutils.cpp \
+    domain/auxiliary/columnardatastore.cpp \
+    domain/auxiliary/numberparser.cpp \
+    domain/auxiliary/datafilebinarycache.cpp \
+    domain/auxiliary/columnstatistics.cpp \
+    domain/auxiliary/ndvpredicate.cpp \
+    geostats/neighborhoodmask.cpp \
+    geostats/compiledvariogrammodel.cpp \
+    geostats/krigingsystem.cpp \
+    geostats/krigingsolver.cpp \
+    geostats/krigingneighborhood.cpp \
+    spatialindex/pointkdtree.cpp \
+    spatialindex/implicitgridindex.cpp \
+    geostats/experimentalvariogramcalculator.cpp \
+    geostats/gridvariogramcalculator.cpp \
+    geostats/krigingestimation.cpp \
+    geostats/sequentialsimulationutils.cpp \
+    geostats/simulatednodetemplate.cpp \
+    geostats/sequentialgaussiansimulation.cpp \
+    geostats/indicatordistribution.cpp \
+    geostats/indicatorkriging.cpp \
+    geostats/sequentialindicatorsimulation.cpp
 
 HEADERS  += mainwindow.h \
     domain/project.h \
@@ -451,7 +472,29 @@ HEADERS  += mainwindow.h \
     imagejockey/gabor/gaborutils.h \
     imagejockey/gabor/gaborfrequencyazimuthselections.h \
     imagejockey/wavelet/wavelettransformdialog.h \
-    imagejockey/wavelet/waveletutils.h
+    imagejockey/wavelet/waveletutils.h \
+    domain/auxiliary/columnardatastore.h \
+    domain/auxiliary/numberparser.h \
+    domain/auxiliary/datafilebinarycache.h \
+    domain/auxiliary/columnstatistics.h \
+    domain/auxiliary/ndvpredicate.h \
+    geostats/neighborhoodmask.h \
+    geostats/compiledvariogrammodel.h \
+    geostats/krigingsystem.h \
+    geostats/krigingsolver.h \
+    geostats/krigingneighborhood.h \
+    spatialindex/pointkdtree.h \
+    spatialindex/implicitgridindex.h \
+    spatialindex/neighborvisitor.h \
+    geostats/experimentalvariogramcalculator.h \
+    geostats/gridvariogramcalculator.h \
+    geostats/krigingestimation.h \
+    geostats/sequentialsimulationutils.h \
+    geostats/simulatednodetemplate.h \
+    geostats/sequentialgaussiansimulation.h \
+    geostats/indicatordistribution.h \
+    geostats/indicatorkriging.h \
+    geostats/sequentialindicatorsimulation.h
 
 
 FORMS    += mainwindow.ui \
@@ -128,6 +128,7 @@ void FactorialKrigingDialog::onParameters()
 		factor_par->addOption( ist+1, variogram->getStructureDescription( ist ) +
 							   "(Factor " + QString::number(3+ist) + ")" );
 	}
+	factor_par->addOption( ALL_FACTORS, "All factors (saved to the estimation grid)" );
 
 	GSLibParametersDialog gpd( m_gpfFK );
 	int response = gpd.exec();
@@ -147,6 +148,10 @@ void FactorialKrigingDialog::onSave()
         QMessageBox::critical( this, "Error", "Please, run the estimation at least once.");
         return;
     }
+	if( m_results.empty() ){
+		QMessageBox::information( this, "Info", "All factors were already saved to the estimation grid.");
+		return;
+	}
 
 	//user enters the name for the new variable with the desired factor.
 	QString new_variable_name = QInputDialog::getText(this, "Name the new variable",
@@ -257,18 +262,14 @@ void FactorialKrigingDialog::preview()
 {
 }
 
-void FactorialKrigingDialog::doFK()
+QString FactorialKrigingDialog::makeVariableName(int factorNumber)
 {
-    //Get the factor number (-1 = mean, 0 = nugget, 1 and onwards = the variogram structures).
-    int factor_number =  (m_gpfFK->getParameter<GSLibParOption*>( 7 ))->_selected_value;
-
-    //propose a name for the new variable to contain the choosen factor.
 	QString factorName;
 	VariogramModel* vModel = m_vModelSelector->getSelectedVModel();
-	switch( factor_number ){
+	switch( factorNumber ){
 	case -1: factorName = "mean"; break;
 	case 0: factorName = "nugget"; break;
-	default: factorName = vModel->getStructureDescription( factor_number - 1 );
+	default: factorName = vModel->getStructureDescription( factorNumber - 1 );
 	}
 	QString kTypeName;
 	switch ( static_cast<KrigingType>(m_gpfFK->getParameter<GSLibParOption*>( 0 )->_selected_value) ) {
@@ -279,7 +280,26 @@ void FactorialKrigingDialog::doFK()
 	QString tmp_name = m_DataSetVariableSelector->getSelectedVariableName() + "_" + kTypeName + "_" + factorName;
 	tmp_name = tmp_name.replace('(', ' ');
 	tmp_name = tmp_name.replace(')', ' ');
-	m_varName = tmp_name;
+	return tmp_name;
+}
+
+void FactorialKrigingDialog::doFK()
+{
+    //Get the factor number (-1 = mean, 0 = nugget, 1 and onwards = the variogram structures, ALL_FACTORS = all of them).
+    int factor_number =  (m_gpfFK->getParameter<GSLibParOption*>( 7 ))->_selected_value;
+
+    //the factors to compute: all factors are computed in a single pass over the grid.
+    std::vector<int> factorNumbers;
+    if( factor_number == ALL_FACTORS ){
+        factorNumbers.push_back( -1 );
+        factorNumbers.push_back( 0 );
+        for( uint ist = 0; ist < m_vModelSelector->getSelectedVModel()->getNst(); ++ist )
+            factorNumbers.push_back( ist + 1 );
+    } else
+        factorNumbers.push_back( factor_number );
+
+    //propose a name for the new variable to contain the choosen factor.
+	m_varName = makeVariableName( factorNumbers[0] );
 
 	// Get the estimation grid.
 	m_cg_estimation = static_cast<CartesianGrid*>( m_cgSelector->getSelectedDataFile() );
@@ -325,11 +345,26 @@ void FactorialKrigingDialog::doFK()
         estimation.setMeanForSimpleKriging( skmean_par->_value );
         estimation.setInputVariable( m_DataSetVariableSelector->getSelectedVariable() );
         estimation.setEstimationGrid( m_cg_estimation );
-        estimation.setFactorNumber( factor_number );
-		m_results = estimation.run( );
+        estimation.setFactorNumber( factorNumbers[0] );
+		std::vector< std::vector<double> > results = estimation.run( factorNumbers );
+		if( results.empty() )
+			return;
 		//get the numbers of sample used in the estimations
 		std::vector< uint > vNSamplesAsUints = estimation.getNumberOfSamples();
 		std::copy( vNSamplesAsUints.begin(), vNSamplesAsUints.end(), std::back_inserter( m_vNSamplesAsDoubles ) );
+		if( factor_number != ALL_FACTORS )
+			m_results = results[0];
+		else {
+			//save all factors to the estimation grid, rewriting its file only once.
+			m_cg_estimation->beginColumnEdits();
+			for( size_t i = 0; i < factorNumbers.size(); ++i )
+				m_cg_estimation->addNewDataColumn( makeVariableName( factorNumbers[i] ), results[i] );
+			m_cg_estimation->commitColumnEdits();
+			Application::instance()->logInfo("FactorialKrigingDialog::doFK(): " + QString::number( factorNumbers.size() ) +
+											 " factors saved to " + m_cg_estimation->getName() + ".");
+			//there is no single factor to preview.
+			return;
+		}
     }
 
 	//preview the results
@@ -22,6 +22,9 @@ class FactorialKrigingDialog : public QDialog
     Q_OBJECT
 
 public:
+    /** The factor option value to compute and save all the factors at once. */
+    static const int ALL_FACTORS = -2;
+
     explicit FactorialKrigingDialog(QWidget *parent = 0);
     ~FactorialKrigingDialog();
 
@@ -40,6 +43,8 @@ private:
 	std::vector<double> m_vNSamplesAsDoubles;
 	void preview();
     void doFK();
+    /** Proposes a name for the variable with the given factor (see FKEstimation::run()). */
+    QString makeVariableName( int factorNumber );
 
 private slots:
     void onParameters();
@@ -19,10 +19,14 @@
 #include "gslib/gslibparametersdialog.h"
 #include "gslib/gslib.h"
 #include "gslib/gslibparameterfiles/gslibparamtypes.h"
+#include "geostats/indicatorkriging.h"
 #include "util.h"
 
+#include <QFile>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <algorithm>
+#include <limits>
 
 IndicatorKrigingDialog::IndicatorKrigingDialog(IKVariableType varType, QWidget *parent) :
     QDialog(parent),
@@ -122,20 +126,23 @@ void IndicatorKrigingDialog::addVariogramSelector(){
 
 void IndicatorKrigingDialog::preview()
 {
-    if( m_cg_estimation )
-        delete m_cg_estimation;
+    //the grid estimated in GammaRay is already made (see runEstimation()).
+    if( m_results.empty() ){
+        if( m_cg_estimation )
+            delete m_cg_estimation;
 
-    //get the tmp file path created by ik3d with the p.d.f. estimates
-    QString grid_file_path = m_gpf_ik3d->getParameter<GSLibParFile*>(14)->_path;
+        //get the tmp file path created by ik3d with the p.d.f. estimates
+        QString grid_file_path = m_gpf_ik3d->getParameter<GSLibParFile*>(14)->_path;
 
-    //create a new grid object corresponding to the file created by kt3d
-    m_cg_estimation = new CartesianGrid( grid_file_path );
+        //create a new grid object corresponding to the file created by kt3d
+        m_cg_estimation = new CartesianGrid( grid_file_path );
 
-    //set the grid geometry info.
-    m_cg_estimation->setInfoFromGridParameter( m_gpf_ik3d->getParameter<GSLibParGrid*>(15) );
+        //set the grid geometry info.
+        m_cg_estimation->setInfoFromGridParameter( m_gpf_ik3d->getParameter<GSLibParGrid*>(15) );
 
-    //ik3d usually uses -9.9999 as no-data-value.
-    m_cg_estimation->setNoDataValue( "-9.9999" );
+        //ik3d usually uses -9.9999 as no-data-value.
+        m_cg_estimation->setNoDataValue( "-9.9999" );
+    }
 
     //get the number of classes/thresholds in the distribution file
     uint ndist = m_dfSelector->getSelectedFile()->getContentsCount();
@@ -147,6 +154,12 @@ void IndicatorKrigingDialog::preview()
         //open the plot dialog
         Util::viewGrid( est_var, this );
     }
+
+    //the E-type estimates follow the c.d.f. values in the grids estimated by GammaRay
+    if( m_varType == IKVariableType::CONTINUOUS && m_cg_estimation->getChildCount() > (int)ndist ){
+        Attribute* etype_var = (Attribute*)m_cg_estimation->getChildByIndex( ndist );
+        Util::viewGrid( etype_var, this );
+    }
 }
 
 void IndicatorKrigingDialog::onUpdateVariogramSelectors()
@@ -366,6 +379,14 @@ void IndicatorKrigingDialog::onConfigureAndRun()
 
     //if user didn't cancel the dialog
     if( result == QDialog::Accepted ){
+        //the grid is estimated in GammaRay, cross validation and jackknife are still done by ik3d.
+        m_results.clear();
+        if( m_gpf_ik3d->getParameter<GSLibParOption*>(1)->_selected_value == 0 ){
+            if( runEstimation( pointSet, cg ) )
+                preview();
+            return;
+        }
+
         //Generate the parameter file
         QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath( "par" );
         m_gpf_ik3d->save( par_file_path );
@@ -379,6 +400,124 @@ void IndicatorKrigingDialog::onConfigureAndRun()
     }
 }
 
+bool IndicatorKrigingDialog::runEstimation( PointSet* pointSet, CartesianGrid* cg )
+{
+    //the thresholds/categories and their global c.d.f./p.d.f. values
+    uint ndist = m_gpf_ik3d->getParameter<GSLibParUInt*>(4)->_value;
+    GSLibParMultiValuedVariable *par5 = m_gpf_ik3d->getParameter<GSLibParMultiValuedVariable*>(5);
+    GSLibParMultiValuedVariable *par6 = m_gpf_ik3d->getParameter<GSLibParMultiValuedVariable*>(6);
+    std::vector<double> thresholds, probabilities;
+    for( uint i = 0; i < ndist; ++i ){
+        thresholds.push_back( par5->getParameter<GSLibParDouble*>(i)->_value );
+        probabilities.push_back( par6->getParameter<GSLibParDouble*>(i)->_value );
+    }
+    bool isCategorical = m_gpf_ik3d->getParameter<GSLibParOption*>(0)->_selected_value == 0;
+    IndicatorDistribution distribution( isCategorical, thresholds, probabilities );
+
+    //the E-type estimates are interpolated linearly within the classes, with the tails extending to the range
+    //of the data within the trimming limits (ik3d has no postik tail options, so these are postik's defaults).
+    GSLibParMultiValuedFixed *par8 = m_gpf_ik3d->getParameter<GSLibParMultiValuedFixed*>(8);
+    uint varIndex = par8->getParameter<GSLibParUInt*>(4)->_value;
+    GSLibParMultiValuedFixed *par11 = m_gpf_ik3d->getParameter<GSLibParMultiValuedFixed*>(11);
+    double tmin = par11->getParameter<GSLibParDouble*>(0)->_value;
+    double tmax = par11->getParameter<GSLibParDouble*>(1)->_value;
+    if( ! isCategorical ){
+        pointSet->loadData();
+        double zmin = std::numeric_limits<double>::max();
+        double zmax = std::numeric_limits<double>::lowest();
+        for( uint i = 0; i < pointSet->getDataLineCount(); ++i ){
+            double value = pointSet->data( i, varIndex - 1 );
+            if( pointSet->isNDV( value ) || value < tmin || value > tmax )
+                continue;
+            zmin = std::min( zmin, value );
+            zmax = std::max( zmax, value );
+        }
+        if( zmin > zmax ){
+            QMessageBox::critical( this, "Error", "There are no data within the trimming limits." );
+            return false;
+        }
+        distribution.setInterpolation( zmin, zmax, 1, 1.0, 1, 1.0, 1, 1.0 );
+    }
+
+    //the variogram models in the ik3d parameters (the user may have changed them in the parameters dialog).
+    //median IK uses only the model of the threshold closest to the median IK cutoff, as ik3d does.
+    //Thresholds with identical models share the same model object, so they are kriged with the same matrix.
+    GSLibParMultiValuedFixed *par20 = m_gpf_ik3d->getParameter<GSLibParMultiValuedFixed*>(20);
+    bool isMedianIK = par20->getParameter<GSLibParOption*>(0)->_selected_value == 1;
+    uint medianThreshold = distribution.getClosestThreshold( par20->getParameter<GSLibParDouble*>(1)->_value );
+    GSLibParRepeat *par22 = m_gpf_ik3d->getParameter<GSLibParRepeat*>(22);
+    std::vector<VariogramModel*> distinctVariograms;
+    std::vector<VariogramModel*> variograms = GSLibParameterFile::makeVariogramModels( par22, isMedianIK ? medianThreshold : 0,
+                                                                                       isMedianIK ? 1 : ndist,
+                                                                                       distinctVariograms );
+
+    //build the search strategy from the ik3d search parameters.  The octant search is done with
+    //eight sectors of the search ellipsoid.
+    GSLibParMultiValuedFixed *par16 = m_gpf_ik3d->getParameter<GSLibParMultiValuedFixed*>(16);
+    uint ndmin = par16->getParameter<GSLibParUInt*>(0)->_value;
+    uint ndmax = par16->getParameter<GSLibParUInt*>(1)->_value;
+    GSLibParMultiValuedFixed *par17 = m_gpf_ik3d->getParameter<GSLibParMultiValuedFixed*>(17);
+    GSLibParMultiValuedFixed *par18 = m_gpf_ik3d->getParameter<GSLibParMultiValuedFixed*>(18);
+    uint noct = m_gpf_ik3d->getParameter<GSLibParUInt*>(19)->_value;
+    SearchStrategyPtr searchStrategy = GSLibParameterFile::makeSearchStrategy( par17, par18, noct, ndmax, ndmin );
+
+    IndicatorKriging estimation( pointSet, cg );
+    estimation.setVariable( varIndex );
+    PointSet *psSoftData = (PointSet*)m_psSoftSelector->getSelectedDataFile();
+    if( psSoftData ){
+        GSLibParMultiValuedVariable *par10_3 = m_gpf_ik3d->getParameter<GSLibParMultiValuedFixed*>(10)
+                                                         ->getParameter<GSLibParMultiValuedVariable*>(3);
+        std::vector<uint> softColumns;
+        for( uint i = 0; i < ndist; ++i )
+            softColumns.push_back( par10_3->getParameter<GSLibParUInt*>(i)->_value );
+        estimation.setSoftIndicators( psSoftData, softColumns );
+    }
+    estimation.setTrimmingLimits( tmin, tmax );
+    estimation.setDistribution( distribution );
+    estimation.setSearchStrategy( searchStrategy );
+    estimation.setVariogramModels( variograms );
+    estimation.setKrigingType( static_cast<IndicatorKrigingType>( m_gpf_ik3d->getParameter<GSLibParOption*>(21)->_selected_value ) );
+    //ik3d uses -9.9999 as no-data-value.
+    estimation.setUnestimatedValue( -9.9999 );
+
+    Application::instance()->logInfo("Starting indicator kriging...");
+    bool ok = estimation.run();
+    for( VariogramModel* variogram : distinctVariograms )
+        delete variogram;
+    if( ! ok )
+        return false;
+    Application::instance()->logInfo("Indicator kriging completed.");
+
+    //the results in memory, one column per threshold/category followed, for continuous variables, by the E-type
+    //estimates and the conditional variances.
+    const std::vector<double>& estimatedProbabilities = estimation.getProbabilities();
+    size_t nCells = (size_t)cg->getNX() * cg->getNY() * cg->getNZ();
+    std::vector<QString> columnNames;
+    m_results.assign( ndist, std::vector<double>( nCells ) );
+    for( uint i = 0; i < ndist; ++i ){
+        columnNames.push_back( ( isCategorical ? "Probability_of_" : "Probability_below_" ) + QString::number( thresholds[i] ) );
+        for( size_t iCell = 0; iCell < nCells; ++iCell )
+            m_results[i][iCell] = estimatedProbabilities[ iCell * ndist + i ];
+    }
+    if( ! isCategorical ){
+        columnNames.push_back( "E-type" );
+        columnNames.push_back( "ConditionalVariance" );
+        m_results.push_back( estimation.getMeans() );
+        m_results.push_back( estimation.getVariances() );
+    }
+
+    //the results grid is saved from memory as ik3d's output file, which is imported for postik.
+    QString grid_file_path = m_gpf_ik3d->getParameter<GSLibParFile*>(14)->_path;
+    QFile::remove( grid_file_path );
+    if( m_cg_estimation )
+        delete m_cg_estimation;
+    m_cg_estimation = new CartesianGrid( grid_file_path );
+    m_cg_estimation->setInfoFromGridParameter( m_gpf_ik3d->getParameter<GSLibParGrid*>(15) );
+    m_cg_estimation->setNoDataValue( "-9.9999" );
+    Util::saveGridColumns( m_cg_estimation, columnNames, m_results );
+    return true;
+}
+
 void IndicatorKrigingDialog::onIk3dCompletes()
 {
     //frees all signal connections to the GSLib singleton.
@@ -424,6 +563,29 @@ void IndicatorKrigingDialog::onSave()
         QMessageBox::critical( this, "Error", "Please, select an estimation grid.");
         return;
     }
+    if( ! m_results.empty() &&
+        m_results[0].size() != (size_t)estimation_grid->getNX() * estimation_grid->getNY() * estimation_grid->getNZ() ){
+        QMessageBox::critical( this, "Error", "The selected grid is not the estimated one. Please, run the estimation again.");
+        return;
+    }
+
+    //adds a result (a GEO-EAS column of the results grid) to the selected estimation grid.  The results estimated
+    //in GammaRay are added directly from memory, those of ik3d from its output file.
+    auto addResult = [this, estimation_grid]( uint iResult, const QString name ){
+        if( m_results.empty() ){
+            estimation_grid->addGEOEASColumn( m_cg_estimation->getAttributeFromGEOEASIndex( iResult + 1 ), name );
+            return;
+        }
+        std::vector<double> values = m_results[iResult];
+        //the cells that were not estimated get the grid's no-data value, if it has one.
+        if( estimation_grid->hasNoDataValue() ){
+            double ndv = estimation_grid->getNoDataValueAsDouble();
+            for( double& value : values )
+                if( value == -9.9999 )
+                    value = ndv;
+        }
+        estimation_grid->addNewDataColumn( name, values );
+    };
 
     if( m_varType == IKVariableType::CATEGORICAL ){
         //suggest a prefix for the variable names to the user
@@ -442,6 +604,8 @@ void IndicatorKrigingDialog::onSave()
             //get the category definition used to create the p.d.f. (if defined)
             CategoryDefinition *cd = pdf->getCategoryDefinition();
 
+            //add all fields to the grid file in a single rewrite
+            estimation_grid->beginColumnEdits();
             //for each code/probability pair
             for(int i = 0; i < pdf->getPairCount(); ++i){
                 //make a meaningful name
@@ -452,10 +616,9 @@ void IndicatorKrigingDialog::onSave()
                     proposed_name.append( "Category_" ).append( pdf->get1stValue( i ) );
 
                 //the estimates normally follow the order of the categories in the resulting grid
-                Attribute* values = m_cg_estimation->getAttributeFromGEOEASIndex( i + 1 );
-                //add the estimates or variances to the selected estimation grid
-                estimation_grid->addGEOEASColumn( values, proposed_name );
+                addResult( i, proposed_name );
             }
+            estimation_grid->commitColumnEdits();
         }
     }
 
@@ -473,6 +636,8 @@ void IndicatorKrigingDialog::onSave()
             //get the selected c.d.f. file
             ThresholdCDF *cdf = (ThresholdCDF *)m_dfSelector->getSelectedFile();
 
+            //add all fields to the grid file in a single rewrite
+            estimation_grid->beginColumnEdits();
             //for each code/probability pair
             for(int i = 0; i < cdf->getPairCount(); ++i){
                 //make a meaningful name
@@ -480,10 +645,14 @@ void IndicatorKrigingDialog::onSave()
                 proposed_name.append( QString::number(cdf->get1stValue( i )) );
 
                 //the estimates normally follow the order of the categories in the resulting grid
-                Attribute* values = m_cg_estimation->getAttributeFromGEOEASIndex( i + 1 );
-                //add the estimates or variances to the selected estimation grid
-                estimation_grid->addGEOEASColumn( values, proposed_name );
+                addResult( i, proposed_name );
+            }
+            //the E-type estimates and the conditional variances follow the c.d.f. values in the grids estimated by GammaRay
+            if( m_cg_estimation->getChildCount() > cdf->getPairCount() + 1 ){
+                addResult( cdf->getPairCount(), "E-type" );
+                addResult( cdf->getPairCount() + 1, "ConditionalVariance" );
             }
+            estimation_grid->commitColumnEdits();
         }
     }
 }
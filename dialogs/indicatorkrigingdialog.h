@@ -3,6 +3,7 @@
 
 #include <QDialog>
 #include <QList>
+#include <vector>
 
 namespace Ui {
 class IndicatorKrigingDialog;
@@ -16,6 +17,7 @@ class VariogramModelSelector;
 class FileSelectorWidget;
 class GSLibParameterFile;
 class CartesianGrid;
+class PointSet;
 
 /*! The variable type result in different indicator kriging beahvior. */
 enum class IKVariableType : uint {
@@ -45,8 +47,18 @@ private:
     void addVariogramSelector();
     IKVariableType m_varType;
     CartesianGrid* m_cg_estimation;
+    /** The results of the estimation run in GammaRay, one vector per GEO-EAS column of m_cg_estimation (empty if
+     * ik3d was run instead).  They are added to the estimation grid from memory. */
+    std::vector< std::vector<double> > m_results;
     void preview();
 
+    /** Runs indicator kriging in GammaRay with the ik3d parameters (grid mode), keeping the results in m_results:
+     * the probabilities of the thresholds/categories followed, for continuous variables, by the E-type estimates
+     * and the conditional variances.  m_cg_estimation is made from them and saved as ik3d's output file.
+     * @return False if the estimation failed (the reason is logged or shown).
+     */
+    bool runEstimation( PointSet* pointSet, CartesianGrid* cg );
+
 private slots:
     void onUpdateVariogramSelectors();
     void onConfigureAndRun();
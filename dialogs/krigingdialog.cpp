@@ -15,6 +15,7 @@
 #include "gslib/gslibparametersdialog.h"
 #include "gslib/gslib.h"
 #include "util.h"
+#include "geostats/krigingestimation.h"
 
 #include <QInputDialog>
 #include <QMessageBox>
@@ -214,7 +215,7 @@ void KrigingDialog::onParameters()
     par9->_specs_z->getParameter<GSLibParDouble*>(1)->_value = estimation_grid->getZ0(); //min z
     par9->_specs_z->getParameter<GSLibParDouble*>(2)->_value = estimation_grid->getDZ(); //cell size z
 
-    //----------------------------prepare and execute kt3d--------------------------------
+    //----------------------------prepare and execute the estimation--------------------------------
 
     //show the kt3d parameters
     GSLibParametersDialog gsd( m_gpf_kt3d, this );
@@ -222,19 +223,66 @@ void KrigingDialog::onParameters()
 
     //if user didn't cancel the dialog
     if( result == QDialog::Accepted ){
-        //Generate the parameter file
-        QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath( "par" );
-        m_gpf_kt3d->save( par_file_path );
-
-        //to be notified when kt3d completes.
-        connect( GSLib::instance(), SIGNAL(programFinished()), this, SLOT(onKt3dCompletes()) );
-
-        //run kt3d program asynchronously
-        Application::instance()->logInfo("Starting kt3d program...");
-        GSLib::instance()->runProgramAsync( "kt3d", par_file_path );
+        //run the estimation in GammaRay instead of running kt3d
+        if( runEstimation( input_data_file, estimation_grid, sec_data_grid ) )
+            preview( estimation_grid );
     }
 }
 
+bool KrigingDialog::runEstimation( PointSet* input_data_file, CartesianGrid* estimation_grid, CartesianGrid* sec_data_grid )
+{
+    //the variogram model in the kt3d parameters (the user may have changed it in the parameters dialog)
+    QString var_model_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath("par");
+    m_gpf_kt3d->saveVariogramModel( var_model_file_path );
+    VariogramModel variogram( var_model_file_path );
+
+    //build the search strategy from the kt3d search parameters.  The octant search is done with
+    //eight sectors of the search ellipsoid.
+    GSLibParMultiValuedFixed *par11 = m_gpf_kt3d->getParameter<GSLibParMultiValuedFixed*>(11);
+    uint ndmin = par11->getParameter<GSLibParUInt*>(0)->_value;
+    uint ndmax = par11->getParameter<GSLibParUInt*>(1)->_value;
+    uint noct = m_gpf_kt3d->getParameter<GSLibParUInt*>(12)->_value;
+    GSLibParMultiValuedFixed *par13 = m_gpf_kt3d->getParameter<GSLibParMultiValuedFixed*>(13);
+    GSLibParMultiValuedFixed *par14 = m_gpf_kt3d->getParameter<GSLibParMultiValuedFixed*>(14);
+    SearchStrategyPtr searchStrategy = GSLibParameterFile::makeSearchStrategy( par13, par14, noct, ndmax, ndmin );
+
+    KrigingEstimation estimation( input_data_file, estimation_grid );
+    GSLibParMultiValuedFixed *par1 = m_gpf_kt3d->getParameter<GSLibParMultiValuedFixed*>(1);
+    estimation.setVariable( par1->getParameter<GSLibParUInt*>(4)->_value );
+    GSLibParMultiValuedFixed *par2 = m_gpf_kt3d->getParameter<GSLibParMultiValuedFixed*>(2);
+    estimation.setTrimmingLimits( par2->getParameter<GSLibParDouble*>(0)->_value,
+                                  par2->getParameter<GSLibParDouble*>(1)->_value );
+    estimation.setSearchStrategy( searchStrategy );
+    estimation.setVariogramModel( &variogram );
+    GSLibParMultiValuedFixed *par15 = m_gpf_kt3d->getParameter<GSLibParMultiValuedFixed*>(15);
+    estimation.setKrigingType( static_cast<KrigingEstimationType>( par15->getParameter<GSLibParOption*>(0)->_selected_value ),
+                               par15->getParameter<GSLibParDouble*>(1)->_value );
+    estimation.setSecondaryVariable( par1->getParameter<GSLibParUInt*>(5)->_value,
+                                     sec_data_grid,
+                                     m_gpf_kt3d->getParameter<GSLibParUInt*>(19)->_value );
+    GSLibParMultiValuedFixed *par16 = m_gpf_kt3d->getParameter<GSLibParMultiValuedFixed*>(16);
+    std::vector<bool> driftTerms;
+    for( uint i = 0; i < 9; ++i )
+        driftTerms.push_back( par16->getParameter<GSLibParOption*>(i)->_selected_value == 1 );
+    estimation.setDriftTerms( driftTerms );
+    estimation.setEstimateTrend( m_gpf_kt3d->getParameter<GSLibParOption*>(17)->_selected_value == 1 );
+    GSLibParMultiValuedFixed *par10 = m_gpf_kt3d->getParameter<GSLibParMultiValuedFixed*>(10);
+    estimation.setBlockDiscretization( par10->getParameter<GSLibParUInt*>(0)->_value,
+                                       par10->getParameter<GSLibParUInt*>(1)->_value,
+                                       par10->getParameter<GSLibParUInt*>(2)->_value );
+    //kt3d uses -999 as no-data-value.
+    estimation.setUnestimatedValue( -999.0 );
+
+    Application::instance()->logInfo("Starting kriging...");
+    if( ! estimation.run() )
+        return false;
+    Application::instance()->logInfo("Kriging completed.");
+
+    m_estimates = estimation.getEstimates();
+    m_kVariances = estimation.getKrigingVariances();
+    return true;
+}
+
 void KrigingDialog::onXValidation()
 {
     if( ! m_gpf_kt3d ){
@@ -277,8 +325,7 @@ void KrigingDialog::onXValidation()
 
 void KrigingDialog::onSave(bool estimates)
 {
-    //TODO: this onSave() method (or the functions it calls) crashed once.
-    if( ! m_gpf_kt3d || ! m_cg_estimation ){
+    if( ! m_gpf_kt3d || m_estimates.empty() ){
         QMessageBox::critical( this, "Error", "Please, run the estimation at least once.");
         return;
     }
@@ -301,14 +348,20 @@ void KrigingDialog::onSave(bool estimates)
                                              "New variable name:", QLineEdit::Normal,
                                              proposed_name, &ok);
     if (ok && !new_var_name.isEmpty()){
-        //the estimates are normally the first variable in the resulting grid
-        Attribute* values = m_cg_estimation->getAttributeFromGEOEASIndex( ( estimates ? 1 : 2 ) );
-		if( values ){
-			//add the estimates or variances to the selected estimation grid
-			estimation_grid->addGEOEASColumn( values, new_var_name );
-		} else {
-			QMessageBox::critical( this, "Error", "KrigingDialog::onSave: m_cd_estimation is null. Please, run the estimation again.");
-		}
+        std::vector<double> values = ( estimates ? m_estimates : m_kVariances );
+        if( values.size() != (size_t)estimation_grid->getNX() * estimation_grid->getNY() * estimation_grid->getNZ() ){
+            QMessageBox::critical( this, "Error", "The selected grid is not the estimated one. Please, run the estimation again.");
+            return;
+        }
+        //the cells that were not estimated get the grid's no-data value, if it has one.
+        if( estimation_grid->hasNoDataValue() ){
+            double ndv = estimation_grid->getNoDataValueAsDouble();
+            for( double& value : values )
+                if( value == -999.0 )
+                    value = ndv;
+        }
+        //add the estimates or variances to the selected estimation grid directly from memory
+        estimation_grid->addNewDataColumn( new_var_name, values );
     }
 }
 
@@ -369,14 +422,6 @@ void KrigingDialog::onSaveOrUpdateVModel()
     }
 }
 
-void KrigingDialog::onKt3dCompletes()
-{
-    //frees all signal connections to the GSLib singleton.
-    GSLib::instance()->disconnect();
-
-    preview();
-}
-
 void KrigingDialog::onVariogramChanged()
 {
     if( ! m_gpf_kt3d )
@@ -391,21 +436,28 @@ void KrigingDialog::onVariogramChanged()
     Application::instance()->logInfo("NOTE: The user selected a variogram model. Re-reading the variogram parameters.");
 }
 
-void KrigingDialog::preview()
+void KrigingDialog::preview( CartesianGrid* estimation_grid )
 {
     if( m_cg_estimation )
         delete m_cg_estimation;
 
-    //get the tmp file path created by kte3d with the estimates and kriging variances
+    //the plot is made from a file, so the estimates and kriging variances are written to a tmp grid file
+    //in the same format of kt3d's output.
     QString grid_file_path = m_gpf_kt3d->getParameter<GSLibParFile*>(8)->_path;
-
-    //create a new grid object corresponding to the file created by kt3d
+    std::vector< std::vector<double> > lines( m_estimates.size() );
+    for( size_t i = 0; i < m_estimates.size(); ++i )
+        lines[i] = std::vector<double>{ m_estimates[i], m_kVariances[i] };
+    Util::createGEOEASGridFile( "KT3D Estimates with:" + m_PointSetVariableSelector->getSelectedVariableName(),
+                                std::vector<QString>{ "Estimate", "EstimationVariance" },
+                                lines, grid_file_path );
+
+    //create a new grid object corresponding to the tmp file
     m_cg_estimation = new CartesianGrid( grid_file_path );
 
     //set the grid geometry info.
-    m_cg_estimation->setInfoFromGridParameter( m_gpf_kt3d->getParameter<GSLibParGrid*>(9) );
+    m_cg_estimation->setInfoFromOtherCG( estimation_grid, false );
 
-    //kt3d usually uses -999 as no-data-value.
+    //the cells not estimated have kt3d's no-data-value.
     m_cg_estimation->setNoDataValue( "-999" );
 
     //get the variable with the estimation values (normally the first)
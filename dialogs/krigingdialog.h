@@ -2,6 +2,7 @@
 #define KRIGINGDIALOG_H
 
 #include <QDialog>
+#include <vector>
 
 namespace Ui {
 class KrigingDialog;
@@ -14,6 +15,7 @@ class VariableSelector;
 class GSLibParameterFile;
 class VariogramModel;
 class CartesianGrid;
+class PointSet;
 
 class KrigingDialog : public QDialog
 {
@@ -34,7 +36,12 @@ private:
     VariableSelector* m_PointSetSecondaryVariableSelector;
     GSLibParameterFile* m_gpf_kt3d;
     CartesianGrid* m_cg_estimation;
-    void preview();
+    /** The results of the last estimation, in the GEO-EAS grid scan order. */
+    std::vector<double> m_estimates;
+    std::vector<double> m_kVariances;
+    /** Runs the estimation with the kt3d parameters set in m_gpf_kt3d.  Returns false if it failed. */
+    bool runEstimation( PointSet* input_data_file, CartesianGrid* estimation_grid, CartesianGrid* sec_data_grid );
+    void preview( CartesianGrid* estimation_grid );
     /** Called when the user changes the variogram model, so the variogram parameters
      * in m_gpf_kt3d are read from the newly selected variogram model.*/
     void updateVariogramParameters(VariogramModel *vm );
@@ -46,7 +53,6 @@ private slots:
     void onSaveEstimates();
     void onSaveKVariances();
     void onSaveOrUpdateVModel();
-    void onKt3dCompletes();
     void onVariogramChanged();
 };
 
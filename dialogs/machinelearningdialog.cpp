@@ -270,8 +270,10 @@ void MachineLearningDialog::runCARTRegression()
     }
 
     //add the results as continuous attributes
+    outputDataFile->beginColumnEdits();
     outputDataFile->addNewDataColumn( gpf.getParameterByName<GSLibParString*>("VariableName")->_value, estimatedValues );
     outputDataFile->addNewDataColumn( gpf.getParameterByName<GSLibParString*>("VariableName")->_value + "_percent", percentages );
+    outputDataFile->commitColumnEdits();
 }
 
 bool MachineLearningDialog::getRandomForestParameters(GSLibParameterFile &gpf )
@@ -396,12 +398,14 @@ void MachineLearningDialog::runRandomForestClassify()
     Attribute* at = trainingDataFile->getAttributeFromGEOEASIndex(
                     m_trainingDependentVariableSelector->getSelectedVariableGEOEASIndex() );
 
+    outputDataFile->beginColumnEdits();
     //add the classification as a categorical attribute
     outputDataFile->addNewDataColumn( gpf.getParameterByName<GSLibParString*>("VariableName")->_value,
                                       classes, trainingDataFile->getCategoryDefinition(at) );
 
     //add the counts as a common variable
     outputDataFile->addNewDataColumn( gpf.getParameterByName<GSLibParString*>("VariableName")->_value + "_uncert", counts );
+    outputDataFile->commitColumnEdits();
 
     Application::instance()->logInfo("MachineLearningDialog::runRandomForestClassify(): finished.");
 }
@@ -493,8 +497,10 @@ void MachineLearningDialog::runRandomForestRegression()
     Application::instance()->logInfo("MachineLearningDialog::runRandomForestRegression(): regression completed.");
 
     //add the regression and its variance as continuous attributes
+    outputDataFile->beginColumnEdits();
     outputDataFile->addNewDataColumn( gpf.getParameterByName<GSLibParString*>("VariableName")->_value, means );
     outputDataFile->addNewDataColumn( gpf.getParameterByName<GSLibParString*>("VariableName")->_value + "_variance", variances );
+    outputDataFile->commitColumnEdits();
 
     Application::instance()->logInfo("MachineLearningDialog::runRandomForestRegression(): finished.");
 }
@@ -12,6 +12,7 @@
 #include "gslib/gslibparametersdialog.h"
 #include "gslib/gslib.h"
 #include "dialogs/displayplotdialog.h"
+#include "geostats/gridvariogramcalculator.h"
 
 MultiVariogramDialog::MultiVariogramDialog(const std::vector<Attribute *> attributes,
                                            QWidget *parent) :
@@ -163,14 +164,10 @@ void MultiVariogramDialog::onGam()
                     Application::instance()->getProject()->generateUniqueTmpFilePath("out");
             expVarFilePaths.push_back( m_gpf_gam->getParameter<GSLibParFile*>(3)->_path );
 
-            //Generate the parameter file
-            QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath("par");
-            m_gpf_gam->save( par_file_path );
-
-            //...run gam program
-            Application::instance()->logInfo("Starting gam program for variable " +
+            //...compute the variograms in process (same algorithm and output file of gam)
+            Application::instance()->logInfo("Computing experimental variograms for variable " +
                                              at->getName() + " in file " + cg->getName() + "...");
-            GSLib::instance()->runProgram( "gam", par_file_path );
+            GridVariogramCalculator::runGam( m_gpf_gam, cg );
         }
 
 
@@ -13,6 +13,7 @@ SetupDialog::SetupDialog(QWidget *parent) :
     ui->txtGSLibPath->setText( Application::instance()->getGSLibPathSetting() );
     ui->txtGSPath->setText( Application::instance()->getGhostscriptPathSetting() );
     ui->spinMaxGridCells3DView->setValue( Application::instance()->getMaxGridCellCountFor3DVisualizationSetting() );
+    ui->spinMappedDataMemoryBudget->setValue( Application::instance()->getMappedDataMemoryBudgetSetting() );
     adjustSize();
 }
 
@@ -41,6 +42,7 @@ void SetupDialog::accept()
     Application::instance()->setGSLibPathSetting( ui->txtGSLibPath->text() );
     Application::instance()->setGhostscriptPathSetting( ui->txtGSPath->text() );
     Application::instance()->setMaxGridCellCountFor3DVisualizationSetting( ui->spinMaxGridCells3DView->value() );
+    Application::instance()->setMappedDataMemoryBudgetSetting( ui->spinMappedDataMemoryBudget->value() );
     //make dialog close.
     this->reject();
 }
@@ -19,6 +19,7 @@
 #include "widgets/variogrammodelselector.h"
 #include "widgets/distributionfieldselector.h"
 #include "dialogs/displayplotdialog.h"
+#include "geostats/sequentialgaussiansimulation.h"
 #include "util.h"
 
 #include <QInputDialog>
@@ -146,10 +147,10 @@ void SGSIMDialog::preview()
     if( m_cg_simulation )
         delete m_cg_simulation;
 
-    //get the tmp file path created by sgsim with the realizations
+    //get the tmp file path with the realizations
     QString grid_file_path = m_gpf_sgsim->getParameter<GSLibParFile*>(13)->_path;
 
-    //create a new grid object corresponding to the file created by sgsim
+    //create a new grid object corresponding to the file with the realizations
     m_cg_simulation = new CartesianGrid( grid_file_path );
 
     //set the grid geometry info.
@@ -162,7 +163,7 @@ void SGSIMDialog::preview()
     m_cg_simulation->setNReal( m_gpf_sgsim->getParameter<GSLibParUInt*>(14)->_value );
 
 	if( m_cg_simulation->getChildCount() < 1 ){
-		QMessageBox::critical( this, "Error", "SGSIM yielded a file without data.  It is possible that SGSIM crashed.  Check the message panel.  Aborted.");
+		QMessageBox::critical( this, "Error", "The simulation yielded a file without data.  Check the message panel.  Aborted.");
 		return;
 	}
 
@@ -343,18 +344,91 @@ void SGSIMDialog::onConfigAndRun()
 
     //if user didn't cancel the dialog
     if( result == QDialog::Accepted ){
-        //Generate the parameter file
-        QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath( "par" );
-        m_gpf_sgsim->save( par_file_path );
+        //run the simulation in GammaRay instead of running sgsim
+        if( runSimulation( input_data_file ) )
+            preview();
+    }
 
-        //to be notified when sgsim completes.
-        connect( GSLib::instance(), SIGNAL(programFinished()), this, SLOT(onSgsimCompletes()) );
+}
 
-        //run sgsim program asynchronously
-        Application::instance()->logInfo("Starting sgsim program...");
-        GSLib::instance()->runProgramAsync( "sgsim", par_file_path );
+bool SGSIMDialog::runSimulation( PointSet* input_data_file )
+{
+    //the variogram model in the sgsim parameters (the user may have changed it in the parameters dialog)
+    QString var_model_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath("par");
+    m_gpf_sgsim->saveVariogramModel( var_model_file_path );
+    VariogramModel variogram( var_model_file_path );
+
+    //build the search strategy from the sgsim search parameters.  The octant search is done with
+    //eight sectors of the search ellipsoid.
+    GSLibParMultiValuedFixed *par17 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(17);
+    uint ndmin = par17->getParameter<GSLibParUInt*>(0)->_value;
+    uint ndmax = par17->getParameter<GSLibParUInt*>(1)->_value;
+    uint noct = m_gpf_sgsim->getParameter<GSLibParUInt*>(21)->_value;
+    GSLibParMultiValuedFixed *par22 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(22);
+    GSLibParMultiValuedFixed *par23 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(23);
+    SearchStrategyPtr searchStrategy = GSLibParameterFile::makeSearchStrategy( par22, par23, noct, ndmax, ndmin );
+
+    //the grid object is made before its file exists, so the simulation takes the grid geometry from it.
+    QString grid_file_path = m_gpf_sgsim->getParameter<GSLibParFile*>(13)->_path;
+    CartesianGrid simulation_grid( grid_file_path );
+    simulation_grid.setInfoFromGridParameter( m_gpf_sgsim->getParameter<GSLibParGrid*>(15) );
+
+    SequentialGaussianSimulation simulation( input_data_file, &simulation_grid );
+    GSLibParMultiValuedFixed *par1 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(1);
+    simulation.setVariable( par1->getParameter<GSLibParUInt*>(3)->_value,
+                            par1->getParameter<GSLibParUInt*>(4)->_value );
+    GSLibParMultiValuedFixed *par2 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(2);
+    simulation.setTrimmingLimits( par2->getParameter<GSLibParDouble*>(0)->_value,
+                                  par2->getParameter<GSLibParDouble*>(1)->_value );
+    simulation.setTransform( m_gpf_sgsim->getParameter<GSLibParOption*>(3)->_selected_value == 1 );
+    if( m_gpf_sgsim->getParameter<GSLibParOption*>(5)->_selected_value == 1 ){
+        //read the values and frequencies of the reference distribution.
+        QString dist_file_path = m_gpf_sgsim->getParameter<GSLibParFile*>(6)->_path;
+        GSLibParMultiValuedFixed *par7 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(7);
+        uint values_column = par7->getParameter<GSLibParUInt*>(0)->_value;
+        uint weights_column = par7->getParameter<GSLibParUInt*>(1)->_value;
+        std::vector<double> values, weights;
+        if( ! Util::readGEOEASValuesAndWeights( dist_file_path, values_column, weights_column, values, weights ) ){
+            QMessageBox::critical( this, "Error", "Could not read the reference distribution from " + dist_file_path + "." );
+            return false;
+        }
+        simulation.setReferenceDistribution( values, weights );
     }
-
+    GSLibParMultiValuedFixed *par8 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(8);
+    GSLibParMultiValuedFixed *par9 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(9);
+    GSLibParMultiValuedFixed *par10 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(10);
+    simulation.setTailExtrapolation( par8->getParameter<GSLibParDouble*>(0)->_value,
+                                     par8->getParameter<GSLibParDouble*>(1)->_value,
+                                     par9->getParameter<GSLibParOption*>(0)->_selected_value,
+                                     par9->getParameter<GSLibParDouble*>(1)->_value,
+                                     par10->getParameter<GSLibParOption*>(0)->_selected_value,
+                                     par10->getParameter<GSLibParDouble*>(1)->_value );
+    simulation.setNumberOfRealizations( m_gpf_sgsim->getParameter<GSLibParUInt*>(14)->_value );
+    simulation.setSeed( m_gpf_sgsim->getParameter<GSLibParUInt*>(16)->_value );
+    simulation.setSearchStrategy( searchStrategy );
+    simulation.setMaxSimulatedNodes( m_gpf_sgsim->getParameter<GSLibParUInt*>(18)->_value );
+    simulation.setAssignDataToNodes( m_gpf_sgsim->getParameter<GSLibParOption*>(19)->_selected_value == 1 );
+    GSLibParMultiValuedFixed *par20 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(20);
+    simulation.setMultigrid( par20->getParameter<GSLibParOption*>(0)->_selected_value == 1 ?
+                             par20->getParameter<GSLibParUInt*>(1)->_value : 0 );
+    GSLibParMultiValuedFixed *par24 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(24);
+    simulation.setCovarianceTableSize( par24->getParameter<GSLibParUInt*>(0)->_value,
+                                       par24->getParameter<GSLibParUInt*>(1)->_value,
+                                       par24->getParameter<GSLibParUInt*>(2)->_value );
+    simulation.setVariogramModel( &variogram );
+    GSLibParMultiValuedFixed *par25 = m_gpf_sgsim->getParameter<GSLibParMultiValuedFixed*>(25);
+    simulation.setKrigingType( static_cast<SequentialGaussianSimulationType>( par25->getParameter<GSLibParOption*>(0)->_selected_value ),
+                               par25->getParameter<GSLibParDouble*>(1)->_value,
+                               par25->getParameter<GSLibParDouble*>(2)->_value );
+    simulation.setSecondaryVariable( par1->getParameter<GSLibParUInt*>(5)->_value,
+                                     (CartesianGrid*)m_secVarGridSelector->getSelectedDataFile(),
+                                     m_gpf_sgsim->getParameter<GSLibParUInt*>(27)->_value );
+
+    Application::instance()->logInfo("Starting sequential Gaussian simulation...");
+    if( ! simulation.run( grid_file_path ) )
+        return false;
+    Application::instance()->logInfo("Sequential Gaussian simulation completed.");
+    return true;
 }
 
 void SGSIMDialog::onVariogramChanged()
@@ -371,14 +445,6 @@ void SGSIMDialog::onVariogramChanged()
     Application::instance()->logInfo("NOTE: The user selected a variogram model. Re-reading the variogram parameters.");
 }
 
-void SGSIMDialog::onSgsimCompletes()
-{
-    //frees all signal connections to the GSLib singleton.
-    GSLib::instance()->disconnect();
-
-    preview();
-}
-
 void SGSIMDialog::onRealizationHistogram()
 {
     //Get the Cartesian grid object.
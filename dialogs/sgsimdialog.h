@@ -19,6 +19,7 @@ class DataFile;
 class GSLibParameterFile;
 class VariogramModel;
 class CartesianGrid;
+class PointSet;
 
 
 class SGSIMDialog : public QDialog
@@ -52,6 +53,10 @@ private:
     /** Called when the user changes the variogram model, so the variogram parameters
      * in m_gpf_kt3d are read from the newly selected variogram model.*/
     void updateVariogramParameters(VariogramModel *vm );
+    /** Runs the simulation in GammaRay (see SequentialGaussianSimulation) with the parameters in m_gpf_sgsim
+     * instead of running sgsim.  The realizations are saved to the output file set in the parameters.
+     * Returns false if the simulation fails. */
+    bool runSimulation( PointSet* input_data_file );
     void preview();
     void previewPostsim();
 
@@ -59,7 +64,6 @@ private slots:
     void onGridCopySpectsSelected( DataFile* grid );
     void onConfigAndRun();
     void onVariogramChanged();
-    void onSgsimCompletes();
     void onRealizationHistogram();
     void onEnsembleHistogram();
     void onEnsembleVariogram();
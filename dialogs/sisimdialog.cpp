@@ -22,8 +22,10 @@
 #include "gslib/gslibparameterfiles/gslibparameterfile.h"
 #include "gslib/gslibparametersdialog.h"
 #include "gslib/gslib.h"
+#include "geostats/sequentialindicatorsimulation.h"
 #include "util.h"
 
+#include <QFile>
 #include <QFileInfo>
 #include <QInputDialog>
 #include <QMessageBox>
@@ -38,6 +40,7 @@ SisimDialog::SisimDialog(IKVariableType varType, QWidget *parent) :
 	m_gpf_gam( nullptr ),
 	m_gpf_postsim( nullptr ),
 	m_cg_postsim( nullptr ),
+	m_hasSimulationStatistics( false ),
 	m_DensityFunctionSecondarySelector( nullptr ),
 	m_BidistributionSelector( nullptr ),
 	m_BidistPrimaryValuesFieldSelector( nullptr ),
@@ -211,32 +214,35 @@ void SisimDialog::preview()
 
 void SisimDialog::previewPostsim()
 {
-	if( m_cg_postsim )
-		delete m_cg_postsim;
-
-    QString sisimProgram = ui->cmbProgram->currentText();
-
-    ///////// Set an offset to account for differences in parameter count between the different sisim programs/////////////////////
-    int offset = 0;
-    if( sisimProgram == "sisim" )
-        offset = 0;
-    else if ( sisimProgram == "sisim_gs" )
-        offset = -1;
-	else if ( sisimProgram == "sisim_lm" )
-		offset = -3;
-	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-	//get the tmp file path created by sgsim with the realizations
-	QString grid_file_path = m_gpf_postsim->getParameter<GSLibParFile*>(4)->_path;
-
-	//create a new grid object corresponding to the file created by sgsim
-	m_cg_postsim = new CartesianGrid( grid_file_path );
-
-	//set the grid geometry info.
-    m_cg_postsim->setInfoFromGridParameter( m_gpf_sisim->getParameter<GSLibParGrid*>(21 + offset) );
-
-	//postsim usually uses -999 as no-data-value.
-	m_cg_postsim->setNoDataValue( "-999.0" );
+	//the statistics of the realizations simulated in GammaRay are already in m_cg_postsim (see runSimulation()).
+	if( ! m_hasSimulationStatistics ){
+		if( m_cg_postsim )
+			delete m_cg_postsim;
+
+		QString sisimProgram = ui->cmbProgram->currentText();
+
+        ///////// Set an offset to account for differences in parameter count between the different sisim programs/////////////////////
+        int offset = 0;
+        if( sisimProgram == "sisim" )
+            offset = 0;
+        else if ( sisimProgram == "sisim_gs" )
+            offset = -1;
+		else if ( sisimProgram == "sisim_lm" )
+			offset = -3;
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+		//get the tmp file path created by postsim with the statistics
+		QString grid_file_path = m_gpf_postsim->getParameter<GSLibParFile*>(4)->_path;
+
+		//create a new grid object corresponding to the file created by sgsim
+		m_cg_postsim = new CartesianGrid( grid_file_path );
+
+		//set the grid geometry info.
+        m_cg_postsim->setInfoFromGridParameter( m_gpf_sisim->getParameter<GSLibParGrid*>(21 + offset) );
+
+		//postsim usually uses -999 as no-data-value.
+		m_cg_postsim->setNoDataValue( "-999.0" );
+	}
 
 	//Display all variables found in the post-processed grid
 	for( uint iVar = 0; iVar < m_cg_postsim->getDataColumnCount(); ++iVar){
@@ -721,6 +727,15 @@ void SisimDialog::onConfigureAndRun()
 
     //if user didn't cancel the dialog
     if( result == QDialog::Accepted ){
+        m_hasSimulationStatistics = false;
+
+        //sisim is run in GammaRay, sisim_gs and sisim_lm are still run as external programs.
+        if( sisimProgram == "sisim" ){
+            if( runSimulation( inputPointSet ) )
+                preview();
+            return;
+        }
+
         //Generate the parameter file
         QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath( "par" );
         m_gpf_sisim->save( par_file_path );
@@ -734,6 +749,150 @@ void SisimDialog::onConfigureAndRun()
     }
 }
 
+bool SisimDialog::runSimulation( PointSet* inputPointSet )
+{
+    //the thresholds/categories and their global c.d.f./p.d.f. values
+    uint ncat = m_gpf_sisim->getParameter<GSLibParUInt*>(1)->_value;
+    GSLibParMultiValuedVariable *par2 = m_gpf_sisim->getParameter<GSLibParMultiValuedVariable*>(2);
+    GSLibParMultiValuedVariable *par3 = m_gpf_sisim->getParameter<GSLibParMultiValuedVariable*>(3);
+    std::vector<double> thresholds, probabilities;
+    for( uint i = 0; i < ncat; ++i ){
+        thresholds.push_back( par2->getParameter<GSLibParDouble*>(i)->_value );
+        probabilities.push_back( par3->getParameter<GSLibParDouble*>(i)->_value );
+    }
+    bool isCategorical = m_gpf_sisim->getParameter<GSLibParOption*>(0)->_selected_value == 0;
+    IndicatorDistribution distribution( isCategorical, thresholds, probabilities );
+
+    //how values are drawn within the classes of continuous variables
+    if( ! isCategorical ){
+        GSLibParMultiValuedFixed *par11 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(11);
+        GSLibParMultiValuedFixed *par12 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(12);
+        GSLibParMultiValuedFixed *par13 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(13);
+        GSLibParMultiValuedFixed *par14 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(14);
+        int ltail = par12->getParameter<GSLibParOption*>(0)->_selected_value;
+        int middle = par13->getParameter<GSLibParOption*>(0)->_selected_value;
+        int utail = par14->getParameter<GSLibParOption*>(0)->_selected_value;
+        distribution.setInterpolation( par11->getParameter<GSLibParDouble*>(0)->_value,
+                                       par11->getParameter<GSLibParDouble*>(1)->_value,
+                                       ltail, par12->getParameter<GSLibParDouble*>(1)->_value,
+                                       middle, par13->getParameter<GSLibParDouble*>(1)->_value,
+                                       utail, par14->getParameter<GSLibParDouble*>(1)->_value );
+        //read the tabulated values for the interpolation between quantiles.
+        if( ltail == 3 || middle == 3 || utail == 3 ){
+            QString tab_file_path = m_gpf_sisim->getParameter<GSLibParFile*>(15)->_path;
+            GSLibParMultiValuedFixed *par16 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(16);
+            std::vector<double> values, weights;
+            if( ! Util::readGEOEASValuesAndWeights( tab_file_path,
+                                                    par16->getParameter<GSLibParUInt*>(0)->_value,
+                                                    par16->getParameter<GSLibParUInt*>(1)->_value,
+                                                    values, weights ) ){
+                QMessageBox::critical( this, "Error", "Could not read the tabulated values from " + tab_file_path + "." );
+                return false;
+            }
+            distribution.setTabulatedValues( values, weights );
+        }
+    }
+
+    //the variogram models in the sisim parameters (the user may have changed them in the parameters dialog).
+    //median IK uses only the model of the threshold closest to the median IK cutoff, as sisim does.
+    //Thresholds with identical models share the same model object, so they are kriged with the same matrix.
+    GSLibParMultiValuedFixed *par32 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(32);
+    bool isMedianIK = par32->getParameter<GSLibParOption*>(0)->_selected_value == 1;
+    uint medianThreshold = distribution.getClosestThreshold( par32->getParameter<GSLibParDouble*>(1)->_value );
+    GSLibParRepeat *par34 = m_gpf_sisim->getParameter<GSLibParRepeat*>(34);
+    std::vector<VariogramModel*> distinctVariograms;
+    std::vector<VariogramModel*> variograms = GSLibParameterFile::makeVariogramModels( par34, isMedianIK ? medianThreshold : 0,
+                                                                                       isMedianIK ? 1 : ncat,
+                                                                                       distinctVariograms );
+
+    //build the search strategy from the sisim search parameters.  The octant search is done with
+    //eight sectors of the search ellipsoid.  sisim simulates from the global distribution only the
+    //nodes without any sample.
+    uint ndmax = m_gpf_sisim->getParameter<GSLibParUInt*>(23)->_value;
+    uint noct = m_gpf_sisim->getParameter<GSLibParUInt*>(28)->_value;
+    GSLibParMultiValuedFixed *par29 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(29);
+    GSLibParMultiValuedFixed *par30 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(30);
+    SearchStrategyPtr searchStrategy = GSLibParameterFile::makeSearchStrategy( par29, par30, noct, ndmax, 1 );
+
+    //the grid object is made before its file exists, so the simulation takes the grid geometry from it.
+    QString grid_file_path = m_gpf_sisim->getParameter<GSLibParFile*>(19)->_path;
+    CartesianGrid simulation_grid( grid_file_path );
+    simulation_grid.setInfoFromGridParameter( m_gpf_sisim->getParameter<GSLibParGrid*>(21) );
+
+    SequentialIndicatorSimulation simulation( inputPointSet, &simulation_grid );
+    simulation.setVariable( m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(5)->getParameter<GSLibParUInt*>(3)->_value );
+    PointSet *psSoftData = static_cast<PointSet*>( m_SoftDataSetSelector->getSelectedFile() );
+    if( psSoftData ){
+        GSLibParMultiValuedVariable *par7_3 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(7)
+                                                          ->getParameter<GSLibParMultiValuedVariable*>(3);
+        std::vector<uint> softColumns;
+        for( uint i = 0; i < ncat; ++i )
+            softColumns.push_back( par7_3->getParameter<GSLibParUInt*>(i)->_value );
+        simulation.setSoftIndicators( psSoftData, softColumns );
+        GSLibParMultiValuedVariable *par9 = m_gpf_sisim->getParameter<GSLibParMultiValuedVariable*>(9);
+        std::vector<double> calibrations;
+        for( uint i = 0; i < ncat; ++i )
+            calibrations.push_back( par9->getParameter<GSLibParDouble*>(i)->_value );
+        simulation.setMarkovBayes( m_gpf_sisim->getParameter<GSLibParOption*>(8)->_selected_value == 1, calibrations );
+        simulation.setMaxSoftData( m_gpf_sisim->getParameter<GSLibParUInt*>(25)->_value );
+    }
+    GSLibParMultiValuedFixed *par10 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(10);
+    simulation.setTrimmingLimits( par10->getParameter<GSLibParDouble*>(0)->_value,
+                                  par10->getParameter<GSLibParDouble*>(1)->_value );
+    simulation.setDistribution( distribution );
+    simulation.setNumberOfRealizations( m_gpf_sisim->getParameter<GSLibParUInt*>(20)->_value );
+    simulation.setSeed( m_gpf_sisim->getParameter<GSLibParUInt*>(22)->_value );
+    simulation.setSearchStrategy( searchStrategy );
+    simulation.setMaxSimulatedNodes( m_gpf_sisim->getParameter<GSLibParUInt*>(24)->_value );
+    simulation.setAssignDataToNodes( m_gpf_sisim->getParameter<GSLibParOption*>(26)->_selected_value == 1 );
+    GSLibParMultiValuedFixed *par27 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(27);
+    simulation.setMultigrid( par27->getParameter<GSLibParOption*>(0)->_selected_value == 1 ?
+                             par27->getParameter<GSLibParUInt*>(1)->_value : 0 );
+    GSLibParMultiValuedFixed *par31 = m_gpf_sisim->getParameter<GSLibParMultiValuedFixed*>(31);
+    simulation.setCovarianceTableSize( par31->getParameter<GSLibParUInt*>(0)->_value,
+                                       par31->getParameter<GSLibParUInt*>(1)->_value,
+                                       par31->getParameter<GSLibParUInt*>(2)->_value );
+    simulation.setVariogramModels( variograms );
+    simulation.setKrigingType( static_cast<SequentialIndicatorSimulationType>(
+                                   m_gpf_sisim->getParameter<GSLibParOption*>(33)->_selected_value ) );
+
+    Application::instance()->logInfo("Starting sequential indicator simulation...");
+    bool ok = simulation.run( grid_file_path );
+    for( VariogramModel* variogram : distinctVariograms )
+        delete variogram;
+    if( ! ok )
+        return false;
+    Application::instance()->logInfo("Sequential indicator simulation completed.");
+
+    //the statistics of the realizations computed by the simulation are saved from memory to a tmp grid file,
+    //which is previewed and imported as postsim's results.
+    std::vector<QString> columnNames;
+    std::vector< std::vector<double> > columns;
+    if( isCategorical ){
+        size_t nCells = (size_t)simulation_grid.getNX() * simulation_grid.getNY() * simulation_grid.getNZ();
+        const std::vector<double>& frequencies = simulation.getFrequencies();
+        columns.assign( ncat, std::vector<double>( nCells ) );
+        for( uint i = 0; i < ncat; ++i ){
+            columnNames.push_back( "Probability_of_" + QString::number( thresholds[i] ) );
+            for( size_t iCell = 0; iCell < nCells; ++iCell )
+                columns[i][iCell] = frequencies[ iCell * ncat + i ];
+        }
+    } else {
+        columnNames.push_back( "E-type" );
+        columnNames.push_back( "ConditionalVariance" );
+        columns.push_back( simulation.getMeans() );
+        columns.push_back( simulation.getVariances() );
+    }
+    if( m_cg_postsim )
+        delete m_cg_postsim;
+    m_cg_postsim = new CartesianGrid( Application::instance()->getProject()->generateUniqueTmpFilePath("dat") );
+    m_cg_postsim->setInfoFromGridParameter( m_gpf_sisim->getParameter<GSLibParGrid*>(21) );
+    m_cg_postsim->setNoDataValue( "-999.0" );
+    Util::saveGridColumns( m_cg_postsim, columnNames, columns );
+    m_hasSimulationStatistics = true;
+    return true;
+}
+
 void SisimDialog::onSisimCompletes()
 {
     //frees all signal connections to the GSLib singleton.
@@ -1177,14 +1336,16 @@ void SisimDialog::onSaveEnsemble()
             CategoryDefinition* cd = pdf->getCategoryDefinition();
             //Get the simulated values
             std::vector< double > values = m_cg_simulation->getDataColumn(0);
+            //the column changes below are written to file in a single pass
+            m_cg_simulation->beginColumnEdits();
             //Duplicate it as a new column with the categorical definition
             m_cg_simulation->addNewDataColumn( m_InputVariableSelector->getSelectedVariableName(),
                                                values,
                                                cd);
-            //write to file
-            m_cg_simulation->saveData();
             //remove the first column not linked to a categorical definition
             m_cg_simulation->deleteVariable(0);
+            //write to file
+            m_cg_simulation->commitColumnEdits();
         }
 
         //import the newly created grid file as a project item
@@ -1194,6 +1355,12 @@ void SisimDialog::onSaveEnsemble()
 
 void SisimDialog::onPostsim()
 {
+	//the realizations simulated in GammaRay already have their statistics computed.
+	if( m_hasSimulationStatistics ){
+		previewPostsim();
+		return;
+	}
+
 	//load the data in grid
 	m_cg_simulation->loadData();
 
@@ -1247,13 +1414,17 @@ void SisimDialog::onSavePostsim()
 	bool ok;
 
 	//part of the suggested name for the grid depends on the post-processed product type
-	GSLibParMultiValuedFixed* postsim_par5 = m_gpf_postsim->getParameter<GSLibParMultiValuedFixed*>(5);
 	QString postsimType;
-	switch( postsim_par5->getParameter<GSLibParOption*>(0)->_selected_value ){
-	case 1: postsimType = "EType"; break;
-	case 2: postsimType = "ProbMeanAb" + QString::number(postsim_par5->getParameter<GSLibParDouble*>(1)->_value); break;
-	case 3: postsimType = "P" + QString::number(postsim_par5->getParameter<GSLibParDouble*>(1)->_value * 100); break;
-	case 4: postsimType = "SymmProbIntervFor" + QString::number(postsim_par5->getParameter<GSLibParDouble*>(1)->_value);
+	if( m_hasSimulationStatistics )
+		postsimType = m_varType == IKVariableType::CONTINUOUS ? "EType" : "Probabilities";
+	else {
+		GSLibParMultiValuedFixed* postsim_par5 = m_gpf_postsim->getParameter<GSLibParMultiValuedFixed*>(5);
+		switch( postsim_par5->getParameter<GSLibParOption*>(0)->_selected_value ){
+		case 1: postsimType = "EType"; break;
+		case 2: postsimType = "ProbMeanAb" + QString::number(postsim_par5->getParameter<GSLibParDouble*>(1)->_value); break;
+		case 3: postsimType = "P" + QString::number(postsim_par5->getParameter<GSLibParDouble*>(1)->_value * 100); break;
+		case 4: postsimType = "SymmProbIntervFor" + QString::number(postsim_par5->getParameter<GSLibParDouble*>(1)->_value);
+		}
 	}
 
 	//propose a name based the postsim product selected by the user.
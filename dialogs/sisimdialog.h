@@ -8,6 +8,7 @@ class GSLibParGrid;
 class WidgetGSLibParGrid;
 class DataFile;
 class DistributionFieldSelector;
+class PointSet;
 
 namespace Ui {
 class SisimDialog;
@@ -45,11 +46,17 @@ private:
     GSLibParameterFile* m_gpf_gam;
 	GSLibParameterFile* m_gpf_postsim;
 	CartesianGrid* m_cg_postsim;
+    /** Whether m_cg_postsim holds the E-type estimates and conditional variances or the category frequencies computed
+     * with the realizations simulated in GammaRay (false if they were simulated by a GSLib program). */
+    bool m_hasSimulationStatistics;
     ///--------------private methods----------------------------
     void addVariogramSelector();
     void preview();
 	void previewPostsim();
     void configureSoftDataUI();
+    /** Simulates the realizations with GammaRay's sequential indicator simulation (instead of GSLib's sisim)
+     * with the sisim parameters, saving them to sisim's output file.  Returns false if it did not complete. */
+    bool runSimulation( PointSet* inputPointSet );
 
 private Q_SLOTS:
     void onUpdateSoftIndicatorVariablesSelectors();
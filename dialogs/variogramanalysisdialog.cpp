@@ -10,6 +10,8 @@
 #include "domain/project.h"
 #include "domain/attribute.h"
 #include "domain/application.h"
+#include "geostats/experimentalvariogramcalculator.h"
+#include "geostats/gridvariogramcalculator.h"
 #include "realizationselectiondialog.h"
 #include <QMessageBox>
 #include "displayplotdialog.h"
@@ -215,6 +217,14 @@ void VariogramAnalysisDialog::onOpenVarMapParameters()
     GSLibParametersDialog gslibpardiag( m_gpf_varmap );
     int result = gslibpardiag.exec();
     if( result == QDialog::Accepted ){
+        //variogram maps of gridded data are computed in process with FFT (same output file of varmap)
+        if( m_gpf_varmap->getParameter<GSLibParOption*>(3)->_selected_value == 1 ){
+            Application::instance()->logInfo("Computing variogram map...");
+            CartesianGrid* cgrid = (CartesianGrid*)m_head->getContainingFile();
+            if( GridVariogramCalculator::runVarmap( m_gpf_varmap, cgrid ) )
+                onOpenVarMapPlot();
+            return;
+        }
         //Generate the parameter file
         QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath("par");
         m_gpf_varmap->save( par_file_path );
@@ -805,27 +815,67 @@ void VariogramAnalysisDialog::onGamv()
 
     //--------------------------------------------------------------------------------
 
-    //show the parameter dialog so the user can adjust other settings before running gamv
+    //show the parameter dialog so the user can adjust other settings before computing the variograms
     GSLibParametersDialog gslibpardiag( m_gpf_gamv );
     int result = gslibpardiag.exec();
     if( result == QDialog::Accepted ){
-        //Generate the parameter file
-        QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath("par");
-        m_gpf_gamv->save( par_file_path );
-        //to be notified when gamv completes.
-        connect( GSLib::instance(), SIGNAL(programFinished()), this, SLOT(onGamvCompletion()) );
-        //run gamv program asynchronously (user can see the program outputs while it runs)
-        Application::instance()->logInfo("Starting gamv program...");
-        GSLib::instance()->runProgramAsync( "gamv", par_file_path );
-    }
-}
+        //the experimental variograms are computed in process (same algorithm and output file of gamv)
+        PointSet* input_data_file = (PointSet*)m_head->getContainingFile();
+        ExperimentalVariogramCalculator calculator( input_data_file );
 
-void VariogramAnalysisDialog::onGamvCompletion()
-{
-    //frees all signal connections to the GSLib singleton.
-    GSLib::instance()->disconnect();
-    //when gamv completes, call vargplt.
-    onVargpltExperimentalIrregular();
+        GSLibParMultiValuedFixed* par1 = m_gpf_gamv->getParameter<GSLibParMultiValuedFixed*>(1);
+        calculator.setCoordinateColumns( par1->getParameter<GSLibParUInt*>(0)->_value,
+                                         par1->getParameter<GSLibParUInt*>(1)->_value,
+                                         par1->getParameter<GSLibParUInt*>(2)->_value );
+
+        GSLibParMultiValuedFixed *par2 = m_gpf_gamv->getParameter<GSLibParMultiValuedFixed*>(2);
+        GSLibParMultiValuedVariable *par2_1 = par2->getParameter<GSLibParMultiValuedVariable*>(1);
+        for( int i = 0; i < par2_1->_parameters.size(); ++i )
+            calculator.addVariable( par2_1->getParameter<GSLibParUInt*>(i)->_value );
+
+        GSLibParMultiValuedFixed *par3 = m_gpf_gamv->getParameter<GSLibParMultiValuedFixed*>(3);
+        calculator.setTrimmingLimits( par3->getParameter<GSLibParDouble*>(0)->_value,
+                                      par3->getParameter<GSLibParDouble*>(1)->_value );
+
+        calculator.setLags( m_gpf_gamv->getParameter<GSLibParUInt*>(5)->_value,
+                            m_gpf_gamv->getParameter<GSLibParDouble*>(6)->_value,
+                            m_gpf_gamv->getParameter<GSLibParDouble*>(7)->_value );
+
+        GSLibParRepeat *par9 = m_gpf_gamv->getParameter<GSLibParRepeat*>(9); //repeat ndir-times
+        uint ndir = m_gpf_gamv->getParameter<GSLibParUInt*>(8)->_value;
+        for( uint i = 0; i < ndir; ++i ){
+            GSLibParMultiValuedFixed *par9_0 = par9->getParameter<GSLibParMultiValuedFixed*>(i, 0);
+            VariogramDirection direction;
+            direction.azimuth = par9_0->getParameter<GSLibParDouble*>(0)->_value;
+            direction.azimuthTolerance = par9_0->getParameter<GSLibParDouble*>(1)->_value;
+            direction.horizontalBandwidth = par9_0->getParameter<GSLibParDouble*>(2)->_value;
+            direction.dip = par9_0->getParameter<GSLibParDouble*>(3)->_value;
+            direction.dipTolerance = par9_0->getParameter<GSLibParDouble*>(4)->_value;
+            direction.verticalBandwidth = par9_0->getParameter<GSLibParDouble*>(5)->_value;
+            calculator.addDirection( direction );
+        }
+
+        calculator.setStandardizeSills( m_gpf_gamv->getParameter<GSLibParOption*>(10)->_selected_value == 1 );
+
+        GSLibParRepeat *par12 = m_gpf_gamv->getParameter<GSLibParRepeat*>(12); //repeat nvarios-times
+        uint nvarios = m_gpf_gamv->getParameter<GSLibParUInt*>(11)->_value;
+        for( uint i = 0; i < nvarios; ++i ){
+            GSLibParMultiValuedFixed *par12_0 = par12->getParameter<GSLibParMultiValuedFixed*>(i, 0);
+            VariogramDefinition variogram;
+            variogram.tailVariable = par12_0->getParameter<GSLibParUInt*>(0)->_value;
+            variogram.headVariable = par12_0->getParameter<GSLibParUInt*>(1)->_value;
+            variogram.type = par12_0->getParameter<GSLibParOption*>(2)->_selected_value;
+            variogram.cutoff = par12_0->getParameter<GSLibParDouble*>(3)->_value;
+            calculator.addVariogram( variogram );
+        }
+
+        Application::instance()->logInfo("Computing experimental variograms...");
+        if( calculator.run() && calculator.save( m_gpf_gamv->getParameter<GSLibParFile*>(4)->_path ) ){
+            Application::instance()->logInfo("Experimental variograms computed.");
+            //plot the results as if gamv had run.
+            onVargpltExperimentalIrregular();
+        }
+    }
 }
 
 void VariogramAnalysisDialog::onVarmapCompletion()
@@ -1150,16 +1200,14 @@ void VariogramAnalysisDialog::onGam(bool forMultipleRealizations)
     GSLibParametersDialog gslibpardiag( m_gpf_gam );
     int result = gslibpardiag.exec();
     if( result == QDialog::Accepted ){
+        CartesianGrid* input_data_file = (CartesianGrid*)m_head->getContainingFile();
         //standard usage for variogram modeling (one variogram, single realization)
         if( ! forMultipleRealizations ){
 
-            //Generate the parameter file
-            QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath("par");
-            m_gpf_gam->save( par_file_path );
-            //run gam program
-            Application::instance()->logInfo("Starting gam program...");
-            GSLib::instance()->runProgram( "gam", par_file_path );
-            onVargpltExperimentalRegular();
+            //compute the variograms in process (same algorithm and output file of gam)
+            Application::instance()->logInfo("Computing experimental variograms...");
+            if( GridVariogramCalculator::runGam( m_gpf_gam, input_data_file ) )
+                onVargpltExperimentalRegular();
 
         } else { //usage for simulation validation (plot of several realization variograms)
 
@@ -1177,13 +1225,10 @@ void VariogramAnalysisDialog::onGam(bool forMultipleRealizations)
                 m_gpf_gam->getParameter<GSLibParFile*>(3)->_path =
                         Application::instance()->getProject()->generateUniqueTmpFilePath("out");
                 expVarFilePaths.push_back( m_gpf_gam->getParameter<GSLibParFile*>(3)->_path );
-                //...Generate the parameter file
-                QString par_file_path = Application::instance()->getProject()->generateUniqueTmpFilePath("par");
-                m_gpf_gam->save( par_file_path );
-                //...run gam program
-                Application::instance()->logInfo("Starting gam program for realization " +
+                //...compute the variograms
+                Application::instance()->logInfo("Computing experimental variograms for realization " +
                                                  QString::number(realNum) + "...");
-                GSLib::instance()->runProgram( "gam", par_file_path );
+                GridVariogramCalculator::runGam( m_gpf_gam, input_data_file );
             }
             //restore the realization number setting for the variogram modeling workflow
             m_gpf_gam->getParameter<GSLibParUInt*>(4)->_value = oldNReal;
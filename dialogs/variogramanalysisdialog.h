@@ -65,7 +65,6 @@ private slots:
     void onVarNReals();
     // the slots below are called indirectly.
     void onGamv();
-    void onGamvCompletion();
     void onVarmapCompletion();
     void onVargpltExperimentalIrregular();
     void onVargpltExperimentalRegular();
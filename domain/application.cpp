@@ -79,6 +79,23 @@ void Application::setMaxGridCellCountFor3DVisualizationSetting(int value)
     qs.setValue("maxcellgrid3dview", value);
 }
 
+int Application::getMappedDataMemoryBudgetSetting()
+{
+    QSettings qs;
+    bool ok;
+    int setting = qs.value("mappeddatamemorybudget").toInt( &ok );
+    if( ! ok )
+        return 4096; //default
+    else
+        return setting;
+}
+
+void Application::setMappedDataMemoryBudgetSetting(int value)
+{
+    QSettings qs;
+    qs.setValue("mappeddatamemorybudget", value);
+}
+
 void Application::logInfo(const QString text, bool showMessageBox)
 {
     Q_ASSERT(_mw != 0);
@@ -80,6 +80,13 @@ public:
     void setMaxGridCellCountFor3DVisualizationSetting(int value);
     //!@}
 
+    //!@{
+    //! Reads and saves the physical memory usage (in MiB) beyond which memory-mapped data pages
+    //! are released (see DataFileBinaryCache).
+    int getMappedDataMemoryBudgetSetting();
+    void setMappedDataMemoryBudgetSetting(int value);
+    //!@}
+
     /**
      * @brief Treats the text as an information text.
      */
@@ -35,6 +35,14 @@ void Attribute::setCategorical(bool value)
     _categorical = value;
 }
 
+ColumnStatistics Attribute::getStatistics()
+{
+    File* file = getContainingFile();
+    if( ! file || ! file->isDataFile() )
+        return ColumnStatistics();
+    return static_cast<DataFile*>( file )->getColumnStatistics( getAttributeGEOEASgivenIndex() - 1 );
+}
+
 
 QString Attribute::getName() const
 {
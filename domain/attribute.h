@@ -3,6 +3,7 @@
 #include "projectcomponent.h"
 #include "imagejockey/ijabstractvariable.h"
 #include "calculator/icalcproperty.h"
+#include "auxiliary/columnstatistics.h"
 #include <QString>
 
 class File;
@@ -31,6 +32,13 @@ public:
     /** Sets whether this attribute was considered as a categorical variable. */
     void setCategorical( bool value );
 
+    /**
+     * Returns the summary statistics (min, max, mean, variance, etc.) of this attribute's values
+     * cached by the containing data file (see DataFile::getColumnStatistics()).
+     * Returns the statistics of no values if the attribute is not in a data file or its data is not loaded.
+     */
+    ColumnStatistics getStatistics();
+
     // ProjectComponent interface
 public:
 	virtual QString getName() const;
@@ -0,0 +1,157 @@
+#include "columnardatastore.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+ColumnarDataStore::ColumnarDataStore() :
+    m_rowCount( 0 ),
+    m_rowCapacity( 0 )
+{
+}
+
+ColumnarDataStore::~ColumnarDataStore()
+{
+}
+
+void ColumnarDataStore::reset(size_t columnCount, size_t rowCapacity)
+{
+    clear();
+    m_columns.resize( columnCount );
+    for( Column& column : m_columns )
+        reallocate( column, rowCapacity, 0 );
+    m_rowCapacity = rowCapacity;
+}
+
+void ColumnarDataStore::reserveRows(size_t rowCapacity)
+{
+    if( rowCapacity <= m_rowCapacity )
+        return;
+    for( Column& column : m_columns )
+        reallocate( column, rowCapacity, m_rowCount );
+    m_rowCapacity = rowCapacity;
+    //all columns are now in memory owned by this object
+    m_externalMemoryOwner.reset();
+}
+
+void ColumnarDataStore::resizeRows(size_t rowCount, double fillValue)
+{
+    if( rowCount > m_rowCapacity )
+        //grow geometrically so row-by-row appending has amortized constant cost
+        reserveRows( std::max( rowCount, m_rowCapacity + m_rowCapacity / 2 ) );
+    if( rowCount > m_rowCount )
+        for( Column& column : m_columns ){
+            if( ! column.isWritable )
+                makeWritable( column );
+            std::fill( column.values + m_rowCount, column.values + rowCount, fillValue );
+        }
+    m_rowCount = rowCount;
+}
+
+size_t ColumnarDataStore::appendColumn(double fillValue)
+{
+    return appendColumn( nullptr, 0, fillValue );
+}
+
+size_t ColumnarDataStore::appendColumn(const double *values, size_t count, double fillValue)
+{
+    //the first column defines the number of rows
+    if( m_columns.empty() ){
+        m_rowCount = count;
+        m_rowCapacity = std::max( m_rowCapacity, count );
+    }
+    m_columns.push_back( Column() );
+    Column& column = m_columns.back();
+    reallocate( column, m_rowCapacity, 0 );
+    size_t nToCopy = std::min( count, m_rowCount );
+    if( nToCopy )
+        std::memcpy( column.values, values, nToCopy * sizeof(double) );
+    std::fill( column.values + nToCopy, column.values + m_rowCount, fillValue );
+    return m_columns.size() - 1;
+}
+
+void ColumnarDataStore::removeColumn(size_t column)
+{
+    m_columns.erase( m_columns.begin() + column );
+    if( m_columns.empty() ){
+        m_rowCount = 0;
+        m_rowCapacity = 0;
+        m_externalMemoryOwner.reset();
+    }
+}
+
+void ColumnarDataStore::removeRow(size_t row)
+{
+    makeAllWritable();
+    for( Column& column : m_columns )
+        std::memmove( column.values + row, column.values + row + 1, ( m_rowCount - row - 1 ) * sizeof(double) );
+    --m_rowCount;
+}
+
+void ColumnarDataStore::removeRows(const std::vector<size_t> &rows)
+{
+    if( rows.empty() )
+        return;
+    makeAllWritable();
+    for( Column& column : m_columns ){
+        //shifts the values between removed rows towards the beginning in a single pass
+        size_t iDestination = rows[0];
+        for( size_t iRemoved = 0; iRemoved < rows.size(); ++iRemoved ){
+            size_t iFirstKept = rows[iRemoved] + 1;
+            size_t iLastKept = ( iRemoved + 1 < rows.size() ) ? rows[iRemoved + 1] : m_rowCount;
+            std::memmove( column.values + iDestination, column.values + iFirstKept, ( iLastKept - iFirstKept ) * sizeof(double) );
+            iDestination += iLastKept - iFirstKept;
+        }
+    }
+    m_rowCount -= rows.size();
+}
+
+void ColumnarDataStore::clear()
+{
+    m_columns.clear();
+    //clear() may not actually free memory
+    std::vector<Column>().swap( m_columns );
+    m_rowCount = 0;
+    m_rowCapacity = 0;
+    m_externalMemoryOwner.reset();
+}
+
+void ColumnarDataStore::adoptExternalColumns(const std::vector<double *> &columns, size_t rowCount,
+                                             std::shared_ptr<void> owner, bool isWritable)
+{
+    clear();
+    m_columns.resize( columns.size() );
+    for( size_t iColumn = 0; iColumn < columns.size(); ++iColumn ){
+        m_columns[iColumn].values = columns[iColumn];
+        m_columns[iColumn].isWritable = isWritable;
+    }
+    m_rowCount = rowCount;
+    m_rowCapacity = rowCount;
+    m_externalMemoryOwner = owner;
+}
+
+void ColumnarDataStore::reallocate(ColumnarDataStore::Column &column, size_t capacity, size_t count)
+{
+    //over-allocate so the first value can be moved to an aligned address
+    std::unique_ptr<char[]> buffer( new char[ capacity * sizeof(double) + ALIGNMENT ] );
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>( buffer.get() );
+    std::uintptr_t alignedAddress = ( address + ALIGNMENT - 1 ) & ~( std::uintptr_t( ALIGNMENT ) - 1 );
+    double* values = reinterpret_cast<double*>( alignedAddress );
+    if( count )
+        std::memcpy( values, column.values, count * sizeof(double) );
+    column.buffer.swap( buffer );
+    column.values = values;
+    column.isWritable = true;
+}
+
+void ColumnarDataStore::makeWritable(ColumnarDataStore::Column &column)
+{
+    //the external memory is still kept by m_externalMemoryOwner, as other columns may refer to it.
+    reallocate( column, m_rowCapacity, m_rowCount );
+}
+
+void ColumnarDataStore::makeAllWritable()
+{
+    for( Column& column : m_columns )
+        if( ! column.isWritable )
+            makeWritable( column );
+}
@@ -0,0 +1,170 @@
+#ifndef COLUMNARDATASTORE_H
+#define COLUMNARDATASTORE_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+/**
+ * The DataColumnSpan class is a read-only view of the values of a data column.
+ * The values are contiguous in memory, so a loop over a span is a sequential memory stream.
+ * A span is invalidated by any operation that changes the number of rows or columns of the
+ * data store it refers to.
+ */
+class DataColumnSpan
+{
+public:
+    DataColumnSpan() : m_values( nullptr ), m_size( 0 ) {}
+    DataColumnSpan( const double* values, size_t size ) : m_values( values ), m_size( size ) {}
+
+    const double* data() const { return m_values; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const double* begin() const { return m_values; }
+    const double* end() const { return m_values + m_size; }
+    double operator[]( size_t i ) const { return m_values[i]; }
+
+private:
+    const double* m_values;
+    size_t m_size;
+};
+
+/**
+ * The ColumnarDataStore class is the in-memory data table of DataFile objects.
+ * The values are stored in column-major order: each column (variable) is a single block of doubles
+ * aligned to ALIGNMENT bytes.  This replaces the former vector-of-vectors table (one heap allocation
+ * per data row), so scanning a variable of a large grid no longer chases row pointers.
+ * @note The accessors do not check bounds.  It is up to client code to use valid row and column indexes.
+ */
+class ColumnarDataStore
+{
+public:
+    /** Alignment in bytes of the column buffers (a cache line, also suitable for wide SIMD loads). */
+    static const size_t ALIGNMENT = 64;
+
+    ColumnarDataStore();
+    ~ColumnarDataStore();
+
+    ColumnarDataStore( const ColumnarDataStore& ) = delete;
+    ColumnarDataStore& operator=( const ColumnarDataStore& ) = delete;
+
+    /** Returns the number of data rows (records). */
+    size_t getRowCount() const { return m_rowCount; }
+
+    /** Returns the number of data columns (variables). */
+    size_t getColumnCount() const { return m_columns.size(); }
+
+    /** Returns the number of rows that fit in the currently allocated memory. */
+    size_t getRowCapacity() const { return m_rowCapacity; }
+
+    /** Returns whether there are no data rows. */
+    bool empty() const { return m_rowCount == 0; }
+
+    /** Returns the value at the given row and column (both zero-based). */
+    inline double get( size_t row, size_t column ) const { return m_columns[column].values[row]; }
+
+    /** Sets the value at the given row and column (both zero-based). */
+    inline void set( size_t row, size_t column, double value ) {
+        Column& c = m_columns[column];
+        if( ! c.isWritable )
+            makeWritable( c );
+        c.values[row] = value;
+    }
+
+    /** Returns a pointer to the first value of the given column. */
+    inline double* column( size_t column ) {
+        Column& c = m_columns[column];
+        if( ! c.isWritable )
+            makeWritable( c );
+        return c.values;
+    }
+    inline const double* column( size_t column ) const { return m_columns[column].values; }
+
+    /** Returns a read-only view of the given column. */
+    DataColumnSpan getColumnSpan( size_t column ) const
+    { return DataColumnSpan( m_columns[column].values, m_rowCount ); }
+
+    /**
+     * Frees the current data and sets the store up with the given number of columns and zero rows.
+     * @param rowCapacity Number of rows to pre-allocate in each column, so subsequent calls to
+     *                    resizeRows() up to this amount do not cause reallocations.
+     */
+    void reset( size_t columnCount, size_t rowCapacity );
+
+    /** Makes sure there is room for the given number of rows without reallocation. */
+    void reserveRows( size_t rowCapacity );
+
+    /** Changes the number of rows.  New rows, if any, are filled with the given value. */
+    void resizeRows( size_t rowCount, double fillValue = 0.0 );
+
+    /** Appends a new column filled with the given value.  Returns the index of the new column. */
+    size_t appendColumn( double fillValue );
+
+    /**
+     * Appends a new column with the given values.  If there are less values than rows, the remaining
+     * elements are filled with fillValue.  Excess values are ignored.  If the store has no columns yet,
+     * the number of rows becomes count.  Returns the index of the new column.
+     */
+    size_t appendColumn( const double* values, size_t count, double fillValue );
+
+    /** Removes the given column. */
+    void removeColumn( size_t column );
+
+    /** Removes the given row. */
+    void removeRow( size_t row );
+
+    /** Removes the given rows.  The row indexes must be unique and in ascending order. */
+    void removeRows( const std::vector<size_t>& rows );
+
+    /** Removes all rows and columns and frees the memory. */
+    void clear();
+
+    /**
+     * Replaces the current data with columns residing in memory not allocated by this object
+     * (e.g. a memory-mapped binary file, see DataFileBinaryCache).  External columns are aligned
+     * only if the given pointers are.
+     * @param columns Pointers to the first value of each column.
+     * @param rowCount Number of values in each column.
+     * @param owner Object that keeps the memory valid.  It is released when the store no longer
+     *              refers to the external memory (e.g. clear() or reset()).
+     * @param isWritable If false (e.g. a read-only mapping), the values of a column are copied to memory
+     *                   owned by this object on the first change to it (copy-on-write), so the external
+     *                   memory is never written to.
+     * @note Operations that need more rows than rowCount move the columns to memory owned by
+     *       this object.
+     */
+    void adoptExternalColumns( const std::vector<double*>& columns, size_t rowCount,
+                               std::shared_ptr<void> owner, bool isWritable = true );
+
+    /** Returns whether the values reside in external memory (see adoptExternalColumns()). */
+    bool hasExternalColumns() const { return m_externalMemoryOwner != nullptr; }
+
+private:
+    /** A column buffer.  values points to the first ALIGNMENT-aligned position in buffer.
+     * Columns in external memory have a null buffer. */
+    struct Column {
+        Column() : values( nullptr ), isWritable( true ) {}
+        std::unique_ptr<char[]> buffer;
+        double* values;
+        bool isWritable; //false for columns in read-only external memory
+    };
+
+    std::vector<Column> m_columns;
+    size_t m_rowCount;
+    size_t m_rowCapacity;
+
+    /** Keeps the memory of external columns valid (see adoptExternalColumns()). */
+    std::shared_ptr<void> m_externalMemoryOwner;
+
+    /** Allocates an aligned buffer for capacity values and copies the first count values of
+     * the column's current buffer (if any) to it. */
+    static void reallocate( Column& column, size_t capacity, size_t count );
+
+    /** Copies the values of a column in read-only external memory to memory owned by this object. */
+    void makeWritable( Column& column );
+
+    /** Calls makeWritable() for all columns in read-only external memory. */
+    void makeAllWritable();
+};
+
+#endif // COLUMNARDATASTORE_H
@@ -0,0 +1,77 @@
+#include "columnstatistics.h"
+#include "columnardatastore.h"
+#include "ndvpredicate.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    /** Number of values accumulated before merging into the running statistics.  Small enough to stay in L1 cache. */
+    const size_t BLOCK_SIZE = 1024;
+}
+
+ColumnStatistics::ColumnStatistics() :
+    min( std::numeric_limits<double>::max() ),
+    max( -std::numeric_limits<double>::max() ),
+    minAbs( std::numeric_limits<double>::max() ),
+    maxAbs( 0.0 ),
+    mean( 0.0 ),
+    variance( std::numeric_limits<double>::quiet_NaN() ),
+    count( 0 ),
+    ndvCount( 0 )
+{
+}
+
+ColumnStatistics ColumnStatistics::compute(const DataColumnSpan &values, const NDVPredicate &isNDV)
+{
+    ColumnStatistics result;
+    double runningMean = 0.0;
+    double runningM2 = 0.0; //sum of squared deviations from the running mean
+    double block[BLOCK_SIZE];
+    for( size_t iBlockBegin = 0; iBlockBegin < values.size(); iBlockBegin += BLOCK_SIZE ){
+        size_t iBlockEnd = std::min( values.size(), iBlockBegin + BLOCK_SIZE );
+        //gather the valid values of the block, updating the extrema
+        size_t nValid = 0;
+        for( size_t i = iBlockBegin; i < iBlockEnd; ++i ){
+            const double value = values[i];
+            if( isNDV( value ) ){
+                ++result.ndvCount;
+                continue;
+            }
+            block[nValid++] = value;
+            const double absValue = std::abs( value );
+            //the comparisons are written so NaNs never become extrema
+            if( value < result.min )
+                result.min = value;
+            if( value > result.max )
+                result.max = value;
+            if( absValue < result.minAbs )
+                result.minAbs = absValue;
+            if( absValue > result.maxAbs )
+                result.maxAbs = absValue;
+        }
+        if( ! nValid )
+            continue;
+        //mean and sum of squared deviations of the block (two passes over cached values)
+        double blockSum = 0.0;
+        for( size_t i = 0; i < nValid; ++i )
+            blockSum += block[i];
+        const double blockMean = blockSum / nValid;
+        double blockM2 = 0.0;
+        for( size_t i = 0; i < nValid; ++i ){
+            const double deviation = block[i] - blockMean;
+            blockM2 += deviation * deviation;
+        }
+        //merge the block into the running statistics
+        const size_t newCount = result.count + nValid;
+        const double delta = blockMean - runningMean;
+        runningMean += delta * nValid / newCount;
+        runningM2 += blockM2 + delta * delta * ( (double)result.count * nValid / newCount );
+        result.count = newCount;
+    }
+    if( result.count ){
+        result.mean = runningMean;
+        result.variance = runningM2 / result.count;
+    }
+    return result;
+}
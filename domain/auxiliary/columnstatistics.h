@@ -0,0 +1,46 @@
+#ifndef COLUMNSTATISTICS_H
+#define COLUMNSTATISTICS_H
+
+#include <cstddef>
+
+class DataColumnSpan;
+class NDVPredicate;
+
+/**
+ * The ColumnStatistics class holds the summary statistics of a data column, which are all computed
+ * in a single pass over the values (see compute()).  DataFile keeps one object per column to serve
+ * repeated calls to DataFile::min(), DataFile::max(), DataFile::mean(), etc. without rescanning the data.
+ * No-data values are excluded from all statistics.
+ */
+class ColumnStatistics
+{
+public:
+    ColumnStatistics();
+
+    /** Smallest valid value.  Equals std::numeric_limits<double>::max() if there are no valid values. */
+    double min;
+    /** Greatest valid value.  Equals -std::numeric_limits<double>::max() if there are no valid values. */
+    double max;
+    /** Smallest absolute valid value.  Equals std::numeric_limits<double>::max() if there are no valid values. */
+    double minAbs;
+    /** Greatest absolute valid value.  Equals zero if there are no valid values. */
+    double maxAbs;
+    /** Arithmetic mean of the valid values.  Equals zero if there are no valid values. */
+    double mean;
+    /** Population variance of the valid values.  NaN if there are no valid values. */
+    double variance;
+    /** Number of valid values (those that are not the no-data value). */
+    size_t count;
+    /** Number of no-data values. */
+    size_t ndvCount;
+
+    /**
+     * Computes the statistics of the given values in a single pass.  The variance is accumulated per
+     * block of values and the blocks are merged with the pairwise update of Chan et al., so the result
+     * is as accurate as the two-pass (mean first, then squared deviations) computation.
+     * @param isNDV The test for the no-data value (see DataFile::getNDVPredicate()).
+     */
+    static ColumnStatistics compute( const DataColumnSpan& values, const NDVPredicate& isNDV );
+};
+
+#endif // COLUMNSTATISTICS_H
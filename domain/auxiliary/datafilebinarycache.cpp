@@ -0,0 +1,460 @@
+#include "datafilebinarycache.h"
+#include "columnardatastore.h"
+#include "util.h"
+#include "../application.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+const qint64 DataFileBinaryCache::MIN_SOURCE_FILE_SIZE = 1 << 20;
+
+namespace {
+
+    const char CACHE_MAGIC[8] = { 'G', 'R', 'B', 'C', 'A', 'C', 'H', 'E' };
+    const uint32_t CACHE_VERSION = 2;
+    /** Used to detect sidecars written on machines with different byte order. */
+    const uint32_t ENDIANNESS_MARK = 0x01020304;
+    /** Offset of the first column in the sidecar file (one memory page). */
+    const uint64_t DATA_OFFSET = 4096;
+    /** Number of bytes at the beginning and at the end of the source file used in its fingerprint. */
+    const qint64 FINGERPRINT_SAMPLE_SIZE = 64 * 1024;
+    /** Maximum number of data pages kept mapped regardless of the memory budget. */
+    const size_t MAX_MAPPED_PAGES = 64;
+    /** Once the memory usage exceeds the budget, unused pages are unmapped until it falls below this
+     * fraction of the budget, so they are not unmapped one at a time at each load while the usage
+     * hovers around the budget. */
+    const int64_t RELEASE_TARGET_NUMERATOR = 3;
+    const int64_t RELEASE_TARGET_DENOMINATOR = 4;
+    /** The page interval recorded in complete sidecars (all data lines). */
+    const uint64_t ALL_LINES_FIRST = 0;
+    const uint64_t ALL_LINES_LAST = ~uint64_t( 0 );
+
+    /** The sidecar file header. */
+    struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t endiannessMark;
+        uint64_t columnCount;
+        uint64_t rowCount;
+        uint64_t columnStride;        //number of values between the beginnings of two columns (includes padding)
+        uint64_t dataOffset;          //position of the first value of the first column in the file
+        int64_t sourceSize;
+        int64_t sourceLastModified;   //milliseconds since epoch
+        uint64_t sourceFingerprint;
+        double noDataValue;           //NaN if not set
+        uint64_t pageFirstLine;       //the data page held (see DataFile::setDataPage()), all lines if complete
+        uint64_t pageLastLine;
+        uint64_t dataLineCount;       //number of data lines in the source file
+    };
+
+    /** A data page (interval of rows) of a sidecar file mapped into memory. */
+    struct MappedPage {
+        QString cachePath;
+        uint64_t sourceFingerprint;
+        int64_t sourceLastModified;
+        uint64_t firstRow;
+        uint64_t rowCount;
+        std::shared_ptr<QFile> file;  //the mappings are released when the file object is destroyed
+        std::unique_ptr<char[]> buffer; //the values copied from the file if they could not be mapped aligned
+        std::vector<double*> columns;
+        qint64 size;                  //in bytes
+    };
+
+    /** The recently used mapped pages, the most recent first.
+     * Pages still in use by data stores are shared with them. */
+    std::list< std::shared_ptr<MappedPage> > g_mappedPages;
+    std::mutex g_mappedPagesMutex;
+
+    /** Returns the number of values per column, rounded up so every column begins at an aligned offset. */
+    uint64_t computeColumnStride( uint64_t rowCount ){
+        const uint64_t valuesPerAlignment = ColumnarDataStore::ALIGNMENT / sizeof(double);
+        return ( rowCount + valuesPerAlignment - 1 ) / valuesPerAlignment * valuesPerAlignment;
+    }
+
+    /** FNV-1a hash. */
+    uint64_t fnv1a( const char* bytes, qint64 size, uint64_t hash ){
+        for( qint64 i = 0; i < size; ++i ){
+            hash ^= static_cast<unsigned char>( bytes[i] );
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /** Returns the path to the sidecar file of a data page (see DataFile::setDataPage()) of the given data file. */
+    QString getPageCachePath( const QString sourcePath, uint64_t pageFirstLine, uint64_t pageLastLine ){
+        return DataFileBinaryCache::getCachePath( sourcePath ).append( "." ).append( QString::number( pageFirstLine ) )
+                                                              .append( "-" ).append( QString::number( pageLastLine ) );
+    }
+
+    /** Fills the header of a finished sidecar file. */
+    void fillHeader( CacheHeader& header, const QString sourcePath, uint64_t sourceFingerprint,
+                     uint64_t columnCount, uint64_t rowCount, uint64_t columnStride, double noDataValue,
+                     uint64_t pageFirstLine, uint64_t pageLastLine, uint64_t dataLineCount ){
+        QFileInfo sourceInfo( sourcePath );
+        std::memcpy( header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC) );
+        header.version = CACHE_VERSION;
+        header.endiannessMark = ENDIANNESS_MARK;
+        header.columnCount = columnCount;
+        header.rowCount = rowCount;
+        header.columnStride = columnStride;
+        header.dataOffset = DATA_OFFSET;
+        header.sourceSize = sourceInfo.size();
+        header.sourceLastModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+        header.sourceFingerprint = sourceFingerprint;
+        header.noDataValue = noDataValue;
+        header.pageFirstLine = pageFirstLine;
+        header.pageLastLine = pageLastLine;
+        header.dataLineCount = dataLineCount;
+    }
+
+    /** Reads the header of the sidecar and checks whether it describes the current source file. */
+    bool readFreshHeader( const QString sourcePath, QFile& cacheFile, CacheHeader& header, uint64_t sourceFingerprint ){
+        if( cacheFile.read( reinterpret_cast<char*>( &header ), sizeof(CacheHeader) ) != sizeof(CacheHeader) )
+            return false;
+        if( std::memcmp( header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC) ) ||
+            header.version != CACHE_VERSION ||
+            header.endiannessMark != ENDIANNESS_MARK )
+            return false;
+        QFileInfo sourceInfo( sourcePath );
+        if( header.sourceSize != sourceInfo.size() ||
+            header.sourceLastModified != sourceInfo.lastModified().toMSecsSinceEpoch() ||
+            header.sourceFingerprint != sourceFingerprint )
+            return false;
+        //guards against truncated sidecars
+        uint64_t expectedSize = header.dataOffset + header.columnCount * header.columnStride * sizeof(double);
+        return static_cast<uint64_t>( cacheFile.size() ) >= expectedSize;
+    }
+
+    /** Opens a sidecar and reads its header if it describes the current source file. */
+    bool readFreshHeader( const QString sourcePath, const QString cachePath, CacheHeader& header, uint64_t sourceFingerprint ){
+        QFile cacheFile( cachePath );
+        return cacheFile.open( QFile::ReadOnly ) && readFreshHeader( sourcePath, cacheFile, header, sourceFingerprint );
+    }
+
+    /** Replaces the sidecar with the complete temporary file, if ok is true.  Otherwise, the temporary file is deleted. */
+    bool replaceCacheFile( QFile& tmpFile, const QString cachePath, bool ok ){
+        QFile::remove( cachePath );
+        if( ! ok || ! tmpFile.rename( cachePath ) ){
+            Application::instance()->logWarn( "DataFileBinaryCache: failed to write " + cachePath +
+                                              ".  The data file will be parsed in its next load." );
+            tmpFile.remove();
+            return false;
+        }
+        return true;
+    }
+
+    /** Returns a previously mapped page and makes it the most recently used.  Assumes g_mappedPagesMutex is locked. */
+    std::shared_ptr<MappedPage> findMappedPage( const QString cachePath, const CacheHeader& header,
+                                                uint64_t firstRow, uint64_t rowCount ){
+        for( auto it = g_mappedPages.begin(); it != g_mappedPages.end(); ++it ){
+            const MappedPage& page = **it;
+            if( page.cachePath == cachePath && page.sourceFingerprint == header.sourceFingerprint &&
+                page.sourceLastModified == header.sourceLastModified &&
+                page.firstRow == firstRow && page.rowCount == rowCount ){
+                std::shared_ptr<MappedPage> result = *it;
+                g_mappedPages.erase( it );
+                g_mappedPages.push_front( result );
+                return result;
+            }
+        }
+        return nullptr;
+    }
+
+    /** Maps the given rows of each column of a sidecar read-only into memory. */
+    std::shared_ptr<MappedPage> mapPage( const QString cachePath, const CacheHeader& header,
+                                         uint64_t firstRow, uint64_t rowCount ){
+        std::shared_ptr<MappedPage> page( new MappedPage() );
+        page->cachePath = cachePath;
+        page->sourceFingerprint = header.sourceFingerprint;
+        page->sourceLastModified = header.sourceLastModified;
+        page->firstRow = firstRow;
+        page->rowCount = rowCount;
+        page->file.reset( new QFile( cachePath ) );
+        page->columns.resize( header.columnCount, nullptr );
+        page->size = header.columnCount * rowCount * sizeof(double);
+        if( ! page->file->open( QFile::ReadOnly ) )
+            return nullptr;
+        if( rowCount == 0 )
+            return page;
+        //the columns begin aligned in the file, so the page is aligned if its first row is.
+        //Otherwise, its values are copied to an aligned buffer, as the data stores expect.
+        const uint64_t valuesPerAlignment = ColumnarDataStore::ALIGNMENT / sizeof(double);
+        bool isAligned = firstRow % valuesPerAlignment == 0;
+        double* bufferValues = nullptr;
+        uint64_t bufferStride = computeColumnStride( rowCount );
+        if( ! isAligned ){
+            page->buffer.reset( new char[ header.columnCount * bufferStride * sizeof(double) + ColumnarDataStore::ALIGNMENT ] );
+            std::uintptr_t address = reinterpret_cast<std::uintptr_t>( page->buffer.get() );
+            address = ( address + ColumnarDataStore::ALIGNMENT - 1 ) & ~( std::uintptr_t( ColumnarDataStore::ALIGNMENT ) - 1 );
+            bufferValues = reinterpret_cast<double*>( address );
+        }
+        for( uint64_t iColumn = 0; iColumn < header.columnCount; ++iColumn ){
+            qint64 offset = header.dataOffset + ( iColumn * header.columnStride + firstRow ) * sizeof(double);
+            uchar* mapping = page->file->map( offset, rowCount * sizeof(double) );
+            if( ! mapping ){
+                Application::instance()->logWarn( "DataFileBinaryCache::load(): failed to memory-map " + cachePath + "." );
+                return nullptr;
+            }
+            if( isAligned )
+                page->columns[iColumn] = reinterpret_cast<double*>( mapping );
+            else {
+                page->columns[iColumn] = bufferValues + iColumn * bufferStride;
+                std::memcpy( page->columns[iColumn], mapping, rowCount * sizeof(double) );
+                page->file->unmap( mapping );
+            }
+        }
+        return page;
+    }
+
+    /** Returns whether the program uses more physical memory than the user allows for the mapped pages.
+     *  Assumes g_mappedPagesMutex is locked. */
+    bool isOverMemoryBudget( int64_t budget ){
+        int64_t usage = Util::getPhysicalRAMusage();
+        if( usage < 0 ){
+            //memory usage is not available in this OS: assume the mapped pages are fully resident
+            usage = 0;
+            for( const std::shared_ptr<MappedPage>& page : g_mappedPages )
+                usage += page->size;
+        }
+        return usage > budget;
+    }
+
+    /** If the memory usage is over the budget, unmaps the least recently used pages not in use by any
+     *  data store until it falls below the release target (see RELEASE_TARGET_NUMERATOR).
+     *  Assumes g_mappedPagesMutex is locked. */
+    void releaseMappedPages(){
+        const int64_t budget = (int64_t)Application::instance()->getMappedDataMemoryBudgetSetting() << 20;
+        if( g_mappedPages.size() <= MAX_MAPPED_PAGES && ! isOverMemoryBudget( budget ) )
+            return;
+        const int64_t target = budget / RELEASE_TARGET_DENOMINATOR * RELEASE_TARGET_NUMERATOR;
+        for( auto it = g_mappedPages.end(); it != g_mappedPages.begin(); ){
+            --it;
+            if( g_mappedPages.size() <= MAX_MAPPED_PAGES && ! isOverMemoryBudget( target ) )
+                break;
+            if( it->use_count() == 1 )
+                it = g_mappedPages.erase( it );
+        }
+    }
+
+    /** Forgets the mapped pages of a sidecar about to be replaced or deleted.
+     *  Pages still in use by data stores remain valid until released by them. */
+    void discardMappedPages( const QString cachePath ){
+        std::lock_guard<std::mutex> lock( g_mappedPagesMutex );
+        g_mappedPages.remove_if( [&cachePath]( const std::shared_ptr<MappedPage>& page ){
+            return page->cachePath == cachePath;
+        } );
+    }
+
+    /** Deletes the sidecars of data pages of the given data file. */
+    void removePageCacheFiles( const QString sourcePath ){
+        QFileInfo cacheInfo( DataFileBinaryCache::getCachePath( sourcePath ) );
+        QDir dir = cacheInfo.dir();
+        for( const QString& fileName : dir.entryList( QStringList() << cacheInfo.fileName() + ".*-*", QDir::Files ) ){
+            QString pageCachePath = dir.absoluteFilePath( fileName );
+            discardMappedPages( pageCachePath );
+            QFile::remove( pageCachePath );
+        }
+    }
+
+    /** Creates the temporary file of a sidecar under construction and maps it into the data store.
+     *  See DataFileBinaryCache::beginBuild(). */
+    bool beginSidecarBuild( const QString sourcePath, uint64_t columnCount, uint64_t rowCount,
+                            uint64_t pageFirstLine, uint64_t pageLastLine, uint64_t dataLineCount,
+                            ColumnarDataStore& data ){
+        std::shared_ptr<QFile> tmpFile( new QFile( DataFileBinaryCache::getCachePath( sourcePath ).append(".new") ) );
+        if( ! tmpFile->open( QFile::ReadWrite | QFile::Truncate ) ){
+            Application::instance()->logWarn( "DataFileBinaryCache::beginBuild(): could not create " + tmpFile->fileName() + "." );
+            return false;
+        }
+
+        //the header is only completed in finishBuild(), so an unfinished sidecar is never taken as valid.
+        CacheHeader header;
+        std::memset( &header, 0, sizeof(CacheHeader) );
+        header.columnCount = columnCount;
+        header.rowCount = rowCount;
+        header.columnStride = computeColumnStride( rowCount );
+        header.pageFirstLine = pageFirstLine;
+        header.pageLastLine = pageLastLine;
+        header.dataLineCount = dataLineCount;
+        qint64 dataSize = columnCount * header.columnStride * sizeof(double);
+        bool ok = tmpFile->write( reinterpret_cast<const char*>( &header ), sizeof(CacheHeader) ) == sizeof(CacheHeader);
+        ok = ok && tmpFile->resize( DATA_OFFSET + dataSize );
+        uchar* mapping = nullptr;
+        if( ok && dataSize > 0 ){
+            mapping = tmpFile->map( DATA_OFFSET, dataSize );
+            ok = mapping != nullptr;
+        }
+        if( ! ok ){
+            Application::instance()->logWarn( "DataFileBinaryCache::beginBuild(): could not allocate or memory-map " +
+                                              tmpFile->fileName() + "." );
+            tmpFile->remove();
+            return false;
+        }
+
+        std::vector<double*> columns( columnCount );
+        for( uint64_t iColumn = 0; iColumn < columnCount; ++iColumn )
+            columns[iColumn] = reinterpret_cast<double*>( mapping ) + iColumn * header.columnStride;
+        data.adoptExternalColumns( columns, rowCount, tmpFile );
+        return true;
+    }
+}
+
+QString DataFileBinaryCache::getCachePath(const QString sourcePath)
+{
+    return QString( sourcePath ).append(".bincache");
+}
+
+bool DataFileBinaryCache::isFresh(const QString sourcePath)
+{
+    CacheHeader header;
+    return readFreshHeader( sourcePath, getCachePath( sourcePath ), header, computeSourceFingerprint( sourcePath ) );
+}
+
+bool DataFileBinaryCache::load(const QString sourcePath, ColumnarDataStore &data,
+                               ulong firstDataLine, ulong lastDataLine, uint &dataLineCount)
+{
+    QString cachePath = getCachePath( sourcePath );
+    uint64_t sourceFingerprint = computeSourceFingerprint( sourcePath );
+    CacheHeader header;
+    uint64_t firstRow, nRows;
+    if( readFreshHeader( sourcePath, cachePath, header, sourceFingerprint ) ){
+        //the rows within the data page
+        firstRow = std::min<uint64_t>( firstDataLine, header.rowCount );
+        uint64_t endRow = std::min<uint64_t>( (uint64_t)lastDataLine + 1, header.rowCount );
+        nRows = endRow > firstRow ? endRow - firstRow : 0;
+    } else {
+        //there is no complete sidecar, but there may be one of the data page alone
+        cachePath = getPageCachePath( sourcePath, firstDataLine, lastDataLine );
+        if( ! readFreshHeader( sourcePath, cachePath, header, sourceFingerprint ) ||
+            header.pageFirstLine != firstDataLine || header.pageLastLine != lastDataLine )
+            return false;
+        firstRow = 0;
+        nRows = header.rowCount;
+    }
+
+    std::lock_guard<std::mutex> lock( g_mappedPagesMutex );
+    std::shared_ptr<MappedPage> page = findMappedPage( cachePath, header, firstRow, nRows );
+    if( ! page ){
+        page = mapPage( cachePath, header, firstRow, nRows );
+        if( ! page )
+            return false;
+        g_mappedPages.push_front( page );
+    }
+    data.adoptExternalColumns( page->columns, nRows, page, false );
+    releaseMappedPages();
+
+    dataLineCount = header.dataLineCount;
+    return true;
+}
+
+bool DataFileBinaryCache::save(const QString sourcePath, const ColumnarDataStore &data, double noDataValue)
+{
+    CacheHeader header;
+    fillHeader( header, sourcePath, computeSourceFingerprint( sourcePath ), data.getColumnCount(),
+                data.getRowCount(), computeColumnStride( data.getRowCount() ), noDataValue,
+                ALL_LINES_FIRST, ALL_LINES_LAST, data.getRowCount() );
+
+    //write to a temporary file first, so an incomplete sidecar never replaces a good one.
+    QString cachePath = getCachePath( sourcePath );
+    QFile tmpFile( QString( cachePath ).append(".new") );
+    if( ! tmpFile.open( QFile::WriteOnly | QFile::Truncate ) ){
+        Application::instance()->logWarn( "DataFileBinaryCache::save(): could not create " + tmpFile.fileName() + "." );
+        return false;
+    }
+
+    bool ok = tmpFile.write( reinterpret_cast<const char*>( &header ), sizeof(CacheHeader) ) == sizeof(CacheHeader);
+    std::vector<char> padding( DATA_OFFSET - sizeof(CacheHeader), 0 );
+    ok = ok && tmpFile.write( padding.data(), padding.size() ) == (qint64)padding.size();
+    qint64 columnBytes = header.rowCount * sizeof(double);
+    padding.assign( ( header.columnStride - header.rowCount ) * sizeof(double), 0 );
+    for( uint64_t iColumn = 0; ok && iColumn < header.columnCount; ++iColumn ){
+        ok = tmpFile.write( reinterpret_cast<const char*>( data.column( iColumn ) ), columnBytes ) == columnBytes;
+        ok = ok && tmpFile.write( padding.data(), padding.size() ) == (qint64)padding.size();
+    }
+    tmpFile.close();
+
+    //replace the previous sidecar, if any, and those of data pages it supersedes.
+    discardMappedPages( cachePath );
+    removePageCacheFiles( sourcePath );
+    return replaceCacheFile( tmpFile, cachePath, ok );
+}
+
+bool DataFileBinaryCache::beginBuild(const QString sourcePath, uint64_t columnCount, uint64_t rowCount,
+                                     ColumnarDataStore &data)
+{
+    return beginSidecarBuild( sourcePath, columnCount, rowCount, ALL_LINES_FIRST, ALL_LINES_LAST, rowCount, data );
+}
+
+bool DataFileBinaryCache::beginPageBuild(const QString sourcePath, uint64_t columnCount,
+                                         ulong firstDataLine, ulong lastDataLine, uint64_t rowCount,
+                                         uint64_t dataLineCount, ColumnarDataStore &data)
+{
+    return beginSidecarBuild( sourcePath, columnCount, rowCount, firstDataLine, lastDataLine, dataLineCount, data );
+}
+
+bool DataFileBinaryCache::finishBuild(const QString sourcePath, ColumnarDataStore &data, double noDataValue)
+{
+    QString cachePath = getCachePath( sourcePath );
+    QFile tmpFile( QString( cachePath ).append(".new") );
+
+    //operations that reallocate the columns move them out of the sidecar under construction.
+    bool ok = data.hasExternalColumns();
+    uint64_t columnCount = data.getColumnCount();
+    uint64_t rowCount = data.getRowCount();
+    //unmaps the sidecar, so the values set in the data store are committed to the file.
+    data.clear();
+
+    CacheHeader header;
+    ok = ok && tmpFile.open( QFile::ReadWrite );
+    ok = ok && tmpFile.read( reinterpret_cast<char*>( &header ), sizeof(CacheHeader) ) == sizeof(CacheHeader);
+    ok = ok && header.columnCount == columnCount && header.rowCount >= rowCount;
+    bool isPage = header.pageFirstLine != ALL_LINES_FIRST || header.pageLastLine != ALL_LINES_LAST;
+    if( ok ){
+        //the rows removed from the data store are no longer counted as data lines
+        uint64_t dataLineCount = header.dataLineCount - ( header.rowCount - rowCount );
+        fillHeader( header, sourcePath, computeSourceFingerprint( sourcePath ), columnCount, rowCount,
+                    header.columnStride, noDataValue, header.pageFirstLine, header.pageLastLine, dataLineCount );
+        ok = tmpFile.seek( 0 ) &&
+             tmpFile.write( reinterpret_cast<const char*>( &header ), sizeof(CacheHeader) ) == sizeof(CacheHeader);
+    }
+    tmpFile.close();
+
+    if( ok && isPage )
+        cachePath = getPageCachePath( sourcePath, header.pageFirstLine, header.pageLastLine );
+    else if( ok )
+        removePageCacheFiles( sourcePath );
+    discardMappedPages( cachePath );
+    return replaceCacheFile( tmpFile, cachePath, ok );
+}
+
+void DataFileBinaryCache::remove(const QString sourcePath)
+{
+    discardMappedPages( getCachePath( sourcePath ) );
+    QFile::remove( getCachePath( sourcePath ) );
+    removePageCacheFiles( sourcePath );
+}
+
+uint64_t DataFileBinaryCache::computeSourceFingerprint(const QString sourcePath)
+{
+    QFile sourceFile( sourcePath );
+    if( ! sourceFile.open( QFile::ReadOnly ) )
+        return 0;
+    qint64 size = sourceFile.size();
+    uint64_t hash = fnv1a( reinterpret_cast<const char*>( &size ), sizeof(size), 14695981039346656037ULL );
+    QByteArray head = sourceFile.read( FINGERPRINT_SAMPLE_SIZE );
+    hash = fnv1a( head.constData(), head.size(), hash );
+    if( size > FINGERPRINT_SAMPLE_SIZE ){
+        sourceFile.seek( std::max( FINGERPRINT_SAMPLE_SIZE, size - FINGERPRINT_SAMPLE_SIZE ) );
+        QByteArray tail = sourceFile.read( FINGERPRINT_SAMPLE_SIZE );
+        hash = fnv1a( tail.constData(), tail.size(), hash );
+    }
+    return hash;
+}
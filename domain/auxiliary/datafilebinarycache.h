@@ -0,0 +1,99 @@
+#ifndef DATAFILEBINARYCACHE_H
+#define DATAFILEBINARYCACHE_H
+
+#include <QString>
+#include <QtGlobal>
+#include <cstdint>
+
+class ColumnarDataStore;
+
+/**
+ * The DataFileBinaryCache class manages the binary sidecar files that cache the parsed contents of
+ * GEO-EAS data files.  The sidecar sits next to the data file (see getCachePath()) and is made of a
+ * header (column count, row count, no-data value and the identity of the source file) followed by
+ * the raw values, column by column, each column aligned to ColumnarDataStore::ALIGNMENT bytes.
+ * On later loads, the sidecar is memory-mapped instead of parsing the ASCII file again, which turns
+ * project reopening from a CPU-bound parse into a few page faults.
+ * A sidecar is fresh only if the size, last modification time and a fingerprint of the source file
+ * match those recorded when it was written.  Stale sidecars are simply ignored and overwritten.
+ * Sidecars can be built without holding the data in the heap (see beginBuild()) and each data page
+ * (e.g. a grid realization, see GridFile::setDataPageToRealization()) is mapped separately, so data
+ * files larger than the physical memory can be worked with one page at a time.  A data page loaded
+ * before the file has a complete sidecar gets a sidecar of its own (see beginPageBuild()), so the rest
+ * of the file is not parsed to load it.  Pages beginning at rows not aligned to ColumnarDataStore::ALIGNMENT
+ * bytes are copied to aligned memory instead of mapped.  Recently used pages are kept mapped, so revisiting
+ * them costs nothing.  When the program's physical memory usage exceeds the budget set by the user (see
+ * Application::getMappedDataMemoryBudgetSetting()), unused pages are unmapped until it is well below it.
+ */
+class DataFileBinaryCache
+{
+public:
+    /** Data files smaller than this (in bytes) are not cached, as they are parsed quickly anyway. */
+    static const qint64 MIN_SOURCE_FILE_SIZE;
+
+    /** Returns the path to the sidecar file of the given data file. */
+    static QString getCachePath( const QString sourcePath );
+
+    /** Returns whether the given data file has a sidecar file that is up to date. */
+    static bool isFresh( const QString sourcePath );
+
+    /**
+     * Loads the data of the given data file from its sidecar file or from the sidecar of the data page,
+     * if it is up to date.
+     * Only the data page is memory-mapped (read-only), so no values are read until they are accessed.
+     * The values of a column are copied to the heap only when they are changed (see
+     * ColumnarDataStore::adoptExternalColumns()), so the sidecar and the mapped pages shared with
+     * other loads are never modified.
+     * The interval of data lines is inclusive and follows the semantics of DataFile::setDataPage().
+     * @param dataLineCount Output parameter: number of data lines in the source file.
+     * @return false if there is no fresh sidecar or it cannot be read.  Nothing is changed in this case.
+     */
+    static bool load( const QString sourcePath, ColumnarDataStore& data,
+                      ulong firstDataLine, ulong lastDataLine, uint& dataLineCount );
+
+    /**
+     * Writes the sidecar file of the given data file with the given data, which must hold all the
+     * data lines of the file (no data page).
+     * @param noDataValue The no-data value to record in the header (NaN if not set).
+     * @return false if the sidecar could not be written.
+     */
+    static bool save( const QString sourcePath, const ColumnarDataStore& data, double noDataValue );
+
+    /**
+     * Starts building the sidecar file of the given data file by creating it with room for the given
+     * number of columns and rows and memory-mapping it (read-write) into the given data store, so the
+     * values set in the store are written to the file by the operating system as needed.
+     * finishBuild() must be called after all values have been set.
+     * @return false if the sidecar could not be created.  The data store is not changed in this case.
+     */
+    static bool beginBuild( const QString sourcePath, uint64_t columnCount, uint64_t rowCount,
+                            ColumnarDataStore& data );
+
+    /**
+     * Same as beginBuild(), but for a sidecar of a data page alone, which is loaded only for the same
+     * interval of data lines (see load()).
+     * @param rowCount The number of data lines within the data page.
+     * @param dataLineCount The number of data lines in the file.
+     */
+    static bool beginPageBuild( const QString sourcePath, uint64_t columnCount,
+                                ulong firstDataLine, ulong lastDataLine, uint64_t rowCount,
+                                uint64_t dataLineCount, ColumnarDataStore& data );
+
+    /**
+     * Completes the sidecar file started with beginBuild() or beginPageBuild().  Rows may have been removed
+     * from the data store in the meantime.  The data store is cleared (unmapped).  A complete sidecar
+     * replaces those of data pages.
+     * @param noDataValue The no-data value to record in the header (NaN if not set).
+     * @return false if the sidecar could not be completed.
+     */
+    static bool finishBuild( const QString sourcePath, ColumnarDataStore& data, double noDataValue );
+
+    /** Deletes the sidecar file of the given data file and those of its data pages, if they exist. */
+    static void remove( const QString sourcePath );
+
+private:
+    /** Computes a fingerprint of the source file from its size and its first and last bytes. */
+    static uint64_t computeSourceFingerprint( const QString sourcePath );
+};
+
+#endif // DATAFILEBINARYCACHE_H
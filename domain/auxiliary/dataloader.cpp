@@ -1,17 +1,144 @@
 #include "dataloader.h"
+#include "columnardatastore.h"
+#include "datafilebinarycache.h"
+#include "numberparser.h"
 #include <QFileInfo>
 #include <QStringList>
-#include <QTextStream>
 #include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
 #include "util.h"
 #include "../application.h"
 
+namespace {
+
+    /** A data line that could not be parsed correctly. */
+    struct ParsingError {
+        uint64_t fileLine;  //line number in file (first line of file is 0)
+        uint64_t dataRow;   //row index in the data array
+        bool wrongValueCount; //true: wrong number of values; false: a value is not a number
+        int valueCount;
+        QByteArray text;    //the offending line or value
+    };
+
+    /** A slice of the data section of the file, beginning and ending at line boundaries. */
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        uint64_t nDataLines;     //number of non-blank lines
+        uint64_t nLines;         //number of physical lines
+        uint64_t firstDataLine;  //global index of the first non-blank line in the chunk
+        uint64_t firstFileLine;  //file line number of the first line in the chunk
+        std::vector<uint64_t> blankLines; //blank lines (indexes of the physical lines in the chunk)
+        uint64_t nTrailingBlankLines; //blank lines after the last non-blank line in the chunk
+        std::vector<ParsingError> errors;
+    };
+
+    /** Update progress for each this many bytes processed to not impact performance much. */
+    const uint64_t PROGRESS_GRANULARITY = 1 << 20;
+
+    /** Minimum chunk size.  Smaller files are not worth the threading overhead. */
+    const uint64_t MIN_CHUNK_SIZE = 4 << 20;
+
+    /** Maximum number of blank lines reported one by one (the others are just counted). */
+    const uint64_t MAX_REPORTED_BLANK_LINES = 100;
+
+    /** Returns the end of the line starting at p (the position of the line break or end). */
+    inline const char* findEndOfLine( const char* p, const char* end ){
+        const char* eol = static_cast<const char*>( std::memchr( p, '\n', end - p ) );
+        return eol ? eol : end;
+    }
+
+    /** Returns whether the line has no values (empty or only separators). */
+    inline bool isBlank( const char* begin, const char* end ){
+        for( const char* p = begin; p != end; ++p )
+            if( NumberParser::isNumberChar( *p ) )
+                return false;
+        return true;
+    }
+
+    /** Counts the physical and non-blank lines of a chunk and records where the blank lines are. */
+    void taskCountLines( Chunk* chunk ){
+        uint64_t nLines = 0;
+        uint64_t nDataLines = 0;
+        uint64_t nTrailingBlankLines = 0;
+        for( const char* p = chunk->begin; p < chunk->end; ){
+            const char* eol = findEndOfLine( p, chunk->end );
+            if( ! isBlank( p, eol ) ){
+                ++nDataLines;
+                nTrailingBlankLines = 0;
+            } else {
+                chunk->blankLines.push_back( nLines );
+                ++nTrailingBlankLines;
+            }
+            ++nLines;
+            p = eol + 1;
+        }
+        chunk->nLines = nLines;
+        chunk->nDataLines = nDataLines;
+        chunk->nTrailingBlankLines = nTrailingBlankLines;
+    }
+
+    /** Parses the values of the lines of a chunk that fall within the data page directly into the data array. */
+    void taskParseLines( Chunk* chunk,
+                         int nVars,
+                         uint64_t firstDataLineToRead,
+                         uint64_t lastDataLineToRead,
+                         ColumnarDataStore* data,
+                         std::atomic<uint64_t>* bytesParsedSoFar,
+                         std::atomic<unsigned int>* nFinishedThreads ){
+        uint64_t iDataLine = chunk->firstDataLine;
+        uint64_t iFileLine = chunk->firstFileLine;
+        const char* lastProgressUpdate = chunk->begin;
+        for( const char* p = chunk->begin; p < chunk->end && iDataLine <= lastDataLineToRead; ++iFileLine ){
+            const char* eol = findEndOfLine( p, chunk->end );
+            if( ! isBlank( p, eol ) ){
+                if( iDataLine >= firstDataLineToRead ){
+                    uint64_t iRow = iDataLine - firstDataLineToRead;
+                    //tokenize the line and parse each value along it
+                    int j = 0;
+                    const char* c = p;
+                    while( c != eol ){
+                        while( c != eol && ! NumberParser::isNumberChar( *c ) )
+                            ++c;
+                        if( c == eol )
+                            break;
+                        const char* tokenBegin = c;
+                        while( c != eol && NumberParser::isNumberChar( *c ) )
+                            ++c;
+                        if( j < nVars ){
+                            double value;
+                            if( ! NumberParser::parseDouble( tokenBegin, c, value ) )
+                                chunk->errors.push_back( { iFileLine, iRow, false, 0, QByteArray( tokenBegin, c - tokenBegin ) } );
+                            data->set( iRow, j, value );
+                        }
+                        ++j;
+                    }
+                    if( j != nVars )
+                        chunk->errors.push_back( { iFileLine, iRow, true, j, QByteArray( p, eol - p ) } );
+                }
+                ++iDataLine;
+            }
+            p = std::min( eol + 1, chunk->end );
+            if( static_cast<uint64_t>( p - lastProgressUpdate ) >= PROGRESS_GRANULARITY ){
+                *bytesParsedSoFar += p - lastProgressUpdate;
+                lastProgressUpdate = p;
+            }
+        }
+        *bytesParsedSoFar += chunk->end - lastProgressUpdate;
+        ++(*nFinishedThreads);
+    }
+}
 
 DataLoader::DataLoader(QFile &file,
-                       std::vector<std::vector<double> > &data,
+                       ColumnarDataStore &data,
                        uint &data_line_count,
                        ulong firstDataLineToRead,
                        ulong lastDataLineToRead,
+                       bool buildBinaryCache,
                        QObject *parent) :
     QObject(parent),
     _file(file),
@@ -19,108 +146,169 @@ DataLoader::DataLoader(QFile &file,
     _data_line_count(data_line_count),
     _finished(false),
     _firstDataLineToRead( firstDataLineToRead ),
-    _lastDataLineToRead( lastDataLineToRead )
+    _lastDataLineToRead( lastDataLineToRead ),
+    _buildBinaryCache( buildBinaryCache ),
+    _binaryCacheBuilt( false )
 {
 }
 
 void DataLoader::doLoad() { /* do what you need and emit progress signal */
-	//QStringList list;
-    int n_vars = 0;
-    int var_count = 0;
-    QTextStream in(&_file);
-    long bytesReadSofar = 0;
-	QStringList valuesAsString;
 
 	//Get data file size in bytes.
 	QFileInfo fileInfo( _file );
 	uint64_t fileSize = fileInfo.size();
 
-	uint iDataLineParsed = 0;
-
-	uint nPushesBack = 0;
-
-	uint nPopsBack = 0;
-
-	for (int i = 0; !in.atEnd(); ++i)
-    {
-       //read file line by line
-       QString line = in.readLine();
-
-	   //Clear the list with the tokenized data values as string
-	   valuesAsString.clear();
-
-	   //updates the progress
-	   bytesReadSofar += line.size() + 1; //account for line break char (in Windows may have 2, though.)
-
-	   if( ! ( i % 100 ) ){ //update progress for each 100 lines to not impact performance much
-		   // allows tracking progress of a file up to about 400GB
-		   emit progress( (int)(bytesReadSofar / 100) );
-	   }
-
-	   //TODO: second line may contain other information in grid files, so it will fail for such cases.
-	   if( i == 0 ){} //first line is ignored
-	   else if( i == 1 ){ //second line is the number of variables
-		   n_vars = Util::getFirstNumber( line );
-	   } else if ( i > 1 && var_count < n_vars ){ //the variables names
-		   //list << line;
-		   ++var_count;
-	   } else if( _data_line_count >= _firstDataLineToRead &&
-				  _data_line_count <= _lastDataLineToRead ) { //parse lines containing data (must be within the target interval)
-		   //read line from the GSLib data file
-		   Util::fastSplit( line, valuesAsString );
-		   //if we are at the first data line to read...
-		   if( _data_line_count == _firstDataLineToRead ){
-			   //...estimate the number of lines in the file
-			   uint nLinesExpectation = fileSize / ( line.size() + 2 ) + 200; //+2 -> line breaks in Windows; +200 -> make room for possible line length variation
-			   //the number of data lines to store should be smaller or equal than the file line window
-			   if( nLinesExpectation > ( _lastDataLineToRead - _firstDataLineToRead ) )
-				   nLinesExpectation =  _lastDataLineToRead - _firstDataLineToRead;
-			   //now we can reserve capacity in the _data array to avoid minimize push_back calls and vector re-allocations/copies
-			   _data = std::vector<std::vector<double> >( 1.1 * nLinesExpectation, std::vector<double>( n_vars, -424242.0 ) );
-		   }
-		   if( valuesAsString.size() != n_vars ){
-			   Application::instance()->logError( QString("ERROR: wrong number of values in line ").append(QString::number(i)) );
-			   Application::instance()->logError( QString("       expected: ").append(QString::number(n_vars)).append(", found:").append(QString::number(valuesAsString.size())) );
-			   for( QStringList::Iterator it = valuesAsString.begin(); it != valuesAsString.end(); ++it ){
-				   Application::instance()->logInfo((*it));
-			   }
-		   } else {
-			   //read each value along the line
-			   QStringList::Iterator it = valuesAsString.begin();
-			   for( int j = 0; it != valuesAsString.end(); ++it, ++j ){
-				   //parse the double value
-				   bool ok = true;
-				   double value = (*it).toDouble( &ok );
-				   if( !ok ){
-					   Application::instance()->logError( QString("DataLoader::doLoad(): error in data file (line ").append(QString::number(i)).append("): cannot convert ").append( *it ).append(" to double.") );
-				   }
-				   //making sure there is room for the new data.
-				   if( iDataLineParsed == _data.size() ){
-					   ++nPushesBack;
-					   _data.push_back( std::vector<double>( n_vars, -424242.0 ) );
-				   }
-				   //store the value in the data array.
-				   _data[iDataLineParsed][j] = value;
-			   }
-			   ++_data_line_count;
-			   ++iDataLineParsed;
-		   }
-	   } else { //if the data line is not within the target interval (window in data file)
-		   ++_data_line_count; //just count it as parsed.
-	   }
-    }
+	//Map the file into memory, so the parser works directly on the file bytes.
+	//If mapping fails (e.g. empty file), reads the entire file into memory instead.
+	uchar* mapping = fileSize ? _file.map( 0, fileSize ) : nullptr;
+	QByteArray fileContents;
+	if( ! mapping && fileSize ){
+		Application::instance()->logWarn( "DataLoader::doLoad(): failed to memory-map " + _file.fileName() +
+										  ".  Reading the entire file into memory instead." );
+		fileContents = _file.readAll();
+		fileSize = fileContents.size();
+	}
+	const char* fileBegin = mapping ? reinterpret_cast<const char*>( mapping ) : fileContents.constData();
+	const char* fileEnd = fileBegin + fileSize;
+
+	//Parse the header: first line is ignored, second line is the number of variables,
+	//followed by the variables names, one per line.
+	//TODO: second line may contain other information in grid files, so it will fail for such cases.
+	int n_vars = 0;
+	int var_count = 0;
+	uint64_t nHeaderLines = 0;
+	const char* p = fileBegin;
+	for( ; p < fileEnd && ( nHeaderLines < 2 || var_count < n_vars ); ++nHeaderLines ){
+		const char* eol = findEndOfLine( p, fileEnd );
+		if( nHeaderLines == 1 )
+			n_vars = Util::getFirstNumber( QString::fromLatin1( p, eol - p ) );
+		else if( nHeaderLines > 1 )
+			++var_count;
+		p = eol + 1;
+	}
+	const char* dataBegin = std::min( p, fileEnd );
+
+	//Split the data section into chunks at line boundaries, one per thread.
+	uint64_t dataSize = fileEnd - dataBegin;
+	unsigned int nThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	nThreads = std::max<uint64_t>( 1, std::min<uint64_t>( nThreads, dataSize / MIN_CHUNK_SIZE ) );
+	std::vector<Chunk> chunks( nThreads );
+	const char* chunkBegin = dataBegin;
+	for( unsigned int iChunk = 0; iChunk < nThreads; ++iChunk ){
+		const char* chunkEnd = fileEnd;
+		if( iChunk + 1 < nThreads ){
+			chunkEnd = std::max( chunkBegin, dataBegin + dataSize * ( iChunk + 1 ) / nThreads );
+			chunkEnd = std::min( fileEnd, findEndOfLine( chunkEnd, fileEnd ) + 1 );
+		}
+		chunks[iChunk].begin = chunkBegin;
+		chunks[iChunk].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	//First pass: count the lines in each chunk, so each thread knows the data line index
+	//of its first line and, hence, where to store the values in the data array.
+	{
+		std::vector<std::thread> threads;
+		for( unsigned int iChunk = 0; iChunk < nThreads; ++iChunk )
+			threads.push_back( std::thread( taskCountLines, &chunks[iChunk] ) );
+		for( std::thread& thread : threads )
+			thread.join();
+	}
+	uint64_t nDataLines = 0;
+	uint64_t nFileLines = nHeaderLines;
+	for( Chunk& chunk : chunks ){
+		chunk.firstDataLine = nDataLines;
+		chunk.firstFileLine = nFileLines;
+		nDataLines += chunk.nDataLines;
+		nFileLines += chunk.nLines;
+	}
+
+	//Allocate the data array for all lines in the binary cache file under construction or,
+	//otherwise, in memory for the lines within the target interval (window in data file)
+	//The binary cache file holds the entire file if the data page spans it or just the data page otherwise.
+	uint64_t firstDataLineToRead = _firstDataLineToRead;
+	uint64_t lastDataLineToRead = _lastDataLineToRead;
+	uint64_t nRows = 0;
+	if( nDataLines > firstDataLineToRead )
+		nRows = std::min<uint64_t>( nDataLines - 1, lastDataLineToRead ) + 1 - firstDataLineToRead;
+	if( _buildBinaryCache && ( nRows == nDataLines ?
+			DataFileBinaryCache::beginBuild( _file.fileName(), n_vars, nDataLines, _data ) :
+			DataFileBinaryCache::beginPageBuild( _file.fileName(), n_vars, _firstDataLineToRead, _lastDataLineToRead,
+												 nRows, nDataLines, _data ) ) ){
+		_binaryCacheBuilt = true;
+	} else {
+		_data.reset( n_vars, nRows );
+		_data.resizeRows( nRows, -424242.0 );
+	}
+
+	//Second pass: parse the values in parallel.
+	std::atomic<uint64_t> bytesParsedSoFar( dataBegin - fileBegin );
+	std::atomic<unsigned int> nFinishedThreads( 0 );
+	{
+		std::vector<std::thread> threads;
+		for( unsigned int iChunk = 0; iChunk < nThreads; ++iChunk )
+			threads.push_back( std::thread( taskParseLines, &chunks[iChunk], n_vars,
+											firstDataLineToRead, lastDataLineToRead,
+											&_data, &bytesParsedSoFar, &nFinishedThreads ) );
+		//updates the progress while the threads work
+		// allows tracking progress of a file up to about 400GB
+		while( nFinishedThreads < nThreads ){
+			emit progress( (int)( bytesParsedSoFar / 100 ) );
+			QThread::msleep( 100 );
+		}
+		for( std::thread& thread : threads )
+			thread.join();
+		emit progress( (int)( fileSize / 100 ) );
+	}
+
+	//Report the blank lines amid the data lines (those at the end of file are harmless), which are not
+	//loaded, so a truncated or malformed file can be noticed by its number of data lines.
+	uint64_t nBlankLines = 0;
+	{
+		size_t iLastChunkWithData = 0;
+		for( size_t iChunk = 0; iChunk < chunks.size(); ++iChunk )
+			if( chunks[iChunk].nDataLines )
+				iLastChunkWithData = iChunk;
+		for( size_t iChunk = 0; iChunk <= iLastChunkWithData && nDataLines; ++iChunk ){
+			const Chunk& chunk = chunks[iChunk];
+			size_t nBlankLinesInChunk = chunk.blankLines.size();
+			if( iChunk == iLastChunkWithData )
+				nBlankLinesInChunk -= chunk.nTrailingBlankLines;
+			for( size_t iBlank = 0; iBlank < nBlankLinesInChunk; ++iBlank, ++nBlankLines ){
+				if( nBlankLines < MAX_REPORTED_BLANK_LINES ){
+					uint64_t fileLine = chunk.firstFileLine + chunk.blankLines[iBlank];
+					Application::instance()->logError( QString("ERROR: wrong number of values in line ").append(QString::number(fileLine)) );
+					Application::instance()->logError( QString("       expected: ").append(QString::number(n_vars)).append(", found:0") );
+				}
+			}
+		}
+		if( nBlankLines )
+			Application::instance()->logWarn( QString("DataLoader::doLoad(): ").append(QString::number(nBlankLines))
+											  .append(" blank line(s) amid the data lines of ").append(_file.fileName())
+											  .append(" were not loaded.  The file may be truncated or malformed.") );
+	}
 
-	//remove possibly excess of data in pre-allocation of _data
-	while( iDataLineParsed < _data.size() ){
-		++nPopsBack;
-		_data.pop_back();
+	//Report the parsing errors.  Lines with the wrong number of values are not loaded.
+	std::vector<size_t> rowsToRemove;
+	for( Chunk& chunk : chunks ){
+		for( const ParsingError& error : chunk.errors ){
+			if( error.wrongValueCount ){
+				Application::instance()->logError( QString("ERROR: wrong number of values in line ").append(QString::number(error.fileLine)) );
+				Application::instance()->logError( QString("       expected: ").append(QString::number(n_vars)).append(", found:").append(QString::number(error.valueCount)) );
+				Application::instance()->logInfo( QString::fromLatin1( error.text ) );
+				rowsToRemove.push_back( error.dataRow );
+			} else {
+				Application::instance()->logError( QString("DataLoader::doLoad(): error in data file (line ").append(QString::number(error.fileLine)).append("): cannot convert ").append( QString::fromLatin1( error.text ) ).append(" to double.") );
+			}
+		}
 	}
+	_data.removeRows( rowsToRemove );
 
-	if( nPushesBack )
-		Application::instance()->logInfo( QString("DataLoader::doLoad(): data array adjustment resulted in ").append(QString::number(nPushesBack)).append(" push(es)-back.") );
+	//lines outside the target interval are just counted as parsed.
+	_data_line_count = nDataLines - rowsToRemove.size();
 
-	if( nPopsBack )
-		Application::instance()->logInfo( QString("DataLoader::doLoad(): data array adjustment resulted in ").append(QString::number(nPopsBack)).append(" pop(s)-back.") );
+	if( mapping )
+		_file.unmap( mapping );
 
     _finished = true;
 }
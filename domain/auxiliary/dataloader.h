@@ -4,8 +4,17 @@
 #include <QObject>
 #include <QFile>
 
+class ColumnarDataStore;
+
 /** This is an auxiliary class used in DataFile::loadData() to enable the progress dialog.
  * The file is read in a separate thread, so the progress bar updates.
+ * The file is memory-mapped and its data section is split into chunks at line boundaries, which
+ * are parsed in parallel directly from the file bytes (see NumberParser).  Blank lines amid the data lines
+ * are reported as lines with the wrong number of values and are not loaded (those at the end of the file are ignored).
+ * If buildBinaryCache is set, the data lines within the data page are parsed directly into a
+ * memory-mapped binary cache file, of the entire file if the page spans it or of the page alone otherwise
+ * (see DataFileBinaryCache::beginBuild() and beginPageBuild()), so files larger than the physical
+ * memory can be loaded.  If the cache file cannot be created, the data page is loaded into memory as usual.
  */
 class DataLoader : public QObject
 {
@@ -13,14 +22,20 @@ class DataLoader : public QObject
 
 public:
     explicit DataLoader(QFile &file,
-                        std::vector< std::vector<double> > &data,
+                        ColumnarDataStore &data,
                         uint &data_line_count,
                         ulong firstDataLineToRead,
                         ulong lastDataLineToRead,
+                        bool buildBinaryCache = false,
                         QObject *parent = 0);
 
     bool isFinished(){ return _finished; }
 
+    /** Returns whether the data page was parsed into a new binary cache file (see the
+     * buildBinaryCache constructor parameter).  If true, the data store refers to the sidecar
+     * under construction and DataFileBinaryCache::finishBuild() must be called next. */
+    bool hasBuiltBinaryCache(){ return _binaryCacheBuilt; }
+
 public slots:
     void doLoad( );
 signals:
@@ -28,11 +43,13 @@ signals:
 
 private:
     QFile &_file;
-    std::vector< std::vector<double> > &_data;
+    ColumnarDataStore &_data;
     uint &_data_line_count;
     bool _finished;
     ulong _firstDataLineToRead;
     ulong _lastDataLineToRead;
+    bool _buildBinaryCache;
+    bool _binaryCacheBuilt;
 };
 
 #endif // DATALOADER_H
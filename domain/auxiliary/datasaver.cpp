@@ -1,9 +1,80 @@
 #include "datasaver.h"
+#include "columnardatastore.h"
+#include "../application.h"
+#include <QIODevice>
 #include <QTextStream>
-#include <sstream>    // std::stringstream
-#include <iomanip>      // std::setprecision
+#include <algorithm>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
 
-DataSaver::DataSaver(std::vector<std::vector<double> > &data, QTextStream &out, QObject *parent) :
+namespace {
+
+    /** Target size in bytes of the text formatted by each thread in a round. */
+    const size_t BATCH_SIZE = 4 << 20;
+
+    /** Maximum number of characters of a value formatted with formatValue() (e.g. -1.23456789012e-308). */
+    const size_t MAX_VALUE_LENGTH = 32;
+
+    /**
+     * Writes the value to the buffer in the same text std::stringstream with std::setprecision(12)
+     * outputs (printf's %.12g in the C locale), the GSLib-like precision used in GammaRay's data files.
+     * Returns the number of characters written.
+     */
+    inline size_t formatValue( double value, char* buffer, char localeDecimalPoint ){
+        //fast path: integers are printed without decimal point or exponent up to 12 digits (as %.12g does).
+        if( std::fabs( value ) < 1e12 && value == std::trunc( value ) && ! ( value == 0.0 && std::signbit( value ) ) ){
+            long long integer = static_cast<long long>( value );
+            char digits[16];
+            size_t nDigits = 0;
+            unsigned long long magnitude = integer < 0 ? -integer : integer;
+            do {
+                digits[nDigits++] = '0' + ( magnitude % 10 );
+                magnitude /= 10;
+            } while( magnitude );
+            size_t length = 0;
+            if( integer < 0 )
+                buffer[length++] = '-';
+            while( nDigits )
+                buffer[length++] = digits[--nDigits];
+            return length;
+        }
+        int length = std::snprintf( buffer, MAX_VALUE_LENGTH, "%.12g", value );
+        //the program may be running in a locale with a decimal comma, but data files use the point.
+        if( localeDecimalPoint != '.' ){
+            char* decimalPoint = static_cast<char*>( std::memchr( buffer, localeDecimalPoint, length ) );
+            if( decimalPoint )
+                *decimalPoint = '.';
+        }
+        return length;
+    }
+
+    /** Formats the given data rows as tab-separated text lines into the given buffer. */
+    void taskFormatRows( const ColumnarDataStore* data,
+                         size_t firstRow,
+                         size_t endRow,
+                         char localeDecimalPoint,
+                         std::string* text ){
+        size_t nColumns = data->getColumnCount();
+        text->resize( ( endRow - firstRow ) * nColumns * ( MAX_VALUE_LENGTH + 1 ) );
+        char* p = &(*text)[0];
+        for( size_t iRow = firstRow; iRow < endRow; ++iRow ){
+            for( size_t iColumn = 0; iColumn < nColumns; ++iColumn ){
+                if( iColumn )
+                    *p++ = '\t';
+                p += formatValue( data->get( iRow, iColumn ), p, localeDecimalPoint );
+            }
+            *p++ = '\n';
+        }
+        text->resize( p - text->data() );
+    }
+}
+
+DataSaver::DataSaver(const ColumnarDataStore &data, QTextStream &out, QObject *parent) :
     QObject(parent),
     _finished( false ),
     _data(data),
@@ -13,27 +84,39 @@ DataSaver::DataSaver(std::vector<std::vector<double> > &data, QTextStream &out,
 
 void DataSaver::doSave()
 {
-    int linesSavedSoFar = 0;
-    //for each data line
-    std::vector< std::vector<double> >::iterator itDataLine = _data.begin();
-    for(; itDataLine != _data.end(); ++itDataLine){
+    size_t nLines = _data.getRowCount();
+    size_t nColumns = _data.getColumnCount();
+
+    //the header lines may still be buffered in the text stream.
+    _out.flush();
+    QIODevice* device = _out.device();
+
+    //the rows are formatted in parallel in batches, then each batch is written to the file in
+    //a single operation in the order of the rows.
+    //the line breaks are converted to the OS convention by the device if it is opened in text mode.
+    char localeDecimalPoint = *std::localeconv()->decimal_point;
+    unsigned int nThreads = std::max( 1u, std::thread::hardware_concurrency() );
+    size_t rowsPerBatch = std::max<size_t>( 1, BATCH_SIZE / ( std::max<size_t>( 1, nColumns ) * 16 ) );
+    std::vector<std::string> texts( nThreads );
+    bool ok = true;
+    for( size_t iLine = 0; ok && iLine < nLines; ){
         //updates the progress
-        if( ! ( linesSavedSoFar % 1000 ) ){ //update progress for each 1000 lines to not impact performance much
-            emit progress( (int)(linesSavedSoFar) );
-        }
-        //for each data column
-        std::vector<double>::iterator itDataColumn = (*itDataLine).begin();
-        _out << *itDataColumn;
-        ++itDataColumn;
-        for(; itDataColumn != (*itDataLine).end(); ++itDataColumn){
-            //making sure the values are written in GSLib-like precision
-            std::stringstream ss;
-            ss << std::setprecision( 12 /*std::numeric_limits<double>::max_digits10*/ );
-            ss << *itDataColumn;
-            _out << '\t' << ss.str().c_str();
+        emit progress( (int)(iLine) );
+        //format one batch of rows per thread
+        std::vector<std::thread> threads;
+        unsigned int nBatches = 0;
+        for( ; nBatches < nThreads && iLine < nLines; ++nBatches ){
+            size_t endLine = std::min( nLines, iLine + rowsPerBatch );
+            threads.push_back( std::thread( taskFormatRows, &_data, iLine, endLine, localeDecimalPoint, &texts[nBatches] ) );
+            iLine = endLine;
         }
-        _out << endl; //this must be QTextStream's endl, not std::endl
-        ++linesSavedSoFar;
+        for( std::thread& thread : threads )
+            thread.join();
+        //write the batches in order
+        for( unsigned int iBatch = 0; ok && iBatch < nBatches; ++iBatch )
+            ok = device->write( texts[iBatch].data(), texts[iBatch].size() ) == (qint64)texts[iBatch].size();
     }
+    if( ! ok )
+        Application::instance()->logError( "DataSaver::doSave(): failed to write data values: " + device->errorString() );
     _finished = true;
 }
@@ -4,9 +4,13 @@
 #include <QObject>
 
 class QTextStream;
+class ColumnarDataStore;
 
 /** This is an auxiliary class used in DataFile::writeToFS() to enable the progress dialog.
  * The file is saved in a separate thread, so the progress bar updates.
+ * The data rows are formatted in parallel into large text buffers, which are written to the
+ * output stream's device in row order, one write per buffer.  The values are written with
+ * 12 significant digits, as in GSLib programs.
  */
 class DataSaver : public QObject
 {
@@ -14,7 +18,7 @@ class DataSaver : public QObject
 
 public:
 
-    explicit DataSaver(std::vector< std::vector<double> >& data,
+    explicit DataSaver(const ColumnarDataStore& data,
                        QTextStream& out,
                        QObject *parent = 0);
 
@@ -27,7 +31,7 @@ signals:
 
 private:
     bool _finished;
-    std::vector< std::vector<double> >& _data;
+    const ColumnarDataStore& _data;
     QTextStream& _out;
 
 };
@@ -0,0 +1,52 @@
+#include "ndvpredicate.h"
+#include "columnardatastore.h"
+
+ValidityMask::ValidityMask() :
+    _size( 0 )
+{
+}
+
+size_t ValidityMask::countValid() const
+{
+    size_t result = 0;
+    for( uint64_t word : _words )
+        for( ; word; word &= word - 1 )
+            ++result;
+    return result;
+}
+
+NDVPredicate::NDVPredicate() :
+    _hasNDV( false ),
+    _ndv( 0.0 ),
+    _ndvBits( 0 )
+{
+}
+
+NDVPredicate::NDVPredicate(double ndv) :
+    _hasNDV( true ),
+    _ndv( ndv ),
+    _ndvBits( toOrderedBits( ndv ) )
+{
+}
+
+void NDVPredicate::computeValidityMask(const DataColumnSpan &values, ValidityMask &mask) const
+{
+    const size_t n = values.size();
+    mask._size = n;
+    mask._words.assign( ( n + 63 ) / 64, ~0ULL );
+    //clears the unused bits of the last word
+    if( n % 64 )
+        mask._words.back() = ( 1ULL << ( n % 64 ) ) - 1;
+    if( ! _hasNDV )
+        return;
+    const double* data = values.data();
+    //each word is built without branches, so the compiler can vectorize the inner loop
+    for( size_t iWord = 0; iWord < mask._words.size(); ++iWord ){
+        const size_t first = iWord * 64;
+        const size_t count = ( n - first ) < 64 ? ( n - first ) : 64;
+        uint64_t word = 0;
+        for( size_t i = 0; i < count; ++i )
+            word |= (uint64_t)( ! isNDVBits( toOrderedBits( data[first + i] ) ) ) << i;
+        mask._words[iWord] = word;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef NDVPREDICATE_H
+#define NDVPREDICATE_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class DataColumnSpan;
+
+/**
+ * The ValidityMask class is a bit array with one bit per data value, set for the values that are not
+ * the no-data value (see NDVPredicate::computeValidityMask()).  Loops over a column can test a bit instead
+ * of comparing each value with the no-data value.
+ */
+class ValidityMask
+{
+public:
+    ValidityMask();
+
+    /** Returns whether the value with the given index is valid (not the no-data value). */
+    inline bool isValid( size_t index ) const {
+        return ( _words[ index >> 6 ] >> ( index & 63 ) ) & 1;
+    }
+
+    /** Returns the number of values (bits) in the mask. */
+    size_t size() const { return _size; }
+
+    /** Returns the number of valid values (set bits) in the mask. */
+    size_t countValid() const;
+
+private:
+    friend class NDVPredicate;
+    std::vector< uint64_t > _words;
+    size_t _size;
+};
+
+/**
+ * The NDVPredicate class tests whether values equal a data file's no-data value.  The no-data value is
+ * parsed once and its ordered integer representation is precomputed, so each test costs a few integer
+ * operations instead of a text-to-double conversion plus a call to Util::almostEqual2sComplement().
+ * The result is exactly that of Util::almostEqual2sComplement( ndv, value, 1 ).
+ */
+class NDVPredicate
+{
+public:
+    /** Constructs a predicate that is always false (no no-data value set). */
+    NDVPredicate();
+
+    /** Constructs a predicate for the given no-data value. */
+    explicit NDVPredicate( double ndv );
+
+    /** Returns whether a no-data value is set. */
+    bool hasNDV() const { return _hasNDV; }
+
+    /** Returns the no-data value.  Only meaningful if hasNDV() returns true. */
+    double getNDV() const { return _ndv; }
+
+    /** Returns whether the given value is the no-data value (within 1 ULP). */
+    inline bool operator()( double value ) const {
+        return _hasNDV && isNDVBits( toOrderedBits( value ) );
+    }
+
+    /**
+     * Fills the given mask with the validity of each value of the given column
+     * (bit set == value is not the no-data value).
+     */
+    void computeValidityMask( const DataColumnSpan& values, ValidityMask& mask ) const;
+
+private:
+    bool _hasNDV;
+    double _ndv;
+    /** The no-data value's raw bits in two's-complement lexicographic order. */
+    uint64_t _ndvBits;
+
+    /** Returns the raw bits of the value in two's-complement lexicographic order. */
+    static inline uint64_t toOrderedBits( double value ){
+        uint64_t bits;
+        std::memcpy( &bits, &value, sizeof(bits) );
+        if( bits & 0x8000000000000000ULL )
+            bits = 0x8000000000000000ULL - bits;
+        return bits;
+    }
+
+    /** Same as the comparison in Util::almostEqual2sComplement() with maxUlps == 1.  Note that the
+     * test is not symmetric (the masked difference wraps around), so the no-data value must come first. */
+    inline bool isNDVBits( uint64_t valueBits ) const {
+        return ( ( _ndvBits - valueBits ) & 0x7FFFFFFFFFFFFFFFULL ) <= 1;
+    }
+};
+
+#endif // NDVPREDICATE_H
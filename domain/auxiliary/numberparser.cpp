@@ -0,0 +1,106 @@
+#include "numberparser.h"
+#include <QByteArray>
+#include <cstdint>
+
+namespace {
+    //powers of ten that are exactly representable as doubles.
+    const double EXACT_POWERS_OF_TEN[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                           1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                           1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const int MAX_EXACT_POWER_OF_TEN = 22;
+    //largest integer such that it and all smaller integers are exactly representable as doubles (2^53).
+    const uint64_t MAX_EXACT_MANTISSA = 9007199254740992ULL;
+    //more significant digits than this may overflow the 64-bit mantissa accumulator.
+    const int MAX_MANTISSA_DIGITS = 19;
+}
+
+bool NumberParser::parseDouble(const char *begin, const char *end, double &value)
+{
+    const char* p = begin;
+    bool isNegative = false;
+    if( p != end && ( *p == '-' || *p == '+' ) ){
+        isNegative = ( *p == '-' );
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int nSignificantDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+
+    //integer part
+    for( ; p != end && *p >= '0' && *p <= '9'; ++p ){
+        hasDigits = true;
+        if( nSignificantDigits < MAX_MANTISSA_DIGITS ){
+            mantissa = mantissa * 10 + ( *p - '0' );
+            if( mantissa )
+                ++nSignificantDigits;
+        } else {
+            ++exponent;
+            nSignificantDigits = MAX_MANTISSA_DIGITS + 1; //signals loss of digits
+        }
+    }
+
+    //fractional part
+    if( p != end && *p == '.' ){
+        ++p;
+        for( ; p != end && *p >= '0' && *p <= '9'; ++p ){
+            hasDigits = true;
+            if( nSignificantDigits < MAX_MANTISSA_DIGITS ){
+                mantissa = mantissa * 10 + ( *p - '0' );
+                if( mantissa )
+                    ++nSignificantDigits;
+                --exponent;
+            } else
+                nSignificantDigits = MAX_MANTISSA_DIGITS + 1; //signals loss of digits
+        }
+    }
+
+    if( ! hasDigits ){
+        value = 0.0;
+        return false;
+    }
+
+    //exponent part
+    if( p != end && ( *p == 'e' || *p == 'E' ) ){
+        ++p;
+        bool isExponentNegative = false;
+        if( p != end && ( *p == '-' || *p == '+' ) ){
+            isExponentNegative = ( *p == '-' );
+            ++p;
+        }
+        if( p == end || *p < '0' || *p > '9' ){
+            value = 0.0;
+            return false;
+        }
+        int explicitExponent = 0;
+        for( ; p != end && *p >= '0' && *p <= '9'; ++p )
+            if( explicitExponent < 100000 ) //saturate to avoid overflow, the result is zero or infinity anyway
+                explicitExponent = explicitExponent * 10 + ( *p - '0' );
+        exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+    }
+
+    //trailing characters make the text an invalid number
+    if( p != end ){
+        value = 0.0;
+        return false;
+    }
+
+    //fast path: both the mantissa and the power of ten are exact, so a single
+    //IEEE-754 multiplication or division yields the correctly rounded result.
+    if( nSignificantDigits <= MAX_MANTISSA_DIGITS && mantissa <= MAX_EXACT_MANTISSA &&
+        exponent >= -MAX_EXACT_POWER_OF_TEN && exponent <= MAX_EXACT_POWER_OF_TEN ){
+        double result = static_cast<double>( mantissa );
+        if( exponent < 0 )
+            result /= EXACT_POWERS_OF_TEN[ -exponent ];
+        else
+            result *= EXACT_POWERS_OF_TEN[ exponent ];
+        value = isNegative ? -result : result;
+        return true;
+    }
+
+    //slow path: Qt's locale-independent conversion (the text has been validated above).
+    bool ok = false;
+    value = QByteArray::fromRawData( begin, static_cast<int>( end - begin ) ).toDouble( &ok );
+    return ok;
+}
@@ -0,0 +1,31 @@
+#ifndef NUMBERPARSER_H
+#define NUMBERPARSER_H
+
+/**
+ * The NumberParser class converts numbers in text form directly from character buffers,
+ * without creating intermediate string objects.  It is meant to parse the values in
+ * GEO-EAS data files (see DataLoader).
+ */
+class NumberParser
+{
+public:
+    /**
+     * Returns whether the given character can be part of a number in a GEO-EAS data line.
+     * Any other character is a value separator (see Util::fastSplit()).
+     */
+    inline static bool isNumberChar( char c ){
+        return ( c >= '0' && c <= '9' ) || c == '-' || c == '.' || c == '+' || c == 'e' || c == 'E';
+    }
+
+    /**
+     * Parses the characters in the interval [begin, end) as a double value.
+     * Returns false if the entire interval is not a valid decimal number (e.g. "1.2.3" or "1e").
+     * In this case, value is set to zero (as QString::toDouble() does).
+     * The result is correctly rounded, so it is the same as the one given by QString::toDouble().
+     * Most numbers in data files (up to 15 significant digits and moderate exponents) are converted
+     * with a single floating point operation.  Others fall back to a slower, but exact, conversion.
+     */
+    static bool parseDouble( const char* begin, const char* end, double& value );
+};
+
+#endif // NUMBERPARSER_H
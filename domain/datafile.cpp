@@ -19,6 +19,7 @@
 #include <QRegularExpression>
 #include <QTextStream>
 #include <QtConcurrent/QtConcurrent>
+#include <algorithm>
 #include <cmath>
 #include <iomanip> // std::setprecision
 #include <limits>
@@ -26,6 +27,7 @@
 #include "auxiliary/dataloader.h"
 #include "auxiliary/variableremover.h"
 #include "auxiliary/datasaver.h"
+#include "auxiliary/datafilebinarycache.h"
 #include "algorithms/ialgorithmdatasource.h"
 #include "calculator/icalcproperty.h"
 #include "geogrid.h"
@@ -86,15 +88,15 @@ public:
         for (uint iColumn = 0; iColumn < dataColumnCount; ++iColumn)
             m_isCategoricalCache.push_back(m_dataFile.isCategorical(
                 m_dataFile.getAttributeFromGEOEASIndex(iColumn + 1)));
-        // init the data cache to avoid calls to DataFile::data(), as it contains a
-        // std::vector of std::vector, which causes
-        // cache misses.  The data cache is a continuous array of doubles to optimize
-        // cache hits.
+        // init the data cache to avoid calls to DataFile::data() per value.  The data
+        // cache is a continuous array of doubles in row-major order, which is the access
+        // pattern of the algorithms (one record at a time).
         m_dataCache = new double[dataRowCount * dataColumnCount];
-        for (long iRow = 0; iRow < dataRowCount; ++iRow)
-            for (uint iColumn = 0; iColumn < dataColumnCount; ++iColumn)
-                m_dataCache[iRow * dataColumnCount + iColumn]
-                    = m_dataFile.data(iRow, iColumn);
+        for (uint iColumn = 0; iColumn < dataColumnCount; ++iColumn) {
+            DataColumnSpan columnValues = m_dataFile.getColumnSpan(iColumn);
+            for (long iRow = 0; iRow < dataRowCount; ++iRow)
+                m_dataCache[iRow * dataColumnCount + iColumn] = columnValues[iRow];
+        }
         // store the data source sizes as the DataFile methods generate too many messages
         // (performance bottleneck)
         // and/or use the filesystem often.
@@ -113,7 +115,9 @@ protected:
 
 DataFile::DataFile(QString path)
     : File(path), ICalcPropertyCollection(), _lastModifiedDateTimeLastLoad(), _dataPageFirstLine(0),
-      _dataPageLastLine(std::numeric_limits<long>::max())
+      _dataPageLastLine(std::numeric_limits<long>::max()), _columnEditsDepth(0),
+      _columnEditsPageFirstLine(0), _columnEditsPageLastLine(std::numeric_limits<long>::max()),
+      _hasPendingColumnEdits(false)
 {
     _algorithmDataSourceInterface.reset(new AlgorithmDataSource(*this));
 }
@@ -146,37 +150,28 @@ void DataFile::loadData()
 
     // make sure _data is empty
     _data.clear();
-	std::vector< std::vector<double> >().swap(_data); //clear() may not actually free memory
-
-    // data load takes place in another thread, so we can show and update a progress bar
-    //////////////////////////////////
-    QProgressDialog progressDialog;
-    progressDialog.show();
-    progressDialog.setLabelText("Loading and parsing " + _path + "...");
-    progressDialog.setMinimum(0);
-    progressDialog.setValue(0);
-    progressDialog.setMaximum(getFileSize() / 100); // see DataLoader::doLoad(). Dividing
-                                                    // by 100 allows a max value of ~400GB
-                                                    // when converting from long to int
-    QThread *thread = new QThread(); // does it need to set parent (a QObject)?
-    DataLoader *dl = new DataLoader(file, _data, data_line_count, _dataPageFirstLine,
-                                    _dataPageLastLine); // Do not set a parent. The object
-                                                        // cannot be moved if it has a
-                                                        // parent.
-    dl->moveToThread(thread);
-    dl->connect(thread, SIGNAL(finished()), dl, SLOT(deleteLater()));
-    dl->connect(thread, SIGNAL(started()), dl, SLOT(doLoad()));
-    dl->connect(dl, SIGNAL(progress(int)), &progressDialog, SLOT(setValue(int)));
-	thread->start();
-    /////////////////////////////////
-
-    // wait for the data load to finish
-    // not very beautiful, but simple and effective
-    while (!dl->isFinished()) {
-        thread->wait(200); // reduces cpu usage, refreshes at each 500 milliseconds
-        QCoreApplication::processEvents(); // let Qt repaint widgets
+    invalidateColumnStatistics();
+
+    // try to load the values from the binary sidecar cache first (see DataFileBinaryCache)
+    if (DataFileBinaryCache::load(_path, _data, _dataPageFirstLine, _dataPageLastLine,
+                                  data_line_count)) {
+        Application::instance()->logInfo(
+            QString("Data loaded from binary cache ")
+                .append(DataFileBinaryCache::getCachePath(_path)).append("."));
+    } else if (parseData(file, data_line_count,
+                         getFileSize() >= DataFileBinaryCache::MIN_SOURCE_FILE_SIZE)) {
+        // the data page was parsed into a new binary cache (of the entire file or of the page
+        // alone), from which it is mapped.  If anything fails, parses the data page into memory.
+        bool loaded = DataFileBinaryCache::finishBuild(_path, _data,
+                                                       hasNoDataValue() ? getNoDataValueAsDouble()
+                                                                        : std::nan(""))
+                      && DataFileBinaryCache::load(_path, _data, _dataPageFirstLine,
+                                                   _dataPageLastLine, data_line_count);
+        if (!loaded) {
+            _data.clear();
+            parseData(file, data_line_count, false);
+        }
     }
-
     file.close();
 
 	// geo- and cartesian grids must have a given number of read lines
@@ -202,102 +197,91 @@ void DataFile::loadData()
 
 double DataFile::data(uint line, uint column)
 {
-    switch (_data.size()) { // if _data is empty
-    case 0:
+    if (_data.empty())
         loadData(); // loads the data from disk.
-    }
-    return (this->_data.at(line)).at(column);
+    return _data.get(line, column);
+}
+
+DataColumnSpan DataFile::getColumnSpan(uint column)
+{
+    if (_data.empty())
+        loadData(); // loads the data from disk.
+    if (column >= _data.getColumnCount())
+        return DataColumnSpan();
+    return _data.getColumnSpan(column);
 }
 
 // TODO: consider adding a flag to disable NDV checking (applicable to coordinates)
 double DataFile::max(uint column)
 {
-    if (_data.size() == 0)
+    if (_data.empty())
         Application::instance()->logError(
             "DataFile::max(): Data not loaded. Unspecified value was returned.");
-    double ndv = this->getNoDataValue().toDouble();
-    bool has_ndv = this->hasNoDataValue();
-    double result = -std::numeric_limits<double>::max();
-    for (uint i = 0; i < _data.size(); ++i) {
-        double value = data(i, column);
-        if (value > result && (!has_ndv || !Util::almostEqual2sComplement(ndv, value, 1)))
-            result = value;
-    }
-    return result;
+    return getColumnStatistics(column).max;
 }
 
 double DataFile::maxAbs(uint column)
 {
-    if (_data.size() == 0)
+    if (_data.empty())
         Application::instance()->logError(
             "DataFile::maxAbs(): Data not loaded. Unspecified value was returned.");
-    double ndv = this->getNoDataValue().toDouble();
-    bool has_ndv = this->hasNoDataValue();
-	double result = 0.0;
-    for (uint i = 0; i < _data.size(); ++i) {
-        double value = data(i, column);
-        if (std::abs<double>(value) > result
-            && (!has_ndv || !Util::almostEqual2sComplement(ndv, value, 1)))
-            result = std::abs<double>(value);
-    }
-    return result;
+    return getColumnStatistics(column).maxAbs;
 }
 
 // TODO: consider adding a flag to disable NDV checking (applicable to coordinates)
 double DataFile::min(uint column)
 {
-    if (_data.size() == 0)
+    if (_data.empty())
         Application::instance()->logError(
             "DataFile::min(): Data not loaded. Unspecified value was returned.");
-    double ndv = this->getNoDataValue().toDouble();
-    bool has_ndv = this->hasNoDataValue();
-    double result = std::numeric_limits<double>::max();
-    for (uint i = 0; i < _data.size(); ++i) {
-        double value = data(i, column);
-        if (value < result && (!has_ndv || !Util::almostEqual2sComplement(ndv, value, 1)))
-            result = value;
-    }
-    return result;
+    return getColumnStatistics(column).min;
 }
 
 double DataFile::minAbs(uint column)
 {
-    if (_data.size() == 0)
+    if (_data.empty())
         Application::instance()->logError(
             "DataFile::minAbs(): Data not loaded. Unspecified value was returned.");
-    double ndv = this->getNoDataValue().toDouble();
-    bool has_ndv = this->hasNoDataValue();
-    double result = std::numeric_limits<double>::max();
-    for (uint i = 0; i < _data.size(); ++i) {
-        double value = data(i, column);
-        if (std::abs<double>(value) < result
-            && (!has_ndv || !Util::almostEqual2sComplement(ndv, value, 1)))
-            result = std::abs<double>(value);
-    }
-    return result;
+    return getColumnStatistics(column).minAbs;
 }
 
 // TODO: consider adding a flag to disable NDV checking (applicable to coordinates)
 double DataFile::mean(uint column)
 {
-    if (_data.size() == 0)
+    if (_data.empty())
         Application::instance()->logError(
             "DataFile::mean(): Data not loaded. Unspecified value was returned.");
-    double ndv = this->getNoDataValue().toDouble();
-    bool has_ndv = this->hasNoDataValue();
-    double result = 0.0;
-    uint count_valid = 0;
-    for (uint i = 0; i < _data.size(); ++i) {
-        double value = data(i, column);
-        if (!has_ndv || !Util::almostEqual2sComplement(ndv, value, 1)) {
-            result += value;
-            ++count_valid;
-        }
+    return getColumnStatistics(column).mean;
+}
+
+const ColumnStatistics &DataFile::getColumnStatistics(uint column)
+{
+    // statistics of columns not loaded are not cached
+    if (_data.empty() || column >= _data.getColumnCount()) {
+        _emptyColumnStatistics = ColumnStatistics();
+        return _emptyColumnStatistics;
     }
-    if (count_valid > 0)
-        return result / count_valid;
-    else
-        return 0.0;
+    // a change in the no-data value affects the statistics of all columns
+    if (_columnStatisticsNDV != _no_data_value) {
+        invalidateColumnStatistics();
+        _columnStatisticsNDV = _no_data_value;
+    }
+    if (_columnStatistics.size() < _data.getColumnCount()) {
+        _columnStatistics.resize(_data.getColumnCount());
+        _isColumnStatisticsValid.resize(_data.getColumnCount(), false);
+    }
+    if (!_isColumnStatisticsValid[column]) {
+        _columnStatistics[column] = ColumnStatistics::compute(getColumnSpan(column),
+                                                              getNDVPredicate());
+        _isColumnStatisticsValid[column] = true;
+    }
+    return _columnStatistics[column];
+}
+
+void DataFile::invalidateColumnStatistics()
+{
+    _columnStatistics.clear();
+    _isColumnStatisticsValid.clear();
 }
 
 uint DataFile::getFieldGEOEASIndex(QString field_name)
@@ -396,6 +380,41 @@ Attribute *DataFile::getVariableOfNScoreVar(Attribute *at)
     return variable;
 }
 
+bool DataFile::parseData(QFile &file, uint &data_line_count, bool buildBinaryCache)
+{
+    // data load takes place in another thread, so we can show and update a progress bar
+    //////////////////////////////////
+    QProgressDialog progressDialog;
+    progressDialog.show();
+    progressDialog.setLabelText("Loading and parsing " + _path + "...");
+    progressDialog.setMinimum(0);
+    progressDialog.setValue(0);
+    progressDialog.setMaximum(getFileSize() / 100); // see DataLoader::doLoad(). Dividing
+                                                    // by 100 allows a max value of ~400GB
+                                                    // when converting from long to int
+    QThread *thread = new QThread(); // does it need to set parent (a QObject)?
+    DataLoader *dl = new DataLoader(file, _data, data_line_count, _dataPageFirstLine,
+                                    _dataPageLastLine,
+                                    buildBinaryCache); // Do not set a parent. The object
+                                                       // cannot be moved if it has a
+                                                       // parent.
+    dl->moveToThread(thread);
+    dl->connect(thread, SIGNAL(finished()), dl, SLOT(deleteLater()));
+    dl->connect(thread, SIGNAL(started()), dl, SLOT(doLoad()));
+    dl->connect(dl, SIGNAL(progress(int)), &progressDialog, SLOT(setValue(int)));
+	thread->start();
+    /////////////////////////////////
+
+    // wait for the data load to finish
+    // not very beautiful, but simple and effective
+    while (!dl->isFinished()) {
+        thread->wait(200); // reduces cpu usage, refreshes at each 500 milliseconds
+        QCoreApplication::processEvents(); // let Qt repaint widgets
+    }
+
+    return dl->hasBuiltBinaryCache();
+}
+
 void DataFile::deleteFromFS()
 {
     File::deleteFromFS(); // delete the file itself.
@@ -403,12 +422,14 @@ void DataFile::deleteFromFS()
     QFile file(this->getMetaDataFilePath());
     file.remove(); // TODO: throw exception if remove() returns false (fails).  Also see
                    // QIODevice::errorString() to see error message.
+    // also deletes the binary cache file, if any
+    DataFileBinaryCache::remove(this->getPath());
 }
 
 void DataFile::writeToFS()
 {
 
-    if( _data.size() <= 0 ){
+    if( _data.empty() ){
         Application::instance()->logError("DataFile::writeToFS(): No data. Save failed.");
         return;
     }
@@ -434,7 +455,7 @@ void DataFile::writeToFS()
 
     // next, we need to know the number of columns
     //(assumes the first data line has the correct number of variables)
-    uint nvars = _data[0].size();
+    uint nvars = _data.getColumnCount();
     out << nvars << endl;
 
     // get all child objects (mostly attributes directly under this file or attached under
@@ -503,6 +524,13 @@ void DataFile::writeToFS()
     currentFile.remove();
     // renames the .new file, effectively replacing the current file.
     outputFile.rename(this->getPath());
+    // the in-memory data is the entire contents of the new file, so the binary cache
+    // can be refreshed without parsing it again.
+    if (getFileSize() >= DataFileBinaryCache::MIN_SOURCE_FILE_SIZE)
+        DataFileBinaryCache::save(getPath(), _data,
+                                  hasNoDataValue() ? getNoDataValueAsDouble() : std::nan(""));
+    else
+        DataFileBinaryCache::remove(getPath());
     // updates properties list so any changes appear in the project tree.
     updatePropertyCollection();
     // update the project tree in the main window.
@@ -541,6 +569,12 @@ int DataFile::getCalcPropertyIndex(const std::string & name)
 
 void DataFile::updatePropertyCollection()
 {
+	// while column edits are staged, the file header is out of date, so the variable names are
+	// taken from the current Attribute objects (see getStagedFieldNames())
+	QStringList stagedFieldNames;
+	if( isEditingColumns() )
+		stagedFieldNames = getStagedFieldNames();
+
 	// erases all current children
     this->_children.clear(); // TODO: deallocate elements/deep delete (minor memory leak)
 
@@ -557,7 +591,7 @@ void DataFile::updatePropertyCollection()
 		cgUVW->updatePropertyCollection();
 	} else {
 		// list fields from data file
-		QStringList fields = Util::getFieldNames(this->_path);
+		QStringList fields = isEditingColumns() ? stagedFieldNames : Util::getFieldNames(this->_path);
 
 		// create children objects (Attributes)
 		for (int i = 0; i < fields.size(); ++i) {
@@ -643,11 +677,6 @@ void DataFile::addGEOEASColumn(Attribute *at, const QString new_name, bool categ
     // get the number of data lines in the source file
     uint data_line_count = attributes_file->getDataLineCount();
 
-    // create a new file for output
-    QFile outputFile(QString(file_path).append(".new"));
-    outputFile.open(QFile::WriteOnly | QFile::Text);
-    QTextStream out(&outputFile);
-
     // set the no-data value to be used
     QString NDV;
     if (this->hasNoDataValue()) // the expected no-data value is from the destination file
@@ -666,6 +695,37 @@ void DataFile::addGEOEASColumn(Attribute *at, const QString new_name, bool categ
                                          "-9999999.");
     }
 
+    // if column edits are being staged, the new column is added to the data in memory and
+    // the file is rewritten only in commitColumnEdits()
+    if (isEditingColumns()) {
+        double ndv = NDV.toDouble();
+        std::vector<double> values(getDataLineCount(), ndv);
+        for (uint i = 0; i < values.size() && i < data_line_count; ++i) {
+            double value = attributes_file->data(i, column_index_in_original_file);
+            if (!attributes_file->isNDV(value))
+                values[i] = value;
+        }
+        _data.appendColumn(values.data(), values.size(), ndv);
+        uint indexGEOEAS_new_variable = _data.getColumnCount();
+        if (categorical) {
+            // TODO: guard against cd being nullptr
+            _categorical_attributes.append(
+                QPair<uint, QString>(indexGEOEAS_new_variable, cd->getName()));
+            this->updateMetaDataFile();
+        }
+        // Create a new Attribute object that correspond to the new data column in memory
+        Attribute *newAttribute = new Attribute(var_name, indexGEOEAS_new_variable, categorical);
+        addChild(newAttribute);
+        newAttribute->setParent(this);
+        _hasPendingColumnEdits = true;
+        return;
+    }
+
+    // create a new file for output
+    QFile outputFile(QString(file_path).append(".new"));
+    outputFile.open(QFile::WriteOnly | QFile::Text);
+    QTextStream out(&outputFile);
+
     // open the destination file for reading
     QFile inputFile(file_path);
     if (inputFile.open(QIODevice::ReadOnly | QFile::Text)) {
@@ -752,25 +812,33 @@ void DataFile::addGEOEASColumn(Attribute *at, const QString new_name, bool categ
     }
 }
 
-uint DataFile::getDataLineCount() { return _data.size(); }
+uint DataFile::getDataLineCount() { return _data.getRowCount(); }
 
 uint DataFile::getDataColumnCount()
 {
     loadData();
     if (getDataLineCount() > 0)
-        return _data[0].size();
+        return _data.getColumnCount();
     else
         return 0;
 }
 
-bool DataFile::isNDV(double value)
+void DataFile::updateNDVPredicate()
 {
+    // a null QString marks the predicate as not built yet, so an empty no-data value is stored as ""
+    _ndvPredicateText = _no_data_value.isNull() ? QString("") : _no_data_value;
     if (!this->hasNoDataValue())
-        return false;
-    else {
-        double ndv = this->getNoDataValue().toDouble();
-        return Util::almostEqual2sComplement(ndv, value, 1);
-    }
+        _ndvPredicate = NDVPredicate();
+    else
+        _ndvPredicate = NDVPredicate(_ndvPredicateText.toDouble());
+}
+
+void DataFile::getValidityMask(uint column, ValidityMask &mask)
+{
+    DataColumnSpan columnValues = (_data.empty() || column >= _data.getColumnCount())
+                                      ? DataColumnSpan()
+                                      : getColumnSpan(column);
+    getNDVPredicate().computeValidityMask(columnValues, mask);
 }
 
 void DataFile::classify(uint column, UnivariateCategoryClassification *ucc,
@@ -779,20 +847,21 @@ void DataFile::classify(uint column, UnivariateCategoryClassification *ucc,
     // load the current data from the file system
     loadData();
 
+    // define the default value (for class not found)
+    int noClassFoundValue = -1;
+    if (hasNoDataValue())
+        // hopefully the file's NDV is integer
+        noClassFoundValue = (int)getNoDataValue().toDouble();
+
+    // append a new column to hold the category codes
+    size_t newColumn = _data.appendColumn(noClassFoundValue);
+    const double *values = _data.getColumnSpan(column).data();
+    double *categoryIds = _data.column(newColumn);
+
     // for each data row...
-    std::vector<std::vector<double>>::iterator it = _data.begin();
-    for (; it != _data.end(); ++it) {
-        // define the default value (for class not found)
-        int noClassFoundValue = -1;
-        if (hasNoDataValue())
-            // hopefully the file's NDV is integer
-            noClassFoundValue = (int)getNoDataValue().toDouble();
-        //...get the input value
-        double value = (*it).at(column);
-        //...get the category code corresponding to the value
-        int categoryId = ucc->getCategory(value, noClassFoundValue);
-        //...append the code to the current row.
-        (*it).push_back(categoryId);
+    for (size_t i = 0; i < _data.getRowCount(); ++i) {
+        //...get the category code corresponding to the input value
+        categoryIds[i] = ucc->getCategory(values[i], noClassFoundValue);
     }
 
     // create and add a new Attribute object the represents the new column
@@ -806,7 +875,7 @@ void DataFile::classify(uint column, UnivariateCategoryClassification *ucc,
     this->addChild(at);
 
     // saves the file contents to file system
-    this->writeToFS();
+    this->writeColumnEditsToFS();
 
     // update the metadata file
     this->updateMetaDataFile();
@@ -814,8 +883,7 @@ void DataFile::classify(uint column, UnivariateCategoryClassification *ucc,
 
 void DataFile::freeLoadedData() {
 	_data.clear();
-	//clear() does not guarantee memory is actually freed.
-	std::vector< std::vector<double> >().swap( _data );
+	invalidateColumnStatistics();
 }
 
 void DataFile::setDataPage(long firstDataLine, long lastDataLine)
@@ -840,31 +908,26 @@ void DataFile::addDataColumns(std::vector< std::complex<double> > &columns,
                               const QString nameForNewAttributeOfImaginaryPart)
 {
     // TODO: refatorar reutilizando addEmptyDataColumn e um futuro addDataColumn
-    if (_data.empty()) { // no data, column will be first column
-        _data.reserve(columns.size());
-        std::vector<std::complex<double>>::iterator it = columns.begin();
-        for (; it != columns.end(); ++it)
-            _data.push_back({(*it).real(), (*it).imag()});
-    } else { // there are data already, column will be appended to the current ones
-        std::vector<std::complex<double>>::iterator itColumn = columns.begin();
-        std::vector<std::vector<double>>::iterator itData = _data.begin();
-        // hopefully both iterators end at the same time
-        for (; itColumn != columns.end(), itData != _data.end(); ++itColumn, ++itData) {
-            (*itData).push_back((*itColumn).real());
-            (*itData).push_back((*itColumn).imag());
-        }
-        if (itData != _data.end() || itColumn != columns.end())
-            Application::instance()->logError("DataFile::addDataColumn(): number of "
-                                              "values to add mismatched number of data "
-                                              "rows.");
+    if (_data.getColumnCount() > 0 && columns.size() != _data.getRowCount())
+        Application::instance()->logError("DataFile::addDataColumn(): number of "
+                                          "values to add mismatched number of data "
+                                          "rows.");
+
+    // split the complex values into the real and imaginary parts
+    std::vector<double> realParts(columns.size());
+    std::vector<double> imaginaryParts(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        realParts[i] = columns[i].real();
+        imaginaryParts[i] = columns[i].imag();
     }
 
+    // if there is no data, the new columns will be the first ones
+    _data.appendColumn(realParts.data(), realParts.size(), 0.0);
+    _data.appendColumn(imaginaryParts.data(), imaginaryParts.size(), 0.0);
+
     // get the GEO-EAS index for new attributes
-    uint indexGEOEASreal
-        = _data[0].size()
-          - 1; // assumes the first row has the correct number of data columns
-    uint indexGEOEASimag
-        = _data[0].size(); // assumes the first row has the correct number of data columns
+    uint indexGEOEASreal = _data.getColumnCount() - 1;
+    uint indexGEOEASimag = _data.getColumnCount();
 
     // Create new Attribute objects that correspond to the new data columns in memory
     Attribute *newAttributeReal
@@ -883,29 +946,17 @@ void DataFile::addDataColumns(std::vector< std::complex<double> > &columns,
 
 long DataFile::addEmptyDataColumn(const QString columnName, long numberOfDataElements)
 {
-    std::vector<double> newColumn(numberOfDataElements, 0.0);
+    if (_data.getColumnCount() > 0 && numberOfDataElements != (long)_data.getRowCount())
+        Application::instance()->logError("DataFile::addEmptyDataColumn(): number of "
+                                          "values to add mismatched number of data "
+                                          "rows.");
 
-    if (_data.empty()) { // no data, column will be first column
-        _data.reserve(newColumn.size());
-        std::vector<double>::iterator it = newColumn.begin();
-        for (; it != newColumn.end(); ++it)
-            _data.push_back({*it});
-    } else { // there are data already, column will be appended to the current ones
-        std::vector<double>::iterator itColumn = newColumn.begin();
-        std::vector<std::vector<double>>::iterator itData = _data.begin();
-        // hopefully both iterators end at the same time
-        for (; itColumn != newColumn.end(), itData != _data.end(); ++itColumn, ++itData) {
-            (*itData).push_back(*itColumn);
-        }
-        if (itData != _data.end() || itColumn != newColumn.end())
-            Application::instance()->logError("DataFile::addEmptyDataColumn(): number of "
-                                              "values to add mismatched number of data "
-                                              "rows.");
-    }
+    // if there is no data, the new column will be the first one
+    std::vector<double> newColumn(numberOfDataElements, 0.0);
+    _data.appendColumn(newColumn.data(), newColumn.size(), 0.0);
 
     // get the GEO-EAS index for new attribute
-    uint indexGEOEAS
-        = _data[0].size(); // assumes the first row has the correct number of data column
+    uint indexGEOEAS = _data.getColumnCount();
 
     // Create new Attribute objects that correspond to the new data column in memory
     Attribute *newAttribute = new Attribute(columnName, indexGEOEAS);
@@ -939,20 +990,12 @@ int DataFile::addNewDataColumn(const QString columnName,
         defaultValue = getNoDataValueAsDouble();
 
     // append the values to the existing data array
-    std::vector<double>::const_iterator itColumn = values.cbegin();
-    std::vector<std::vector<double>>::iterator itData = _data.begin();
-    // hopefully both iterators end at the same time
-	for (; itColumn != values.cend(), itColumn != values.end() && itData != _data.end(); ++itColumn, ++itData)
-        (*itData).push_back(*itColumn);
-
-    // If the transfer was not completed (the input vector is too short), fill the
-    // remainder with the default value
-    for (; itData != _data.end(); ++itData)
-        (*itData).push_back(defaultValue);
+    // If the transfer was not completed (the input vector is too short), the
+    // remainder is filled with the default value
+    _data.appendColumn(values.data(), values.size(), defaultValue);
 
     // get the GEO-EAS index for new attribute
-    uint indexGEOEAS
-        = _data[0].size(); // assumes the first row has the correct number of data column
+    uint indexGEOEAS = _data.getColumnCount();
 
     // if the added column was deemed categorical, adds its GEO-EAS index and name of the
     // category definition
@@ -976,7 +1019,7 @@ int DataFile::addNewDataColumn(const QString columnName,
     newAttribute->setParent(this);
 
     // update the file
-    writeToFS();
+    writeColumnEditsToFS();
 
     // returns the index of the new column
     return indexGEOEAS - 1;
@@ -984,13 +1027,16 @@ int DataFile::addNewDataColumn(const QString columnName,
 
 void DataFile::deleteVariable( uint columnToDelete )
 {
-    if( Util::getFieldNames( getPath() ).size() < 2 ){ //getDataColumnCount() triggers a loadData().
+    uint nVariables = isEditingColumns() ? _data.getColumnCount()
+                                         : Util::getFieldNames( getPath() ).size(); //getDataColumnCount() triggers a loadData().
+    if( nVariables < 2 ){
         Application::instance()->logError("DataFile::deleteVariable(): Cannot delete the single variable of a file.  Remove the file instead.");
         return;
     }
 
-    //delete any data loaded to memory.
-    freeLoadedData();
+    //delete any data loaded to memory, unless the column removal is staged (see beginColumnEdits()).
+    if( ! isEditingColumns() )
+        freeLoadedData();
 
     uint columnToDeleteGEOEAS = columnToDelete + 1;
 
@@ -1033,8 +1079,21 @@ void DataFile::deleteVariable( uint columnToDelete )
     //updates the metadata file in the project
     updateMetaDataFile();
 
-    //remove the data column from the physical file
-    {
+    if( isEditingColumns() ){
+        //remove the data column in memory and the corresponding Attribute object,
+        //the file is rewritten in commitColumnEdits()
+        _data.removeColumn( columnToDelete );
+        invalidateColumnStatistics();
+        _hasPendingColumnEdits = true;
+        std::vector<ProjectComponent *> allChildren;
+        getAllObjects( allChildren );
+        for( ProjectComponent* pc : allChildren )
+            if( pc->isAttribute() && ((Attribute*)pc)->getAttributeGEOEASgivenIndex() == (int)columnToDeleteGEOEAS ){
+                pc->getParent()->removeChild( pc );
+                break;
+            }
+    } else {
+       //remove the data column from the physical file
        //file manipulation takes place in another thread, so we can show and update a progress bar
        //////////////////////////////////
        QProgressDialog progressDialog;
@@ -1070,32 +1129,79 @@ void DataFile::deleteVariable( uint columnToDelete )
     _algorithmDataSourceInterface.reset( new AlgorithmDataSource(*this) );
 }
 
+void DataFile::beginColumnEdits()
+{
+    if( _columnEditsDepth++ > 0 )
+        return;
+    //the edits apply to the entire data set (the current page is restored in commitColumnEdits())
+    _columnEditsPageFirstLine = _dataPageFirstLine;
+    _columnEditsPageLastLine = _dataPageLastLine;
+    setDataPageToAll();
+    loadData();
+    _hasPendingColumnEdits = false;
+}
+
+void DataFile::commitColumnEdits()
+{
+    if( _columnEditsDepth == 0 ){
+        Application::instance()->logWarn("DataFile::commitColumnEdits(): no prior call to beginColumnEdits().  Nothing done.");
+        return;
+    }
+    if( --_columnEditsDepth > 0 )
+        return;
+    if( _hasPendingColumnEdits ){
+        _hasPendingColumnEdits = false;
+        //write all staged column additions and removals in a single pass
+        writeToFS();
+        //updates properties list so any changes appear in the project tree.
+        updatePropertyCollection();
+        //update the project tree in the main window.
+        Application::instance()->refreshProjectTree();
+    }
+    //back to the data page set before the edits
+    setDataPage( _columnEditsPageFirstLine, _columnEditsPageLastLine );
+}
+
+bool DataFile::isEditingColumns()
+{
+    return _columnEditsDepth > 0;
+}
+
+void DataFile::writeColumnEditsToFS()
+{
+    if( isEditingColumns() )
+        _hasPendingColumnEdits = true;
+    else
+        writeToFS();
+}
+
+QStringList DataFile::getStagedFieldNames()
+{
+    //collect the Attribute objects (including those under other attributes, such as weights)
+    std::vector<ProjectComponent *> allChildren;
+    getAllObjects( allChildren );
+    std::vector<Attribute *> attributes;
+    for( ProjectComponent* pc : allChildren )
+        if( pc->isAttribute() )
+            attributes.push_back( (Attribute*)pc );
+    //the names in GEO-EAS order (gaps left by removed variables are closed)
+    std::stable_sort( attributes.begin(), attributes.end(), []( Attribute* a, Attribute* b ){
+        return a->getAttributeGEOEASgivenIndex() < b->getAttributeGEOEASgivenIndex();
+    } );
+    QStringList names;
+    for( Attribute* at : attributes )
+        names << at->getName();
+    return names;
+}
+
 double DataFile::variance(uint column)
 {
-    if (_data.size() == 0) {
+    if (_data.empty()) {
         Application::instance()->logError(
             "DataFile::variance(): Data not loaded. Zero was returned.");
         return 0.0;
     }
-    // collect the valid values
-    double ndv = this->getNoDataValue().toDouble();
-    bool has_ndv = this->hasNoDataValue();
-    std::vector<double> values;
-    values.reserve(getDataLineCount());
-    for (uint i = 0; i < _data.size(); ++i) {
-        double value = data(i, column);
-        if (!has_ndv || !Util::almostEqual2sComplement(ndv, value, 1)) {
-            values.push_back(value);
-        }
-    }
-    // compute the variance
-    double mean = this->mean(column);
-    std::vector<double> diff(values.size());
-    std::transform(values.begin(), values.end(), diff.begin(),
-                   [mean](double x) { return x - mean; });
-    double squaredSum(std::inner_product(diff.begin(), diff.end(), diff.begin(), 0.0));
-    double stdev(std::sqrt(squaredSum / (double)values.size()));
-    return stdev * stdev;
+    return getColumnStatistics(column).variance;
 }
 
 double DataFile::correlation(uint columnX, uint columnY)
@@ -1104,16 +1210,14 @@ double DataFile::correlation(uint columnX, uint columnY)
     double squareSum_X = 0.0, squareSum_Y = 0.0;
     int n = getDataLineCount();
     int nValidValues = 0;
-    double ndv = this->getNoDataValue().toDouble();
-    bool has_ndv = this->hasNoDataValue();
+    const NDVPredicate isNDV = getNDVPredicate();
 
     for (int i = 0; i < n; i++) {
         double X = data(i, columnX);
         double Y = data(i, columnY);
 
         // if one of the values is invalid, ignore the record
-        if (has_ndv && (Util::almostEqual2sComplement(ndv, X, 1)
-                        || Util::almostEqual2sComplement(ndv, Y, 1))) {
+        if (isNDV(X) || isNDV(Y)) {
             continue;
         }
 
@@ -1141,25 +1245,21 @@ double DataFile::correlation(uint columnX, uint columnY)
 
 void DataFile::setData(uint line, uint column, double value)
 {
-	switch (_data.size()) { // if _data is empty
-	case 0:
+	if (_data.empty())
 		loadData(); // loads the data from disk.
-	}
-    this->_data.at(line).at(column) = value;
+    _data.set(line, column, value);
+    invalidateColumnStatistics(column);
 }
 
 std::vector<double> DataFile::getDataColumn(uint column)
 {
     loadData();
-    std::vector<double> result;
-    uint nLines = getDataLineCount();
-    result.reserve( nLines );
-    for( uint i = 0; i < nLines; ++i)
-        result.push_back( data(i, column) );
-    return result;
+    DataColumnSpan values = getColumnSpan( column );
+    return std::vector<double>( values.begin(), values.end() );
 }
 
 void DataFile::removeDataLine(uint line)
 {
-	_data.erase( _data.begin() + line );
+	_data.removeRow( line );
+	invalidateColumnStatistics();
 }
@@ -3,9 +3,13 @@
 
 #include "file.h"
 #include "calculator/icalcpropertycollection.h"
+#include "auxiliary/columnardatastore.h"
+#include "auxiliary/columnstatistics.h"
+#include "auxiliary/ndvpredicate.h"
 #include <vector>
 #include <QMap>
 #include <QDateTime>
+#include <QStringList>
 #include <complex>
 #include <memory>
 
@@ -13,6 +17,7 @@ class Attribute;
 class UnivariateCategoryClassification;
 class CategoryDefinition;
 class IAlgorithmDataSource;
+class QFile;
 
 enum class CartesianCoord : int {
 	X,
@@ -44,6 +49,15 @@ public:
       */
     double data(uint line, uint column);
 
+    /**
+     * Returns a read-only view of the loaded values of the given column (first column is 0).
+     * The values are contiguous in memory, which makes this the preferred way to scan a variable
+     * in performance-critical loops.  Data is loaded if not already.
+     * @note The returned span is invalidated by any operation that adds or removes data lines or columns
+     *       or that reloads or frees the data.
+     */
+    DataColumnSpan getColumnSpan( uint column );
+
     /**
      * Returns the maximum value in the given column.
      * First column is 0.
@@ -213,9 +227,26 @@ public:
 
     /** Returns whether the given value equals the no-data value set for this data file.
      * If a no-data value has not been set, this method always returns false.
-     * TODO: possible performance bottleneck.
+     * The no-data value is parsed only once (see getNDVPredicate()).
+     */
+    inline bool isNDV( double value ){ return getNDVPredicate()( value ); }
+
+    /**
+     * Returns the predicate that tests values against this data file's no-data value.  The predicate is
+     * rebuilt only when the no-data value text changes.  Copy it to local variables in tight loops.
+     */
+    inline const NDVPredicate& getNDVPredicate(){
+        if( _ndvPredicateText.isNull() || _ndvPredicateText != _no_data_value )
+            updateNDVPredicate();
+        return _ndvPredicate;
+    }
+
+    /**
+     * Fills the given mask with the validity of each loaded value of the given column (GEO-EAS index - 1),
+     * that is, a bit set for each value that is not the no-data value.  Loops over the column can then
+     * skip no-data values without testing each value.  The mask is empty if data is not loaded.
      */
-    bool isNDV( double value );
+    void getValidityMask( uint column, ValidityMask& mask );
 
     /**
      * Adds a new data column (variable/attribute) containing categorical values computed from the
@@ -235,11 +266,14 @@ public:
      * To read all data lines in the file, set any interval that will surely include
      * all data lines such as 0 and std::numeric_limits<long>::max().
      * Setting a data page also helps in selecting a realization or range of realizations in Cartesian grids.
+     * For files with a binary cache (see DataFileBinaryCache), changing pages just maps another portion of
+     * the cache file into memory.
      */
     void setDataPage( long firstDataLine, long lastDataLine );
 
     /** Sets data page to cover the entire file (from line 0 to infinity).
-     * @note WARNING! Makes the entire file to be loaded into memory!
+     * @note WARNING! Makes the entire file to be loaded into memory!  For large files, the data is mapped
+     *       from the binary cache file, so the operating system can page it in and out as needed.
      */
     void setDataPageToAll();
 
@@ -290,9 +324,33 @@ public:
      */
     virtual void deleteVariable(uint columnToDelete );
 
+    /**
+     * Starts staging column edits: until the matching call to commitColumnEdits(), addGEOEASColumn(),
+     * addNewDataColumn(), classify(), deleteVariable() and the column operations of grids change only
+     * the data in memory, so a sequence of edits costs a single rewrite of the file instead of one per edit.
+     * The entire data set is loaded (the data page is reset, see setDataPageToAll(), and restored by the
+     * outermost commitColumnEdits()).
+     * Calls can be nested.  Only the outermost commitColumnEdits() writes the file.
+     */
+    void beginColumnEdits();
+
+    /** Writes the column edits staged since beginColumnEdits() to the file in a single pass. */
+    void commitColumnEdits();
+
+    /** Returns whether column edits are being staged (see beginColumnEdits()). */
+    bool isEditingColumns();
+
     /** Returns the variance of the values in the given column. */
     double variance( uint column );
 
+    /**
+     * Returns the summary statistics (min, max, mean, variance, etc.) of the given column (GEO-EAS index - 1).
+     * The statistics are computed in a single pass on the first call and cached until the column values
+     * or the no-data value change, so methods like max(), min() and mean() do not rescan the data.
+     * If data is not loaded or the column does not exist, returns the statistics of no values.
+     */
+    const ColumnStatistics& getColumnStatistics( uint column );
+
     /** Returns the Pearson correlation coefficient of the values in the given columns. */
     double correlation(uint columnX, uint columnY );
 
@@ -350,11 +408,9 @@ public:
 protected:
 
     /**
-     * The data table.  A matrix of doubles.
-     * Outer vector are rows of data.
-     * Inner vector are values in a row of data.
+     * The data table.  A matrix of doubles stored column by column (see ColumnarDataStore).
      */
-	std::vector< std::vector<double> > _data;
+	ColumnarDataStore _data;
 
     /** The no-data value specified by the user. */
     QString _no_data_value;
@@ -362,6 +418,35 @@ protected:
     /** Repopulates the _children collection.  Mainly useful when there are changes in the physical file. */
     void updatePropertyCollection();
 
+    /** Saves the data to the file system or, if column edits are being staged, just marks the
+     * data as having changes to be written in commitColumnEdits(). */
+    void writeColumnEditsToFS();
+
+    /** Returns the variable names in GEO-EAS order from the current Attribute objects.  Used instead of
+     * the file header while column edits are staged. */
+    QStringList getStagedFieldNames();
+
+    /** Rebuilds the no-data value predicate from the current no-data value text (see getNDVPredicate()). */
+    void updateNDVPredicate();
+
+    /** Discards the cached statistics of all columns (see getColumnStatistics()). */
+    void invalidateColumnStatistics();
+
+    /** Discards the cached statistics of the given column (see getColumnStatistics()). */
+    inline void invalidateColumnStatistics( uint column ){
+        if( column < _isColumnStatisticsValid.size() )
+            _isColumnStatisticsValid[column] = false;
+    }
+
+    /**
+     * Parses the file contents into _data, showing a progress dialog.  Used by loadData().
+     * @param buildBinaryCache If true, the data page is parsed into a new binary cache file instead
+     *                         (see DataLoader).
+     * @return Whether the binary cache was built, which requires a call to
+     *         DataFileBinaryCache::finishBuild() next.
+     */
+    bool parseData( QFile& file, uint& data_line_count, bool buildBinaryCache );
+
     /**
      * pairs relating n-scored variables (first uint) and variables
      * (second uint) by their GEO-EAS indexes (1=first), also
@@ -388,6 +473,30 @@ protected:
     /** The last line of file to load.  Default is infinity (read all data). */
     long _dataPageLastLine;
 
+    /** Number of nested calls to beginColumnEdits() not yet committed. */
+    uint _columnEditsDepth;
+
+    /** The data page set before the outermost beginColumnEdits(), restored by commitColumnEdits(). */
+    long _columnEditsPageFirstLine;
+    long _columnEditsPageLastLine;
+
+    /** Whether there are staged column edits not yet written to the file. */
+    bool _hasPendingColumnEdits;
+
+    /** Cached statistics of each column and whether they are up to date (see getColumnStatistics()). */
+    std::vector< ColumnStatistics > _columnStatistics;
+    std::vector< bool > _isColumnStatisticsValid;
+
+    /** The no-data value the cached column statistics were computed with. */
+    QString _columnStatisticsNDV;
+
+    /** Returned by getColumnStatistics() for columns that are not loaded. */
+    ColumnStatistics _emptyColumnStatistics;
+
+    /** The compiled no-data value test and the no-data value text it was built from (see getNDVPredicate()). */
+    NDVPredicate _ndvPredicate;
+    QString _ndvPredicateText;
+
     /** The pointer to the internal interface to the algorithms' data source (see classes in /algorithms subdirectory). */
     std::shared_ptr<IAlgorithmDataSource> _algorithmDataSourceInterface;
 
@@ -79,7 +79,7 @@ long GridFile::append(const QString columnName, const spectral::array &array)
 	if( idx != m_nI * m_nJ * m_nK )
 		Application::instance()->logError("GridFile::append(): mismatch between number of data values added and grid cell count.");
 
-	writeToFS();
+	writeColumnEditsToFS();
 
 	//update the project tree in the main window.
 	Application::instance()->refreshProjectTree();
@@ -92,7 +92,8 @@ void GridFile::setDataIJK(uint column, uint i, uint j, uint k, double value)
 {
 	//TODO: verify any data update flags (specially in DataFile class)
 	uint dataRow = i + j*m_nI + k*m_nJ*m_nI;
-	_data[dataRow][column] = value;
+	_data.set( dataRow, column, value );
+	invalidateColumnStatistics( column );
 }
 
 void GridFile::indexToIJK(uint index, uint & i, uint & j, uint & k)
@@ -132,7 +133,7 @@ void GridFile::setColumnData(uint dataColumn, spectral::array & array)
 	if( idx != m_nI * m_nJ * m_nK )
 		Application::instance()->logError("GridFile::setColumnData(): mismatch between number of data values added and grid cell count.");
 
-	writeToFS();
+	writeColumnEditsToFS();
 
 	//update the project tree in the main window.
 	Application::instance()->refreshProjectTree();
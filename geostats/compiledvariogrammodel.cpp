@@ -0,0 +1,141 @@
+#include "compiledvariogrammodel.h"
+
+#include "geostatsutils.h"
+#include "spatiallocation.h"
+#include "domain/variogrammodel.h"
+#include "domain/application.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+    /** Number of separation vectors processed at a time by the batch evaluation in gamma(). */
+    const size_t BATCH_SIZE = 256;
+
+    /** Computes the anisotropy-corrected separations h of the given separation vectors
+     * (same arithmetic as GeostatsUtils::getH()). */
+    inline void computeH( const double* t, const double* dx, const double* dy, const double* dz,
+                          size_t n, double* h ){
+        for( size_t i = 0; i < n; ++i ){
+            double a1 = t[0] * dx[i] + t[1] * dy[i] + t[2] * dz[i];
+            double a2 = t[3] * dx[i] + t[4] * dy[i] + t[5] * dz[i];
+            double a3 = t[6] * dx[i] + t[7] * dy[i] + t[8] * dz[i];
+            h[i] = std::sqrt( a1*a1 + a2*a2 + a3*a3 );
+        }
+    }
+
+    /** Returns whether h is zero (within 1 ULP) as tested by GeostatsUtils::getGamma(). h is never negative. */
+    inline bool isZero( double h ){
+        return h <= std::numeric_limits<double>::denorm_min();
+    }
+
+    /** Adds the contribution of one structure to the result (same formulas of GeostatsUtils::getGamma()).
+     * Each case is a separate loop without branches on the structure type. */
+    void addStructure( int type, double range, double contribution, const double* h, size_t n, double* result ){
+        switch( static_cast<VariogramStructureType>( type ) ){
+        case VariogramStructureType::EXPONENTIAL:
+            for( size_t i = 0; i < n; ++i )
+                result[i] += isZero( h[i] ) ? 0.0 : contribution * ( 1.0 - std::exp( -3.0 * ( h[i] / range ) ) );
+            break;
+        case VariogramStructureType::GAUSSIAN:
+            for( size_t i = 0; i < n; ++i ){
+                double h_over_a = h[i] / range;
+                result[i] += isZero( h[i] ) ? 0.0 : contribution * ( 1.0 - std::exp( -9.0 * ( h_over_a * h_over_a ) ) );
+            }
+            break;
+        case VariogramStructureType::POWER_LAW:
+            for( size_t i = 0; i < n; ++i )
+                result[i] += contribution * std::pow( h[i], 1.5 );
+            break;
+        case VariogramStructureType::COSINE_HOLE_EFFECT:
+            for( size_t i = 0; i < n; ++i )
+                result[i] += (double)( contribution * ( 1.0 - std::cos( ( h[i] / range ) * Util::PI ) ) );
+            break;
+        default: //spheric (unknown types were reported and assumed spheric in the constructor)
+            for( size_t i = 0; i < n; ++i ){
+                double h_over_a = h[i] / range;
+                result[i] += h[i] > range ? contribution :
+                                            contribution * ( 1.5*h_over_a - 0.5*(h_over_a*h_over_a*h_over_a) );
+            }
+        }
+    }
+}
+
+CompiledVariogramModel::CompiledVariogramModel() :
+    m_nugget( 0.0 ),
+    m_sill( 0.0 )
+{
+}
+
+CompiledVariogramModel::CompiledVariogramModel(VariogramModel *model) :
+    m_nugget( model->getNugget() ),
+    m_sill( model->getSill() )
+{
+    int nst = model->getNst();
+    m_structures.reserve( nst );
+    for( int i = 0; i < nst; ++i ){
+        Structure structure;
+        VariogramStructureType type = model->getIt( i );
+        switch( type ){
+        case VariogramStructureType::SPHERIC:
+        case VariogramStructureType::EXPONENTIAL:
+        case VariogramStructureType::GAUSSIAN:
+        case VariogramStructureType::COSINE_HOLE_EFFECT:
+            break;
+        case VariogramStructureType::POWER_LAW:
+            //TODO: using a constant power (1.5) since I don't know how it is entered in GSLib par files.
+            Application::instance()->logWarn("CompiledVariogramModel::CompiledVariogramModel(): Power model using a constant power == 1.5");
+            break;
+        default:
+            Application::instance()->logError("CompiledVariogramModel::CompiledVariogramModel(): Unknown structure type.  Assuming spheric.");
+            type = VariogramStructureType::SPHERIC;
+        }
+        structure.type = static_cast<int>( type );
+        structure.range = model->get_a_hMax( i );
+        structure.contribution = model->getCC( i );
+        Matrix3X3<double> t = GeostatsUtils::getAnisoTransform(
+                    model->get_a_hMax(i), model->get_a_hMin(i), model->get_a_vert(i),
+                    model->getAzimuth(i), model->getDip(i), model->getRoll(i) );
+        structure.t[0] = t._a11; structure.t[1] = t._a12; structure.t[2] = t._a13;
+        structure.t[3] = t._a21; structure.t[4] = t._a22; structure.t[5] = t._a23;
+        structure.t[6] = t._a31; structure.t[7] = t._a32; structure.t[8] = t._a33;
+        m_structures.push_back( structure );
+    }
+}
+
+double CompiledVariogramModel::gamma(const SpatialLocation &locA, const SpatialLocation &locB) const
+{
+    return gamma( locB._x - locA._x, locB._y - locA._y, locB._z - locA._z );
+}
+
+double CompiledVariogramModel::gamma(double dx, double dy, double dz) const
+{
+    double result;
+    gamma( &dx, &dy, &dz, 1, &result );
+    return result;
+}
+
+void CompiledVariogramModel::gamma(const double *dx, const double *dy, const double *dz, size_t n, double *result) const
+{
+    double h[BATCH_SIZE];
+    for( size_t first = 0; first < n; first += BATCH_SIZE ){
+        size_t count = std::min( BATCH_SIZE, n - first );
+        double* batchResult = result + first;
+        for( size_t i = 0; i < count; ++i )
+            batchResult[i] = m_nugget;
+        for( const Structure& structure : m_structures ){
+            computeH( structure.t, dx + first, dy + first, dz + first, count, h );
+            addStructure( structure.type, structure.range, structure.contribution, h, count, batchResult );
+        }
+    }
+}
+
+void CompiledVariogramModel::covariance(const double *dx, const double *dy, const double *dz, size_t n, double *result) const
+{
+    gamma( dx, dy, dz, n, result );
+    for( size_t i = 0; i < n; ++i )
+        result[i] = m_sill - result[i];
+}
@@ -0,0 +1,66 @@
+#ifndef COMPILEDVARIOGRAMMODEL_H
+#define COMPILEDVARIOGRAMMODEL_H
+
+#include <cstddef>
+#include <vector>
+
+class VariogramModel;
+class SpatialLocation;
+
+/**
+ * The CompiledVariogramModel class is an immutable, evaluation-ready copy of a VariogramModel.
+ * The model parameters are read once and the anisotropy transforms are computed once on construction,
+ * so evaluating the variogram costs no getter calls, file reads or cache lookups.  Since the object is
+ * never changed after construction, it can be shared by several threads.
+ * The values are exactly those of the former GeostatsUtils::getGamma( VariogramModel*, ... ).
+ */
+class CompiledVariogramModel
+{
+public:
+    /** Creates a pure nugget model with zero nugget (gamma is zero everywhere). */
+    CompiledVariogramModel();
+
+    /** Compiles the given variogram model.  The model's current parameters are used (call
+     * VariogramModel::readParameters() before if the file may have changed). */
+    explicit CompiledVariogramModel( VariogramModel* model );
+
+    /** Returns the total variance (nugget plus the contributions of all structures). */
+    double getSill() const { return m_sill; }
+
+    /** Returns the nugget effect contribution. */
+    double getNugget() const { return m_nugget; }
+
+    /** Returns whether the model has no structures other than the nugget effect. */
+    bool isPureNugget() const { return m_structures.empty(); }
+
+    /** Returns the variogram value (semi-variance) between two locations. */
+    double gamma( const SpatialLocation& locA, const SpatialLocation& locB ) const;
+
+    /** Returns the variogram value (semi-variance) for the separation vector (dx, dy, dz). */
+    double gamma( double dx, double dy, double dz ) const;
+
+    /**
+     * Computes the variogram values for n separation vectors given as separate arrays of components.
+     * The structures are evaluated one at a time over all vectors.  The inner loops have no branches on the
+     * structure type, so the compiler can vectorize them.  The results are the same as calling gamma() n times.
+     */
+    void gamma( const double* dx, const double* dy, const double* dz, size_t n, double* result ) const;
+
+    /** Same as the batch gamma(), but returns covariances (sill - gamma). */
+    void covariance( const double* dx, const double* dy, const double* dz, size_t n, double* result ) const;
+
+private:
+    /** The parameters of one nested structure, with its anisotropy transform flattened row by row. */
+    struct Structure {
+        int type; //a VariogramStructureType
+        double range;
+        double contribution;
+        double t[9];
+    };
+
+    double m_nugget;
+    double m_sill;
+    std::vector<Structure> m_structures;
+};
+
+#endif // COMPILEDVARIOGRAMMODEL_H
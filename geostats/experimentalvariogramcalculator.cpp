@@ -0,0 +1,554 @@
+#include "experimentalvariogramcalculator.h"
+#include "domain/pointset.h"
+#include "domain/attribute.h"
+#include "domain/application.h"
+#include "spatialindex/pointkdtree.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QProgressDialog>
+#include <QTextStream>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace {
+
+    /** Same tolerance used in gamv to detect zero distances and denominators. */
+    const double EPSLON = 1.0E-20;
+
+    /** A direction with its unit vectors and tolerances precomputed as in gamv. */
+    struct DirectionTolerances
+    {
+        double uvxazm, uvyazm, csatol, uvzdec, uvhdec, csdtol, bandwh, bandwd;
+        bool omni;
+    };
+
+    /** Takes the values of the pair of samples i and j (j - i is the separation vector) as gamv does:
+     * the tail variable is taken at the sample behind along the direction and the head variable at the sample
+     * ahead, so the result agrees with GridVariogramCalculator (tail at x, head at x+h) whichever sample comes
+     * first in the search.  The primed values are the other variable at each end.
+     */
+    void orientPair( bool alongDirection, const std::vector<double>& tail, const std::vector<double>& head,
+                     uint i, uint j, double& vrt, double& vrh, double& vrtpr, double& vrhpr )
+    {
+        if( alongDirection ){
+            vrh = tail[i];
+            vrt = head[j];
+            vrtpr = head[i];
+            vrhpr = tail[j];
+        } else {
+            vrh = tail[j];
+            vrt = head[i];
+            vrtpr = head[j];
+            vrhpr = tail[i];
+        }
+    }
+
+#ifndef NDEBUG
+    /** Regression check of orientPair() with an asymmetric cross covariance: the head variable is the tail
+     * variable shifted one step, so C(h) = E[tail(x) * head(x+h)] differs from C(-h).  The product must be
+     * tail(x) * head(x+h) whether the sample at x or the one at x+h is visited first. */
+    bool pairOrientationIsConsistent()
+    {
+        const std::vector<double> tail = { 1.0, 5.0 }; //samples at x = 0 and x = 1
+        const std::vector<double> head = { 2.0, 7.0 };
+        double vrt, vrh, vrtpr, vrhpr;
+        orientPair( true, tail, head, 0, 1, vrt, vrh, vrtpr, vrhpr );    //from x = 0 to x = 1: along +h
+        double forward = vrh * vrt;
+        orientPair( false, tail, head, 1, 0, vrt, vrh, vrtpr, vrhpr );   //from x = 1 to x = 0: against +h
+        double backward = vrh * vrt;
+        return forward == tail[0] * head[1] && backward == forward && vrtpr == head[0] && vrhpr == tail[1];
+    }
+#endif
+
+    QString variogramTitle( int type )
+    {
+        switch( type ){
+        case 1: return "Semivariogram          :";
+        case 2: return "Cross Semivariogram    :";
+        case 3: return "Covariance             :";
+        case 4: return "Correlogram            :";
+        case 5: return "General Relative       :";
+        case 6: return "Pairwise Relative      :";
+        case 7: return "Variogram of Logarithms:";
+        case 8: return "Semimadogram           :";
+        default: return "Indicator 1/2 Variogram:";
+        }
+    }
+}
+
+void ExperimentalVariogramCalculator::LagBins::reset(size_t size)
+{
+    np.assign( size, 0.0 );
+    dis.assign( size, 0.0 );
+    gam.assign( size, 0.0 );
+    hm.assign( size, 0.0 );
+    tm.assign( size, 0.0 );
+    hv.assign( size, 0.0 );
+    tv.assign( size, 0.0 );
+}
+
+void ExperimentalVariogramCalculator::LagBins::add(const ExperimentalVariogramCalculator::LagBins &other)
+{
+    for( size_t i = 0; i < np.size(); ++i ){
+        np[i] += other.np[i];
+        dis[i] += other.dis[i];
+        gam[i] += other.gam[i];
+        hm[i] += other.hm[i];
+        tm[i] += other.tm[i];
+        hv[i] += other.hv[i];
+        tv[i] += other.tv[i];
+    }
+}
+
+ExperimentalVariogramCalculator::ExperimentalVariogramCalculator(PointSet *pointSet) :
+    m_pointSet( pointSet ),
+    m_xColumn( 0 ),
+    m_yColumn( 0 ),
+    m_zColumn( 0 ),
+    m_tmin( -1.0e21 ),
+    m_tmax( 1.0e21 ),
+    m_nLags( 10 ),
+    m_lagSeparation( 1.0 ),
+    m_lagTolerance( 0.5 ),
+    m_standardizeSills( false )
+{
+}
+
+void ExperimentalVariogramCalculator::setCoordinateColumns(uint xColumn, uint yColumn, uint zColumn)
+{
+    m_xColumn = xColumn;
+    m_yColumn = yColumn;
+    m_zColumn = zColumn;
+}
+
+void ExperimentalVariogramCalculator::addVariable(uint column)
+{
+    m_variableColumns.push_back( column );
+}
+
+void ExperimentalVariogramCalculator::setTrimmingLimits(double tmin, double tmax)
+{
+    m_tmin = tmin;
+    m_tmax = tmax;
+}
+
+void ExperimentalVariogramCalculator::setLags(uint nLags, double lagSeparation, double lagTolerance)
+{
+    m_nLags = nLags;
+    m_lagSeparation = lagSeparation;
+    m_lagTolerance = lagTolerance;
+}
+
+void ExperimentalVariogramCalculator::addDirection(const VariogramDirection &direction)
+{
+    m_directions.push_back( direction );
+}
+
+void ExperimentalVariogramCalculator::addVariogram(const VariogramDefinition &variogram)
+{
+    m_variograms.push_back( variogram );
+}
+
+void ExperimentalVariogramCalculator::setStandardizeSills(bool standardizeSills)
+{
+    m_standardizeSills = standardizeSills;
+}
+
+bool ExperimentalVariogramCalculator::run()
+{
+    if( m_nLags < 1 || m_lagSeparation <= 0.0 || m_directions.empty() || m_variograms.empty() ){
+        Application::instance()->logError( "ExperimentalVariogramCalculator::run(): the number of lags, the lag separation,"
+                                           " the directions and the variograms must be set.", true );
+        return false;
+    }
+    for( const VariogramDefinition& variogram : m_variograms )
+        if( variogram.tailVariable < 1 || variogram.tailVariable > m_variableColumns.size() ||
+            variogram.headVariable < 1 || variogram.headVariable > m_variableColumns.size() ||
+            variogram.type < 1 || variogram.type > 10 ){
+            Application::instance()->logError( "ExperimentalVariogramCalculator::run(): invalid variable number"
+                                               " or variogram type.", true );
+            return false;
+        }
+    if( m_lagTolerance <= 0.0 )
+        m_lagTolerance = 0.5 * m_lagSeparation;
+    assert( pairOrientationIsConsistent() && "ExperimentalVariogramCalculator::run(): pairs are oriented unlike gamv." );
+
+    m_pointSet->loadData();
+    uint nData = m_pointSet->getDataLineCount();
+
+    //copy the coordinates and the values, so the threads do not access the data file
+    auto column = [this, nData]( uint geoEasIndex ){
+        std::vector<double> values( nData, 0.0 );
+        if( geoEasIndex > 0 )
+            for( uint i = 0; i < nData; ++i )
+                values[i] = m_pointSet->data( i, geoEasIndex - 1 );
+        return values;
+    };
+    m_x = column( m_xColumn );
+    m_y = column( m_yColumn );
+    m_z = column( m_zColumn );
+    m_values.clear();
+    m_valueNames.clear();
+    for( uint geoEasIndex : m_variableColumns ){
+        std::vector<double> values = column( geoEasIndex );
+        //values outside the trimming limits do not make pairs
+        for( double& value : values )
+            if( value < m_tmin || value > m_tmax )
+                value = std::numeric_limits<double>::quiet_NaN();
+        m_values.push_back( values );
+        Attribute* at = m_pointSet->getAttributeFromGEOEASIndex( geoEasIndex );
+        m_valueNames.append( at ? at->getName() : QString::number( geoEasIndex ) );
+    }
+
+    //the indicator variograms are computed for new variables: the indicator transforms
+    m_tails.clear();
+    m_heads.clear();
+    for( const VariogramDefinition& variogram : m_variograms ){
+        if( variogram.type == 9 || variogram.type == 10 ){
+            const std::vector<double>& values = m_values[ variogram.tailVariable - 1 ];
+            std::vector<double> indicators( nData );
+            for( uint i = 0; i < nData; ++i ){
+                if( std::isnan( values[i] ) )
+                    indicators[i] = values[i];
+                else if( variogram.type == 9 )
+                    indicators[i] = values[i] <= variogram.cutoff ? 1.0 : 0.0;
+                else //category codes are compared as integers, as gamv does
+                    indicators[i] = static_cast<int>( values[i] + 0.5 ) ==
+                                    static_cast<int>( variogram.cutoff + 0.5 ) ? 1.0 : 0.0;
+            }
+            m_values.push_back( indicators );
+            m_valueNames.append( m_valueNames[ variogram.tailVariable - 1 ] );
+            m_tails.push_back( m_values.size() - 1 );
+            m_heads.push_back( m_values.size() - 1 );
+        } else {
+            m_tails.push_back( variogram.tailVariable - 1 );
+            m_heads.push_back( variogram.headVariable - 1 );
+        }
+    }
+
+    //the sills are the variances of the variables
+    m_sills.clear();
+    for( const std::vector<double>& values : m_values ){
+        double sum = 0.0, sumSquares = 0.0;
+        uint n = 0;
+        for( double value : values )
+            if( ! std::isnan( value ) ){
+                sum += value;
+                sumSquares += value * value;
+                ++n;
+            }
+        m_sills.push_back( n ? sumSquares / n - ( sum / n ) * ( sum / n ) : 0.0 );
+    }
+
+    //the pairs are searched among the samples within the maximum lag distance
+    std::vector<KDTreePoint> points( nData );
+    for( uint i = 0; i < nData; ++i ){
+        points[i].coords[0] = m_x[i];
+        points[i].coords[1] = m_y[i];
+        points[i].coords[2] = m_z[i];
+        points[i].index = i;
+    }
+    PointKDTree kdtree;
+    kdtree.build( points );
+
+    size_t nBins = m_directions.size() * m_variograms.size() * ( m_nLags + 2 );
+    unsigned int nThreads = std::max( 1u, std::min( std::thread::hardware_concurrency(), nData ) );
+    std::vector<LagBins> threadBins( nThreads );
+    for( LagBins& bins : threadBins )
+        bins.reset( nBins );
+
+    QProgressDialog progressDialog;
+    progressDialog.show();
+    progressDialog.setLabelText("Computing experimental variograms in " + QString::number(nThreads) + " threads...");
+    progressDialog.setMinimum( 0 );
+    progressDialog.setValue( 0 );
+    progressDialog.setMaximum( nData );
+
+    VariogramCalculationProgress progressInfo;
+    std::vector<std::thread> threads;
+    for( unsigned int iThread = 0; iThread < nThreads; ++iThread )
+        threads.push_back( std::thread( &ExperimentalVariogramCalculator::accumulatePairs, this,
+                                        &kdtree, &progressInfo, &threadBins[iThread] ) );
+
+    //report progress while the workers run
+    while( progressInfo.nSamplesDone < nData ){
+        progressDialog.setValue( progressInfo.nSamplesDone.load() );
+        QCoreApplication::processEvents(); //let Qt repaint widgets
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    }
+
+    for( std::thread& thread : threads )
+        thread.join();
+
+    //sum the bins of all threads
+    m_results = threadBins[0];
+    for( unsigned int iThread = 1; iThread < nThreads; ++iThread )
+        m_results.add( threadBins[iThread] );
+
+    computeMeasures();
+
+    return true;
+}
+
+void ExperimentalVariogramCalculator::accumulatePairs(const PointKDTree *kdtree,
+                                                      VariogramCalculationProgress *progressInfo,
+                                                      LagBins *bins) const
+{
+    const double PI = 3.14159265358979323846;
+    uint nData = m_x.size();
+    uint nLagBins = m_nLags + 2;
+    uint nVariograms = m_variograms.size();
+    double xlag = m_lagSeparation;
+    double xltol = m_lagTolerance;
+    double dismxs = ( ( m_nLags + 0.5 - EPSLON ) * xlag ) * ( ( m_nLags + 0.5 - EPSLON ) * xlag );
+    double maxDistance = std::sqrt( dismxs );
+
+    std::vector<DirectionTolerances> directions;
+    for( const VariogramDirection& direction : m_directions ){
+        DirectionTolerances tolerances;
+        double azimuth = ( 90.0 - direction.azimuth ) * PI / 180.0;
+        tolerances.uvxazm = std::cos( azimuth );
+        tolerances.uvyazm = std::sin( azimuth );
+        tolerances.csatol = std::cos( ( direction.azimuthTolerance <= 0.0 ? 45.0 : direction.azimuthTolerance ) * PI / 180.0 );
+        double declination = ( 90.0 - direction.dip ) * PI / 180.0;
+        tolerances.uvzdec = std::cos( declination );
+        tolerances.uvhdec = std::sin( declination );
+        tolerances.csdtol = std::cos( ( direction.dipTolerance <= 0.0 ? 45.0 : direction.dipTolerance ) * PI / 180.0 );
+        tolerances.bandwh = direction.horizontalBandwidth;
+        tolerances.bandwd = direction.verticalBandwidth;
+        tolerances.omni = direction.azimuthTolerance >= 90.0;
+        directions.push_back( tolerances );
+    }
+
+    std::vector<size_t> positions;
+    for( uint i = progressInfo->nextSample++; i < nData; i = progressInfo->nextSample++ ){
+        positions.clear();
+        kdtree->queryBox( m_x[i] - maxDistance, m_y[i] - maxDistance, m_z[i] - maxDistance,
+                          m_x[i] + maxDistance, m_y[i] + maxDistance, m_z[i] + maxDistance, positions );
+        for( size_t position : positions ){
+            //each pair is visited once, from its sample with the lowest index (as the j >= i loop of gamv)
+            uint j = kdtree->getPoint( position ).index;
+            if( j < i )
+                continue;
+            double dx = m_x[j] - m_x[i];
+            double dy = m_y[j] - m_y[i];
+            double dz = m_z[j] - m_z[i];
+            double hs = dx * dx + dy * dy + dz * dz;
+            if( hs > dismxs )
+                continue;
+            double h = std::sqrt( hs );
+
+            //the lags the pair falls in (the tolerance may be greater than half the lag separation)
+            int lagbeg = -1, lagend = -1;
+            if( h <= EPSLON ){
+                lagbeg = 0;
+                lagend = 0;
+            } else {
+                for( uint il = 1; il < nLagBins; ++il )
+                    if( h >= xlag * ( il - 1 ) - xltol && h <= xlag * ( il - 1 ) + xltol ){
+                        if( lagbeg < 0 )
+                            lagbeg = il;
+                        lagend = il;
+                    }
+                if( lagend < 0 )
+                    continue;
+            }
+
+            for( uint id = 0; id < directions.size(); ++id ){
+                const DirectionTolerances& dir = directions[id];
+                //azimuth tolerance
+                double dxy = std::sqrt( std::max( dx * dx + dy * dy, 0.0 ) );
+                double dcazm = dxy < EPSLON ? 1.0 : ( dx * dir.uvxazm + dy * dir.uvyazm ) / dxy;
+                if( std::abs( dcazm ) < dir.csatol )
+                    continue;
+                //horizontal bandwidth
+                double band = dir.uvxazm * dy - dir.uvyazm * dx;
+                if( std::abs( band ) > dir.bandwh )
+                    continue;
+                //dip tolerance
+                if( dcazm < 0.0 )
+                    dxy = -dxy;
+                double dcdec = 0.0;
+                if( lagbeg != 0 ){
+                    dcdec = ( dxy * dir.uvhdec + dz * dir.uvzdec ) / h;
+                    if( std::abs( dcdec ) < dir.csdtol )
+                        continue;
+                }
+                //vertical bandwidth
+                band = dir.uvhdec * dz - dir.uvzdec * dxy;
+                if( std::abs( band ) > dir.bandwd )
+                    continue;
+
+                for( uint iv = 0; iv < nVariograms; ++iv ){
+                    int type = m_variograms[iv].type;
+                    const std::vector<double>& tail = m_values[ m_tails[iv] ];
+                    const std::vector<double>& head = m_values[ m_heads[iv] ];
+                    double vrt, vrh, vrtpr, vrhpr;
+                    orientPair( dcazm >= 0.0 && dcdec >= 0.0, tail, head, i, j, vrt, vrh, vrtpr, vrhpr );
+                    bool needsReverse = dir.omni || type == 2;
+                    if( std::isnan( vrt ) || std::isnan( vrh ) )
+                        continue;
+                    if( type == 2 && ( std::isnan( vrtpr ) || std::isnan( vrhpr ) ) )
+                        continue;
+
+                    size_t offset = ( id * nVariograms + iv ) * nLagBins;
+                    for( int il = lagbeg; il <= lagend; ++il ){
+                        size_t ii = offset + il;
+                        switch( type ){
+                        case 2: //cross semivariogram
+                            bins->np[ii] += 1.0;
+                            bins->dis[ii] += h;
+                            bins->tm[ii] += 0.5 * ( vrt + vrtpr );
+                            bins->hm[ii] += 0.5 * ( vrh + vrhpr );
+                            bins->gam[ii] += ( vrhpr - vrh ) * ( vrt - vrtpr );
+                            break;
+                        case 3: //covariance
+                        case 4: //correlogram
+                            bins->np[ii] += 1.0;
+                            bins->dis[ii] += h;
+                            bins->tm[ii] += vrt;
+                            bins->hm[ii] += vrh;
+                            bins->gam[ii] += vrh * vrt;
+                            if( type == 4 ){
+                                bins->hv[ii] += vrh * vrh;
+                                bins->tv[ii] += vrt * vrt;
+                            }
+                            break;
+                        case 6: //pairwise relative
+                            if( std::abs( vrt + vrh ) > EPSLON ){
+                                double relative = 2.0 * ( vrt - vrh ) / ( vrt + vrh );
+                                bins->np[ii] += 1.0;
+                                bins->dis[ii] += h;
+                                bins->tm[ii] += vrt;
+                                bins->hm[ii] += vrh;
+                                bins->gam[ii] += relative * relative;
+                            }
+                            break;
+                        case 7: //logarithms
+                            if( vrt > EPSLON && vrh > EPSLON ){
+                                double difference = std::log( vrt ) - std::log( vrh );
+                                bins->np[ii] += 1.0;
+                                bins->dis[ii] += h;
+                                bins->tm[ii] += vrt;
+                                bins->hm[ii] += vrh;
+                                bins->gam[ii] += difference * difference;
+                            }
+                            break;
+                        case 8: //madogram
+                            bins->np[ii] += 1.0;
+                            bins->dis[ii] += h;
+                            bins->tm[ii] += vrt;
+                            bins->hm[ii] += vrh;
+                            bins->gam[ii] += std::abs( vrh - vrt );
+                            break;
+                        default: //semivariograms (1, 5, 9 and 10)
+                            bins->np[ii] += 1.0;
+                            bins->dis[ii] += h;
+                            bins->tm[ii] += vrt;
+                            bins->hm[ii] += vrh;
+                            bins->gam[ii] += ( vrh - vrt ) * ( vrh - vrt );
+                            //omnidirectional: the pair also counts in the opposite direction
+                            if( needsReverse && ! std::isnan( vrtpr ) && ! std::isnan( vrhpr ) ){
+                                bins->np[ii] += 1.0;
+                                bins->dis[ii] += h;
+                                bins->tm[ii] += vrtpr;
+                                bins->hm[ii] += vrhpr;
+                                bins->gam[ii] += ( vrhpr - vrtpr ) * ( vrhpr - vrtpr );
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        ++progressInfo->nSamplesDone;
+    }
+}
+
+void ExperimentalVariogramCalculator::computeMeasures()
+{
+    uint nLagBins = m_nLags + 2;
+    uint nVariograms = m_variograms.size();
+    LagBins& r = m_results;
+    for( uint id = 0; id < m_directions.size(); ++id )
+        for( uint iv = 0; iv < nVariograms; ++iv )
+            for( uint il = 0; il < nLagBins; ++il ){
+                size_t i = ( id * nVariograms + iv ) * nLagBins + il;
+                if( r.np[i] <= 0.0 )
+                    continue;
+                double rnum = r.np[i];
+                r.dis[i] /= rnum;
+                r.gam[i] /= rnum;
+                r.hm[i] /= rnum;
+                r.tm[i] /= rnum;
+                r.hv[i] /= rnum;
+                r.tv[i] /= rnum;
+                int type = m_variograms[iv].type;
+                //standardize the semivariograms of single variables
+                if( m_standardizeSills && m_tails[iv] == m_heads[iv] ){
+                    double sill = m_sills[ m_tails[iv] ];
+                    if( ( type == 1 || type >= 9 ) && sill > 0.0 )
+                        r.gam[i] /= sill;
+                }
+                switch( type ){
+                case 3: //covariance (centered)
+                    r.gam[i] -= r.hm[i] * r.tm[i];
+                    break;
+                case 4: //correlogram
+                    r.hv[i] = std::sqrt( std::max( r.hv[i] - r.hm[i] * r.hm[i], 0.0 ) );
+                    r.tv[i] = std::sqrt( std::max( r.tv[i] - r.tm[i] * r.tm[i], 0.0 ) );
+                    if( r.hv[i] * r.tv[i] < EPSLON )
+                        r.gam[i] = 0.0;
+                    else
+                        r.gam[i] = ( r.gam[i] - r.hm[i] * r.tm[i] ) / ( r.hv[i] * r.tv[i] );
+                    //report the variances
+                    r.hv[i] *= r.hv[i];
+                    r.tv[i] *= r.tv[i];
+                    break;
+                case 5: //general relative
+                {
+                    double htave = 0.5 * ( r.hm[i] + r.tm[i] );
+                    htave *= htave;
+                    r.gam[i] = htave < EPSLON ? 0.0 : r.gam[i] / htave;
+                    break;
+                }
+                default: //semi- measures
+                    r.gam[i] *= 0.5;
+                }
+            }
+}
+
+bool ExperimentalVariogramCalculator::save(const QString &path) const
+{
+    QFile file( path );
+    if( ! file.open( QFile::WriteOnly | QFile::Text ) ){
+        Application::instance()->logError( "ExperimentalVariogramCalculator::save(): could not open " + path + " for writing." );
+        return false;
+    }
+    QTextStream out( &file );
+    uint nLagBins = m_nLags + 2;
+    uint nVariograms = m_variograms.size();
+    for( uint iv = 0; iv < nVariograms; ++iv )
+        for( uint id = 0; id < m_directions.size(); ++id ){
+            out << variogramTitle( m_variograms[iv].type )
+                << QString("tail:%1 head:%2 direction %3").arg( m_valueNames[ m_tails[iv] ].left(12), -12 )
+                                                           .arg( m_valueNames[ m_heads[iv] ].left(12), -12 )
+                                                           .arg( id + 1, 2 )
+                << '\n';
+            for( uint il = 0; il < nLagBins; ++il ){
+                size_t i = ( id * nVariograms + iv ) * nLagBins + il;
+                out << QString(" %1 %2 %3 %4 %5 %6\n").arg( il + 1, 3 )
+                                                      .arg( m_results.dis[i], 12, 'f', 3 )
+                                                      .arg( m_results.gam[i], 12, 'f', 5 )
+                                                      .arg( static_cast<qlonglong>( m_results.np[i] ), 8 )
+                                                      .arg( m_results.hm[i], 14, 'f', 5 )
+                                                      .arg( m_results.tm[i], 14, 'f', 5 );
+            }
+        }
+    file.close();
+    return true;
+}
@@ -0,0 +1,134 @@
+#ifndef EXPERIMENTALVARIOGRAMCALCULATOR_H
+#define EXPERIMENTALVARIOGRAMCALCULATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <vector>
+
+class PointSet;
+class PointKDTree;
+
+/** A direction of an experimental variogram of irregularly spaced data.  The angles are in degrees, following
+ * the GSLIB convention (azimuth clockwise from north, dip downwards from the horizontal).
+ */
+struct VariogramDirection
+{
+    double azimuth;
+    double azimuthTolerance;
+    double horizontalBandwidth;
+    double dip;
+    double dipTolerance;
+    double verticalBandwidth;
+};
+
+/** An experimental variogram to compute: the variables (numbers in the order they were added to
+ * ExperimentalVariogramCalculator, starting with 1), the type (the same codes of GSLIB's gamv,
+ * e.g. 1 = semivariogram, see ExperimentalVariogramCalculator) and the indicator threshold (types 9 and 10).
+ */
+struct VariogramDefinition
+{
+    uint tailVariable;
+    uint headVariable;
+    int type;
+    double cutoff;
+};
+
+/** Work distribution and counters shared by the threads of ExperimentalVariogramCalculator. */
+struct VariogramCalculationProgress
+{
+    VariogramCalculationProgress() : nextSample(0), nSamplesDone(0) {}
+    std::atomic<unsigned int> nextSample;
+    std::atomic<unsigned int> nSamplesDone;
+};
+
+/**
+ * The ExperimentalVariogramCalculator class computes experimental variograms of point set data in process, as
+ * an alternative to running GSLIB's gamv program.  It follows gamv's algorithm (lag, azimuth, dip and bandwidth
+ * tolerances, all variogram types and sill standardization) and writes its output file format, so the results
+ * can be plotted with vargplt and handled as any gamv output.  Unlike gamv, the pairs are not found by testing
+ * all N² of them: the pairs of a sample are searched with a k-d tree within the maximum lag distance.
+ * All directions and variograms are computed in a single pass over the pairs, which is divided among as many
+ * threads as there are processor cores, each accumulating its own lag bins, summed at the end.
+ * The variogram types are:
+ *  1 - traditional semivariogram;
+ *  2 - traditional cross semivariogram;
+ *  3 - covariance;
+ *  4 - correlogram;
+ *  5 - general relative semivariogram;
+ *  6 - pairwise relative semivariogram;
+ *  7 - semivariogram of logarithms;
+ *  8 - semimadogram;
+ *  9 - indicator semivariogram of a continuous variable (indicator is 1 if value <= cutoff);
+ * 10 - indicator semivariogram of a categorical variable (indicator is 1 if the value rounds to the cutoff).
+ */
+class ExperimentalVariogramCalculator
+{
+public:
+    /** @param pointSet The point set with the data. */
+    explicit ExperimentalVariogramCalculator( PointSet* pointSet );
+
+    //@{
+    /** Set the calculation parameters (see GSLIB's gamv documentation). */
+    /** The GEO-EAS indexes (first is 1) of the X, Y and Z columns.  Zero means the coordinate is not used. */
+    void setCoordinateColumns( uint xColumn, uint yColumn, uint zColumn );
+    /** Adds a variable by its GEO-EAS index (first is 1) in the point set. */
+    void addVariable( uint column );
+    void setTrimmingLimits( double tmin, double tmax );
+    void setLags( uint nLags, double lagSeparation, double lagTolerance );
+    void addDirection( const VariogramDirection& direction );
+    void addVariogram( const VariogramDefinition& variogram );
+    /** Whether the semivariograms of single variables are divided by the variable's variance. */
+    void setStandardizeSills( bool standardizeSills );
+    //@}
+
+    /** Computes the experimental variograms, showing a progress dialog.
+     * @return False if the parameters are invalid (the reason is logged as an error).
+     */
+    bool run();
+
+    /** Saves the results of run() to a file in the same format of gamv's output. */
+    bool save( const QString& path ) const;
+
+private:
+    /** The lag bins of all directions and variograms.  The bin of lag il (0 to nLags+1) of variogram
+     * iv of direction id is at index ( id * nVariograms + iv ) * ( nLags + 2 ) + il. */
+    struct LagBins
+    {
+        void reset( size_t size );
+        void add( const LagBins& other );
+        std::vector<double> np, dis, gam, hm, tm, hv, tv;
+    };
+
+    /** Accumulates the pairs of the samples taken from progressInfo->nextSample until all samples are
+     * processed.  Runs in several threads at once, each with its own bins. */
+    void accumulatePairs( const PointKDTree* kdtree, VariogramCalculationProgress* progressInfo,
+                          LagBins* bins ) const;
+
+    /** Turns the bin sums into the averages and the final variogram measures. */
+    void computeMeasures();
+
+    PointSet* m_pointSet;
+    uint m_xColumn, m_yColumn, m_zColumn;
+    std::vector<uint> m_variableColumns;
+    double m_tmin, m_tmax;
+    uint m_nLags;
+    double m_lagSeparation, m_lagTolerance;
+    std::vector<VariogramDirection> m_directions;
+    std::vector<VariogramDefinition> m_variograms;
+    bool m_standardizeSills;
+
+    //@{
+    /** Data prepared by run() before starting the threads.  The indicator variograms use their own
+     * variables (the indicator transform of the original ones).  Trimmed values are NaN. */
+    std::vector<double> m_x, m_y, m_z;
+    std::vector< std::vector<double> > m_values;
+    QStringList m_valueNames;
+    std::vector<double> m_sills;
+    std::vector<uint> m_tails, m_heads;
+    //@}
+
+    LagBins m_results;
+};
+
+#endif // EXPERIMENTALVARIOGRAMCALCULATOR_H
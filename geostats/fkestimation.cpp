@@ -9,12 +9,14 @@
 #include "datacell.h"
 #include "gridcell.h"
 #include "pointsetcell.h"
+#include "krigingneighborhood.h"
 #include "spatialindex/spatialindexpoints.h"
 
 #include <QCoreApplication>
 #include <QProgressDialog>
 #include <QThread>
 #include <iostream>
+#include <cmath>
 
 FKEstimation::FKEstimation() :
     m_searchStrategy( nullptr ),
@@ -68,7 +70,8 @@ void FKEstimation::setInputVariable(Attribute *at_input)
 		Application::instance()->logInfo( "Spatial index created for " + m_inputDataFile->getName() + " regular grid." );
 	} else {
 		PointSet* ps = static_cast<PointSet*>( m_inputDataFile );
-		m_spatialIndexPoints->fill( ps, 0.000001 );
+		//the samples are points, so the k-d tree suffices (it is faster to build and to query than the R-tree).
+		m_spatialIndexPoints->fill( ps, 0.000001, SpatialIndexStructure::KD_TREE );
 		Application::instance()->logInfo( "Spatial index created for " + m_inputDataFile->getName() + " point set." );
 	}
 }
@@ -83,44 +86,61 @@ void FKEstimation::setFactorNumber(int factorNumber)
     m_factorNumber = factorNumber;
 }
 
-DataCellPtrMultiset FKEstimation::getSamples(const GridCell & estimationCell )
+void FKEstimation::getSamples(const GridCell & estimationCell, KrigingNeighborhood & samples )
 {
-	DataCellPtrMultiset result;
+	samples.clear();
 	if( m_searchStrategy && m_at_input ){
 
         //Fetch the indexes of the samples to be used in the estimation.
         QList<uint> samplesIndexes = m_spatialIndexPoints->getNearestWithin( estimationCell, *m_searchStrategy );
         QList<uint>::iterator it = samplesIndexes.begin();
+        uint column = m_at_input->getAttributeGEOEASgivenIndex()-1;
+        const SpatialLocation& center = estimationCell._center;
+        auto cartesianDistance = [&center]( double x, double y, double z ){
+            return std::sqrt( (x - center._x)*(x - center._x) + (y - center._y)*(y - center._y) + (z - center._z)*(z - center._z) );
+        };
 
-        //Create and return the sample objects, which depend on the type of the input file.
+        //Collect the samples' locations and values, which depend on the type of the input file.
         if( m_inputDataFile->isRegular() ){ //TODO: this currently assumes the regular data is a CartesianGrid object.
+			CartesianGrid* cg = static_cast<CartesianGrid*>( m_inputDataFile );
 			for( ; it != samplesIndexes.end(); ++it ){
-				CartesianGrid* cg = static_cast<CartesianGrid*>( m_inputDataFile );
 				uint i, j, k;
 				cg->indexToIJK( *it, i, j, k );
-				DataCellPtr p(new GridCell( cg, m_at_input->getAttributeGEOEASgivenIndex()-1, i, j, k ));
-				p->computeCartesianDistance( estimationCell );
-				result.insert( p );
+				//same location as a GridCell object
+				double x = cg->getX0() + i * cg->getDX();
+				double y = cg->getY0() + j * cg->getDY();
+				double z = cg->getZ0() + k * cg->getDZ();
+				samples.add( *it, x, y, z, cg->dataIJK( column, i, j, k ), cartesianDistance( x, y, z ) );
 			}
 		} else { //TODO: this currently assumes the irregular data is a PointSet object.
+			PointSet* ps = static_cast<PointSet*>( m_inputDataFile );
 			for( ; it != samplesIndexes.end(); ++it ){
-				DataCellPtr p(new PointSetCell( static_cast<PointSet*>( m_inputDataFile ), m_at_input->getAttributeGEOEASgivenIndex()-1, *it ));
-				p->computeCartesianDistance( estimationCell );
-				result.insert( p );
+				//same location as a PointSetCell object
+				double x = ps->data( *it, ps->getXindex()-1 );
+				double y = ps->data( *it, ps->getYindex()-1 );
+				double z = ps->is3D() ? ps->data( *it, ps->getZindex()-1 ) : 0.0;
+				samples.add( *it, x, y, z, ps->data( *it, column ), cartesianDistance( x, y, z ) );
 			}
 		}
 
 	} else {
 		Application::instance()->logError( "FKEstimation::getSamples(): sample search failed.  Search strategy and/or input data not set." );
 	}
-	return result;
 }
 
 std::vector<double> FKEstimation::run( )
+{
+    std::vector< std::vector<double> > results = run( std::vector<int>{ m_factorNumber } );
+    if( results.empty() )
+        return std::vector<double>();
+    return results[0];
+}
+
+std::vector< std::vector<double> > FKEstimation::run( const std::vector<int>& factorNumbers )
 {
     if( ! m_variogramModel ){
         Application::instance()->logError("FKEstimation::run(): variogram model not specified. Aborted.", true);
-        return std::vector<double>();
+        return std::vector< std::vector<double> >();
     } else {
         m_variogramModel->readFromFS();
     }
@@ -130,25 +150,25 @@ std::vector<double> FKEstimation::run( )
 
     if( ! input_datafile->hasNoDataValue() ){
         Application::instance()->logError("FKEstimation::run(): No-data-value not set for the input dataset. Aborted.", true);
-        return std::vector<double>();
+        return std::vector< std::vector<double> >();
     } else {
         bool ok;
         m_NDV_of_input = input_datafile->getNoDataValue().toDouble( &ok );
         if( ! ok ){
             Application::instance()->logError("FKEstimation::run(): No-data-value setting of the input dataset is not a valid number. Aborted.", true);
-            return std::vector<double>();
+            return std::vector< std::vector<double> >();
         }
     }
 
     if( ! m_cg_estimation->hasNoDataValue() ){
         Application::instance()->logError("FKEstimation::run(): No-data-value not set for the estimation grid. Aborted.", true);
-        return std::vector<double>();
+        return std::vector< std::vector<double> >();
     } else {
         bool ok;
         m_NDV_of_output = m_cg_estimation->getNoDataValue().toDouble( &ok );
         if( ! ok ){
             Application::instance()->logError("FKEstimation::run(): No-data-value setting of the output grid is not a valid number. Aborted.", true);
-            return std::vector<double>();
+            return std::vector< std::vector<double> >();
         }
     }
 
@@ -177,7 +197,7 @@ std::vector<double> FKEstimation::run( )
     progressDialog.setValue( 0 );
     progressDialog.setMaximum( nI * nJ * nK );
     QThread* thread = new QThread();
-    FKEstimationRunner* runner = new FKEstimationRunner( this );
+    FKEstimationRunner* runner = new FKEstimationRunner( this, factorNumbers );
     runner->moveToThread(thread);
     runner->connect(thread, SIGNAL(finished()), runner, SLOT(deleteLater()));
     runner->connect(thread, SIGNAL(started()), runner, SLOT(doRun()));
@@ -197,12 +217,8 @@ std::vector<double> FKEstimation::run( )
     Application::instance()->logWarningOn();
     Application::instance()->logErrorOn();
 
-    //get the factor wanted by the user.
-    std::vector<double> results;
-	if( m_factorNumber == -1 )
-        results = runner->getMeans();
-    else
-        results = runner->getFactor();
+    //get the factors wanted by the user.
+    std::vector< std::vector<double> > results = runner->getFactors();
 
 	//get the number of samples map
 	m_numberOfSamples = runner->getNSamples();
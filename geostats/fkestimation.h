@@ -10,6 +10,7 @@ class Attribute;
 class CartesianGrid;
 class DataCell;
 class SpatialIndexPoints;
+class KrigingNeighborhood;
 
 
 /** This class encpsulates the factorial kriging estimation.
@@ -42,25 +43,31 @@ public:
 	double getMeanForSimpleKriging(){ return m_meanSK; }
     //@}
 
-	/** Returns a container with the samples around the estimation cell to be used in the estimation.
-	 * The resulting collection depends on the SearchStrategy object set.  Returns an empty object if any
-	 * required parameter for the search to work (e.g. input data) is missing.  The data cells are ordered
-	 * by their distance to the passed estimation cell.
+	/** Fills the passed neighborhood with the samples around the estimation cell to be used in the estimation.
+	 * The resulting collection depends on the SearchStrategy object set.  The neighborhood is left empty if any
+	 * required parameter for the search to work (e.g. input data) is missing.  The samples' distances are the
+	 * Cartesian distances to the passed estimation cell.
 	 */
-	DataCellPtrMultiset getSamples(const GridCell & estimationCell );
+	void getSamples(const GridCell & estimationCell, KrigingNeighborhood & samples );
 
     /** Performs the factorial kriging. Make sure all parameters have been set properly.
-     * @param factorNumber The number of factor to get: -1 (mean); 0 (nugget); 1 and onwards (each variographic structure).
+     * The factor computed is the one set with setFactorNumber().
      */
 	std::vector<double> run( );
 
+    /** Same as run(), but computes several factors in a single pass over the estimation grid, sharing the
+     * sample search and the kriging matrix factorization of each cell.  Returns one result vector per factor.
+     * @param factorNumbers The numbers of the factors to get: -1 (mean); 0 (nugget); 1 and onwards (each variographic structure).
+     */
+	std::vector< std::vector<double> > run( const std::vector<int>& factorNumbers );
+
 	/** Returns the no-data-value for the estimation grid. */
 	double ndvOfEstimationGrid(){ return m_NDV_of_output; }
 
 	/** Shortcut method to get the variogam model's sill. */
 	double getVariogramSill(){ return m_variogramSill; }
 
-	/** Returns a reference to the number of samples that informed each estimation in the results vector
+	/** Returns a reference to the number of samples that informed each estimation in the results vector(s)
 	 * returned by run().
 	 */
 	std::vector< uint >& getNumberOfSamples(){ return m_numberOfSamples; }
@@ -4,18 +4,22 @@
 #include "gridcell.h"
 #include "domain/application.h"
 
-FKEstimationRunner::FKEstimationRunner(FKEstimation *fkEstimation, QObject *parent) :
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+FKEstimationRunner::FKEstimationRunner(FKEstimation *fkEstimation, const std::vector<int> &factorNumbers, QObject *parent) :
     QObject(parent),
     m_finished( false ),
 	m_fkEstimation( fkEstimation ),
-	m_singleStructVModel( nullptr )
+	m_factorNumbers( factorNumbers ),
+	m_epsilonNugget( 0.1 )
 {
 }
 
 FKEstimationRunner::~FKEstimationRunner()
 {
-	if( m_singleStructVModel )
-		delete m_singleStructVModel;
 }
 
 void FKEstimationRunner::doRun()
@@ -28,58 +32,77 @@ void FKEstimationRunner::doRun()
     uint nK = estimationGrid->getNZ();
 
 	//prepare the vectors with the results (to not overwrite the original data)
-    m_factor.clear();
-    m_factor.reserve( nI * nJ * nK );
-    m_means.clear();
-    m_means.reserve( nI * nJ * nK );
-	m_nSamples.clear();
-    m_nSamples.reserve( nI * nJ * nK );
-
-	//factor number can be -1 (mean), which is not a valid variographic structure number.
-	int ist = m_fkEstimation->getFactorNumber();
-	if( ist == -1 )
-		ist = 0; //set nugget as default
-
-	//make the single-structure variogram model.
-	//Switch to a single-structure variogram model if a structure number was specified.
-	if( m_singleStructVModel )
-		delete m_singleStructVModel;
-	m_singleStructVModel = new VariogramModel( m_fkEstimation->getVariogramModel()->makeVModelFromSingleStructure( ist ) );
-	m_singleStructVModel->setForceReread( false ); //disable reread from file improves performance.
-
-	//if the fator desired is nugget, then the approach is to estimate all structures less the nugget
-	if( m_singleStructVModel->isPureNugget() ){
-		delete m_singleStructVModel;
-		m_singleStructVModel = new VariogramModel( m_fkEstimation->getVariogramModel()->makeVModelWithoutNugget() );
-		m_singleStructVModel->setForceReread( false ); //disable reread from file improves performance.
-	}
+	//they are allocated beforehand, so each thread writes the results of its rows directly
+	size_t nCells = (size_t)nI * nJ * nK;
+	m_factors.assign( m_factorNumbers.size(), std::vector<double>( nCells ) );
+	m_means.assign( nCells, 0.0 );
+	m_nSamples.assign( nCells, 0 );
+
+	//Compute an adequate epsilon for the nugget factor estimation: about 10% of the grid cell size.
+	m_epsilonNugget = std::min<double>( estimationGrid->getDX(), estimationGrid->getDY() );
+	if( estimationGrid->isTridimensional() )
+		m_epsilonNugget = std::min<double>( m_epsilonNugget, estimationGrid->getDZ() );
+	m_epsilonNugget /= 10;
 
 	//Disable automatic re-read from file for the selected variogram model.  This improves performance.
 	m_fkEstimation->getVariogramModel()->readParameters(); //first, make sure the parameters are updated.
 	m_fkEstimation->getVariogramModel()->setForceReread( false );
 
-    //for all grid cells
-    int nKriging = 0;
-    int nFailed = 0;
-    for( uint k = 0; k <nK; ++k){
-        for( uint j = 0; j <nJ; ++j){
-            emit setLabel("Running FK:\n" +
-                          QString::number(nKriging) + " kriging operations (" +
-                          QString::number(nFailed) + " failed). " );
-            emit progress( j * nI + k * nI * nJ );
-            for( uint i = 0; i <nI; ++i){
-                GridCell estimationCell( estimationGrid, -1, i, j, k );
-				double estimatedMean;
-				uint nSamples;
-                m_factor.push_back( fk(  estimationCell,
-                                         estimatedMean,
-                                         nSamples,
-                                         nFailed ) );
-                m_means.push_back( estimatedMean );
-				m_nSamples.push_back( nSamples );
-                ++nKriging;
-            }
-        }
+	//compile the variogram models once for all kriging operations.  The compiled models are
+	//immutable, so all threads share them.
+	m_variogram = CompiledVariogramModel( m_fkEstimation->getVariogramModel() );
+	m_singleStructVariograms.clear();
+	for( int factorNumber : m_factorNumbers ){
+		//factor number can be -1 (mean), which is not a valid variographic structure number.
+		int ist = factorNumber;
+		if( ist == -1 )
+			ist = 0; //set nugget as default
+
+		//make the single-structure variogram model.
+		VariogramModel* singleStructVModel = new VariogramModel( m_fkEstimation->getVariogramModel()->makeVModelFromSingleStructure( ist ) );
+		singleStructVModel->setForceReread( false ); //disable reread from file improves performance.
+
+		//if the fator desired is nugget, then the approach is to estimate all structures less the nugget
+		if( singleStructVModel->isPureNugget() ){
+			delete singleStructVModel;
+			singleStructVModel = new VariogramModel( m_fkEstimation->getVariogramModel()->makeVModelWithoutNugget() );
+			singleStructVModel->setForceReread( false ); //disable reread from file improves performance.
+		}
+
+		m_singleStructVariograms.push_back( CompiledVariogramModel( singleStructVModel ) );
+		delete singleStructVModel;
+	}
+
+    //estimate the grid rows in parallel: each thread takes the next row not yet taken.
+    FKEstimationProgress progressInfo;
+    unsigned int nRows = nJ * nK;
+    unsigned int nThreads = std::max( 1u, std::min( std::thread::hardware_concurrency(), nRows ) );
+    std::vector<std::thread> threads;
+    for( unsigned int iThread = 0; iThread < nThreads; ++iThread )
+        threads.push_back( std::thread( &FKEstimationRunner::fkRows, this, &progressInfo ) );
+
+    //report progress while the workers run
+    while( progressInfo.nRowsDone < nRows ){
+        int nKriging = progressInfo.nKriging.load();
+        double reusePercent = nKriging ? 100.0 * progressInfo.nReused.load() / nKriging : 0.0;
+        emit setLabel("Running FK:\n" +
+                      QString::number(nKriging) + " kriging operations (" +
+                      QString::number(reusePercent, 'f', 1) + "% reused neighborhoods, " +
+                      QString::number(progressInfo.nFailed.load()) + " failed) in " +
+                      QString::number(nThreads) + " threads. " );
+        emit progress( progressInfo.nRowsDone.load() * nI );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    }
+
+    //wait for the workers to finish.
+    for( std::thread& thread : threads )
+        thread.join();
+
+    if( progressInfo.nFailed ){
+        Application::instance()->logWarn( "FKEstimationRunner::doRun(): " + QString::number(progressInfo.nFailed.load()) +
+                                          " kriging operation(s) failed (resulted in NaN or infinity).  Assigned " +
+                                          QString::number(m_fkEstimation->ndvOfEstimationGrid()) +
+                                          " to protect the output data file." );
     }
 
 	//Re-enable automatic re-read from file for the selected variogram model.
@@ -89,23 +112,47 @@ void FKEstimationRunner::doRun()
     m_finished = true;
 }
 
-double FKEstimationRunner::fk(GridCell & estimationCell, double& estimatedMean, uint& nSamples, int& nFailed)
+void FKEstimationRunner::fkRows(FKEstimationProgress *progressInfo)
 {
-	double factor;
+    CartesianGrid* estimationGrid = m_fkEstimation->getEstimationGrid();
+    uint nI = estimationGrid->getNX();
+    uint nJ = estimationGrid->getNY();
+    uint nRows = nJ * estimationGrid->getNZ();
+
+    //the neighborhood, the kriging matrices and their factorizations are reused for all cells estimated by this thread
+    FKKrigingWorkspace workspace( m_fkEstimation->getSearchStrategy()->m_nb_samples );
+    std::vector<double> factors( m_factorNumbers.size() );
+
+    for( uint iRow = progressInfo->nextRow++; iRow < nRows; iRow = progressInfo->nextRow++ ){
+        uint j = iRow % nJ;
+        uint k = iRow / nJ;
+        //the counters are accumulated per row and then merged into the shared ones
+        int nReused = 0;
+        int nFailed = 0;
+        for( uint i = 0; i < nI; ++i ){
+            size_t iCell = i + (size_t)iRow * nI;
+            GridCell estimationCell( estimationGrid, -1, i, j, k );
+            fk( estimationCell, workspace, factors.data(), m_means[iCell], m_nSamples[iCell], nReused, nFailed );
+            for( size_t iFactor = 0; iFactor < factors.size(); ++iFactor )
+                m_factors[iFactor][iCell] = factors[iFactor];
+        }
+        progressInfo->nKriging += nI;
+        progressInfo->nReused += nReused;
+        progressInfo->nFailed += nFailed;
+        ++progressInfo->nRowsDone;
+    }
+}
 
-	//Compute an adequate epsilon for the nugget factor estimation: about 10% of the grid cell size.
-	//TODO: performance.  This doesn't need to be here because the cell dimensions are not supposed to vary.
-	double epsilonNugget = 0.1;
-	if( m_fkEstimation->getFactorNumber() == 0 ){
-		epsilonNugget = std::min<double>( estimationCell._grid->getDX(), estimationCell._grid->getDY() );
-		if( estimationCell._grid->isTridimensional() )
-			epsilonNugget = std::min<double>( epsilonNugget, estimationCell._grid->getDZ() );
-		epsilonNugget /= 10;
-	}
+void FKEstimationRunner::fk(GridCell &estimationCell, FKKrigingWorkspace &workspace,
+                            double *factors, double &estimatedMean, uint &nSamples, int &nReused, int &nFailed)
+{
+	double failValue = m_fkEstimation->ndvOfEstimationGrid();
 
-	//collects samples from the input data set ordered by their distance with respect
-	//to the estimation cell.
-	DataCellPtrMultiset vSamples = m_fkEstimation->getSamples( estimationCell );
+	//collects samples from the input data set around the estimation cell.
+	KrigingNeighborhood& vSamples = workspace.neighborhood;
+	m_fkEstimation->getSamples( estimationCell, vSamples );
+	KrigingSystem& system = workspace.system;
+	KrigingSolver& solver = workspace.solver;
 
 	//register the number of samples to be used in the estimation.
 	nSamples = vSamples.size();
@@ -113,183 +160,116 @@ double FKEstimationRunner::fk(GridCell & estimationCell, double& estimatedMean,
     //if no samples was returned found...
     if( vSamples.empty() ){
         //...Return the no-data-value defined for the output dataset.
-		estimatedMean = m_fkEstimation->ndvOfEstimationGrid();
-		return m_fkEstimation->ndvOfEstimationGrid();
+		estimatedMean = failValue;
+		for( size_t iFactor = 0; iFactor < m_factorNumbers.size(); ++iFactor )
+			factors[iFactor] = failValue;
+		return;
 	}
 
-	//*************************SFK***************************************
-	if( m_fkEstimation->getKrigingType() == KrigingType::SK ){
-
-		//Get the user-supplied simple kriging mean.
-		double mSK = m_fkEstimation->getMeanForSimpleKriging();
-
-		//get the covariance matrix (theoretical full covariances between the data sample locations and themselves.)
-		MatrixNXM<double> covMat_inv = GeostatsUtils::makeCovMatrix( vSamples,
-																 m_fkEstimation->getVariogramModel(),
-																 m_fkEstimation->getVariogramModel()->getSill(),
-																 KrigingType::SK,
-																 true ); //using semivariogram per Deutsch
-		covMat_inv.invertWithEigen();
-
-		if( m_fkEstimation->getFactorNumber() != 0 ){
-			//get the gamma matrix (theoretical partial covariances between sample locations and estimation location)
-			MatrixNXM<double> gammaMatSFK = GeostatsUtils::makeGammaMatrix( vSamples,
-																			estimationCell,
-																			m_singleStructVModel,
-																			m_singleStructVModel->getSill(),
-																			KrigingType::SK,
-																			true ); //using semivariogram per Deutsch
-
-			//get the kriging weights vector: [w] = [Cov]^-1 * [gamma] (solve the kriging system)
-			MatrixNXM<double> weightsSFK( covMat_inv * gammaMatSFK );
-
-			//Apply the weights (estimate).
-			factor = 0.0; //the mean is a separate factor.
-			DataCellPtrMultiset::iterator itSamples = vSamples.begin();
-			for( uint i = 0; i < vSamples.size(); ++i, ++itSamples){
-				factor += weightsSFK(i,0) * ( (*itSamples)->readValueFromDataSet() - mSK );
-			}
-		}
-
-		//if the user opted for the nugget effect, the procedure is different:
-		//FK is used to compute estimates with a small shift of the estimation location.
-		//This procedure effectively eliminates nugget effect.  Thus, the nugget factor
-		//is the difference between the normal SK estimate and the FK estimate with estimation
-		//location shift.
-		if( m_fkEstimation->getFactorNumber() == 0 ){
-			//The gamma matrix for exact SK.
-			MatrixNXM<double> gammaMatSK = GeostatsUtils::makeGammaMatrix( vSamples,
-																		   estimationCell,
-																		   m_fkEstimation->getVariogramModel(),
-																		   m_fkEstimation->getVariogramModel()->getSill(),
-																		   KrigingType::SK,
-																		   true ); //using semivariogram per Deutsch
-			//The gamma matrix for exact SK with the esimation location slightly shifted.
-			MatrixNXM<double> gammaMatSansNugget = GeostatsUtils::makeGammaMatrix( vSamples,
-																		   estimationCell,
-																		   m_fkEstimation->getVariogramModel(),
-																		   m_fkEstimation->getVariogramModel()->getSill(),
-																		   KrigingType::SK,
-																		   true, //using semivariogram per Deutsch
-																		   epsilonNugget );
-			//The kriging weights for exact SK.
-			MatrixNXM<double> weightsSK( covMat_inv * gammaMatSK );
-			//The kriging weights for FK with shifted location.
-			MatrixNXM<double> weightsSansNugget( covMat_inv * gammaMatSansNugget );
-			//Apply the SK weights (estimate).
-			factor = 0.0;
-			DataCellPtrMultiset::iterator itSamples = vSamples.begin();
-			for( uint i = 0; i < vSamples.size(); ++i, ++itSamples){
-				factor += ( weightsSK(i,0) - weightsSansNugget(i,0) ) * ( (*itSamples)->readValueFromDataSet() - mSK );
-			}
-		}
+	//get the covariance matrix (theoretical full covariances between the data sample locations and themselves.)
+	//and factorize it once for all the kriging systems below.
+	//The matrix is made of semivariogram values (per Deutsch), so it is not positive definite and LU is used.
+	//The samples are sorted by location, so if the previous cell had the same samples, its matrix and
+	//factorization are reused as is.
+	vSamples.sortByLocation();
+	system.setSamples( vSamples );
+	if( system.isSampleSetRepeated() )
+		++nReused;
+	else {
+		system.buildCovariances( m_variogram, m_variogram.getSill(), KrigingType::SK, true ); //using semivariogram per Deutsch
+		solver.factorizeGeneral( system.getCovariances() );
+	}
 
-		//The "estimated" mean is simply the user-given global constant mean.
-		estimatedMean = mSK;
+	//get the values of the samples (in the order of the kriging matrices)
+	Eigen::VectorXd& values = workspace.values;
+	values.resize( vSamples.size() );
+	for( int i = 0; i < values.size(); ++i )
+		values(i) = vSamples[i].value;
 
+	//*************************SFK***************************************
+	//The SFK weights apply to the residuals with respect to the user-supplied simple kriging mean.
 	//*************************OFK***************************************
+	//The OFK weights are those of kriging systems bordered with a row and a column of ones:
+	//  [w] = [CZZ]^-1 * [CY] - mu * [CZZ]^-1 * [e], with mu = ( [e]'[CZZ]^-1[CY] - s ) / ( [e]'[CZZ]^-1[e] )
+	//where s is the sum of the weights (zero for the factors, one for the mean).  They are computed by
+	//Schur complement with the factorization of [CZZ].
+	bool isSFK = m_fkEstimation->getKrigingType() == KrigingType::SK;
+	Eigen::VectorXd residuals = values;
+	if( isSFK ){
+		//The "estimated" mean is simply the user-given global constant mean.
+		estimatedMean = m_fkEstimation->getMeanForSimpleKriging();
+		residuals.array() -= estimatedMean;
 	} else {
+		//Getting OK weights to estimate the neighborhood mean.
+		Eigen::VectorXd weightsMean;
+		solver.solveConstrained( Eigen::VectorXd::Zero( values.size() ), 1.0, weightsMean );
+		//Apply the OK weights (estimate the mean).
+		estimatedMean = weightsMean.dot( values );
+	}
 
-		//get the covariance matrix (theoretical full covariances between the data sample locations and themselves.)
-		MatrixNXM<double> CZZ_inv = GeostatsUtils::makeCovMatrix( vSamples,
-																 m_fkEstimation->getVariogramModel(),
-																 m_fkEstimation->getVariogramModel()->getSill(),
-																 KrigingType::SK,
-																 true ); //using semivariogram per Deutsch
-		CZZ_inv.invertWithEigen();
-
-		//get the gamma matrix (theoretical partial covariances between sample locations and estimation location)
-		MatrixNXM<double> CY = GeostatsUtils::makeGammaMatrix( vSamples,
-																	 estimationCell,
-																	 m_singleStructVModel,
-																	 m_singleStructVModel->getSill(),
-																	 KrigingType::SK,
-																	 true ); //using semivariogram per Deutsch
-
-		//Make a vector-column of ones and its transpose.
-		MatrixNXM<double> e( vSamples.size(), 1, 1.0 );
-		MatrixNXM<double> e_t = e.getTranspose();
-
-		//Get a compatible identity matrix.
-		MatrixNXM<double> I( vSamples.size(), vSamples.size() );
-		I.setIdentity();
-
-		//get the kriging weights vector: [w] = [Cov]^-1 * [gamma] (solve the kriging system)
-		//the sum of these weights is zero.
-		MatrixNXM<double> et_x_CZZ_inv_x_e____inv( e_t * CZZ_inv * e );
-		et_x_CZZ_inv_x_e____inv(0, 0) = 1 / et_x_CZZ_inv_x_e____inv(0, 0);
-
-
-		//To estimate non-nugget factors.
-		if( m_fkEstimation->getFactorNumber() != 0 ){
-			MatrixNXM<double> weightsFactor( ( CY.getTranspose() * CZZ_inv * ( I - et_x_CZZ_inv_x_e____inv(0,0) * e * e_t * CZZ_inv ) ).getTranspose() );
-
+	//Solves the kriging system for the current gamma matrix.  In OFK, the weights sum up to weightSum.
+	auto solveKrigingSystem = [&]( double weightSum, Eigen::VectorXd& weights ){
+		if( isSFK )
+			solver.solve( system.getGammas(), weights );
+		else
+			solver.solveConstrained( system.getGammas(), weightSum, weights );
+	};
+
+	//the sample search and the kriging matrix above are shared by all factors
+	Eigen::VectorXd weightsFactor, weightsSansNugget;
+	for( size_t iFactor = 0; iFactor < m_factorNumbers.size(); ++iFactor ){
+		double factor;
+		int factorNumber = m_factorNumbers[iFactor];
+		if( factorNumber == -1 ){
+			//the mean is a separate factor.
+			factor = estimatedMean;
+		} else if( factorNumber != 0 ){
+			//get the gamma matrix (theoretical partial covariances between sample locations and estimation location)
+			const CompiledVariogramModel& singleStructVariogram = m_singleStructVariograms[iFactor];
+			system.buildGammas( singleStructVariogram,
+								singleStructVariogram.getSill(),
+								estimationCell._center,
+								KrigingType::SK,
+								true ); //using semivariogram per Deutsch
+			//get the kriging weights vector: [w] = [Cov]^-1 * [gamma] (solve the kriging system)
+			//in OFK, the sum of these weights is zero.
+			solveKrigingSystem( 0.0, weightsFactor );
 			//Apply the weights (estimate).
-			factor = 0.0;
-			DataCellPtrMultiset::iterator itSamples = vSamples.begin();
-			for( uint i = 0; i < vSamples.size(); ++i, ++itSamples){
-				factor += weightsFactor(i,0) * ( (*itSamples)->readValueFromDataSet() );
-			}
-		//To estimate the nugget factor (apply location shift trick)
+			factor = weightsFactor.dot( residuals );
 		} else {
-			//Make a full gamma matrix with estimation location slightly shifted.
-			MatrixNXM<double> CAA_t = GeostatsUtils::makeGammaMatrix( vSamples,
-																	estimationCell,
-																	m_fkEstimation->getVariogramModel(),
-																	m_fkEstimation->getVariogramModel()->getSill(),
-																	KrigingType::SK,
-																	true,  //using semivariogram per Deutsch
-																	epsilonNugget ).getTranspose();
-			//Get the weights for shifted location.
-			MatrixNXM<double> weightsNugget(  ( CAA_t * CZZ_inv * ( I - et_x_CZZ_inv_x_e____inv(0,0) * e * e_t * CZZ_inv ) +
-												(et_x_CZZ_inv_x_e____inv(0,0) * e_t * CZZ_inv) ).getTranspose()  );
-			//get a full gamma matrix.
-			MatrixNXM<double> gammaNugget = GeostatsUtils::makeGammaMatrix( vSamples,
-																		 estimationCell,
-																		 m_fkEstimation->getVariogramModel(),
-																		 m_fkEstimation->getVariogramModel()->getSill(),
-																		 KrigingType::SK,
-																		 true ); //using semivariogram per Deutsch
-			//Get weights (without location shift).
-			//MatrixNXM<double> weightsFactor( ( gammaNugget.getTranspose() * CZZ_inv * ( I - et_x_CZZ_inv_x_e____inv(0,0) * e * e_t * CZZ_inv ) ).getTranspose() );
-			MatrixNXM<double> weightsFactor(  ( gammaNugget.getTranspose() * CZZ_inv * ( I - et_x_CZZ_inv_x_e____inv(0,0) * e * e_t * CZZ_inv ) +
-												(et_x_CZZ_inv_x_e____inv(0,0) * e_t * CZZ_inv) ).getTranspose()  );
+			//if the user opted for the nugget effect, the procedure is different:
+			//FK is used to compute estimates with a small shift of the estimation location.
+			//This procedure effectively eliminates nugget effect.  Thus, the nugget factor
+			//is the difference between the normal kriging estimate and the FK estimate with estimation
+			//location shift.
+			//The gamma matrix and the kriging weights for exact kriging.
+			system.buildGammas( m_variogram,
+								m_variogram.getSill(),
+								estimationCell._center,
+								KrigingType::SK,
+								true ); //using semivariogram per Deutsch
+			solveKrigingSystem( 1.0, weightsFactor );
+			//The gamma matrix and the kriging weights with the esimation location slightly shifted.
+			system.buildGammas( m_variogram,
+								m_variogram.getSill(),
+								estimationCell._center + m_epsilonNugget,
+								KrigingType::SK,
+								true ); //using semivariogram per Deutsch
+			solveKrigingSystem( 1.0, weightsSansNugget );
 			//Apply the weights (estimate).
-			factor = 0.0;
-			DataCellPtrMultiset::iterator itSamples = vSamples.begin();
-			for( uint i = 0; i < vSamples.size(); ++i, ++itSamples){
-				factor += ( weightsFactor(i,0) - weightsNugget(i,0) ) * ( (*itSamples)->readValueFromDataSet() );
-			}
+			factor = ( weightsFactor - weightsSansNugget ).dot( residuals );
 		}
 
-		//Estimating the mean
-		{
-			//Getting OK weights to estimate the neighborhood mean.
-			MatrixNXM<double> weightsMean( ( et_x_CZZ_inv_x_e____inv(0,0) * e_t * CZZ_inv ).getTranspose() );
-
-			//Apply the OK weights (estimate the mean).
-			estimatedMean = 0.0;
-			DataCellPtrMultiset::iterator itSamples = vSamples.begin();
-			for( uint i = 0; i < vSamples.size(); ++i, ++itSamples){
-				estimatedMean += weightsMean(i,0) * ( (*itSamples)->readValueFromDataSet() );
-			}
+		//rarely, kriging may fail with a NaN or infinity value.
+		//guard the output against such failures (they are reported once by doRun(), since this runs in the worker threads).
+		if( std::isnan(factor) || !std::isfinite(factor) ){
+			++nFailed;
+			factor = failValue;
 		}
+		factors[iFactor] = factor;
 	}
 
-	//************************* Check result and return ***************************************
-
-	//rarely, kriging may fail with a NaN or infinity value.
-	//guard the output against such failures.
-	if( std::isnan(factor) || !std::isfinite(factor) ){
-		++nFailed;
-		double failValue = m_fkEstimation->ndvOfEstimationGrid();
-        Application::instance()->logWarn( "FKEstimationRunner::fk(): at least one kriging operation failed (resulted in NaN or infinity).  Returning " +
-										  QString::number(failValue) + " to protect the output data file." );
-		factor = failValue;
-	}
 	if( std::isnan(estimatedMean) || !std::isfinite(estimatedMean) ){
-		estimatedMean = m_fkEstimation->ndvOfEstimationGrid();
+		estimatedMean = failValue;
 	}
-
-	return factor;
 }
@@ -2,14 +2,45 @@
 #define FKESTIMATIONRUNNER_H
 
 #include <QObject>
+#include "compiledvariogrammodel.h"
+#include "krigingsystem.h"
+#include "krigingsolver.h"
+#include "krigingneighborhood.h"
+#include <atomic>
+#include <vector>
 
 class Attribute;
 class GridCell;
 class FKEstimation;
 class VariogramModel;
 
+/** Work distribution and counters shared by the estimation threads of FKEstimationRunner. */
+struct FKEstimationProgress
+{
+    FKEstimationProgress() : nextRow(0), nRowsDone(0), nKriging(0), nReused(0), nFailed(0) {}
+    std::atomic<unsigned int> nextRow;
+    std::atomic<unsigned int> nRowsDone;
+    std::atomic<int> nKriging;
+    /** Number of kriging operations that reused the kriging matrix of the previous cell. */
+    std::atomic<int> nReused;
+    std::atomic<int> nFailed;
+};
+
+/** The neighborhood and kriging objects of one estimation thread of FKEstimationRunner, reused for all of its cells. */
+struct FKKrigingWorkspace
+{
+    /** @param maxSamples The maximum number of samples of a neighborhood. */
+    explicit FKKrigingWorkspace( int maxSamples ) : neighborhood( maxSamples ) {}
+    KrigingNeighborhood neighborhood;
+    /** The values of the samples in the neighborhood. */
+    Eigen::VectorXd values;
+    KrigingSystem system;
+    KrigingSolver solver;
+};
+
 /** This is an auxiliary class used in FKEstimation::run() to enable the progress dialog.
- * The processing takes place in a separate thread, so the progress bar updates.
+ * The processing takes place in a separate thread, so the progress bar updates.  That thread,
+ * in turn, distributes the grid rows among as many worker threads as there are processor cores.
  */
 class FKEstimationRunner : public QObject
 {
@@ -17,12 +48,18 @@ class FKEstimationRunner : public QObject
     Q_OBJECT
 
 public:
-    explicit FKEstimationRunner(FKEstimation* fkEstimation, QObject *parent = 0);
+    /**
+     * @param factorNumbers The factors to compute in a single pass over the grid: -1 (mean); 0 (nugget);
+     *        1 and onwards (each variographic structure).  The sample search and the factorization of the
+     *        kriging matrix of each cell are shared by all factors.
+     */
+    explicit FKEstimationRunner(FKEstimation* fkEstimation, const std::vector<int>& factorNumbers, QObject *parent = 0);
 	virtual ~FKEstimationRunner();
 
     bool isFinished(){ return m_finished; }
 
-    std::vector<double> getFactor(){ return m_factor; }
+    /** Returns the estimated factors, in the order of the factor numbers passed to the constructor. */
+    const std::vector< std::vector<double> >& getFactors(){ return m_factors; }
 
     std::vector<double> getMeans(){ return m_means; }
 
@@ -38,22 +75,39 @@ public slots:
 private:
     bool m_finished;
     FKEstimation* m_fkEstimation;
-    std::vector<double> m_factor;
+    std::vector<int> m_factorNumbers;
+    std::vector< std::vector<double> > m_factors;
     std::vector<double> m_means;
 	std::vector<uint> m_nSamples;
-	VariogramModel* m_singleStructVModel;
+	/** The variogram model compiled at the start of doRun(). */
+	CompiledVariogramModel m_variogram;
+	/** The single-structure variogram models of the factors (in the order of m_factorNumbers),
+	 * compiled at the start of doRun(). */
+	std::vector<CompiledVariogramModel> m_singleStructVariograms;
+	/** The shift of the estimation location used to estimate the nugget factor: about 10% of the grid cell size. */
+	double m_epsilonNugget;
 
 	/** Perform factorial kriging in a single cell in the output grid according to the formulation at
 	 * https://pubs.geoscienceworld.org/geophysics/article/82/2/G35/520853/data-analysis-of-potential-field-methods-using
 	 * Data analysis of potential field methods using geostatistics - Shamsipour et al, 2017
 	 *
 	 * @param estimationCell Object containing info about the cell such as parent grid, indexes, etc.
+	 * @param workspace The neighborhood and the kriging matrices and their factorization, owned by the calling thread and
+	 *                  kept between cells, so they are not recomputed when consecutive cells have the same samples.
+	 * @param factors Receives the estimated factors (one per element of m_factorNumbers).
 	 * @param estimatedMean The value of the estimated mean computed during FK estimation.
 	 * @param nSamples The number of samples used to inform the estimation.
+	 * @param nReused Its value is increased if the kriging matrix of the previous cell was reused (same samples).
 	 * @param nFailed Its value is increased by the number of kriging operations that failed (resulted in
 	 *                NaN or inifinity).
 	 */
-	double fk(GridCell &estimationCell, double& estimatedMean, uint& nSamples, int& nFailed );
+	void fk( GridCell &estimationCell, FKKrigingWorkspace& workspace,
+			 double* factors, double& estimatedMean, uint& nSamples, int& nReused, int& nFailed );
+
+	/** Estimates the grid rows (nI cells along I) taken from progressInfo->nextRow until all rows are
+	 * processed.  Runs in several threads at once, each writing the results of the rows it takes.
+	 */
+	void fkRows( FKEstimationProgress* progressInfo );
 };
 
 #endif // FKESTIMATIONRUNNER_H
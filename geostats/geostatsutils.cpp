@@ -7,17 +7,12 @@
 #include "ijkdelta.h"
 #include "util.h"
 #include "ijkdeltascache.h"
+#include "krigingneighborhood.h"
 
 #include <cmath>
 #include <limits>
 #include <iostream>
 
-//the aniso transforms only change if variogram model changes
-struct AnisoCache{
-    VariogramModel* vModel;
-    std::vector<Matrix3X3<double>> anisoTransforms;
-} g_anisoCache;
-
 GeostatsUtils::GeostatsUtils()
 {
 }
@@ -106,193 +101,6 @@ double GeostatsUtils::getGamma(VariogramStructureType permissiveModel, double h,
     return std::numeric_limits<double>::quiet_NaN();
 }
 
-double GeostatsUtils::getGamma(VariogramModel *model, const SpatialLocation &locA, const SpatialLocation &locB)
-{
-    //lesser bottleneck
-    double result = model->getNugget();
-    int nst = model->getNst();
-
-    double h;
-
-    for( int i = 0; i < nst; ++i){
-
-        Matrix3X3<double> anisoTransform;
-        //improving performance by saving the aniso transforms in a cache, assuming the anisotropy
-        //      is the same in all locations.
-		if( g_anisoCache.vModel != model){
-			if( i == 0 ) //making sure the cache doesn't grow indefinitely
-				g_anisoCache.anisoTransforms.clear();
-            anisoTransform = GeostatsUtils::getAnisoTransform(
-                        model->get_a_hMax(i), model->get_a_hMin(i), model->get_a_vert(i),
-                        model->getAzimuth(i), model->getDip(i), model->getRoll(i));
-			g_anisoCache.anisoTransforms.push_back( anisoTransform );
-        } else {
-			anisoTransform = g_anisoCache.anisoTransforms[i];
-        }
-
-        //get the separation corrected by anisotropy
-		h = GeostatsUtils::getH( locA._x, locA._y, locA._z,
-                                 locB._x, locB._y, locB._z,
-                                 anisoTransform );
-
-        result += GeostatsUtils::getGamma( model->getIt(i),
-                                           h,
-                                           model->get_a_hMax(i),
-                                           model->getCC(i) );
-    }
-
-    //sets the cache's key (variogram model pointer) so we know whether we can reuse the aniso transforms
-    //saved in the cache
-	g_anisoCache.vModel = model;
-
-    return result;
-}
-
-MatrixNXM<double> GeostatsUtils::makeCovMatrix(DataCellPtrMultiset &samples,
-											   VariogramModel *variogramModel,
-											   double variogramSill,
-											   KrigingType kType,
-											   bool returnGamma )
-{
-    //Define the dimension of cov matrix, which depends on kriging type
-    int append = 0;
-    switch( kType ){
-    case KrigingType::SK:
-        append = 0; break;
-    case KrigingType::OK:
-        append = 1; break;
-    }
-
-    //Special treatment for a pure random noise variogram (pure nugget)
-    //for the pure noise variogram, we impose that all weights sum to zero,
-    //so there is a Lagrangian multiplier like with OK, but not with weights
-    //summing to one.
-//    if( variogramModel->isPureNugget() )
-//        append = 1;
-
-    //Create the cov matrix.
-    MatrixNXM<double> covMatrix( samples.size() + append, samples.size() + append );
-
-    //convert the std::multiset into a std::vector for faster traversal
-    //(memory locality and less pointer chasing)
-	std::vector<DataCellPtr> samplesV;
-    samplesV.reserve( samples.size() );
-    std::copy(samples.begin(), samples.end(), std::back_inserter(samplesV));
-
-    //For each sample.
-	std::vector<DataCellPtr>::iterator rowsIt = samplesV.begin();
-    for( int i = 0; rowsIt != samplesV.end(); ++rowsIt, ++i ){
-		DataCellPtr rowCell = *rowsIt;
-        //For each sample.
-		std::vector<DataCellPtr>::iterator colsIt = samplesV.begin();
-        for( int j = 0; colsIt != samplesV.end(); ++colsIt, ++j ){
-			DataCellPtr colCell = *colsIt;
-            //get semi-variance value from the separation between two samples in a pair
-			double gamma = GeostatsUtils::getGamma( variogramModel, rowCell->_center, colCell->_center );
-            //to remove singularity...
-            //TODO: this needs to be verified.
-            if( variogramModel->isPureNugget() && i != j )
-                gamma = 0.0;
-			if( returnGamma )
-				covMatrix(i, j) = gamma;
-			else
-				//get covariance for the sample pair and assign it the corresponding element in the
-				//cov matrix
-				covMatrix(i, j) = variogramSill - gamma;
-		}
-    }
-
-    //prepare the cov matrix for an OK system, if this is the case.
-    switch( kType ){
-    case KrigingType::SK: break;
-    case KrigingType::OK:
-        int dim = samples.size();
-        for( int i = 0; i < dim; ++i ){
-            covMatrix( dim, i ) = 1.0; //last row with ones
-			covMatrix( i, dim ) = 1.0; //last column with ones
-        }
-        covMatrix( dim, dim ) = 0.0; //last element is zero
-    }
-
-    //The pure noise case
-//    if( variogramModel->isPureNugget() ){
-//        int dim = samples.size();
-//        for( int i = 0; i < dim; ++i ){
-//            covMatrix( dim, i ) = 1.0; //last row with 1's, like OK
-//            covMatrix( i, dim ) = 1.0; //last column with 1's, like OK
-//        }
-//        covMatrix( dim, dim ) = 0.0; //last element is zero, like OK
-//    }
-
-    return covMatrix;
-}
-
-MatrixNXM<double> GeostatsUtils::makeGammaMatrix(DataCellPtrMultiset &samples,
-												 GridCell &estimationLocation,
-												 VariogramModel *variogramModel,
-												 double variogramSill,
-												 KrigingType kType,
-												 bool returnGamma,
-												 double epsilon )
-{
-    int append = 0;
-    switch( kType ){
-    case KrigingType::SK:
-        append = 0; break;
-    case KrigingType::OK:
-        append = 1; break;
-    }
-
-    //Special treatment for a pure random noise variogram (pure nugget)
-    //for the pure noise variogram, we impose that all weights sum to zero,
-    //so there is a Lagrangian multiplier like with OK, but not with weights
-    //summing to one.
-//    if( variogramModel->isPureNugget() )
-//        append = 1;
-
-	//Create the gamma matrix.
-    MatrixNXM<double> result( samples.size()+append, 1 );
-
-	//convert the std::multiset into a std::vector for faster traversal
-	//(memory locality and less pointer chasing)
-	std::vector<DataCellPtr> samplesV;
-	samplesV.reserve( samples.size() );
-	std::copy(samples.begin(), samples.end(), std::back_inserter(samplesV));
-
-	//For each sample.
-	std::vector<DataCellPtr>::iterator rowsIt = samplesV.begin();
-	for( int i = 0; rowsIt != samplesV.end(); ++rowsIt, ++i ){
-		DataCellPtr rowCell = *rowsIt;
-        //get semi-variance value
-		double gamma = GeostatsUtils::getGamma( variogramModel, rowCell->_center, estimationLocation._center + epsilon );
-        //get covariance
-		if( returnGamma )
-			result(i, 0) = gamma;
-		else
-			result(i, 0) = variogramSill - gamma;
-    }
-
-    //prepare the matrix for an OK system, if this is the case.
-    switch( kType ){
-    case KrigingType::SK: break;
-    case KrigingType::OK:
-        result( samples.size(), 0 ) = 1.0; //last element is one
-    }
-
-//    //The pure noise case
-//    if( variogramModel->isPureNugget() ){
-//        result( samples.size(), 0 ) = 0.0; //last element is 0, differently from OK,
-//                                           //to force the sum of weights be 0.0 and not 1.0
-//    }
-
-	//If the matrix has only one element and it is zero, add a small value to prevent
-	//singularities in kriging systems that use only one sample.
-	if( result.is1x1() && result(0,0) == 0.0 )
-		result(0,0) = 0.001;
-
-    return result;
-}
-
 void GeostatsUtils::getValuedNeighborsTopoOrdered(GridCell &cell,
                                                         int numberOfSamples,
                                                         int nColsAround,
@@ -300,7 +108,7 @@ void GeostatsUtils::getValuedNeighborsTopoOrdered(GridCell &cell,
                                                         int nSlicesAround,
                                                         bool hasNDV,
                                                         double NDV,
-														GridCellPtrMultiset &list)
+														KrigingNeighborhood &list)
 {
     CartesianGrid* cg = cell._grid;
     if( ! cg ){
@@ -373,10 +181,13 @@ void GeostatsUtils::getValuedNeighborsTopoOrdered(GridCell &cell,
                 double value = cg->dataIJK( cell._dataIndex, ii, jj, kk );
                 //if the cell is valued... DataFile::hasNDV() is slow.
                 if( !hasNDV || !Util::almostEqual2sComplement( NDV, value, 1 ) ){
-                    //...it is a valid neighbor.
-					GridCellPtr currentCell( new GridCell( cg, cell._dataIndex, ii, jj, kk ) );
-					currentCell->computeTopoDistance( cell );
-                    list.insert( currentCell );
+                    //...it is a valid neighbor (location as in GridCell's constructor).
+                    list.add( ii + jj * column_limit + kk * column_limit * row_limit,
+                              cg->getX0() + ii * cg->getDX(),
+                              cg->getY0() + jj * cg->getDY(),
+                              cg->getZ0() + kk * cg->getDZ(),
+                              value,
+                              std::abs( ii - cell._indexIJK._i ) + std::abs( jj - cell._indexIJK._j ) + std::abs( kk - cell._indexIJK._k ) );
                     //if the number of neighbors is reached...
                     if( list.size() == (unsigned)numberOfSamples )
                         //...interrupt the search
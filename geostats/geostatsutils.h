@@ -8,6 +8,8 @@
 #include "geostats/gridcell.h"
 #include <set>
 
+class KrigingNeighborhood;
+
 class SpatialLocation;
 
 /*! Kriging type. */
@@ -57,46 +59,9 @@ public:
     static double getGamma( VariogramStructureType permissiveModel, double h, double range, double contribution );
 
     /**
-     * Returns the total covariance according to a variogram model between two locations.
-     * Includes the nugget effet contribution, if any.
-     */
-	static double getGamma(VariogramModel* model, const SpatialLocation& locA, const SpatialLocation& locB );
-
-    /**
-     * Creates a covariance matrix for the given set of samples.
-     * @param kType Kriging type.  If SK, then the matrix has only the covariances between
-     *        the samples.  If OK, the matrix has an extra row and column with 1.0s, except
-     *        for the last element of both (the last element of matrix), with is zero.
-	 * @param returnGamma If true, the elements are variogram values (increases with distance).  The
-	 *        default (false) makes the elements be correlogram values (decreases with
-	 *        distance).  The variogram sill value is ignored if this parameter is true.
-     */
-	static MatrixNXM<double> makeCovMatrix(DataCellPtrMultiset & samples,
-										   VariogramModel *variogramModel,
-										   double variogramSill,
-										   KrigingType kType = KrigingType::SK,
-										   bool returnGamma = false);
-
-    /**
-     * Creates a gamma matrix of the given set of samples against the estimation location cell.
-     * @param kType Kriging type.  If SK, then the matrix has only the covariances between
-     *        the samples and the estimation location.  If OK, the matrix has an extra element == 1.0.
-	 * @param returnGamma If true, the elements are variogram values (increases with distance).  The
-	 *        default (false) makes the elements be correlogram values (decreases with
-	 *        distance).  The variogram sill value is ignored if this parameter is true.
-	 * @param epsilon A small value to shift the estimation location a bit.  This trick is used to avoid
-	 *        numerical instabilities in certain operations.  Normally this should be zero.
-	 */
-	static MatrixNXM<double> makeGammaMatrix(DataCellPtrMultiset & samples,
-											 GridCell& estimationLocation,
-											 VariogramModel *variogramModel,
-											 double variogramSill,
-											 KrigingType kType = KrigingType::SK,
-											 bool returnGamma = false,
-											 double epsilon = 0.0 );
-
-    /**
-     *  Returns a list of valued grid cells, ordered by topological proximity to the target cell.
+     *  Fills the neighborhood with the valued grid cells around the target cell, ordered by topological
+     *  proximity to it (the samples' distances are the topological distances).  The neighborhood is not cleared
+     *  before.
      */
 	static void getValuedNeighborsTopoOrdered(GridCell &cell,
 															int numberOfSamples,
@@ -105,13 +70,14 @@ public:
 															int nSlicesAround,
 															bool hasNDV,
 															double NDV,
-															GridCellPtrMultiset & list);
+															KrigingNeighborhood & list);
 	/** Creates the P matrix for Factorial Kriging.
 	 * see theory in Ma et al. (2014) - Factorial kriging for multiscale modelling.
 	 * @param nsamples Number of samples for the kriging operation.
 	 * @param nst Number of structures in the variogram ( TODO: check whether this includes the nugget effect ).
-	 * @param kType Kriging type.  Must match the kType used to call makeCovMatrix() and makeGammaMatrix() so the
-	 *        returned matrix is multiplication compatible with the other matrices in the kriging system.
+	 * @param kType Kriging type.  Must match the kType used to build the covariance and gamma matrices (see
+	 *        KrigingSystem) so the returned matrix is multiplication compatible with the other matrices in the
+	 *        kriging system.
 	 */
 	static MatrixNXM<double> makePmatrixForFK(int nsamples, int nst, KrigingType kType );
 
@@ -0,0 +1,646 @@
+#include "gridvariogramcalculator.h"
+#include "domain/cartesiangrid.h"
+#include "domain/attribute.h"
+#include "domain/application.h"
+#include "gslib/gslibparameterfiles/gslibparameterfile.h"
+#include "gslib/gslibparameterfiles/gslibparamtypes.h"
+#include "spectral/spectral.h"
+#include "util.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QProgressDialog>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+    /** Same tolerance used in gam to detect zero denominators. */
+    const double EPSLON = 1.0E-20;
+
+    QString variogramTitle( int type )
+    {
+        switch( type ){
+        case 1: return "Semivariogram          :";
+        case 2: return "Cross Semivariogram    :";
+        case 3: return "Covariance             :";
+        case 4: return "Correlogram            :";
+        case 5: return "General Relative       :";
+        case 6: return "Pairwise Relative      :";
+        case 7: return "Variogram of Logarithms:";
+        case 8: return "Semimadogram           :";
+        default: return "Indicator 1/2 Variogram:";
+        }
+    }
+
+    /**
+     * Computes the cross-correlations sum_x a(x)b(x+h) of zero-padded grids.  The forward transforms of
+     * the grids are kept, so each grid is transformed only once however many correlations it takes part in.
+     */
+    class GridCorrelator
+    {
+    public:
+        GridCorrelator( spectral::index nI, spectral::index nJ, spectral::index nK ) :
+            m_nI( nI ), m_nJ( nJ ), m_nK( nK ) {}
+
+        /** Adds a grid to correlate, returning its number.  The passed grid is not needed afterwards. */
+        int add( spectral::array& grid ){
+            m_transforms.push_back( spectral::complex_array() );
+            spectral::foward( m_transforms.back(), grid );
+            QCoreApplication::processEvents(); //let Qt repaint widgets
+            return m_transforms.size() - 1;
+        }
+
+        /** Returns the correlation between the grids a (at x) and b (at x + h) for the given lags. */
+        std::vector<double> correlate( int a, int b, const std::vector<GridLag>& lags ){
+            spectral::complex_array& A = m_transforms[a];
+            spectral::complex_array& B = m_transforms[b];
+            spectral::complex_array product( A.size() );
+            product.dot_conj( B, A );
+            spectral::array correlation( m_nI, m_nJ, m_nK );
+            spectral::backward( correlation, product );
+            QCoreApplication::processEvents(); //let Qt repaint widgets
+            //the inverse transform of fftw is not normalized
+            double n = static_cast<double>( m_nI * m_nJ * m_nK );
+            std::vector<double> result( lags.size() );
+            for( size_t iLag = 0; iLag < lags.size(); ++iLag ){
+                //negative lags are at the end of the circular correlation
+                spectral::index i = ( lags[iLag].i % m_nI + m_nI ) % m_nI;
+                spectral::index j = ( lags[iLag].j % m_nJ + m_nJ ) % m_nJ;
+                spectral::index k = ( lags[iLag].k % m_nK + m_nK ) % m_nK;
+                result[iLag] = correlation( i, j, k ) / n;
+            }
+            return result;
+        }
+
+    private:
+        spectral::index m_nI, m_nJ, m_nK;
+        std::vector<spectral::complex_array> m_transforms;
+    };
+}
+
+void GridVariogramCalculator::LagSums::reset(size_t size)
+{
+    np.assign( size, 0.0 );
+    gam.assign( size, 0.0 );
+    hm.assign( size, 0.0 );
+    tm.assign( size, 0.0 );
+    hv.assign( size, 0.0 );
+    tv.assign( size, 0.0 );
+}
+
+GridVariogramCalculator::GridVariogramCalculator(CartesianGrid *grid) :
+    m_grid( grid ),
+    m_tmin( -1.0e21 ),
+    m_tmax( 1.0e21 ),
+    m_realization( 1 ),
+    m_standardizeSills( false ),
+    m_nI( 0 ), m_nJ( 0 ), m_nK( 0 ),
+    m_nLags( 0 ),
+    m_nLagsI( 0 ), m_nLagsJ( 0 ), m_nLagsK( 0 ), m_minPairs( 0 )
+{
+}
+
+void GridVariogramCalculator::addVariable(uint column)
+{
+    m_variableColumns.push_back( column );
+}
+
+void GridVariogramCalculator::setTrimmingLimits(double tmin, double tmax)
+{
+    m_tmin = tmin;
+    m_tmax = tmax;
+}
+
+void GridVariogramCalculator::setRealization(uint realization)
+{
+    m_realization = realization;
+}
+
+void GridVariogramCalculator::addVariogram(const VariogramDefinition &variogram)
+{
+    m_variograms.push_back( variogram );
+}
+
+void GridVariogramCalculator::setStandardizeSills(bool standardizeSills)
+{
+    m_standardizeSills = standardizeSills;
+}
+
+bool GridVariogramCalculator::prepareData()
+{
+    if( m_variograms.empty() ){
+        Application::instance()->logError( "GridVariogramCalculator::prepareData(): no variogram to compute.", true );
+        return false;
+    }
+    for( const VariogramDefinition& variogram : m_variograms )
+        if( variogram.tailVariable < 1 || variogram.tailVariable > m_variableColumns.size() ||
+            variogram.headVariable < 1 || variogram.headVariable > m_variableColumns.size() ||
+            variogram.type < 1 || variogram.type > 10 ){
+            Application::instance()->logError( "GridVariogramCalculator::prepareData(): invalid variable number"
+                                               " or variogram type.", true );
+            return false;
+        }
+    if( m_realization < 1 || m_realization > std::max( 1u, m_grid->getNReal() ) ){
+        Application::instance()->logError( "GridVariogramCalculator::prepareData(): invalid realization number.", true );
+        return false;
+    }
+
+    m_grid->loadData();
+    m_nI = m_grid->getNX();
+    m_nJ = m_grid->getNY();
+    m_nK = m_grid->getNZ();
+    size_t nCells = static_cast<size_t>( m_nI ) * m_nJ * m_nK;
+    size_t firstRow = ( m_realization - 1 ) * nCells;
+
+    //read the variables (uninformed and trimmed values are NaN)
+    std::vector< std::vector<double> > variables;
+    std::vector<QString> names;
+    for( uint column : m_variableColumns ){
+        std::vector<double> values( nCells );
+        for( size_t cell = 0; cell < nCells; ++cell ){
+            double value = m_grid->data( firstRow + cell, column - 1 );
+            if( m_grid->isNDV( value ) || value < m_tmin || value > m_tmax )
+                value = std::numeric_limits<double>::quiet_NaN();
+            values[cell] = value;
+        }
+        variables.push_back( values );
+        Attribute* at = m_grid->getAttributeFromGEOEASIndex( column );
+        names.push_back( at ? at->getName() : QString::number( column ) );
+    }
+
+    auto mean = []( const std::vector<double>& values ){
+        double sum = 0.0;
+        size_t n = 0;
+        for( double value : values )
+            if( ! std::isnan( value ) ){
+                sum += value;
+                ++n;
+            }
+        return n ? sum / n : 0.0;
+    };
+
+    //set the tail and head values of each variogram
+    m_tails.clear();
+    m_heads.clear();
+    m_tailMeans.clear();
+    m_headMeans.clear();
+    m_sills.clear();
+    m_tailNames.clear();
+    m_headNames.clear();
+    for( const VariogramDefinition& variogram : m_variograms ){
+        std::vector<double> tail = variables[ variogram.tailVariable - 1 ];
+        std::vector<double> head = variables[ variogram.headVariable - 1 ];
+        if( variogram.type == 9 || variogram.type == 10 ){
+            //indicator transform of the tail variable (category codes are compared as integers, as gam does)
+            for( double& value : tail )
+                if( ! std::isnan( value ) )
+                    value = ( variogram.type == 9 ? value <= variogram.cutoff :
+                              static_cast<int>( value + 0.5 ) == static_cast<int>( variogram.cutoff + 0.5 ) ) ? 1.0 : 0.0;
+            head = tail;
+        }
+        m_tails.push_back( tail );
+        m_heads.push_back( head );
+        m_tailMeans.push_back( mean( tail ) );
+        m_headMeans.push_back( mean( head ) );
+        //the sill is the variance of the variable
+        double sumSquares = 0.0;
+        size_t n = 0;
+        for( double value : tail )
+            if( ! std::isnan( value ) ){
+                sumSquares += ( value - m_tailMeans.back() ) * ( value - m_tailMeans.back() );
+                ++n;
+            }
+        m_sills.push_back( n ? sumSquares / n : 0.0 );
+        m_tailNames.push_back( names[ variogram.tailVariable - 1 ] );
+        m_headNames.push_back( names[ variogram.headVariable - 1 ] );
+    }
+    return true;
+}
+
+void GridVariogramCalculator::computeLagSums(uint iv, const std::vector<GridLag> &lags, LagSums &sums) const
+{
+    int type = m_variograms[iv].type;
+    if( type == 6 || type == 8 ){
+        computeLagSumsDirectly( iv, lags, sums );
+        return;
+    }
+
+    //pad the grids by the largest lag, so the circular correlations do not wrap around
+    int maxLag[3] = { 0, 0, 0 };
+    for( const GridLag& lag : lags ){
+        maxLag[0] = std::max( maxLag[0], std::abs( lag.i ) );
+        maxLag[1] = std::max( maxLag[1], std::abs( lag.j ) );
+        maxLag[2] = std::max( maxLag[2], std::abs( lag.k ) );
+    }
+    spectral::index nI = m_nI + std::min<int>( maxLag[0], m_nI - 1 );
+    spectral::index nJ = m_nJ + std::min<int>( maxLag[1], m_nJ - 1 );
+    spectral::index nK = m_nK + std::min<int>( maxLag[2], m_nK - 1 );
+
+    //the values are centered, so the expanded sums keep their precision.  Variograms of squared differences
+    //use the same shift for both variables.
+    const std::vector<double>& tail = m_tails[iv];
+    const std::vector<double>& head = m_heads[iv];
+    bool isCross = type == 2;
+    bool separateMeans = type == 2 || type == 3 || type == 4;
+    double tailShift = m_tailMeans[iv];
+    double headShift = separateMeans ? m_headMeans[iv] : tailShift;
+    auto isInformed = [type]( double value ){
+        return ! std::isnan( value ) && ( type != 7 || value > EPSLON );
+    };
+    auto transformed = [type]( double value ){
+        return type == 7 ? std::log( value ) : value;
+    };
+    if( type == 7 ){
+        //the logarithms are centered instead (the head and tail means of this type are of the logarithms)
+        double sum = 0.0;
+        size_t n = 0;
+        for( double value : tail )
+            if( isInformed( value ) ){
+                sum += std::log( value );
+                ++n;
+            }
+        tailShift = headShift = n ? sum / n : 0.0;
+    }
+
+    //the tail and head indicators (both variables must be informed for the cross semivariogram), the centered
+    //values and their squares (or their product for the cross semivariogram)
+    spectral::array tailIndicator( nI, nJ, nK ), headIndicator( nI, nJ, nK );
+    spectral::array tailValues( nI, nJ, nK ), headValues( nI, nJ, nK );
+    spectral::array tailSquares( nI, nJ, nK ), headSquares( nI, nJ, nK );
+    for( uint k = 0; k < m_nK; ++k )
+        for( uint j = 0; j < m_nJ; ++j )
+            for( uint i = 0; i < m_nI; ++i ){
+                size_t cell = i + j * m_nI + k * m_nI * m_nJ;
+                bool tailInformed = isInformed( tail[cell] );
+                bool headInformed = isInformed( head[cell] );
+                if( isCross )
+                    tailInformed = headInformed = tailInformed && headInformed;
+                if( tailInformed ){
+                    double value = transformed( tail[cell] ) - tailShift;
+                    tailIndicator( i, j, k ) = 1.0;
+                    tailValues( i, j, k ) = value;
+                    tailSquares( i, j, k ) = value * value;
+                }
+                if( headInformed ){
+                    double value = transformed( head[cell] ) - headShift;
+                    headIndicator( i, j, k ) = 1.0;
+                    headValues( i, j, k ) = value;
+                    headSquares( i, j, k ) = value * value;
+                }
+                if( isCross && tailInformed )
+                    tailSquares( i, j, k ) = tailValues( i, j, k ) * headValues( i, j, k );
+            }
+
+    GridCorrelator correlator( nI, nJ, nK );
+    int It = correlator.add( tailIndicator );
+    int Ih = isCross ? It : correlator.add( headIndicator );
+    int t = correlator.add( tailValues );
+    int h = correlator.add( headValues );
+
+    sums.np = correlator.correlate( It, Ih, lags );
+    if( isCross ){
+        //sum of (t(x+h)-t(x))(h(x+h)-h(x)): the products at both ends minus the crossed products
+        int products = correlator.add( tailSquares );
+        std::vector<double> a = correlator.correlate( It, products, lags );
+        std::vector<double> b = correlator.correlate( products, It, lags );
+        std::vector<double> c = correlator.correlate( h, t, lags );
+        std::vector<double> d = correlator.correlate( t, h, lags );
+        std::vector<double> tm1 = correlator.correlate( t, It, lags );
+        std::vector<double> tm2 = correlator.correlate( It, t, lags );
+        std::vector<double> hm1 = correlator.correlate( h, It, lags );
+        std::vector<double> hm2 = correlator.correlate( It, h, lags );
+        for( size_t i = 0; i < lags.size(); ++i ){
+            sums.gam[i] = a[i] + b[i] - c[i] - d[i];
+            sums.tm[i] = 0.5 * ( tm1[i] + tm2[i] );
+            sums.hm[i] = 0.5 * ( hm1[i] + hm2[i] );
+        }
+    } else {
+        sums.tm = correlator.correlate( t, Ih, lags );
+        sums.hm = correlator.correlate( It, h, lags );
+        sums.gam = correlator.correlate( t, h, lags );
+        if( type != 3 ){
+            sums.tv = correlator.correlate( correlator.add( tailSquares ), Ih, lags );
+            sums.hv = correlator.correlate( It, correlator.add( headSquares ), lags );
+        }
+        //sum of (h(x+h)-t(x))^2
+        if( type != 3 && type != 4 )
+            for( size_t i = 0; i < lags.size(); ++i ){
+                sums.gam[i] = sums.hv[i] + sums.tv[i] - 2.0 * sums.gam[i];
+                sums.hv[i] = sums.tv[i] = 0.0;
+            }
+    }
+
+    for( size_t i = 0; i < lags.size(); ++i ){
+        //the pair counts are integers, but come from the transforms with rounding errors.  Lags as long as
+        //the grid have no pairs, but are aliased to shorter lags in the correlations.
+        sums.np[i] = std::round( sums.np[i] );
+        if( sums.np[i] < 1.0 || std::abs( lags[i].i ) >= (int)m_nI ||
+                                std::abs( lags[i].j ) >= (int)m_nJ || std::abs( lags[i].k ) >= (int)m_nK ){
+            sums.np[i] = sums.gam[i] = sums.hm[i] = sums.tm[i] = sums.hv[i] = sums.tv[i] = 0.0;
+            continue;
+        }
+        //the sums of the head and tail values are of the actual values, but the measures are still centered
+        sums.tm[i] += tailShift * sums.np[i];
+        sums.hm[i] += headShift * sums.np[i];
+    }
+}
+
+void GridVariogramCalculator::computeLagSumsDirectly(uint iv, const std::vector<GridLag> &lags, LagSums &sums) const
+{
+    int type = m_variograms[iv].type;
+    const std::vector<double>& tail = m_tails[iv];
+    const std::vector<double>& head = m_heads[iv];
+    int nI = m_nI, nJ = m_nJ, nK = m_nK;
+    for( size_t iLag = 0; iLag < lags.size(); ++iLag ){
+        const GridLag& lag = lags[iLag];
+        for( int k = std::max( 0, -lag.k ); k < std::min( nK, nK - lag.k ); ++k ){
+            QCoreApplication::processEvents(); //let Qt repaint widgets
+            for( int j = std::max( 0, -lag.j ); j < std::min( nJ, nJ - lag.j ); ++j )
+                for( int i = std::max( 0, -lag.i ); i < std::min( nI, nI - lag.i ); ++i ){
+                    double vrt = tail[ i + j * nI + k * nI * nJ ];
+                    double vrh = head[ ( i + lag.i ) + ( j + lag.j ) * nI + ( k + lag.k ) * nI * nJ ];
+                    if( std::isnan( vrt ) || std::isnan( vrh ) )
+                        continue;
+                    double measure;
+                    if( type == 6 ){
+                        if( std::abs( vrt + vrh ) <= EPSLON )
+                            continue;
+                        measure = 2.0 * ( vrt - vrh ) / ( vrt + vrh );
+                        measure *= measure;
+                    } else
+                        measure = std::abs( vrh - vrt );
+                    sums.np[iLag] += 1.0;
+                    sums.gam[iLag] += measure;
+                    sums.tm[iLag] += vrt;
+                    sums.hm[iLag] += vrh;
+                }
+        }
+    }
+}
+
+void GridVariogramCalculator::computeMeasure(uint iv, LagSums &sums, size_t i) const
+{
+    if( sums.np[i] <= 0.0 )
+        return;
+    int type = m_variograms[iv].type;
+    double rnum = sums.np[i];
+    sums.gam[i] /= rnum;
+    sums.hm[i] /= rnum;
+    sums.tm[i] /= rnum;
+    sums.hv[i] /= rnum;
+    sums.tv[i] /= rnum;
+    //standardize the semivariograms of single variables
+    VariogramDefinition variogram = m_variograms[iv];
+    if( m_standardizeSills && ( variogram.tailVariable == variogram.headVariable || type >= 9 ) ){
+        if( ( type == 1 || type >= 9 ) && m_sills[iv] > 0.0 )
+            sums.gam[i] /= m_sills[iv];
+    }
+    //the products of the covariance and of the correlogram were summed with the values centered on their means
+    double hmCentered = sums.hm[i] - m_headMeans[iv];
+    double tmCentered = sums.tm[i] - m_tailMeans[iv];
+    switch( type ){
+    case 3: //covariance (centered)
+        sums.gam[i] -= hmCentered * tmCentered;
+        break;
+    case 4: //correlogram
+        sums.hv[i] = std::sqrt( std::max( sums.hv[i] - hmCentered * hmCentered, 0.0 ) );
+        sums.tv[i] = std::sqrt( std::max( sums.tv[i] - tmCentered * tmCentered, 0.0 ) );
+        if( sums.hv[i] * sums.tv[i] < EPSLON )
+            sums.gam[i] = 0.0;
+        else
+            sums.gam[i] = ( sums.gam[i] - hmCentered * tmCentered ) / ( sums.hv[i] * sums.tv[i] );
+        //report the variances
+        sums.hv[i] *= sums.hv[i];
+        sums.tv[i] *= sums.tv[i];
+        break;
+    case 5: //general relative
+    {
+        double htave = 0.5 * ( sums.hm[i] + sums.tm[i] );
+        htave *= htave;
+        sums.gam[i] = htave < EPSLON ? 0.0 : sums.gam[i] / htave;
+        break;
+    }
+    default: //semi- measures
+        sums.gam[i] *= 0.5;
+    }
+}
+
+bool GridVariogramCalculator::computeVariograms(const std::vector<GridLag> &steps, uint nLags)
+{
+    if( steps.empty() || nLags < 1 ){
+        Application::instance()->logError( "GridVariogramCalculator::computeVariograms(): the directions and the number of"
+                                           " lags must be set.", true );
+        return false;
+    }
+    if( ! prepareData() )
+        return false;
+
+    QProgressDialog progressDialog;
+    progressDialog.setRange(0,0);
+    progressDialog.show();
+    progressDialog.setLabelText("Computing experimental variograms with FFT...");
+    QCoreApplication::processEvents(); //let Qt repaint widgets
+
+    //the lags of all directions are computed together
+    std::vector<GridLag> lags;
+    for( const GridLag& step : steps )
+        for( uint il = 1; il <= nLags; ++il )
+            lags.push_back( GridLag{ step.i * (int)il, step.j * (int)il, step.k * (int)il } );
+
+    m_steps = steps;
+    m_nLags = nLags;
+    m_variogramSums.clear();
+    for( uint iv = 0; iv < m_variograms.size(); ++iv ){
+        LagSums all;
+        all.reset( lags.size() );
+        computeLagSums( iv, lags, all );
+        for( size_t i = 0; i < lags.size(); ++i )
+            computeMeasure( iv, all, i );
+        //split the lags by direction
+        for( size_t id = 0; id < steps.size(); ++id ){
+            LagSums direction;
+            auto slice = [id, nLags]( const std::vector<double>& values ){
+                return std::vector<double>( values.begin() + id * nLags, values.begin() + ( id + 1 ) * nLags );
+            };
+            direction.np = slice( all.np );
+            direction.gam = slice( all.gam );
+            direction.hm = slice( all.hm );
+            direction.tm = slice( all.tm );
+            direction.hv = slice( all.hv );
+            direction.tv = slice( all.tv );
+            m_variogramSums.push_back( direction );
+        }
+    }
+    return true;
+}
+
+bool GridVariogramCalculator::saveVariograms(const QString &path) const
+{
+    QFile file( path );
+    if( ! file.open( QFile::WriteOnly | QFile::Text ) ){
+        Application::instance()->logError( "GridVariogramCalculator::saveVariograms(): could not open " + path + " for writing." );
+        return false;
+    }
+    QTextStream out( &file );
+    double dx = m_grid->getDX(), dy = m_grid->getDY(), dz = m_grid->getDZ();
+    for( uint iv = 0; iv < m_variograms.size(); ++iv )
+        for( uint id = 0; id < m_steps.size(); ++id ){
+            const LagSums& sums = m_variogramSums[ iv * m_steps.size() + id ];
+            const GridLag& step = m_steps[id];
+            double stepLength = std::sqrt( step.i * dx * step.i * dx + step.j * dy * step.j * dy + step.k * dz * step.k * dz );
+            out << variogramTitle( m_variograms[iv].type )
+                << QString("tail:%1 head:%2 direction %3").arg( m_tailNames[iv].left(12), -12 )
+                                                           .arg( m_headNames[iv].left(12), -12 )
+                                                           .arg( id + 1, 2 )
+                << '\n';
+            for( uint il = 0; il < m_nLags; ++il ){
+                double distance = sums.np[il] > 0.0 ? ( il + 1 ) * stepLength : 0.0;
+                out << QString(" %1 %2 %3 %4 %5 %6\n").arg( il + 1, 3 )
+                                                      .arg( distance, 12, 'f', 3 )
+                                                      .arg( sums.gam[il], 12, 'f', 5 )
+                                                      .arg( static_cast<qlonglong>( sums.np[il] ), 8 )
+                                                      .arg( sums.hm[il], 14, 'f', 5 )
+                                                      .arg( sums.tm[il], 14, 'f', 5 );
+            }
+        }
+    file.close();
+    return true;
+}
+
+bool GridVariogramCalculator::computeVariogramMap(uint nLagsI, uint nLagsJ, uint nLagsK, uint minPairs)
+{
+    if( ! prepareData() )
+        return false;
+
+    QProgressDialog progressDialog;
+    progressDialog.setRange(0,0);
+    progressDialog.show();
+    progressDialog.setLabelText("Computing variogram map with FFT...");
+    QCoreApplication::processEvents(); //let Qt repaint widgets
+
+    //the lags in the GEO-EAS scan order of the variogram map grid
+    std::vector<GridLag> lags;
+    for( int k = -(int)nLagsK; k <= (int)nLagsK; ++k )
+        for( int j = -(int)nLagsJ; j <= (int)nLagsJ; ++j )
+            for( int i = -(int)nLagsI; i <= (int)nLagsI; ++i )
+                lags.push_back( GridLag{ i, j, k } );
+
+    m_nLagsI = nLagsI;
+    m_nLagsJ = nLagsJ;
+    m_nLagsK = nLagsK;
+    m_minPairs = minPairs;
+    m_mapSums.clear();
+    for( uint iv = 0; iv < m_variograms.size(); ++iv ){
+        LagSums sums;
+        sums.reset( lags.size() );
+        computeLagSums( iv, lags, sums );
+        for( size_t i = 0; i < lags.size(); ++i )
+            computeMeasure( iv, sums, i );
+        m_mapSums.push_back( sums );
+    }
+    return true;
+}
+
+bool GridVariogramCalculator::saveVariogramMap(const QString &path) const
+{
+    double ndv = Util::VARMAP_NDV.toDouble();
+    std::vector< std::vector<double> > lines;
+    for( const LagSums& sums : m_mapSums )
+        for( size_t i = 0; i < sums.np.size(); ++i ){
+            bool hasEnoughPairs = sums.np[i] >= m_minPairs && sums.np[i] > 0.0;
+            lines.push_back( std::vector<double>{ hasEnoughPairs ? sums.gam[i] : ndv, sums.np[i],
+                                                  sums.hm[i], sums.tm[i], sums.hv[i], sums.tv[i] } );
+        }
+    Util::createGEOEASGridFile( "Variogram volume: nx " + QString::number( m_nLagsI * 2 + 1 ) +
+                                " ny " + QString::number( m_nLagsJ * 2 + 1 ) +
+                                " nz " + QString::number( m_nLagsK * 2 + 1 ),
+                                std::vector<QString>{ "variogram", "number of pairs", "head mean",
+                                                      "tail mean", "head variance", "tail variance" },
+                                lines, path );
+    return true;
+}
+
+bool GridVariogramCalculator::runGam(GSLibParameterFile *gpfGam, CartesianGrid *grid)
+{
+    GridVariogramCalculator calculator( grid );
+
+    GSLibParMultiValuedFixed *par1 = gpfGam->getParameter<GSLibParMultiValuedFixed*>(1);
+    GSLibParMultiValuedVariable *par1_1 = par1->getParameter<GSLibParMultiValuedVariable*>(1);
+    for( int i = 0; i < par1_1->_parameters.size(); ++i )
+        calculator.addVariable( par1_1->getParameter<GSLibParUInt*>(i)->_value );
+
+    GSLibParMultiValuedFixed *par2 = gpfGam->getParameter<GSLibParMultiValuedFixed*>(2);
+    calculator.setTrimmingLimits( par2->getParameter<GSLibParDouble*>(0)->_value,
+                                  par2->getParameter<GSLibParDouble*>(1)->_value );
+
+    calculator.setRealization( gpfGam->getParameter<GSLibParUInt*>(4)->_value );
+
+    GSLibParMultiValuedFixed *par6 = gpfGam->getParameter<GSLibParMultiValuedFixed*>(6);
+    uint ndir = par6->getParameter<GSLibParUInt*>(0)->_value;
+    uint nlag = par6->getParameter<GSLibParUInt*>(1)->_value;
+    GSLibParRepeat *par7 = gpfGam->getParameter<GSLibParRepeat*>(7); //repeat ndir-times
+    std::vector<GridLag> steps;
+    for( uint i = 0; i < ndir; ++i ){
+        GSLibParMultiValuedFixed *par7_0 = par7->getParameter<GSLibParMultiValuedFixed*>(i, 0);
+        steps.push_back( GridLag{ par7_0->getParameter<GSLibParInt*>(0)->_value,
+                                  par7_0->getParameter<GSLibParInt*>(1)->_value,
+                                  par7_0->getParameter<GSLibParInt*>(2)->_value } );
+    }
+
+    calculator.setStandardizeSills( gpfGam->getParameter<GSLibParOption*>(8)->_selected_value == 1 );
+
+    GSLibParRepeat *par10 = gpfGam->getParameter<GSLibParRepeat*>(10); //repeat nvarios-times
+    uint nvarios = gpfGam->getParameter<GSLibParUInt*>(9)->_value;
+    for( uint i = 0; i < nvarios; ++i ){
+        GSLibParMultiValuedFixed *par10_0 = par10->getParameter<GSLibParMultiValuedFixed*>(i, 0);
+        VariogramDefinition variogram;
+        variogram.tailVariable = par10_0->getParameter<GSLibParUInt*>(0)->_value;
+        variogram.headVariable = par10_0->getParameter<GSLibParUInt*>(1)->_value;
+        variogram.type = par10_0->getParameter<GSLibParOption*>(2)->_selected_value;
+        variogram.cutoff = par10_0->getParameter<GSLibParDouble*>(3)->_value;
+        calculator.addVariogram( variogram );
+    }
+
+    return calculator.computeVariograms( steps, nlag ) &&
+           calculator.saveVariograms( gpfGam->getParameter<GSLibParFile*>(3)->_path );
+}
+
+bool GridVariogramCalculator::runVarmap(GSLibParameterFile *gpfVarmap, CartesianGrid *grid)
+{
+    GridVariogramCalculator calculator( grid );
+
+    GSLibParMultiValuedFixed *par1 = gpfVarmap->getParameter<GSLibParMultiValuedFixed*>(1);
+    GSLibParMultiValuedVariable *par1_1 = par1->getParameter<GSLibParMultiValuedVariable*>(1);
+    for( int i = 0; i < par1_1->_parameters.size(); ++i )
+        calculator.addVariable( par1_1->getParameter<GSLibParUInt*>(i)->_value );
+
+    GSLibParMultiValuedFixed *par2 = gpfVarmap->getParameter<GSLibParMultiValuedFixed*>(2);
+    calculator.setTrimmingLimits( par2->getParameter<GSLibParDouble*>(0)->_value,
+                                  par2->getParameter<GSLibParDouble*>(1)->_value );
+
+    GSLibParMultiValuedFixed *par8 = gpfVarmap->getParameter<GSLibParMultiValuedFixed*>(8);
+    uint nxlag = par8->getParameter<GSLibParUInt*>(0)->_value;
+    uint nylag = par8->getParameter<GSLibParUInt*>(1)->_value;
+    uint nzlag = par8->getParameter<GSLibParUInt*>(2)->_value;
+
+    calculator.setStandardizeSills( gpfVarmap->getParameter<GSLibParOption*>(11)->_selected_value == 1 );
+
+    GSLibParRepeat *par13 = gpfVarmap->getParameter<GSLibParRepeat*>(13); //repeat nvarios-times
+    uint nvarios = gpfVarmap->getParameter<GSLibParUInt*>(12)->_value;
+    for( uint i = 0; i < nvarios; ++i ){
+        GSLibParMultiValuedFixed *par13_0 = par13->getParameter<GSLibParMultiValuedFixed*>(i, 0);
+        VariogramDefinition variogram;
+        variogram.tailVariable = par13_0->getParameter<GSLibParUInt*>(0)->_value;
+        variogram.headVariable = par13_0->getParameter<GSLibParUInt*>(1)->_value;
+        variogram.type = par13_0->getParameter<GSLibParOption*>(2)->_selected_value;
+        //the varmap template may not have the cutoff of the indicator variograms
+        variogram.cutoff = par13_0->_parameters.size() > 3 ? par13_0->getParameter<GSLibParDouble*>(3)->_value : 0.0;
+        calculator.addVariogram( variogram );
+    }
+
+    return calculator.computeVariogramMap( nxlag, nylag, nzlag, gpfVarmap->getParameter<GSLibParUInt*>(10)->_value ) &&
+           calculator.saveVariogramMap( gpfVarmap->getParameter<GSLibParFile*>(7)->_path );
+}
@@ -0,0 +1,132 @@
+#ifndef GRIDVARIOGRAMCALCULATOR_H
+#define GRIDVARIOGRAMCALCULATOR_H
+
+#include "experimentalvariogramcalculator.h"
+#include <QString>
+#include <vector>
+
+class CartesianGrid;
+class GSLibParameterFile;
+
+/** A lag vector in number of cells along I, J and K. */
+struct GridLag
+{
+    int i;
+    int j;
+    int k;
+};
+
+/**
+ * The GridVariogramCalculator class computes experimental variograms and variogram maps of Cartesian grid
+ * data in process, as an alternative to running GSLIB's gam and varmap programs.  The variogram types are
+ * the same of gam and of ExperimentalVariogramCalculator (1 = semivariogram, 2 = cross semivariogram, etc.)
+ * and the results are written in the same output formats of those programs, so they can be plotted with
+ * vargplt and pixelplt.
+ * Except for the pairwise relative variogram and the madogram, whose pair measures cannot be decomposed
+ * into products, the pair sums of all lags are computed at once with Fast Fourier Transforms: the sum over
+ * the grid of a(x)b(x+h) for all h is the cross-correlation of a and b.  The grids are padded with zeros
+ * by the largest lag, so the circular correlation of the FFT does not wrap.  Uninformed cells (no-data
+ * values or values outside the trimming limits) are handled with indicator grids of the informed cells,
+ * whose cross-correlation is the number of pairs of each lag.  The values are centered on their mean before
+ * the transforms, so the expansion of the squared differences does not lose precision.
+ */
+class GridVariogramCalculator
+{
+public:
+    /** @param grid The Cartesian grid with the data. */
+    explicit GridVariogramCalculator( CartesianGrid* grid );
+
+    //@{
+    /** Set the calculation parameters (see GSLIB's gam and varmap documentation). */
+    /** Adds a variable by its GEO-EAS index (first is 1) in the grid. */
+    void addVariable( uint column );
+    void setTrimmingLimits( double tmin, double tmax );
+    /** The realization (first is 1) to use in grids with more than one. */
+    void setRealization( uint realization );
+    void addVariogram( const VariogramDefinition& variogram );
+    /** Whether the semivariograms of single variables are divided by the variable's variance. */
+    void setStandardizeSills( bool standardizeSills );
+    //@}
+
+    /** Computes the experimental variograms along the given directions, as the gam program does.
+     * @param steps The lag vector of each direction.  The lags are multiples (1 to nLags) of it.
+     * @return False if the parameters are invalid (the reason is logged as an error).
+     */
+    bool computeVariograms( const std::vector<GridLag>& steps, uint nLags );
+
+    /** Saves the results of computeVariograms() to a file in the same format of gam's output. */
+    bool saveVariograms( const QString& path ) const;
+
+    /** Computes the variogram maps for all lags from -nLags to +nLags cells along each axis,
+     * as the varmap program does for gridded data.
+     * @param minPairs Lags with fewer pairs are left uninformed (Util::VARMAP_NDV).
+     * @return False if the parameters are invalid (the reason is logged as an error).
+     */
+    bool computeVariogramMap( uint nLagsI, uint nLagsJ, uint nLagsK, uint minPairs );
+
+    /** Saves the results of computeVariogramMap() to a GEO-EAS grid file in the same format
+     * of varmap's output, one realization per variogram. */
+    bool saveVariogramMap( const QString& path ) const;
+
+    /** Computes the experimental variograms with the given gam parameters and saves them to the
+     * output file set in the parameters, without running gam. */
+    static bool runGam( GSLibParameterFile* gpfGam, CartesianGrid* grid );
+
+    /** Computes the variogram maps with the given varmap parameters (which must be for gridded data)
+     * and saves them to the output file set in the parameters, without running varmap. */
+    static bool runVarmap( GSLibParameterFile* gpfVarmap, CartesianGrid* grid );
+
+private:
+    /** The pair sums (number of pairs, variogram measure, head and tail values and squared values) of
+     * one variogram for a set of lags. */
+    struct LagSums
+    {
+        void reset( size_t size );
+        std::vector<double> np, gam, hm, tm, hv, tv;
+    };
+
+    /** Reads the variables of the set realization and prepares the values of each variogram. */
+    bool prepareData();
+
+    /** Computes the pair sums of a variogram for the given lags. */
+    void computeLagSums( uint iv, const std::vector<GridLag>& lags, LagSums& sums ) const;
+
+    /** Same as computeLagSums(), but accumulating the pairs of each lag directly.  Used for the variogram
+     * types that cannot be computed with correlations. */
+    void computeLagSumsDirectly( uint iv, const std::vector<GridLag>& lags, LagSums& sums ) const;
+
+    /** Turns the sums of lag i into the averages and the final variogram measure. */
+    void computeMeasure( uint iv, LagSums& sums, size_t i ) const;
+
+    CartesianGrid* m_grid;
+    std::vector<uint> m_variableColumns;
+    double m_tmin, m_tmax;
+    uint m_realization;
+    std::vector<VariogramDefinition> m_variograms;
+    bool m_standardizeSills;
+
+    //@{
+    /** Data prepared by prepareData().  The tail and head values of each variogram (NaN if uninformed),
+     * in the GEO-EAS scan order, and their means and variances. */
+    uint m_nI, m_nJ, m_nK;
+    std::vector< std::vector<double> > m_tails, m_heads;
+    std::vector<double> m_tailMeans, m_headMeans, m_sills;
+    std::vector<QString> m_tailNames, m_headNames;
+    //@}
+
+    //@{
+    /** Results of computeVariograms(). */
+    std::vector<GridLag> m_steps;
+    uint m_nLags;
+    /** The sums of variogram iv, direction id are m_variogramSums[ iv * nDirections + id ]. */
+    std::vector<LagSums> m_variogramSums;
+    //@}
+
+    //@{
+    /** Results of computeVariogramMap(). */
+    uint m_nLagsI, m_nLagsJ, m_nLagsK, m_minPairs;
+    std::vector<LagSums> m_mapSums;
+    //@}
+};
+
+#endif // GRIDVARIOGRAMCALCULATOR_H
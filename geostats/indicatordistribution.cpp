@@ -0,0 +1,290 @@
+#include "indicatordistribution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+    /** Same tolerance used in GSLIB's interpolation routines. */
+    const double EPSLON = 1.0E-20;
+
+    /** Number of equal probability intervals of the classes that are not integrated exactly (postik's default). */
+    const int N_CLASS_DISCRETIZATION = 50;
+
+    /** Maximum difference between category codes and the values taken as those categories. */
+    const double CATEGORY_TOLERANCE = 1.0E-6;
+
+    /** Power interpolation between (xLow, yLow) and (xHigh, yHigh) (GSLIB's powint). */
+    double powerInterpolation( double xLow, double xHigh, double yLow, double yHigh, double x, double power ){
+        if( xHigh - xLow < EPSLON )
+            return ( yHigh + yLow ) / 2.0;
+        return yLow + ( yHigh - yLow ) * std::pow( ( x - xLow ) / ( xHigh - xLow ), power );
+    }
+
+    /** Returns the linear interpolation of x in the increasing values xs, clamped to the end values ys. */
+    double interpolate( double x, const std::vector<double>& xs, const std::vector<double>& ys ){
+        if( x <= xs.front() )
+            return ys.front();
+        if( x >= xs.back() )
+            return ys.back();
+        size_t j = std::upper_bound( xs.begin(), xs.end(), x ) - xs.begin();
+        if( xs[j] - xs[j-1] < EPSLON )
+            return ( ys[j] + ys[j-1] ) / 2.0;
+        return ys[j-1] + ( ys[j] - ys[j-1] ) * ( x - xs[j-1] ) / ( xs[j] - xs[j-1] );
+    }
+}
+
+IndicatorDistribution::IndicatorDistribution() :
+    m_isCategorical( false ),
+    m_zmin( 0.0 ),
+    m_zmax( 0.0 ),
+    m_lowerTailOption( 1 ),
+    m_middleOption( 1 ),
+    m_upperTailOption( 1 ),
+    m_lowerTailParameter( 1.0 ),
+    m_middleParameter( 1.0 ),
+    m_upperTailParameter( 1.0 )
+{
+}
+
+IndicatorDistribution::IndicatorDistribution(bool isCategorical, const std::vector<double> &thresholds,
+                                             const std::vector<double> &globalProbabilities) :
+    IndicatorDistribution()
+{
+    m_isCategorical = isCategorical;
+    m_thresholds = thresholds;
+    m_globalProbabilities = globalProbabilities;
+    m_globalProbabilities.resize( thresholds.size(), 0.0 );
+    if( ! thresholds.empty() ){
+        m_zmin = thresholds.front();
+        m_zmax = thresholds.back();
+    }
+}
+
+void IndicatorDistribution::setInterpolation(double zmin, double zmax,
+                                             int lowerTailOption, double lowerTailParameter,
+                                             int middleOption, double middleParameter,
+                                             int upperTailOption, double upperTailParameter)
+{
+    //the tails are extrapolated to the minimum and maximum values, which cannot be within the thresholds.
+    m_zmin = m_thresholds.empty() ? zmin : std::min( zmin, m_thresholds.front() );
+    m_zmax = m_thresholds.empty() ? zmax : std::max( zmax, m_thresholds.back() );
+    m_lowerTailOption = lowerTailOption;
+    m_lowerTailParameter = lowerTailParameter;
+    m_middleOption = middleOption;
+    m_middleParameter = middleParameter;
+    m_upperTailOption = upperTailOption;
+    m_upperTailParameter = upperTailParameter;
+    updateTabulatedTable();
+}
+
+void IndicatorDistribution::setTabulatedValues(const std::vector<double> &values, const std::vector<double> &weights)
+{
+    m_tabulatedValues = values;
+    m_tabulatedWeights = weights;
+    m_tabulatedWeights.resize( values.size(), 1.0 );
+    updateTabulatedTable();
+}
+
+int IndicatorDistribution::getClass(double value) const
+{
+    if( m_isCategorical ){
+        for( size_t k = 0; k < m_thresholds.size(); ++k )
+            if( std::abs( value - m_thresholds[k] ) < CATEGORY_TOLERANCE )
+                return k;
+        return -1;
+    }
+    return std::lower_bound( m_thresholds.begin(), m_thresholds.end(), value ) - m_thresholds.begin();
+}
+
+uint IndicatorDistribution::getClosestThreshold(double value) const
+{
+    uint closest = 0;
+    for( uint k = 1; k < m_thresholds.size(); ++k )
+        if( std::abs( value - m_thresholds[k] ) < std::abs( value - m_thresholds[closest] ) )
+            closest = k;
+    return closest;
+}
+
+bool IndicatorDistribution::correctOrderRelations(double *probabilities) const
+{
+    uint nThresholds = m_thresholds.size();
+    bool isChanged = false;
+    for( uint k = 0; k < nThresholds; ++k ){
+        double clipped = std::min( 1.0, std::max( 0.0, probabilities[k] ) );
+        isChanged = isChanged || clipped != probabilities[k];
+        probabilities[k] = clipped;
+    }
+
+    if( m_isCategorical ){
+        double sum = std::accumulate( probabilities, probabilities + nThresholds, 0.0 );
+        if( sum <= 0.0 ){
+            std::copy( m_globalProbabilities.begin(), m_globalProbabilities.end(), probabilities );
+            return true;
+        }
+        if( std::abs( sum - 1.0 ) > 1.0E-12 ){
+            for( uint k = 0; k < nThresholds; ++k )
+                probabilities[k] /= sum;
+            isChanged = true;
+        }
+        return isChanged;
+    }
+
+    //the average of the upward correction (running maximum) and the downward correction (running minimum).
+    std::vector<double> downward( probabilities, probabilities + nThresholds );
+    for( int k = (int)nThresholds - 2; k >= 0; --k )
+        downward[k] = std::min( downward[k], downward[k + 1] );
+    double upward = 0.0;
+    for( uint k = 0; k < nThresholds; ++k ){
+        upward = std::max( upward, probabilities[k] );
+        double corrected = ( upward + downward[k] ) / 2.0;
+        isChanged = isChanged || corrected != probabilities[k];
+        probabilities[k] = corrected;
+    }
+    return isChanged;
+}
+
+uint IndicatorDistribution::drawClass(const double *probabilities, double p) const
+{
+    uint nThresholds = m_thresholds.size();
+    if( m_isCategorical ){
+        double cumulative = 0.0;
+        for( uint k = 0; k + 1 < nThresholds; ++k ){
+            cumulative += probabilities[k];
+            if( p <= cumulative )
+                return k;
+        }
+        return nThresholds - 1;
+    }
+    for( uint k = 0; k < nThresholds; ++k )
+        if( p <= probabilities[k] )
+            return k;
+    return nThresholds;
+}
+
+double IndicatorDistribution::getValue(const double *probabilities, uint valueClass, double p) const
+{
+    uint nThresholds = m_thresholds.size();
+    double result;
+    if( valueClass == 0 ){
+        double zHigh = m_thresholds.front();
+        double pHigh = probabilities[0];
+        if( m_lowerTailOption == 2 )
+            result = powerInterpolation( 0.0, pHigh, m_zmin, zHigh, p, 1.0 / std::max( EPSLON, m_lowerTailParameter ) );
+        else if( m_lowerTailOption == 3 )
+            result = interpolateTabulated( m_zmin, zHigh, 0.0, pHigh, p );
+        else
+            result = powerInterpolation( 0.0, pHigh, m_zmin, zHigh, p, 1.0 );
+        return std::min( zHigh, std::max( m_zmin, result ) );
+    }
+    if( valueClass >= nThresholds ){
+        double zLow = m_thresholds.back();
+        double pLow = probabilities[nThresholds - 1];
+        if( m_upperTailOption == 4 ){
+            double omega = std::max( EPSLON, m_upperTailParameter );
+            double lambda = std::pow( zLow, omega ) * ( 1.0 - pLow );
+            result = std::pow( lambda / std::max( 1.0 - p, EPSLON ), 1.0 / omega );
+        } else if( m_upperTailOption == 2 )
+            result = powerInterpolation( pLow, 1.0, zLow, m_zmax, p, 1.0 / std::max( EPSLON, m_upperTailParameter ) );
+        else if( m_upperTailOption == 3 )
+            result = interpolateTabulated( zLow, m_zmax, pLow, 1.0, p );
+        else
+            result = powerInterpolation( pLow, 1.0, zLow, m_zmax, p, 1.0 );
+        return std::min( m_zmax, std::max( zLow, result ) );
+    }
+    double zLow = m_thresholds[valueClass - 1];
+    double zHigh = m_thresholds[valueClass];
+    double pLow = probabilities[valueClass - 1];
+    double pHigh = probabilities[valueClass];
+    if( m_middleOption == 2 )
+        result = powerInterpolation( pLow, pHigh, zLow, zHigh, p, 1.0 / std::max( EPSLON, m_middleParameter ) );
+    else if( m_middleOption == 3 )
+        result = interpolateTabulated( zLow, zHigh, pLow, pHigh, p );
+    else
+        result = powerInterpolation( pLow, pHigh, zLow, zHigh, p, 1.0 );
+    return std::min( zHigh, std::max( zLow, result ) );
+}
+
+void IndicatorDistribution::getMeanAndVariance(const double *probabilities, double &mean, double &variance) const
+{
+    uint nThresholds = m_thresholds.size();
+    double sum = 0.0;
+    double sumOfSquares = 0.0;
+    for( uint c = 0; c <= nThresholds; ++c ){
+        double pLow = c == 0 ? 0.0 : probabilities[c - 1];
+        double pHigh = c == nThresholds ? 1.0 : probabilities[c];
+        double width = pHigh - pLow;
+        if( width <= 0.0 )
+            continue;
+        int option = c == 0 ? m_lowerTailOption : ( c == nThresholds ? m_upperTailOption : m_middleOption );
+        if( option == 1 || option < 1 || option > 4 ){
+            //the values are uniform within linear classes.
+            double zLow = c == 0 ? m_zmin : m_thresholds[c - 1];
+            double zHigh = c == nThresholds ? m_zmax : m_thresholds[c];
+            sum += width * ( zLow + zHigh ) / 2.0;
+            sumOfSquares += width * ( zLow * zLow + zLow * zHigh + zHigh * zHigh ) / 3.0;
+        } else {
+            double step = width / N_CLASS_DISCRETIZATION;
+            for( int d = 0; d < N_CLASS_DISCRETIZATION; ++d ){
+                double z = getValue( probabilities, c, pLow + ( d + 0.5 ) * step );
+                sum += step * z;
+                sumOfSquares += step * z * z;
+            }
+        }
+    }
+    mean = sum;
+    variance = std::max( 0.0, sumOfSquares - sum * sum );
+}
+
+double IndicatorDistribution::interpolateTabulated(double zLow, double zHigh, double pLow, double pHigh, double p) const
+{
+    if( m_tableValues.size() < 3 )
+        return powerInterpolation( pLow, pHigh, zLow, zHigh, p, 1.0 );
+    //the conditional probability within the class is mapped onto the probabilities of the tabulated values
+    //within the class, then the value is interpolated in the table.
+    double tableLow = interpolate( zLow, m_tableValues, m_tableProbabilities );
+    double tableHigh = interpolate( zHigh, m_tableValues, m_tableProbabilities );
+    if( tableHigh - tableLow < EPSLON )
+        return powerInterpolation( pLow, pHigh, zLow, zHigh, p, 1.0 );
+    double tableP = pHigh - pLow < EPSLON ? ( tableLow + tableHigh ) / 2.0 :
+                                            tableLow + ( tableHigh - tableLow ) * ( p - pLow ) / ( pHigh - pLow );
+    return std::min( zHigh, std::max( zLow, interpolate( tableP, m_tableProbabilities, m_tableValues ) ) );
+}
+
+void IndicatorDistribution::updateTabulatedTable()
+{
+    m_tableValues.clear();
+    m_tableProbabilities.clear();
+
+    //the tabulated values within the minimum and maximum values, sorted, with ties merged.
+    std::vector<size_t> order;
+    for( size_t i = 0; i < m_tabulatedValues.size(); ++i )
+        if( m_tabulatedValues[i] > m_zmin && m_tabulatedValues[i] < m_zmax && m_tabulatedWeights[i] > 0.0 )
+            order.push_back( i );
+    if( order.empty() )
+        return;
+    std::sort( order.begin(), order.end(), [this]( size_t a, size_t b ){ return m_tabulatedValues[a] < m_tabulatedValues[b]; } );
+    std::vector<double> weights;
+    m_tableValues.push_back( m_zmin );
+    weights.push_back( 0.0 );
+    for( size_t index : order ){
+        if( m_tabulatedValues[index] == m_tableValues.back() )
+            weights.back() += m_tabulatedWeights[index];
+        else {
+            m_tableValues.push_back( m_tabulatedValues[index] );
+            weights.push_back( m_tabulatedWeights[index] );
+        }
+    }
+    m_tableValues.push_back( m_zmax );
+    weights.push_back( 0.0 );
+
+    //the cumulative probabilities are taken at the middle of the weight of each value (as GSLIB does),
+    //and are zero and one at the minimum and maximum values.
+    double totalWeight = std::accumulate( weights.begin(), weights.end(), 0.0 );
+    double cumulativeWeight = 0.0;
+    for( double weight : weights ){
+        m_tableProbabilities.push_back( ( cumulativeWeight + weight / 2.0 ) / totalWeight );
+        cumulativeWeight += weight;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef INDICATORDISTRIBUTION_H
+#define INDICATORDISTRIBUTION_H
+
+#include <qglobal.h>
+#include <vector>
+
+/**
+ * The IndicatorDistribution class holds the thresholds (or categories) and the global probabilities of the indicator
+ * formalism and does what GSLIB's ik3d, sisim, postik and postsim do with the conditional distributions estimated by
+ * indicator kriging at a location: the indicator coding of the data, the order relation correction, the drawing of
+ * values (with sisim's interpolation options within the classes and in the tails) and the E-type mean and the
+ * conditional variance (as postik).  The conditional distributions are arrays with one probability per threshold: the
+ * cumulative probabilities of the thresholds (continuous variables) or the probabilities of the categories.
+ * The object is not changed after it is set up, so it can be shared by several threads.
+ */
+class IndicatorDistribution
+{
+public:
+    /** Creates an empty distribution (no thresholds). */
+    IndicatorDistribution();
+
+    /**
+     * @param isCategorical Whether the thresholds are category codes.  Otherwise, they are increasing values.
+     * @param thresholds The thresholds or the category codes.
+     * @param globalProbabilities The global cumulative probabilities of the thresholds or the global proportions
+     *                            of the categories.
+     */
+    IndicatorDistribution( bool isCategorical, const std::vector<double>& thresholds,
+                           const std::vector<double>& globalProbabilities );
+
+    /** Sets how values are interpolated within the classes of continuous variables (see GSLIB's sisim and postik):
+     * the minimum and maximum values and the options for the lower tail (1 = linear, 2 = power, 3 = tabulated values),
+     * for the middle classes (1 = linear, 2 = power, 3 = tabulated values) and for the upper tail (1 = linear,
+     * 2 = power, 3 = tabulated values, 4 = hyperbolic), each with its parameter.  The default is linear everywhere. */
+    void setInterpolation( double zmin, double zmax,
+                           int lowerTailOption, double lowerTailParameter,
+                           int middleOption, double middleParameter,
+                           int upperTailOption, double upperTailParameter );
+
+    /** Sets the values (and their weights) whose distribution is interpolated within the classes with option 3. */
+    void setTabulatedValues( const std::vector<double>& values, const std::vector<double>& weights );
+
+    bool isCategorical() const { return m_isCategorical; }
+    uint getThresholdCount() const { return m_thresholds.size(); }
+    double getThreshold( uint k ) const { return m_thresholds[k]; }
+    double getGlobalProbability( uint k ) const { return m_globalProbabilities[k]; }
+    double getMinimum() const { return m_zmin; }
+    double getMaximum() const { return m_zmax; }
+
+    /** Returns the class of a value: the index of the first threshold not less than the value (the number of
+     * thresholds if the value is above all of them) or the index of its category (-1 if it is not a category). */
+    int getClass( double value ) const;
+
+    /** Returns the index of the threshold (or category) closest to the given value (e.g. the median IK cutoff). */
+    uint getClosestThreshold( double value ) const;
+
+    /** Returns the indicator of a value of the given class for the given threshold (or category). */
+    double getIndicator( uint valueClass, uint k ) const {
+        return ( m_isCategorical ? valueClass == k : valueClass <= k ) ? 1.0 : 0.0;
+    }
+
+    /**
+     * Corrects the order relations of a conditional distribution as GSLIB's ordrel: the probabilities are clipped
+     * to [0, 1], then the cumulative probabilities are made non-decreasing (the average of the upward and downward
+     * corrections) and the probabilities of the categories are made to sum up to one.
+     * @return Whether any probability was changed.
+     */
+    bool correctOrderRelations( double* probabilities ) const;
+
+    /** Returns the class of the given cumulative probability (e.g. a uniform random number) in a conditional
+     * distribution whose order relations are correct. */
+    uint drawClass( const double* probabilities, double p ) const;
+
+    /** Returns the value of the given cumulative probability, which must be within the given class, in the conditional
+     * distribution of a continuous variable, interpolated with the options set with setInterpolation(). */
+    double getValue( const double* probabilities, uint valueClass, double p ) const;
+
+    /** Computes the mean (E-type estimate) and the variance of the conditional distribution of a continuous variable.
+     * Linear classes are integrated exactly, the others are discretized into equal probability intervals (as postik). */
+    void getMeanAndVariance( const double* probabilities, double& mean, double& variance ) const;
+
+private:
+    /** Interpolates the tabulated values within a class (option 3).  Falls back to linear interpolation
+     * if there are no tabulated values within the class. */
+    double interpolateTabulated( double zLow, double zHigh, double pLow, double pHigh, double p ) const;
+
+    /** Rebuilds the table of the tabulated values and their cumulative probabilities, which ends at the minimum
+     * and maximum values. */
+    void updateTabulatedTable();
+
+    bool m_isCategorical;
+    std::vector<double> m_thresholds;
+    std::vector<double> m_globalProbabilities;
+    double m_zmin, m_zmax;
+    int m_lowerTailOption, m_middleOption, m_upperTailOption;
+    double m_lowerTailParameter, m_middleParameter, m_upperTailParameter;
+    std::vector<double> m_tabulatedValues, m_tabulatedWeights;
+    /** The tabulated values (with the minimum and maximum values at the ends) and their cumulative probabilities. */
+    std::vector<double> m_tableValues, m_tableProbabilities;
+};
+
+#endif // INDICATORDISTRIBUTION_H
@@ -0,0 +1,428 @@
+#include "indicatorkriging.h"
+#include "krigingsolver.h"
+#include "gridcell.h"
+#include "domain/pointset.h"
+#include "domain/cartesiangrid.h"
+#include "domain/variogrammodel.h"
+#include "domain/application.h"
+
+#include <QCoreApplication>
+#include <QProgressDialog>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace {
+
+    /** Same tolerance used in ik3d to detect coincident locations (squared distance). */
+    const double EPSLON = 0.000001;
+
+    /** Kriging matrices with larger condition numbers are deemed singular. */
+    const double MAX_CONDITION_NUMBER = 1.0E15;
+
+}
+
+/** The sample and kriging objects of one estimation thread of IndicatorKriging, reused for all of its cells. */
+struct IndicatorKrigingWorkspace
+{
+    /** The samples of the current cell (data lines, then soft data indexes offset by the number of data lines),
+     * each part in increasing order, and of the previous cell. */
+    std::vector<uint> samples, previousSamples;
+    /** Scratch arrays for the separation vectors (of a matrix column or of the right-hand side) and the covariances. */
+    std::vector<double> dx, dy, dz, covariances;
+    /** The kriging matrix, the right-hand side, the weights and the solver of each distinct variogram model. */
+    std::vector<Eigen::MatrixXd> lhs;
+    std::vector<Eigen::VectorXd> rhs;
+    std::vector<Eigen::VectorXd> weights;
+    std::vector<KrigingSolver> solvers;
+    /** Whether the solvers hold valid factorizations of the matrices of previousSamples. */
+    bool isFactorized;
+};
+
+IndicatorKriging::IndicatorKriging(PointSet *pointSet, CartesianGrid *estimationGrid) :
+    m_pointSet( pointSet ),
+    m_grid( estimationGrid ),
+    m_column( 0 ),
+    m_softData( nullptr ),
+    m_tmin( -1.0e21 ),
+    m_tmax( 1.0e21 ),
+    m_kType( IndicatorKrigingType::OK ),
+    m_unestimatedValue( -9.9999 ),
+    m_nDataLines( 0 )
+{
+}
+
+void IndicatorKriging::setVariable(uint column)
+{
+    m_column = column;
+}
+
+void IndicatorKriging::setSoftIndicators(PointSet *softData, const std::vector<uint> &indicatorColumns)
+{
+    m_softData = softData;
+    m_softIndicatorColumns = indicatorColumns;
+}
+
+void IndicatorKriging::setTrimmingLimits(double tmin, double tmax)
+{
+    m_tmin = tmin;
+    m_tmax = tmax;
+}
+
+void IndicatorKriging::setDistribution(const IndicatorDistribution &distribution)
+{
+    m_distribution = distribution;
+}
+
+void IndicatorKriging::setSearchStrategy(SearchStrategyPtr searchStrategy)
+{
+    m_searchStrategy = searchStrategy;
+}
+
+void IndicatorKriging::setVariogramModels(const std::vector<VariogramModel *> &variogramModels)
+{
+    m_variogramModels = variogramModels;
+}
+
+void IndicatorKriging::setKrigingType(IndicatorKrigingType kType)
+{
+    m_kType = kType;
+}
+
+void IndicatorKriging::setUnestimatedValue(double unestimatedValue)
+{
+    m_unestimatedValue = unestimatedValue;
+}
+
+bool IndicatorKriging::run()
+{
+    uint nThresholds = m_distribution.getThresholdCount();
+    if( ! m_pointSet || ! m_grid || ! m_searchStrategy || m_column < 1 || nThresholds == 0 ){
+        Application::instance()->logError( "IndicatorKriging::run(): the data set, the estimation grid, the variable,"
+                                           " the thresholds and the search strategy must be set.", true );
+        return false;
+    }
+    if( m_variogramModels.size() != 1 && m_variogramModels.size() != nThresholds ){
+        Application::instance()->logError( "IndicatorKriging::run(): there must be either one variogram model per threshold"
+                                           " or a single variogram model (median indicator kriging).", true );
+        return false;
+    }
+    if( m_softData && m_softIndicatorColumns.size() != nThresholds ){
+        Application::instance()->logError( "IndicatorKriging::run(): the soft data must have one indicator per threshold.", true );
+        return false;
+    }
+
+    //compile each distinct variogram model once for all kriging operations.
+    m_variograms.clear();
+    m_thresholdVariograms.clear();
+    std::vector<VariogramModel*> distinctModels;
+    for( uint t = 0; t < nThresholds; ++t ){
+        VariogramModel* model = m_variogramModels[ m_variogramModels.size() == 1 ? 0 : t ];
+        if( ! model ){
+            Application::instance()->logError( "IndicatorKriging::run(): missing variogram model for threshold " +
+                                               QString::number( t + 1 ) + ".", true );
+            return false;
+        }
+        auto it = std::find( distinctModels.begin(), distinctModels.end(), model );
+        if( it == distinctModels.end() ){
+            model->readParameters();
+            distinctModels.push_back( model );
+            m_variograms.push_back( CompiledVariogramModel( model ) );
+            it = distinctModels.end() - 1;
+        }
+        m_thresholdVariograms.push_back( it - distinctModels.begin() );
+    }
+
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    uint nK = m_grid->getNZ();
+    size_t nCells = (size_t)nI * nJ * nK;
+
+    //copy the sample locations and classes, so the threads do not access the data file.
+    //the samples outside the trimming limits (or not of any category) are not indexed, so the searches never find them.
+    m_pointSet->loadData();
+    m_nDataLines = m_pointSet->getDataLineCount();
+    bool is3D = m_pointSet->is3D();
+    m_x.assign( m_nDataLines, 0.0 );
+    m_y.assign( m_nDataLines, 0.0 );
+    m_z.assign( m_nDataLines, m_grid->getZ0() ); //as in ik3d, 2D samples are at the elevation of the grid
+    m_classes.assign( m_nDataLines, -1 );
+    std::vector<uint> validLines;
+    validLines.reserve( m_nDataLines );
+    for( uint iLine = 0; iLine < m_nDataLines; ++iLine ){
+        double value = m_pointSet->data( iLine, m_column - 1 );
+        if( m_pointSet->isNDV( value ) || value < m_tmin || value >= m_tmax )
+            continue;
+        int valueClass = m_distribution.getClass( value );
+        if( valueClass < 0 )
+            continue;
+        m_x[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::X );
+        m_y[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::Y );
+        if( is3D )
+            m_z[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::Z );
+        m_classes[iLine] = valueClass;
+        validLines.push_back( iLine );
+    }
+    m_spatialIndex.fill( m_pointSet, validLines );
+    Application::instance()->logInfo( "IndicatorKriging::run(): " + QString::number( validLines.size() ) + " of " +
+                                      QString::number( m_nDataLines ) + " samples are within the trimming limits"
+                                      + ( m_distribution.isCategorical() ? " and of the categories." : "." ) );
+
+    //the soft data locations follow those of the samples.
+    m_softIndicators.clear();
+    m_softSpatialIndex.clear();
+    if( m_softData ){
+        m_softData->loadData();
+        uint nSoftLines = m_softData->getDataLineCount();
+        bool isSoft3D = m_softData->is3D();
+        m_softIndicators.assign( (size_t)nSoftLines * nThresholds, 0.0 );
+        m_x.resize( m_nDataLines + nSoftLines, 0.0 );
+        m_y.resize( m_nDataLines + nSoftLines, 0.0 );
+        m_z.resize( m_nDataLines + nSoftLines, m_grid->getZ0() );
+        std::vector<uint> validSoftLines;
+        for( uint iLine = 0; iLine < nSoftLines; ++iLine ){
+            bool isValid = true;
+            for( uint t = 0; t < nThresholds && isValid; ++t ){
+                double value = m_softData->data( iLine, m_softIndicatorColumns[t] - 1 );
+                isValid = ! m_softData->isNDV( value ) && value >= 0.0 && value <= 1.0;
+                m_softIndicators[ (size_t)iLine * nThresholds + t ] = value;
+            }
+            if( ! isValid )
+                continue;
+            uint sample = m_nDataLines + iLine;
+            m_x[sample] = m_softData->getDataSpatialLocation( iLine, CartesianCoord::X );
+            m_y[sample] = m_softData->getDataSpatialLocation( iLine, CartesianCoord::Y );
+            if( isSoft3D )
+                m_z[sample] = m_softData->getDataSpatialLocation( iLine, CartesianCoord::Z );
+            validSoftLines.push_back( iLine );
+        }
+        m_softSpatialIndex.fill( m_softData, validSoftLines );
+        Application::instance()->logInfo( "IndicatorKriging::run(): " + QString::number( validSoftLines.size() ) + " of " +
+                                          QString::number( nSoftLines ) + " soft data have all indicators informed." );
+    }
+
+    //the minimum number of samples applies to the samples and the soft data together, so the searches have none.
+    m_dataSearchStrategy.reset( new SearchStrategy( m_searchStrategy->m_searchNB,
+                                                    m_searchStrategy->m_nb_samples,
+                                                    m_searchStrategy->m_minDistanceBetweenSamples, 0 ) );
+
+    m_probabilities.assign( nCells * nThresholds, m_unestimatedValue );
+    bool isContinuous = ! m_distribution.isCategorical();
+    m_means.assign( isContinuous ? nCells : 0, m_unestimatedValue );
+    m_variances.assign( isContinuous ? nCells : 0, m_unestimatedValue );
+
+    unsigned int nRows = nJ * nK;
+    unsigned int nThreads = std::max( 1u, std::min( std::thread::hardware_concurrency(), nRows ) );
+
+    QProgressDialog progressDialog;
+    progressDialog.show();
+    progressDialog.setLabelText("Running indicator kriging...");
+    progressDialog.setMinimum( 0 );
+    progressDialog.setValue( 0 );
+    progressDialog.setMaximum( nRows );
+
+    IndicatorKrigingProgress progressInfo;
+    std::vector<std::thread> threads;
+    for( unsigned int iThread = 0; iThread < nThreads; ++iThread )
+        threads.push_back( std::thread( &IndicatorKriging::estimateRows, this, &progressInfo ) );
+
+    //report progress while the workers run
+    while( progressInfo.nRowsDone < nRows ){
+        int nKriging = progressInfo.nKriging.load();
+        double reusePercent = nKriging ? 100.0 * progressInfo.nReused.load() / nKriging : 0.0;
+        progressDialog.setLabelText("Running indicator kriging:\n" +
+                                    QString::number(nKriging) + " cells with " +
+                                    QString::number(nThresholds) + " thresholds each (" +
+                                    QString::number(reusePercent, 'f', 1) + "% reused neighborhoods, " +
+                                    QString::number(progressInfo.nFailed.load()) + " failed) in " +
+                                    QString::number(nThreads) + " threads. " );
+        progressDialog.setValue( progressInfo.nRowsDone.load() );
+        QCoreApplication::processEvents(); //let Qt repaint widgets
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    }
+
+    for( std::thread& thread : threads )
+        thread.join();
+
+    if( progressInfo.nFailed ){
+        Application::instance()->logWarn( "IndicatorKriging::run(): " + QString::number(progressInfo.nFailed.load()) +
+                                          " kriging operation(s) failed (singular system, NaN or infinity).  Assigned " +
+                                          QString::number(m_unestimatedValue) + " to the cells." );
+    }
+    if( progressInfo.nCorrected ){
+        Application::instance()->logInfo( "IndicatorKriging::run(): the order relations of " +
+                                          QString::number(progressInfo.nCorrected.load()) + " of " +
+                                          QString::number(progressInfo.nKriging.load()) + " estimated cells were corrected." );
+    }
+
+    m_spatialIndex.clear();
+    m_softSpatialIndex.clear();
+
+    return true;
+}
+
+void IndicatorKriging::estimateRows(IndicatorKrigingProgress *progressInfo)
+{
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    uint nRows = nJ * m_grid->getNZ();
+    uint nThresholds = m_distribution.getThresholdCount();
+    bool isContinuous = ! m_distribution.isCategorical();
+
+    //the buffers and the factorizations are reused for all cells estimated by this thread
+    IndicatorKrigingWorkspace workspace;
+    workspace.lhs.resize( m_variograms.size() );
+    workspace.rhs.resize( m_variograms.size() );
+    workspace.weights.resize( m_variograms.size() );
+    workspace.solvers.resize( m_variograms.size() );
+    workspace.isFactorized = false;
+    std::vector<double> probabilities( nThresholds );
+
+    for( uint iRow = progressInfo->nextRow++; iRow < nRows; iRow = progressInfo->nextRow++ ){
+        uint j = iRow % nJ;
+        uint k = iRow / nJ;
+        //the counters are accumulated per row and then merged into the shared ones
+        int nKriging = 0;
+        int nReused = 0;
+        int nFailed = 0;
+        int nCorrected = 0;
+        for( uint i = 0; i < nI; ++i ){
+            size_t iCell = i + (size_t)iRow * nI;
+            if( ! estimateCell( i, j, k, workspace, probabilities.data(), nReused ) )
+                continue;
+            ++nKriging;
+            //rarely, kriging may fail with a NaN or infinity value.  The cell is left unestimated.
+            if( std::any_of( probabilities.begin(), probabilities.end(),
+                             []( double p ){ return std::isnan( p ) || ! std::isfinite( p ); } ) ){
+                ++nFailed;
+                continue;
+            }
+            if( m_distribution.correctOrderRelations( probabilities.data() ) )
+                ++nCorrected;
+            std::copy( probabilities.begin(), probabilities.end(), m_probabilities.begin() + iCell * nThresholds );
+            if( isContinuous )
+                m_distribution.getMeanAndVariance( probabilities.data(), m_means[iCell], m_variances[iCell] );
+        }
+        progressInfo->nKriging += nKriging;
+        progressInfo->nReused += nReused;
+        progressInfo->nFailed += nFailed;
+        progressInfo->nCorrected += nCorrected;
+        ++progressInfo->nRowsDone;
+    }
+}
+
+bool IndicatorKriging::estimateCell(uint i, uint j, uint k, IndicatorKrigingWorkspace &workspace,
+                                    double *probabilities, int &nReused) const
+{
+    GridCell estimationCell( m_grid, -1, i, j, k );
+    const SpatialLocation& center = estimationCell._center;
+    uint nThresholds = m_distribution.getThresholdCount();
+
+    //the samples and the soft data are sorted, so if the previous cell had the same ones,
+    //its factorizations are reused as they are.
+    std::vector<uint>& samples = workspace.samples;
+    QList<uint> samplesIndexes = m_spatialIndex.getNearestWithin( estimationCell, *m_dataSearchStrategy );
+    samples.assign( samplesIndexes.begin(), samplesIndexes.end() );
+    std::sort( samples.begin(), samples.end() );
+    if( ! m_softSpatialIndex.isEmpty() ){
+        size_t nData = samples.size();
+        QList<uint> softIndexes = m_softSpatialIndex.getNearestWithin( estimationCell, *m_dataSearchStrategy );
+        for( uint softLine : softIndexes )
+            samples.push_back( m_nDataLines + softLine );
+        std::sort( samples.begin() + nData, samples.end() );
+    }
+    int n = samples.size();
+    if( n == 0 || n < (int)m_searchStrategy->m_minNumberOfSamples )
+        return false;
+    bool isOrdinaryKriging = m_kType == IndicatorKrigingType::OK;
+
+    workspace.dx.resize( n );
+    workspace.dy.resize( n );
+    workspace.dz.resize( n );
+    workspace.covariances.resize( n );
+    double* dx = workspace.dx.data();
+    double* dy = workspace.dy.data();
+    double* dz = workspace.dz.data();
+    double* covariances = workspace.covariances.data();
+    size_t nVariograms = m_variograms.size();
+
+    if( workspace.isFactorized && samples == workspace.previousSamples )
+        ++nReused;
+    else {
+        workspace.previousSamples = samples;
+        workspace.isFactorized = false;
+        for( size_t v = 0; v < nVariograms; ++v )
+            workspace.lhs[v].resize( n, n );
+        //the upper part of column j2 is evaluated in a single batch for each variogram model, then mirrored.
+        //the separation vectors are shared by all models.
+        for( int j2 = 0; j2 < n; ++j2 ){
+            uint sampleJ = samples[j2];
+            for( int i2 = 0; i2 <= j2; ++i2 ){
+                uint sampleI = samples[i2];
+                dx[i2] = m_x[sampleJ] - m_x[sampleI];
+                dy[i2] = m_y[sampleJ] - m_y[sampleI];
+                dz[i2] = m_z[sampleJ] - m_z[sampleI];
+            }
+            for( size_t v = 0; v < nVariograms; ++v ){
+                const CompiledVariogramModel& variogram = m_variograms[v];
+                Eigen::MatrixXd& lhs = workspace.lhs[v];
+                variogram.covariance( dx, dy, dz, j2 + 1, covariances );
+                for( int i2 = 0; i2 <= j2; ++i2 ){
+                    if( dx[i2]*dx[i2] + dy[i2]*dy[i2] + dz[i2]*dz[i2] < EPSLON )
+                        covariances[i2] = variogram.getSill();
+                    lhs( i2, j2 ) = covariances[i2];
+                    lhs( j2, i2 ) = covariances[i2];
+                }
+            }
+        }
+        //a singular matrix (e.g. duplicate samples) is reported as a failed kriging.
+        for( size_t v = 0; v < nVariograms; ++v ){
+            KrigingSolver& solver = workspace.solvers[v];
+            if( ! solver.factorizeCovariances( workspace.lhs[v] ) || solver.isIllConditioned( MAX_CONDITION_NUMBER ) ){
+                std::fill( probabilities, probabilities + nThresholds, std::numeric_limits<double>::quiet_NaN() );
+                return true;
+            }
+        }
+        workspace.isFactorized = true;
+    }
+
+    //the right-hand sides and the weights, once per variogram model.
+    for( int i2 = 0; i2 < n; ++i2 ){
+        uint sample = samples[i2];
+        dx[i2] = center._x - m_x[sample];
+        dy[i2] = center._y - m_y[sample];
+        dz[i2] = center._z - m_z[sample];
+    }
+    for( size_t v = 0; v < nVariograms; ++v ){
+        const CompiledVariogramModel& variogram = m_variograms[v];
+        Eigen::VectorXd& rhs = workspace.rhs[v];
+        rhs.resize( n );
+        variogram.covariance( dx, dy, dz, n, covariances );
+        for( int i2 = 0; i2 < n; ++i2 )
+            rhs[i2] = ( dx[i2]*dx[i2] + dy[i2]*dy[i2] + dz[i2]*dz[i2] < EPSLON ) ? variogram.getSill() : covariances[i2];
+        if( isOrdinaryKriging )
+            workspace.solvers[v].solveConstrained( rhs, 1.0, workspace.weights[v] );
+        else
+            workspace.solvers[v].solve( rhs, workspace.weights[v] );
+    }
+
+    //the simple kriging weights apply to the residuals of the global probabilities.
+    for( uint t = 0; t < nThresholds; ++t ){
+        const Eigen::VectorXd& weights = workspace.weights[ m_thresholdVariograms[t] ];
+        double mean = isOrdinaryKriging ? 0.0 : m_distribution.getGlobalProbability( t );
+        double estimate = mean;
+        for( int i2 = 0; i2 < n; ++i2 )
+            estimate += weights[i2] * ( indicator( samples[i2], t ) - mean );
+        probabilities[t] = estimate;
+    }
+    return true;
+}
+
+double IndicatorKriging::indicator(uint sample, uint threshold) const
+{
+    if( sample < m_nDataLines )
+        return m_distribution.getIndicator( m_classes[sample], threshold );
+    return m_softIndicators[ (size_t)( sample - m_nDataLines ) * m_distribution.getThresholdCount() + threshold ];
+}
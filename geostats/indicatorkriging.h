@@ -0,0 +1,140 @@
+#ifndef INDICATORKRIGING_H
+#define INDICATORKRIGING_H
+
+#include "searchstrategy.h"
+#include "compiledvariogrammodel.h"
+#include "indicatordistribution.h"
+#include "spatialindex/spatialindexpoints.h"
+#include <atomic>
+#include <vector>
+
+class PointSet;
+class CartesianGrid;
+class VariogramModel;
+struct IndicatorKrigingWorkspace;
+
+/** The kriging types of IndicatorKriging (the same codes of GSLIB's ik3d). */
+enum class IndicatorKrigingType : int {
+    SK = 0,  /*!< Simple kriging with the global probabilities as means. */
+    OK       /*!< Ordinary kriging. */
+};
+
+/** Work distribution and counters shared by the threads of IndicatorKriging. */
+struct IndicatorKrigingProgress
+{
+    IndicatorKrigingProgress() : nextRow(0), nRowsDone(0), nKriging(0), nReused(0), nFailed(0), nCorrected(0) {}
+    std::atomic<unsigned int> nextRow;
+    std::atomic<unsigned int> nRowsDone;
+    std::atomic<int> nKriging;
+    /** Number of kriging operations that reused the factorized matrices of the previous cell. */
+    std::atomic<int> nReused;
+    std::atomic<int> nFailed;
+    /** Number of cells whose order relations were corrected. */
+    std::atomic<int> nCorrected;
+};
+
+/**
+ * The IndicatorKriging class estimates the conditional distributions of a continuous or categorical variable at the
+ * cells of a Cartesian grid from point set samples in process, as an alternative to running GSLIB's ik3d program in
+ * grid mode followed by postik.  All the thresholds (or categories) of a cell are estimated in one pass: the samples
+ * are searched once, the separation vectors are computed once and each distinct variogram model has its kriging
+ * matrix factorized and its weights solved once for all the thresholds using it (median indicator kriging factorizes a
+ * single matrix per cell).  The order relations are corrected as in ik3d and, for continuous variables, the E-type
+ * estimates and the conditional variances are computed from the corrected distributions (as postik).
+ * The grid rows are divided among as many threads as there are processor cores.  Each thread keeps the
+ * factorizations of its last cell and reuses them if the next cell has the same samples.
+ */
+class IndicatorKriging
+{
+public:
+    /**
+     * @param pointSet The point set with the samples.
+     * @param estimationGrid The grid whose cells are estimated.
+     */
+    IndicatorKriging( PointSet* pointSet, CartesianGrid* estimationGrid );
+
+    //@{
+    /** Set the estimation parameters (see GSLIB's ik3d documentation). */
+    /** The GEO-EAS index (first is 1) of the variable in the point set. */
+    void setVariable( uint column );
+    /** The point set with soft indicator data and the GEO-EAS indexes of its indicator columns, one per threshold.
+     * The soft data are searched apart from the samples, with the same search strategy.  Those with any indicator
+     * uninformed or out of [0, 1] are ignored. */
+    void setSoftIndicators( PointSet* softData, const std::vector<uint>& indicatorColumns );
+    void setTrimmingLimits( double tmin, double tmax );
+    /** The thresholds (or categories), the global probabilities and, for continuous variables, how values
+     * are interpolated within the classes for the E-type estimates. */
+    void setDistribution( const IndicatorDistribution& distribution );
+    void setSearchStrategy( SearchStrategyPtr searchStrategy );
+    /** The variogram models of the indicators, one per threshold, or a single model for all thresholds (median
+     * indicator kriging).  Thresholds with the same model object share the kriging matrix. */
+    void setVariogramModels( const std::vector<VariogramModel*>& variogramModels );
+    void setKrigingType( IndicatorKrigingType kType );
+    /** The value assigned to the cells that could not be estimated (e.g. too few samples). */
+    void setUnestimatedValue( double unestimatedValue );
+    //@}
+
+    /** Estimates the grid cells, showing a progress dialog.
+     * @return False if the parameters are invalid (the reason is logged as an error).
+     */
+    bool run();
+
+    /** Returns the probabilities (cumulative for continuous variables) computed by run(), with the order relations
+     * corrected: the values of all thresholds of the first cell, then those of the second cell and so on, the cells
+     * in the GEO-EAS grid scan order. */
+    const std::vector<double>& getProbabilities() const { return m_probabilities; }
+
+    /** Returns the E-type estimates computed by run() for continuous variables, in the GEO-EAS grid scan order. */
+    const std::vector<double>& getMeans() const { return m_means; }
+
+    /** Returns the conditional variances computed by run() for continuous variables, in the GEO-EAS grid scan order. */
+    const std::vector<double>& getVariances() const { return m_variances; }
+
+private:
+    /** Estimates the grid rows (cells along I) taken from progressInfo->nextRow until all rows are
+     * processed.  Runs in several threads at once, each writing the results of the rows it takes. */
+    void estimateRows( IndicatorKrigingProgress* progressInfo );
+
+    /** Estimates the probabilities of one cell.  Returns false if the cell cannot be estimated (too few samples).
+     * The probabilities are NaN if a kriging system could not be solved. */
+    bool estimateCell( uint i, uint j, uint k, IndicatorKrigingWorkspace& workspace,
+                       double* probabilities, int& nReused ) const;
+
+    /** Returns the indicator of a sample (a datum or a soft datum) for a threshold. */
+    double indicator( uint sample, uint threshold ) const;
+
+    PointSet* m_pointSet;
+    CartesianGrid* m_grid;
+    uint m_column;
+    PointSet* m_softData;
+    std::vector<uint> m_softIndicatorColumns;
+    double m_tmin, m_tmax;
+    IndicatorDistribution m_distribution;
+    SearchStrategyPtr m_searchStrategy;
+    std::vector<VariogramModel*> m_variogramModels;
+    IndicatorKrigingType m_kType;
+    double m_unestimatedValue;
+
+    //@{
+    /** Data prepared by run() before starting the threads. */
+    /** The distinct variogram models and the index of the model of each threshold. */
+    std::vector<CompiledVariogramModel> m_variograms;
+    std::vector<uint> m_thresholdVariograms;
+    /** The samples and the soft data, searched apart with a minimum of zero samples (the minimum applies to both). */
+    SpatialIndexPoints m_spatialIndex, m_softSpatialIndex;
+    SearchStrategyPtr m_dataSearchStrategy;
+    /** Sample coordinates by data line, followed by those of the soft data (from m_nDataLines on). */
+    std::vector<double> m_x, m_y, m_z;
+    uint m_nDataLines;
+    /** The classes of the samples (see IndicatorDistribution::getClass()) by data line. */
+    std::vector<int> m_classes;
+    /** The indicators of the soft data, all thresholds of a soft datum together. */
+    std::vector<double> m_softIndicators;
+    //@}
+
+    std::vector<double> m_probabilities;
+    std::vector<double> m_means;
+    std::vector<double> m_variances;
+};
+
+#endif // INDICATORKRIGING_H
@@ -0,0 +1,486 @@
+#include "krigingestimation.h"
+#include "krigingsolver.h"
+#include "gridcell.h"
+#include "domain/pointset.h"
+#include "domain/cartesiangrid.h"
+#include "domain/variogrammodel.h"
+#include "domain/application.h"
+
+#include <QCoreApplication>
+#include <QProgressDialog>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace {
+
+    /** Same tolerance used in kt3d to detect coincident locations (squared distance). */
+    const double EPSLON = 0.000001;
+
+    /** Kriging matrices with larger condition numbers are deemed singular. */
+    const double MAX_CONDITION_NUMBER = 1.0E15;
+
+}
+
+/** The sample and kriging objects of one estimation thread of KrigingEstimation, reused for all of its cells. */
+struct KrigingEstimationWorkspace
+{
+    /** The data lines of the samples of the current cell, in increasing order, and of the previous cell. */
+    std::vector<uint> samples, previousSamples;
+    /** Scratch arrays for the separation vectors and the covariances of a matrix column. */
+    std::vector<double> dx, dy, dz, covariances;
+    /** The kriging matrix (bordered with the drift functions, if any) and its right-hand side. */
+    Eigen::MatrixXd lhs;
+    Eigen::VectorXd rhs;
+    Eigen::VectorXd weights;
+    /** The drift functions at one location. */
+    std::vector<double> drifts;
+    KrigingSolver solver;
+    /** Whether the solver holds a valid factorization of the matrix of previousSamples. */
+    bool isFactorized;
+};
+
+KrigingEstimation::KrigingEstimation(PointSet *pointSet, CartesianGrid *estimationGrid) :
+    m_pointSet( pointSet ),
+    m_grid( estimationGrid ),
+    m_column( 0 ),
+    m_secondaryColumn( 0 ),
+    m_secondaryGrid( nullptr ),
+    m_secondaryGridColumn( 0 ),
+    m_tmin( -1.0e21 ),
+    m_tmax( 1.0e21 ),
+    m_variogramModel( nullptr ),
+    m_kType( KrigingEstimationType::OK ),
+    m_meanSK( 0.0 ),
+    m_driftTerms( 9, false ),
+    m_estimateTrend( false ),
+    m_nDiscretizationX( 1 ),
+    m_nDiscretizationY( 1 ),
+    m_nDiscretizationZ( 1 ),
+    m_unestimatedValue( -999.0 ),
+    m_blockCovariance( 0.0 ),
+    m_nDrifts( 0 ),
+    m_driftScale( 1.0 )
+{
+}
+
+void KrigingEstimation::setVariable(uint column)
+{
+    m_column = column;
+}
+
+void KrigingEstimation::setSecondaryVariable(uint column, CartesianGrid *secondaryGrid, uint secondaryGridColumn)
+{
+    m_secondaryColumn = column;
+    m_secondaryGrid = secondaryGrid;
+    m_secondaryGridColumn = secondaryGridColumn;
+}
+
+void KrigingEstimation::setTrimmingLimits(double tmin, double tmax)
+{
+    m_tmin = tmin;
+    m_tmax = tmax;
+}
+
+void KrigingEstimation::setSearchStrategy(SearchStrategyPtr searchStrategy)
+{
+    m_searchStrategy = searchStrategy;
+}
+
+void KrigingEstimation::setVariogramModel(VariogramModel *variogramModel)
+{
+    m_variogramModel = variogramModel;
+}
+
+void KrigingEstimation::setKrigingType(KrigingEstimationType kType, double meanSK)
+{
+    m_kType = kType;
+    m_meanSK = meanSK;
+}
+
+void KrigingEstimation::setDriftTerms(const std::vector<bool> &driftTerms)
+{
+    m_driftTerms = driftTerms;
+    m_driftTerms.resize( 9, false );
+}
+
+void KrigingEstimation::setEstimateTrend(bool estimateTrend)
+{
+    m_estimateTrend = estimateTrend;
+}
+
+void KrigingEstimation::setBlockDiscretization(uint nX, uint nY, uint nZ)
+{
+    m_nDiscretizationX = std::max( 1u, nX );
+    m_nDiscretizationY = std::max( 1u, nY );
+    m_nDiscretizationZ = std::max( 1u, nZ );
+}
+
+void KrigingEstimation::setUnestimatedValue(double unestimatedValue)
+{
+    m_unestimatedValue = unestimatedValue;
+}
+
+bool KrigingEstimation::run()
+{
+    if( ! m_pointSet || ! m_grid || ! m_variogramModel || ! m_searchStrategy || m_column < 1 ){
+        Application::instance()->logError( "KrigingEstimation::run(): the data set, the estimation grid, the variable,"
+                                           " the variogram model and the search strategy must be set.", true );
+        return false;
+    }
+    bool usesSecondary = m_kType == KrigingEstimationType::LVM || m_kType == KrigingEstimationType::KED;
+    if( usesSecondary && ( m_secondaryColumn < 1 || ! m_secondaryGrid || m_secondaryGridColumn < 1 ) ){
+        Application::instance()->logError( "KrigingEstimation::run(): kriging with a locally varying mean or with an"
+                                           " external drift requires the secondary variable in the data set and in a grid.", true );
+        return false;
+    }
+
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    uint nK = m_grid->getNZ();
+    size_t nCells = (size_t)nI * nJ * nK;
+
+    //copy the sample locations and values, so the threads do not access the data file.
+    //the samples outside the trimming limits (or without the secondary value, if it is used) are not indexed,
+    //so the searches never find them.
+    m_pointSet->loadData();
+    uint nData = m_pointSet->getDataLineCount();
+    bool is3D = m_pointSet->is3D();
+    m_x.assign( nData, 0.0 );
+    m_y.assign( nData, 0.0 );
+    m_z.assign( nData, m_grid->getZ0() ); //as in kt3d, 2D samples are at the elevation of the grid
+    m_values.assign( nData, 0.0 );
+    m_secondaryValues.assign( nData, 0.0 );
+    std::vector<uint> validLines;
+    validLines.reserve( nData );
+    for( uint iLine = 0; iLine < nData; ++iLine ){
+        double value = m_pointSet->data( iLine, m_column - 1 );
+        if( m_pointSet->isNDV( value ) || value < m_tmin || value >= m_tmax )
+            continue;
+        if( usesSecondary ){
+            double secondaryValue = m_pointSet->data( iLine, m_secondaryColumn - 1 );
+            if( m_pointSet->isNDV( secondaryValue ) )
+                continue;
+            m_secondaryValues[iLine] = secondaryValue;
+        }
+        m_x[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::X );
+        m_y[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::Y );
+        if( is3D )
+            m_z[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::Z );
+        m_values[iLine] = value;
+        validLines.push_back( iLine );
+    }
+    m_spatialIndex.fill( m_pointSet, validLines );
+    Application::instance()->logInfo( "KrigingEstimation::run(): " + QString::number( validLines.size() ) + " of " +
+                                      QString::number( nData ) + " samples are within the trimming limits." );
+
+    //the secondary values at the cells (NaN if uninformed)
+    m_secondaryGridValues.clear();
+    if( usesSecondary ){
+        m_secondaryGrid->loadData();
+        if( m_secondaryGrid->getNX() != nI || m_secondaryGrid->getNY() != nJ || m_secondaryGrid->getNZ() != nK ){
+            Application::instance()->logError( "KrigingEstimation::run(): the grid with the secondary variable must have"
+                                               " the same cells as the estimation grid.", true );
+            return false;
+        }
+        m_secondaryGridValues.resize( nCells );
+        for( uint k = 0; k < nK; ++k )
+            for( uint j = 0; j < nJ; ++j )
+                for( uint i = 0; i < nI; ++i ){
+                    double value = m_secondaryGrid->dataIJK( m_secondaryGridColumn - 1, i, j, k );
+                    if( m_secondaryGrid->isNDV( value ) )
+                        value = std::numeric_limits<double>::quiet_NaN();
+                    m_secondaryGridValues[ i + ( j + (size_t)k * nJ ) * nI ] = value;
+                }
+    }
+
+    //compile the variogram model once for all kriging operations.
+    m_variogramModel->readParameters();
+    m_variogram = CompiledVariogramModel( m_variogramModel );
+
+    //the block discretization points are at the centers of equal parts of the cell along each axis
+    m_blockX.clear();
+    m_blockY.clear();
+    m_blockZ.clear();
+    for( uint iz = 0; iz < m_nDiscretizationZ; ++iz )
+        for( uint iy = 0; iy < m_nDiscretizationY; ++iy )
+            for( uint ix = 0; ix < m_nDiscretizationX; ++ix ){
+                m_blockX.push_back( m_grid->getDX() * ( ( ix + 0.5 ) / m_nDiscretizationX - 0.5 ) );
+                m_blockY.push_back( m_grid->getDY() * ( ( iy + 0.5 ) / m_nDiscretizationY - 0.5 ) );
+                m_blockZ.push_back( m_grid->getDZ() * ( ( iz + 0.5 ) / m_nDiscretizationZ - 0.5 ) );
+            }
+
+    //the average covariance within a block (the nugget effect does not apply to the point to itself terms,
+    //unless it is point kriging).
+    size_t nBlockPoints = m_blockX.size();
+    if( nBlockPoints == 1 )
+        m_blockCovariance = m_variogram.getSill();
+    else {
+        m_blockCovariance = 0.0;
+        for( size_t d1 = 0; d1 < nBlockPoints; ++d1 )
+            for( size_t d2 = 0; d2 < nBlockPoints; ++d2 ){
+                m_blockCovariance += covariance( m_blockX[d2] - m_blockX[d1],
+                                                 m_blockY[d2] - m_blockY[d1],
+                                                 m_blockZ[d2] - m_blockZ[d1] );
+                if( d1 == d2 )
+                    m_blockCovariance -= m_variogram.getNugget();
+            }
+        m_blockCovariance /= nBlockPoints * nBlockPoints;
+    }
+
+    //the unbiasedness condition (OK and KED), the polynomial drift terms and the external drift (KED).
+    m_nDrifts = ( m_kType == KrigingEstimationType::OK || m_kType == KrigingEstimationType::KED ) ? 1 : 0;
+    m_nDrifts += std::count( m_driftTerms.begin(), m_driftTerms.end(), true );
+    if( m_kType == KrigingEstimationType::KED )
+        ++m_nDrifts;
+    m_driftScale = 1.0 / m_searchStrategy->m_searchNB->getMinDistanceScale();
+
+    m_estimates.assign( nCells, m_unestimatedValue );
+    m_krigingVariances.assign( nCells, m_unestimatedValue );
+
+    unsigned int nRows = nJ * nK;
+    unsigned int nThreads = std::max( 1u, std::min( std::thread::hardware_concurrency(), nRows ) );
+
+    QProgressDialog progressDialog;
+    progressDialog.show();
+    progressDialog.setLabelText("Running kriging...");
+    progressDialog.setMinimum( 0 );
+    progressDialog.setValue( 0 );
+    progressDialog.setMaximum( nRows );
+
+    KrigingEstimationProgress progressInfo;
+    std::vector<std::thread> threads;
+    for( unsigned int iThread = 0; iThread < nThreads; ++iThread )
+        threads.push_back( std::thread( &KrigingEstimation::estimateRows, this, &progressInfo ) );
+
+    //report progress while the workers run
+    while( progressInfo.nRowsDone < nRows ){
+        int nKriging = progressInfo.nKriging.load();
+        double reusePercent = nKriging ? 100.0 * progressInfo.nReused.load() / nKriging : 0.0;
+        progressDialog.setLabelText("Running kriging:\n" +
+                                    QString::number(nKriging) + " kriging operations (" +
+                                    QString::number(reusePercent, 'f', 1) + "% reused neighborhoods, " +
+                                    QString::number(progressInfo.nFailed.load()) + " failed) in " +
+                                    QString::number(nThreads) + " threads. " );
+        progressDialog.setValue( progressInfo.nRowsDone.load() );
+        QCoreApplication::processEvents(); //let Qt repaint widgets
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    }
+
+    for( std::thread& thread : threads )
+        thread.join();
+
+    if( progressInfo.nFailed ){
+        Application::instance()->logWarn( "KrigingEstimation::run(): " + QString::number(progressInfo.nFailed.load()) +
+                                          " kriging operation(s) failed (singular system, NaN or infinity).  Assigned " +
+                                          QString::number(m_unestimatedValue) + " to the cells." );
+    }
+
+    m_spatialIndex.clear();
+
+    return true;
+}
+
+void KrigingEstimation::estimateRows(KrigingEstimationProgress *progressInfo)
+{
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    uint nRows = nJ * m_grid->getNZ();
+
+    //the buffers and the factorization are reused for all cells estimated by this thread
+    KrigingEstimationWorkspace workspace;
+    workspace.drifts.resize( m_nDrifts );
+    workspace.isFactorized = false;
+
+    for( uint iRow = progressInfo->nextRow++; iRow < nRows; iRow = progressInfo->nextRow++ ){
+        uint j = iRow % nJ;
+        uint k = iRow / nJ;
+        //the counters are accumulated per row and then merged into the shared ones
+        int nKriging = 0;
+        int nReused = 0;
+        int nFailed = 0;
+        for( uint i = 0; i < nI; ++i ){
+            size_t iCell = i + (size_t)iRow * nI;
+            double estimate, krigingVariance;
+            if( ! estimateCell( i, j, k, workspace, estimate, krigingVariance, nReused ) )
+                continue;
+            ++nKriging;
+            //rarely, kriging may fail with a NaN or infinity value.  The cell is left unestimated.
+            if( std::isnan( estimate ) || ! std::isfinite( estimate ) ||
+                std::isnan( krigingVariance ) || ! std::isfinite( krigingVariance ) )
+                ++nFailed;
+            else {
+                m_estimates[iCell] = estimate;
+                m_krigingVariances[iCell] = krigingVariance;
+            }
+        }
+        progressInfo->nKriging += nKriging;
+        progressInfo->nReused += nReused;
+        progressInfo->nFailed += nFailed;
+        ++progressInfo->nRowsDone;
+    }
+}
+
+bool KrigingEstimation::estimateCell(uint i, uint j, uint k, KrigingEstimationWorkspace &workspace,
+                                     double &estimate, double &krigingVariance, int &nReused) const
+{
+    GridCell estimationCell( m_grid, -1, i, j, k );
+    const SpatialLocation& center = estimationCell._center;
+    double secondaryAtCell = 0.0;
+    if( ! m_secondaryGridValues.empty() ){
+        secondaryAtCell = m_secondaryGridValues[ i + ( j + (size_t)k * m_grid->getNY() ) * m_grid->getNX() ];
+        if( std::isnan( secondaryAtCell ) )
+            return false;
+    }
+
+    //the samples are sorted, so if the previous cell had the same samples, its factorization is reused as is.
+    QList<uint> samplesIndexes = m_spatialIndex.getNearestWithin( estimationCell, *m_searchStrategy );
+    std::vector<uint>& samples = workspace.samples;
+    samples.assign( samplesIndexes.begin(), samplesIndexes.end() );
+    std::sort( samples.begin(), samples.end() );
+    int n = samples.size();
+    //with fewer samples than drift functions, the kriging system is singular.
+    if( n == 0 || n < m_nDrifts )
+        return false;
+    int nEquations = n + m_nDrifts;
+    bool isOrdinaryKriging = m_nDrifts == 1 && m_kType == KrigingEstimationType::OK;
+    bool isBordered = m_nDrifts > 0 && ! isOrdinaryKriging;
+
+    workspace.dx.resize( n );
+    workspace.dy.resize( n );
+    workspace.dz.resize( n );
+    workspace.covariances.resize( n );
+    double* dx = workspace.dx.data();
+    double* dy = workspace.dy.data();
+    double* dz = workspace.dz.data();
+    double* covariances = workspace.covariances.data();
+
+    if( workspace.isFactorized && samples == workspace.previousSamples )
+        ++nReused;
+    else {
+        workspace.previousSamples = samples;
+        workspace.isFactorized = false;
+        Eigen::MatrixXd& lhs = workspace.lhs;
+        lhs.resize( isBordered ? nEquations : n, isBordered ? nEquations : n );
+        //the upper part of column j2 is evaluated in a single batch, then mirrored.
+        for( int j2 = 0; j2 < n; ++j2 ){
+            uint sampleJ = samples[j2];
+            for( int i2 = 0; i2 <= j2; ++i2 ){
+                uint sampleI = samples[i2];
+                dx[i2] = m_x[sampleJ] - m_x[sampleI];
+                dy[i2] = m_y[sampleJ] - m_y[sampleI];
+                dz[i2] = m_z[sampleJ] - m_z[sampleI];
+            }
+            m_variogram.covariance( dx, dy, dz, j2 + 1, covariances );
+            for( int i2 = 0; i2 <= j2; ++i2 ){
+                if( dx[i2]*dx[i2] + dy[i2]*dy[i2] + dz[i2]*dz[i2] < EPSLON )
+                    covariances[i2] = m_variogram.getSill();
+                lhs( i2, j2 ) = covariances[i2];
+                lhs( j2, i2 ) = covariances[i2];
+            }
+        }
+        //border the matrix with the drift functions at the samples.
+        if( isBordered ){
+            for( int i2 = 0; i2 < n; ++i2 ){
+                uint sample = samples[i2];
+                evaluateDrifts( m_x[sample], m_y[sample], m_z[sample], m_secondaryValues[sample], workspace.drifts.data() );
+                for( int l = 0; l < m_nDrifts; ++l ){
+                    lhs( i2, n + l ) = workspace.drifts[l];
+                    lhs( n + l, i2 ) = workspace.drifts[l];
+                }
+            }
+            lhs.bottomRightCorner( m_nDrifts, m_nDrifts ).setZero();
+        }
+        bool isFactorized = isBordered ? workspace.solver.factorizeGeneral( lhs ) :
+                                         workspace.solver.factorizeCovariances( lhs );
+        //a singular matrix (e.g. duplicate samples or samples aligned with a drift term) is reported as a failed kriging.
+        if( ! isFactorized || workspace.solver.isIllConditioned( MAX_CONDITION_NUMBER ) ){
+            estimate = std::numeric_limits<double>::quiet_NaN();
+            krigingVariance = estimate;
+            return true;
+        }
+        workspace.isFactorized = true;
+    }
+
+    //the right-hand side: the average covariances between the samples and the block discretization points.
+    //As in kt3d, the nugget effect does not apply to samples coinciding with a discretization point of a block.
+    Eigen::VectorXd& rhs = workspace.rhs;
+    rhs.setZero( isBordered ? nEquations : n );
+    size_t nBlockPoints = m_blockX.size();
+    double coincidentCovariance = m_variogram.getSill() - ( nBlockPoints > 1 ? m_variogram.getNugget() : 0.0 );
+    if( ! m_estimateTrend ){
+        for( size_t d = 0; d < nBlockPoints; ++d ){
+            for( int i2 = 0; i2 < n; ++i2 ){
+                uint sample = samples[i2];
+                dx[i2] = center._x + m_blockX[d] - m_x[sample];
+                dy[i2] = center._y + m_blockY[d] - m_y[sample];
+                dz[i2] = center._z + m_blockZ[d] - m_z[sample];
+            }
+            m_variogram.covariance( dx, dy, dz, n, covariances );
+            for( int i2 = 0; i2 < n; ++i2 )
+                rhs[i2] += ( dx[i2]*dx[i2] + dy[i2]*dy[i2] + dz[i2]*dz[i2] < EPSLON ) ? coincidentCovariance : covariances[i2];
+        }
+        rhs.head( n ) /= nBlockPoints;
+    }
+    //the drift functions averaged over the block.
+    if( isBordered ){
+        for( size_t d = 0; d < nBlockPoints; ++d ){
+            evaluateDrifts( center._x + m_blockX[d], center._y + m_blockY[d], center._z + m_blockZ[d],
+                            secondaryAtCell, workspace.drifts.data() );
+            for( int l = 0; l < m_nDrifts; ++l )
+                rhs[n + l] += workspace.drifts[l];
+        }
+        rhs.tail( m_nDrifts ) /= nBlockPoints;
+    }
+
+    //the simple kriging weights apply to the residuals of the (global or local) mean.
+    double meanAtCell = 0.0;
+    Eigen::VectorXd& weights = workspace.weights;
+    if( isOrdinaryKriging ){
+        double mu = workspace.solver.solveConstrained( rhs, 1.0, weights );
+        krigingVariance = m_blockCovariance - weights.dot( rhs ) - mu;
+    } else {
+        workspace.solver.solve( rhs, weights );
+        krigingVariance = m_blockCovariance - weights.dot( rhs );
+        if( m_kType == KrigingEstimationType::SK )
+            meanAtCell = m_meanSK;
+        else if( m_kType == KrigingEstimationType::LVM )
+            meanAtCell = secondaryAtCell;
+    }
+    estimate = meanAtCell;
+    for( int i2 = 0; i2 < n; ++i2 ){
+        uint sample = samples[i2];
+        double meanAtSample = m_meanSK;
+        if( m_kType == KrigingEstimationType::LVM )
+            meanAtSample = m_secondaryValues[sample];
+        else if( m_kType != KrigingEstimationType::SK )
+            meanAtSample = 0.0;
+        estimate += weights[i2] * ( m_values[sample] - meanAtSample );
+    }
+    return true;
+}
+
+double KrigingEstimation::covariance(double dx, double dy, double dz) const
+{
+    if( dx*dx + dy*dy + dz*dz < EPSLON )
+        return m_variogram.getSill();
+    return m_variogram.getSill() - m_variogram.gamma( dx, dy, dz );
+}
+
+void KrigingEstimation::evaluateDrifts(double x, double y, double z, double externalDrift, double *drifts) const
+{
+    int l = 0;
+    if( m_kType == KrigingEstimationType::OK || m_kType == KrigingEstimationType::KED )
+        drifts[l++] = 1.0;
+    double xs = ( x - m_grid->getX0() ) / m_driftScale;
+    double ys = ( y - m_grid->getY0() ) / m_driftScale;
+    double zs = ( z - m_grid->getZ0() ) / m_driftScale;
+    const double terms[9] = { xs, ys, zs, xs*xs, ys*ys, zs*zs, xs*ys, xs*zs, ys*zs };
+    for( int iTerm = 0; iTerm < 9; ++iTerm )
+        if( m_driftTerms[iTerm] )
+            drifts[l++] = terms[iTerm];
+    if( m_kType == KrigingEstimationType::KED )
+        drifts[l++] = externalDrift;
+}
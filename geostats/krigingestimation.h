@@ -0,0 +1,142 @@
+#ifndef KRIGINGESTIMATION_H
+#define KRIGINGESTIMATION_H
+
+#include "searchstrategy.h"
+#include "compiledvariogrammodel.h"
+#include "spatialindex/spatialindexpoints.h"
+#include <atomic>
+#include <vector>
+
+class PointSet;
+class CartesianGrid;
+class VariogramModel;
+struct KrigingEstimationWorkspace;
+
+/** The kriging types of KrigingEstimation (the same codes of GSLIB's kt3d). */
+enum class KrigingEstimationType : int {
+    SK = 0,  /*!< Simple kriging with a global mean. */
+    OK,      /*!< Ordinary kriging. */
+    LVM,     /*!< Simple kriging with a locally varying mean (given by the secondary variable). */
+    KED      /*!< Kriging with an external drift (given by the secondary variable). */
+};
+
+/** Work distribution and counters shared by the threads of KrigingEstimation. */
+struct KrigingEstimationProgress
+{
+    KrigingEstimationProgress() : nextRow(0), nRowsDone(0), nKriging(0), nReused(0), nFailed(0) {}
+    std::atomic<unsigned int> nextRow;
+    std::atomic<unsigned int> nRowsDone;
+    std::atomic<int> nKriging;
+    /** Number of kriging operations that reused the factorized matrix of the previous cell. */
+    std::atomic<int> nReused;
+    std::atomic<int> nFailed;
+};
+
+/**
+ * The KrigingEstimation class estimates the cells of a Cartesian grid from point set samples in process, as an
+ * alternative to running GSLIB's kt3d program in grid mode.  It follows kt3d's formulation: covariances
+ * are the total sill minus the variogram (the total sill at zero distance), the cells may be estimated as blocks
+ * discretized into points, the polynomial drift terms (kriging with a trend) may be added to any kriging
+ * type, the trend itself may be estimated instead of the variable and the results are the estimates and the
+ * kriging variances.  The samples are searched with a k-d tree of only the samples within the trimming limits.
+ * The grid rows are divided among as many threads as there are processor cores.  Each thread keeps the
+ * factorization of the kriging matrix of its last cell and reuses it if the next cell has the same samples.
+ */
+class KrigingEstimation
+{
+public:
+    /**
+     * @param pointSet The point set with the samples.
+     * @param estimationGrid The grid whose cells are estimated.
+     */
+    KrigingEstimation( PointSet* pointSet, CartesianGrid* estimationGrid );
+
+    //@{
+    /** Set the estimation parameters (see GSLIB's kt3d documentation). */
+    /** The GEO-EAS index (first is 1) of the variable in the point set. */
+    void setVariable( uint column );
+    /** The GEO-EAS index of the local mean (LVM) or of the external drift (KED) in the point set and in the
+     * grid with its values at the estimation cells, which must have the same cells as the estimation grid. */
+    void setSecondaryVariable( uint column, CartesianGrid* secondaryGrid, uint secondaryGridColumn );
+    void setTrimmingLimits( double tmin, double tmax );
+    void setSearchStrategy( SearchStrategyPtr searchStrategy );
+    void setVariogramModel( VariogramModel* variogramModel );
+    /** @param meanSK The global mean, used only in simple kriging. */
+    void setKrigingType( KrigingEstimationType kType, double meanSK );
+    /** Which polynomial drift terms to use (the same order of kt3d): x, y, z, x², y², z², xy, xz and yz. */
+    void setDriftTerms( const std::vector<bool>& driftTerms );
+    /** Whether the trend is estimated instead of the variable. */
+    void setEstimateTrend( bool estimateTrend );
+    /** The number of discretization points along X, Y and Z of the block of each cell.  Ones means point kriging. */
+    void setBlockDiscretization( uint nX, uint nY, uint nZ );
+    /** The value assigned to the cells that could not be estimated (e.g. too few samples). */
+    void setUnestimatedValue( double unestimatedValue );
+    //@}
+
+    /** Estimates the grid cells, showing a progress dialog.
+     * @return False if the parameters are invalid (the reason is logged as an error).
+     */
+    bool run();
+
+    /** Returns the estimates computed by run(), in the GEO-EAS grid scan order. */
+    const std::vector<double>& getEstimates() const { return m_estimates; }
+
+    /** Returns the kriging variances computed by run(), in the GEO-EAS grid scan order. */
+    const std::vector<double>& getKrigingVariances() const { return m_krigingVariances; }
+
+private:
+    /** Estimates the grid rows (cells along I) taken from progressInfo->nextRow until all rows are
+     * processed.  Runs in several threads at once, each writing the results of the rows it takes. */
+    void estimateRows( KrigingEstimationProgress* progressInfo );
+
+    /** Estimates one cell.  Returns false if the cell cannot be estimated (too few samples or no secondary
+     * value).  The results are NaN if the kriging system could not be solved. */
+    bool estimateCell( uint i, uint j, uint k, KrigingEstimationWorkspace& workspace,
+                       double& estimate, double& krigingVariance, int& nReused ) const;
+
+    /** Returns the covariance between two locations, which is the total sill if they coincide (as in kt3d). */
+    double covariance( double dx, double dy, double dz ) const;
+
+    /** Evaluates the drift functions (the constant, the polynomial terms and the external drift) at a location. */
+    void evaluateDrifts( double x, double y, double z, double externalDrift, double* drifts ) const;
+
+    PointSet* m_pointSet;
+    CartesianGrid* m_grid;
+    uint m_column;
+    uint m_secondaryColumn;
+    CartesianGrid* m_secondaryGrid;
+    uint m_secondaryGridColumn;
+    double m_tmin, m_tmax;
+    SearchStrategyPtr m_searchStrategy;
+    VariogramModel* m_variogramModel;
+    KrigingEstimationType m_kType;
+    double m_meanSK;
+    std::vector<bool> m_driftTerms;
+    bool m_estimateTrend;
+    uint m_nDiscretizationX, m_nDiscretizationY, m_nDiscretizationZ;
+    double m_unestimatedValue;
+
+    //@{
+    /** Data prepared by run() before starting the threads. */
+    CompiledVariogramModel m_variogram;
+    SpatialIndexPoints m_spatialIndex;
+    /** Sample coordinates, values and secondary values by data line. */
+    std::vector<double> m_x, m_y, m_z, m_values, m_secondaryValues;
+    /** The secondary values at the grid cells. */
+    std::vector<double> m_secondaryGridValues;
+    /** The offsets of the block discretization points from the cell centers. */
+    std::vector<double> m_blockX, m_blockY, m_blockZ;
+    /** The average covariance within a block. */
+    double m_blockCovariance;
+    /** The number of drift functions (the unbiasedness condition included). */
+    int m_nDrifts;
+    /** The drift coordinates are relative to the grid origin and divided by this length (the search radius),
+     * so the polynomial drift terms do not have huge magnitudes. */
+    double m_driftScale;
+    //@}
+
+    std::vector<double> m_estimates;
+    std::vector<double> m_krigingVariances;
+};
+
+#endif // KRIGINGESTIMATION_H
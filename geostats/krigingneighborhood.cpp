@@ -0,0 +1,14 @@
+#include "krigingneighborhood.h"
+
+#include <algorithm>
+
+void KrigingNeighborhood::sortByLocation()
+{
+    std::sort( m_samples.begin(), m_samples.end(), []( const NeighborhoodSample& a, const NeighborhoodSample& b ){
+        if( a.x != b.x )
+            return a.x < b.x;
+        if( a.y != b.y )
+            return a.y < b.y;
+        return a.z < b.z;
+    });
+}
@@ -0,0 +1,52 @@
+#ifndef KRIGINGNEIGHBORHOOD_H
+#define KRIGINGNEIGHBORHOOD_H
+
+#include <cstddef>
+#include <vector>
+
+/** One sample of a KrigingNeighborhood. */
+struct NeighborhoodSample
+{
+    /** The data line (point sets) or the cell index (grids) of the sample. */
+    unsigned int index;
+    double x, y, z;
+    double value;
+    /** The distance to the estimation location (its meaning depends on the search, e.g. topological for grids). */
+    double distance;
+};
+
+/**
+ * The KrigingNeighborhood class is a flat array of the samples found around an estimation location.
+ * It replaces the DataCellPtrMultiset objects in the estimation loops, which cost one heap allocation per sample
+ * plus the tree nodes of the multiset.  The samples carry their locations and values, so building the kriging
+ * system needs no access to the data files.  An object is meant to be reused for all estimation locations
+ * of a thread: clear() keeps the capacity, so, after the first locations, filling it allocates no memory.
+ */
+class KrigingNeighborhood
+{
+public:
+    /** @param capacity The maximum number of samples expected (e.g. the maximum set in the search). */
+    explicit KrigingNeighborhood( size_t capacity = 0 ){ m_samples.reserve( capacity ); }
+
+    /** Removes all samples, but keeps the allocated memory. */
+    void clear(){ m_samples.clear(); }
+
+    void add( unsigned int index, double x, double y, double z, double value, double distance ){
+        m_samples.push_back( NeighborhoodSample{ index, x, y, z, value, distance } );
+    }
+
+    size_t size() const { return m_samples.size(); }
+
+    bool empty() const { return m_samples.empty(); }
+
+    const NeighborhoodSample& operator[]( size_t i ) const { return m_samples[i]; }
+
+    /** Sorts the samples by their coordinates, so the same set of samples is always in the same order,
+     * whatever the order in which they were found. */
+    void sortByLocation();
+
+private:
+    std::vector<NeighborhoodSample> m_samples;
+};
+
+#endif // KRIGINGNEIGHBORHOOD_H
@@ -0,0 +1,83 @@
+#include "krigingsolver.h"
+
+#include <cmath>
+#include <limits>
+
+KrigingSolver::KrigingSolver() :
+    m_factorization( Factorization::NONE ),
+    m_rcond( 0.0 ),
+    m_isOnesSolutionValid( false )
+{
+}
+
+bool KrigingSolver::factorizeCovariances(const Eigen::MatrixXd &covariances)
+{
+    m_isOnesSolutionValid = false;
+    //Cholesky is the cheapest factorization, but requires a positive definite matrix.
+    m_llt.compute( covariances );
+    if( m_llt.info() == Eigen::Success ){
+        m_factorization = Factorization::LLT;
+        m_rcond = m_llt.rcond();
+    } else {
+        //the matrix is not positive definite (e.g. duplicate samples or a pure nugget model), try LDLT.
+        m_ldlt.compute( covariances );
+        m_factorization = Factorization::LDLT;
+        m_rcond = m_ldlt.info() == Eigen::Success ? m_ldlt.rcond() : 0.0;
+        //LDLT's solve treats null pivots as zeros (pseudo-inverse), so rcond() does not see singularity.
+        Eigen::VectorXd absD = m_ldlt.vectorD().cwiseAbs();
+        if( absD.minCoeff() <= std::numeric_limits<double>::epsilon() * absD.size() * absD.maxCoeff() )
+            m_rcond = 0.0;
+    }
+    if( ! std::isfinite( m_rcond ) )
+        m_rcond = 0.0;
+    return m_rcond > 0.0;
+}
+
+bool KrigingSolver::factorizeGeneral(const Eigen::MatrixXd &matrix)
+{
+    m_isOnesSolutionValid = false;
+    m_lu.compute( matrix );
+    m_factorization = Factorization::LU;
+    m_rcond = m_lu.rcond();
+    if( ! std::isfinite( m_rcond ) )
+        m_rcond = 0.0;
+    return m_rcond > 0.0;
+}
+
+void KrigingSolver::solve(const Eigen::VectorXd &rhs, Eigen::VectorXd &weights)
+{
+    switch( m_factorization ){
+    case Factorization::LLT:
+        weights = m_llt.solve( rhs ); break;
+    case Factorization::LDLT:
+        weights = m_ldlt.solve( rhs ); break;
+    case Factorization::LU:
+        weights = m_lu.solve( rhs ); break;
+    case Factorization::NONE:
+        weights.setConstant( rhs.size(), std::numeric_limits<double>::quiet_NaN() );
+    }
+}
+
+double KrigingSolver::solveConstrained(const Eigen::VectorXd &rhs, double weightSum, Eigen::VectorXd &weights)
+{
+    computeOnesSolution();
+    //unconstrained solution: [w0] = [A]^-1 * [rhs]
+    solve( rhs, weights );
+    //the Lagrange multiplier corrects w0 along [A]^-1 * [1] so the weights sum to weightSum:
+    //[w] = [w0] - mu * [A]^-1 * [1], with mu = ( sum(w0) - weightSum ) / sum( [A]^-1 * [1] )
+    double mu = ( weights.sum() - weightSum ) / m_onesSolution.sum();
+    weights -= mu * m_onesSolution;
+    return mu;
+}
+
+void KrigingSolver::computeOnesSolution()
+{
+    if( m_isOnesSolutionValid )
+        return;
+    int n = m_factorization == Factorization::LLT  ? m_llt.rows()  :
+            m_factorization == Factorization::LDLT ? m_ldlt.rows() :
+            m_factorization == Factorization::LU   ? m_lu.rows()   : 0;
+    m_ones.setOnes( n );
+    solve( m_ones, m_onesSolution );
+    m_isOnesSolutionValid = true;
+}
@@ -0,0 +1,79 @@
+#ifndef KRIGINGSOLVER_H
+#define KRIGINGSOLVER_H
+
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
+
+/**
+ * The KrigingSolver class solves kriging systems by factorizing the left-hand side matrix once and then
+ * solving for as many right-hand sides as needed, instead of computing the explicit inverse of the matrix.
+ * Covariance matrices (symmetric positive definite) are factorized with Cholesky (LLT), falling back to
+ * LDLT (with pivoting) if the matrix is only semi-definite.  Matrices of other kinds (e.g. made of
+ * semivariogram values) are factorized with LU decomposition with partial pivoting.
+ * Systems with weights constrained to a given sum (e.g. ordinary kriging) are solved by Schur complement
+ * of the bordered system with the factorization of the unconstrained matrix, so it is not necessary to
+ * build and factorize the bordered matrix.
+ * The factorizations are kept between uses, so one object per thread, reused for all estimation locations,
+ * allocates memory only when the number of samples changes.
+ */
+class KrigingSolver
+{
+public:
+    KrigingSolver();
+
+    /**
+     * Factorizes a covariance matrix (symmetric positive definite or semi-definite).
+     * Returns false if the matrix is numerically singular.  The solve methods should not be called in this case.
+     */
+    bool factorizeCovariances( const Eigen::MatrixXd& covariances );
+
+    /**
+     * Factorizes a matrix that is not necessarily positive definite (e.g. semivariogram values).
+     * Returns false if the matrix is numerically singular.  The solve methods should not be called in this case.
+     */
+    bool factorizeGeneral( const Eigen::MatrixXd& matrix );
+
+    /** Returns an estimate of the reciprocal of the condition number (1-norm) of the last factorized matrix.
+     * Values close to zero indicate an ill-conditioned matrix. */
+    double getReciprocalConditionNumber() const { return m_rcond; }
+
+    /** Returns whether the condition number of the last factorized matrix exceeds the given value. */
+    bool isIllConditioned( double maxConditionNumber ) const { return m_rcond * maxConditionNumber < 1.0; }
+
+    /** Solves [A][w] = [rhs] for the weights, with [A] being the last factorized matrix.
+     * The weights vector is resized as needed. */
+    void solve( const Eigen::VectorXd& rhs, Eigen::VectorXd& weights );
+
+    /**
+     * Solves the bordered system | A  1 | | w  |   | rhs       |
+     *                            | 1' 0 | | mu | = | weightSum |
+     * for the weights, with [A] being the last factorized matrix.  With weightSum == 1.0, this is the
+     * ordinary kriging system.
+     * @return The Lagrange multiplier (mu).
+     */
+    double solveConstrained( const Eigen::VectorXd& rhs, double weightSum, Eigen::VectorXd& weights );
+
+private:
+    enum class Factorization : int {
+        NONE,
+        LLT,
+        LDLT,
+        LU
+    };
+
+    /** Computes [A]^-1 * [1] for the last factorized matrix, if not already computed. */
+    void computeOnesSolution();
+
+    Factorization m_factorization;
+    Eigen::LLT<Eigen::MatrixXd> m_llt;
+    Eigen::LDLT<Eigen::MatrixXd> m_ldlt;
+    Eigen::PartialPivLU<Eigen::MatrixXd> m_lu;
+    double m_rcond;
+    /** [A]^-1 * [1], which is shared by all constrained solves with the same factorization. */
+    Eigen::VectorXd m_onesSolution;
+    bool m_isOnesSolutionValid;
+    Eigen::VectorXd m_ones;
+};
+
+#endif // KRIGINGSOLVER_H
@@ -0,0 +1,112 @@
+#include "krigingsystem.h"
+#include "compiledvariogrammodel.h"
+#include "krigingneighborhood.h"
+
+KrigingSystem::KrigingSystem() :
+    m_isSampleSetRepeated( false )
+{
+}
+
+void KrigingSystem::setSamples(const DataCellPtrMultiset &samples)
+{
+    beginSamples( samples.size() );
+    size_t i = 0;
+    for( const DataCellPtr& sample : samples ){
+        setSampleLocation( i, sample->_center._x, sample->_center._y, sample->_center._z );
+        ++i;
+    }
+}
+
+void KrigingSystem::setSamples(const KrigingNeighborhood &samples)
+{
+    beginSamples( samples.size() );
+    for( size_t i = 0; i < samples.size(); ++i )
+        setSampleLocation( i, samples[i].x, samples[i].y, samples[i].z );
+}
+
+void KrigingSystem::beginSamples(size_t n)
+{
+    m_isSampleSetRepeated = n == m_x.size();
+    m_x.resize( n );
+    m_y.resize( n );
+    m_z.resize( n );
+    m_dx.resize( n );
+    m_dy.resize( n );
+    m_dz.resize( n );
+}
+
+void KrigingSystem::setSampleLocation(size_t i, double x, double y, double z)
+{
+    if( m_isSampleSetRepeated && ( x != m_x[i] || y != m_y[i] || z != m_z[i] ) )
+        m_isSampleSetRepeated = false;
+    m_x[i] = x;
+    m_y[i] = y;
+    m_z[i] = z;
+}
+
+void KrigingSystem::buildCovariances(const CompiledVariogramModel &variogramModel,
+                                     double variogramSill,
+                                     KrigingType kType,
+                                     bool returnGamma)
+{
+    const int n = getSampleCount();
+    const int dim = n + ( kType == KrigingType::OK ? 1 : 0 );
+    //resize() only reallocates if the number of elements changes
+    m_covariances.resize( dim, dim );
+    const bool isPureNugget = variogramModel.isPureNugget();
+
+    //Eigen matrices are stored column by column, so the upper part of column j (rows 0 to j) is contiguous
+    //and is evaluated in a single batch.
+    for( int j = 0; j < n; ++j ){
+        for( int i = 0; i <= j; ++i ){
+            m_dx[i] = m_x[j] - m_x[i];
+            m_dy[i] = m_y[j] - m_y[i];
+            m_dz[i] = m_z[j] - m_z[i];
+        }
+        double* column = m_covariances.col( j ).data();
+        variogramModel.gamma( m_dx.data(), m_dy.data(), m_dz.data(), j + 1, column );
+        //to remove singularity...
+        //TODO: this needs to be verified.
+        if( isPureNugget )
+            for( int i = 0; i < j; ++i )
+                column[i] = 0.0;
+        if( ! returnGamma )
+            for( int i = 0; i <= j; ++i )
+                column[i] = variogramSill - column[i];
+    }
+
+    //mirror the upper triangle into the lower triangle
+    for( int j = 0; j < n; ++j )
+        for( int i = j + 1; i < n; ++i )
+            m_covariances( i, j ) = m_covariances( j, i );
+
+    //prepare the cov matrix for an OK system, if this is the case.
+    if( kType == KrigingType::OK ){
+        for( int i = 0; i < n; ++i ){
+            m_covariances( n, i ) = 1.0; //last row with ones
+            m_covariances( i, n ) = 1.0; //last column with ones
+        }
+        m_covariances( n, n ) = 0.0; //last element is zero
+    }
+}
+
+void KrigingSystem::buildGammas(const CompiledVariogramModel &variogramModel,
+                                double variogramSill,
+                                const SpatialLocation &estimationLocation,
+                                KrigingType kType,
+                                bool returnGamma)
+{
+    const int n = getSampleCount();
+    m_gammas.resize( n + ( kType == KrigingType::OK ? 1 : 0 ) );
+    for( int i = 0; i < n; ++i ){
+        m_dx[i] = estimationLocation._x - m_x[i];
+        m_dy[i] = estimationLocation._y - m_y[i];
+        m_dz[i] = estimationLocation._z - m_z[i];
+    }
+    variogramModel.gamma( m_dx.data(), m_dy.data(), m_dz.data(), n, m_gammas.data() );
+    if( ! returnGamma )
+        for( int i = 0; i < n; ++i )
+            m_gammas[i] = variogramSill - m_gammas[i];
+    if( kType == KrigingType::OK )
+        m_gammas[n] = 1.0; //last element is one
+}
@@ -0,0 +1,84 @@
+#ifndef KRIGINGSYSTEM_H
+#define KRIGINGSYSTEM_H
+
+#include "geostatsutils.h"
+#include <Eigen/Core>
+#include <vector>
+
+class CompiledVariogramModel;
+class KrigingNeighborhood;
+
+/**
+ * The KrigingSystem class assembles the matrices of a kriging system (the sample-to-sample covariance
+ * matrix and the sample-to-estimation-location covariance vector) directly in Eigen objects.
+ * The sample coordinates are kept as separate arrays (structure of arrays), so the separation vectors
+ * of a whole matrix column are evaluated in a single call to CompiledVariogramModel's batch methods.
+ * Only the upper triangle of the symmetric covariance matrix is evaluated, then mirrored.
+ * The object keeps its buffers between uses, so reusing one object for many estimation locations
+ * (e.g. one per thread) avoids memory allocations.
+ */
+class KrigingSystem
+{
+public:
+    KrigingSystem();
+
+    /** Sets the samples of the kriging system (their order is that of the multiset). */
+    void setSamples( const DataCellPtrMultiset& samples );
+
+    /** Sets the samples of the kriging system (their order is that of the neighborhood). */
+    void setSamples( const KrigingNeighborhood& samples );
+
+    /** Returns the number of samples set with setSamples(). */
+    int getSampleCount() const { return (int)m_x.size(); }
+
+    /**
+     * Returns whether the last call to setSamples() had samples at the same locations (and in the same order)
+     * as the call before it (see KrigingNeighborhood::sortByLocation()).  If so, the covariance matrix depends
+     * only on the variogram model, so the matrix built by the last buildCovariances() (and any factorization
+     * of it) can be reused if the model did not change.
+     */
+    bool isSampleSetRepeated() const { return m_isSampleSetRepeated; }
+
+    /**
+     * Builds the covariance matrix between the samples.
+     * @param kType If OK, the matrix has an extra row and column with 1.0s, except for the last element, which is zero.
+     * @param returnGamma If true, the elements are variogram values instead of covariances (sill - gamma).
+     */
+    void buildCovariances( const CompiledVariogramModel& variogramModel,
+                           double variogramSill,
+                           KrigingType kType = KrigingType::SK,
+                           bool returnGamma = false );
+
+    /**
+     * Builds the vector of covariances between the samples and the estimation location.
+     * @param kType If OK, the vector has an extra element equal to 1.0.
+     * @param returnGamma If true, the elements are variogram values instead of covariances (sill - gamma).
+     */
+    void buildGammas( const CompiledVariogramModel& variogramModel,
+                      double variogramSill,
+                      const SpatialLocation& estimationLocation,
+                      KrigingType kType = KrigingType::SK,
+                      bool returnGamma = false );
+
+    /** Returns the matrix built by the last call to buildCovariances(). */
+    const Eigen::MatrixXd& getCovariances() const { return m_covariances; }
+
+    /** Returns the vector built by the last call to buildGammas(). */
+    const Eigen::VectorXd& getGammas() const { return m_gammas; }
+
+private:
+    /** Resizes the sample arrays for a new set of n samples. */
+    void beginSamples( size_t n );
+    /** Sets the location of the i-th sample, checking whether it is the same as in the previous set. */
+    void setSampleLocation( size_t i, double x, double y, double z );
+
+    bool m_isSampleSetRepeated;
+    /** Sample coordinates. */
+    std::vector<double> m_x, m_y, m_z;
+    /** Scratch arrays for the separation vectors of a matrix column. */
+    std::vector<double> m_dx, m_dy, m_dz;
+    Eigen::MatrixXd m_covariances;
+    Eigen::VectorXd m_gammas;
+};
+
+#endif // KRIGINGSYSTEM_H
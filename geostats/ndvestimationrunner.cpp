@@ -9,12 +9,15 @@
 #include "util.h"
 #include "imagejockey/imagejockeyutils.h"
 #include "spectral/spectral.h"
+#include "neighborhoodmask.h"
+#include "krigingsystem.h"
+#include "krigingsolver.h"
+#include "krigingneighborhood.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
-enum class FlagState : char {
-    NOT_SET = 0,
-    TO_SET,
-    SET
-};
 
 
 NDVEstimationRunner::NDVEstimationRunner(NDVEstimation *ndvEstimation, Attribute *at, QObject *parent) :
@@ -42,21 +45,17 @@ void NDVEstimationRunner::doRun()
     //the flag signals that there is at least one valued cell in the search
     //neighborhood.  This flag saves unnecessary calls to krige() for vast voids
     //in the grid.
-    std::vector<FlagState> mask;
-    mask.reserve(nI * nJ * nK);
-
-    //sets the flags for valued cells
-    for( uint k = 0; k <nK; ++k){
-        for( uint j = 0; j <nJ; ++j){
-            for( uint i = 0; i <nI; ++i){
-                double value = cg->dataIJK( atIndex, i, j, k );
-                if( cg->isNDV( value ) )
-                    mask.push_back( FlagState::NOT_SET );
-                else
-                    mask.push_back( FlagState::SET );
-            }
-        }
-    }
+    NeighborhoodMask mask( nI, nJ, nK );
+
+    //sets the flags for valued cells (grid cells are stored in I, J, K order)
+    cg->loadData();
+    ValidityMask isValued;
+    cg->getValidityMask( atIndex, isValued );
+    for( uint k = 0, iCell = 0; k <nK; ++k)
+        for( uint j = 0; j <nJ; ++j)
+            for( uint i = 0; i <nI && iCell < isValued.size(); ++i, ++iCell)
+                if( isValued.isValid( iCell ) )
+                    mask.set( i, j, k );
 
     //apply dilation algorithm on current flags, so we flag cells
     //which will require a call to krige().  The dilation must be enough
@@ -64,47 +63,12 @@ void NDVEstimationRunner::doRun()
     int maskExpansion = std::max({ _ndvEstimation->searchNumCols()/2,
                                    _ndvEstimation->searchNumRows()/2,
                                    _ndvEstimation->searchNumSlices()/2});
-    //for each dilation step
     emit setLabel("Creating neighborhood values mask...");
-    for( int step = 0; step < maskExpansion; ++step){
-        emit progress(  (step/(float)maskExpansion) * nI * nJ * nK );
-        //for each cell
-        for( uint k = 0; k <nK; ++k){
-            for( uint j = 0; j <nJ; ++j){
-                for( uint i = 0; i <nI; ++i){
-                    //if the flag is not set
-                    if( mask[ i + j*nI + k*nJ*nI ] == FlagState::NOT_SET ){
-                        FlagState flagToSet = FlagState::NOT_SET; //assumes no value will be found
-                        //for each immediate neighbor
-                        for( uint kk = std::max(0, (int)k-1); kk < std::min(nK, k+2); ++kk ){
-                            for( uint jj = std::max(0, (int)j-1); jj < std::min(nJ, j+2); ++jj ){
-                                for( uint ii = std::max(0, (int)i-1); ii < std::min(nI, i+2); ++ii ){
-                                    //if the immediate neighbor has a flag set
-                                    if( mask[ ii + jj*nI + kk*nJ*nI ] == FlagState::SET ){
-                                        //set the flag of the target cell to be set before the next dilation step
-                                        flagToSet = FlagState::TO_SET;
-                                        //interrupt the immediate neighbor search because the flag is already known
-                                        goto set_flag;
-                                    }
-                                }
-                            }
-                        }
-set_flag:               mask[ i + j*nI + k*nJ*nI ] = flagToSet;
-                    }
-                }
-            }
-        }
-        //change the TO_SET flags to SET flags for the next dilation step
-        for( uint k = 0; k <nK; ++k)
-            for( uint j = 0; j <nJ; ++j)
-                for( uint i = 0; i <nI; ++i)
-                    if( mask[ i + j*nI + k*nJ*nI ] == FlagState::TO_SET )
-                        mask[ i + j*nI + k*nJ*nI ] = FlagState::SET;
-    }
+    mask.dilate( maskExpansion );
 
-    //prepare the vector with the results (to not overwrite the original data)
-    _results.clear();
-    _results.reserve( nI * nJ * nK );
+    //prepare the vector with the results (to not overwrite the original data).
+    //the workers write directly to the cells' positions.
+    _results.assign( (size_t)nI * nJ * nK, std::numeric_limits<double>::quiet_NaN() );
 
     //get the no-data-value configuration
     bool hasNDV = cg->hasNoDataValue();
@@ -112,15 +76,6 @@ set_flag:               mask[ i + j*nI + k*nJ*nI ] = flagToSet;
     if( hasNDV )
         NDV = cg->getNoDataValueAsDouble();
 
-    //define what value to assign to an estimated cell in absence of values in the search neighborhood
-    double valueForNoValuesInNeighborhood;
-    if( _ndvEstimation->useDefaultValue() )
-        //...assign a default value (e.g. a global mean or expected value).
-        valueForNoValuesInNeighborhood = _ndvEstimation->defaultValue();
-    else
-        //...or assign a no-data-value.
-        valueForNoValuesInNeighborhood = _ndvEstimation->ndv();
-
     //get the sill in a separate variable because VariogramModel::getSill() is slow.
     double variogramSill = _ndvEstimation->vmodel()->getSill();
 
@@ -130,41 +85,58 @@ set_flag:               mask[ i + j*nI + k*nJ*nI ] = flagToSet;
     //disable reread in model's getters to improve performance
     _ndvEstimation->vmodel()->setForceReread( false );
 
-    //for all grid cells
-    int nCopies = 0;
-    int nTrivial = 0;
-    int nKriging = 0;
-	int nIllConditioned = 0;
-	int nFailed = 0;
-    for( uint k = 0; k <nK; ++k)
-        for( uint j = 0; j <nJ; ++j){
-			emit setLabel("Running estimation:\n" + QString::number(nCopies) + " copies of values.\n" +
-						  QString::number(nTrivial) + " trivial cases.\n" +
-						  QString::number(nKriging) + " actual kriging operations (" +
-						  QString::number(nIllConditioned) + " ill-conditioned, " +
-						  QString::number(nFailed) + " failed). " );
-            emit progress( j * nI + k * nI * nJ );
-			for( uint i = 0; i <nI; ++i){
-                double value = cg->dataIJK( atIndex, i, j, k );
-                if( cg->isNDV( value ) ){
-                    //found an unvalued cell, call krige() only if we're sure we have at least one valued
-                    //cell in the neighborhood.
-                    if( mask[ i + j*nI + k*nJ*nI ] == FlagState::SET ){
-						GridCell cell(cg, atIndex, i,j,k);
-                        //estimate if at least one value exists in the neighborhood
-                        ++nKriging;
-						_results.push_back( krige( cell , _ndvEstimation->meanForSK(), hasNDV, NDV, variogramSill, nIllConditioned, nFailed ) );
-                    } else {
-                        ++nTrivial;
-                        _results.push_back( valueForNoValuesInNeighborhood );
-                    }
-                }
-                else{
-                    ++nCopies;
-                    _results.push_back( value ); //simple copy from valued cells
-                }
-            }
-        }
+    //the variogram model is compiled once and shared by the workers
+    _variogram = CompiledVariogramModel( _ndvEstimation->vmodel() );
+
+    //build the shared cache of neighborhood deltas before the workers start,
+    //so it is only read concurrently.
+    {
+        GridCell firstCell( cg, atIndex, 0, 0, 0 );
+        KrigingNeighborhood neighbors;
+        GeostatsUtils::getValuedNeighborsTopoOrdered( firstCell,
+                                                      _ndvEstimation->searchMaxNumSamples(),
+                                                      _ndvEstimation->searchNumCols(),
+                                                      _ndvEstimation->searchNumRows(),
+                                                      _ndvEstimation->searchNumSlices(),
+                                                      hasNDV, NDV, neighbors );
+    }
+
+    //the grid rows (slabs of nI cells) are distributed dynamically among the workers:
+    //a worker that finishes a row takes the next unprocessed one, so the load stays balanced
+    //even if the unvalued cells are concentrated in some regions of the grid.
+    NDVEstimationProgress progressInfo;
+    unsigned int nRows = nJ * nK;
+    unsigned int nThreads = std::max( 1u, std::min( std::thread::hardware_concurrency(), nRows ) );
+    std::vector<std::thread> threads;
+    for( unsigned int iThread = 0; iThread < nThreads; ++iThread )
+        threads.push_back( std::thread( &NDVEstimationRunner::krigeRows, this,
+                                        &mask, hasNDV, NDV, variogramSill, &progressInfo ) );
+
+    //report progress while the workers run
+    while( progressInfo.nRowsDone < nRows ){
+        int nKriging = progressInfo.nKriging.load();
+        double reusePercent = nKriging ? 100.0 * progressInfo.nReused.load() / nKriging : 0.0;
+        emit setLabel("Running estimation:\n" + QString::number(progressInfo.nCopies.load()) + " copies of values.\n" +
+                      QString::number(progressInfo.nTrivial.load()) + " trivial cases.\n" +
+                      QString::number(nKriging) + " actual kriging operations (" +
+                      QString::number(reusePercent, 'f', 1) + "% reused neighborhoods, " +
+                      QString::number(progressInfo.nIllConditioned.load()) + " ill-conditioned, " +
+                      QString::number(progressInfo.nFailed.load()) + " failed) in " +
+                      QString::number(nThreads) + " threads. " );
+        emit progress( progressInfo.nRowsDone.load() * nI );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    }
+
+    //wait for the workers to finish.
+    for( std::thread& thread : threads )
+        thread.join();
+
+    if( progressInfo.nFailed ){
+        double failValue = _ndvEstimation->useDefaultValue() ? _ndvEstimation->defaultValue() : _ndvEstimation->ndv();
+        Application::instance()->logWarn( "NDVEstimationRunner::doRun(): " + QString::number(progressInfo.nFailed.load()) +
+                                          " kriging operation(s) failed (resulted in NaN or infinity).  Assigned " +
+                                          QString::number(failValue) + " to protect the output data file." );
+    }
 
     //restore automatic reread in model's getters
     _ndvEstimation->vmodel()->setForceReread( true );
@@ -173,14 +145,84 @@ set_flag:               mask[ i + j*nI + k*nJ*nI ] = flagToSet;
     _finished = true;
 }
 
+void NDVEstimationRunner::krigeRows( const NeighborhoodMask* mask, bool hasNDV, double NDV,
+                                     double variogramSill, NDVEstimationProgress* progressInfo )
+{
+    //gets the Attribute's column in its Cartesian grid's data array (GEO-EAS index - 1)
+    uint atIndex = _at->getAttributeGEOEASgivenIndex() - 1;
+    CartesianGrid *cg = (CartesianGrid*)_at->getContainingFile();
+    uint nI = cg->getNX();
+    uint nJ = cg->getNY();
+    uint nRows = nJ * cg->getNZ();
+
+    //the predicate is copied so the workers do not touch the grid's cached one
+    const NDVPredicate isNDV = cg->getNDVPredicate();
+
+    //define what value to assign to an estimated cell in absence of values in the search neighborhood
+    double valueForNoValuesInNeighborhood;
+    if( _ndvEstimation->useDefaultValue() )
+        //...assign a default value (e.g. a global mean or expected value).
+        valueForNoValuesInNeighborhood = _ndvEstimation->defaultValue();
+    else
+        //...or assign a no-data-value.
+        valueForNoValuesInNeighborhood = _ndvEstimation->ndv();
+    double meanSK = _ndvEstimation->meanForSK();
+
+    //the neighborhood, the kriging matrices and their factorizations are reused for all cells estimated by this thread
+    NDVKrigingWorkspace workspace( _ndvEstimation->searchMaxNumSamples() );
+
+    for( uint iRow = progressInfo->nextRow++; iRow < nRows; iRow = progressInfo->nextRow++ ){
+        uint j = iRow % nJ;
+        uint k = iRow / nJ;
+        //the counters are accumulated per row and then merged into the shared ones
+        int nCopies = 0;
+        int nTrivial = 0;
+        int nKriging = 0;
+        int nReused = 0;
+        int nIllConditioned = 0;
+        int nFailed = 0;
+        for( uint i = 0; i <nI; ++i){
+            size_t iCell = i + (size_t)iRow * nI;
+            double value = cg->dataIJK( atIndex, i, j, k );
+            if( isNDV( value ) ){
+                //found an unvalued cell, call krige() only if we're sure we have at least one valued
+                //cell in the neighborhood.
+                if( mask->isSet( i, j, k ) ){
+                    GridCell cell(cg, atIndex, i,j,k);
+                    //estimate if at least one value exists in the neighborhood
+                    ++nKriging;
+                    _results[ iCell ] = krige( cell , meanSK, hasNDV, NDV, variogramSill, workspace,
+                                               nReused, nIllConditioned, nFailed );
+                } else {
+                    ++nTrivial;
+                    _results[ iCell ] = valueForNoValuesInNeighborhood;
+                }
+            }
+            else{
+                ++nCopies;
+                _results[ iCell ] = value; //simple copy from valued cells
+            }
+        }
+        progressInfo->nCopies += nCopies;
+        progressInfo->nTrivial += nTrivial;
+        progressInfo->nKriging += nKriging;
+        progressInfo->nReused += nReused;
+        progressInfo->nIllConditioned += nIllConditioned;
+        progressInfo->nFailed += nFailed;
+        ++progressInfo->nRowsDone;
+    }
+}
+
 double NDVEstimationRunner::krige(GridCell cell, double meanSK, bool hasNDV, double NDV, double variogramSill,
-								  int& nIllConditioned, int& nFailed )
+								  NDVKrigingWorkspace& workspace,
+								  int& nReused, int& nIllConditioned, int& nFailed )
 {
     double result = std::numeric_limits<double>::quiet_NaN();
 
     //collects valued n-neighbors ordered by their topological distance with respect
     //to the target cell
-	GridCellPtrMultiset vCells;
+	KrigingNeighborhood& vCells = workspace.neighborhood;
+	vCells.clear();
 
 	//collects the data samples (depend on the search neighborhood)
     GeostatsUtils::getValuedNeighborsTopoOrdered( cell,
@@ -192,9 +234,6 @@ double NDVEstimationRunner::krige(GridCell cell, double meanSK, bool hasNDV, dou
                                                            NDV,
                                                            vCells);
 
-	//Make a copy of the sample collection but with generic versions of the objects for the methods transparent to grid information.
-	DataCellPtrMultiset vDataCells( vCells.begin(), vCells.end() );
-
     //if no sample was found, either...
 	if( vCells.empty() ){
         if( _ndvEstimation->useDefaultValue() )
@@ -205,71 +244,81 @@ double NDVEstimationRunner::krige(GridCell cell, double meanSK, bool hasNDV, dou
             return _ndvEstimation->ndv();
     }
 
-	//get the matrix of the theoretical covariances between the data sample locations and themselves.
-	// TODO PERFORMANCE: the cov matrix needs only to be computed once.
-	MatrixNXM<double> covMat = GeostatsUtils::makeCovMatrix( vDataCells,
-															 _ndvEstimation->vmodel(),
-                                                             variogramSill );
-
-	//get the gamma matrix (theoretical covariances between sample locations and estimation location)
-	MatrixNXM<double> gammaMat = GeostatsUtils::makeGammaMatrix( vDataCells, cell, _ndvEstimation->vmodel(), variogramSill );
+	//get the matrix of the theoretical covariances between the data sample locations and themselves
+	//and the gamma matrix (theoretical covariances between sample locations and estimation location).
+	//The samples are sorted by location, so a neighborhood equal to the previous cell's yields the same
+	//covariance matrix, which is then neither rebuilt nor refactorized.
+	KrigingSystem& system = workspace.system;
+	KrigingSolver& solver = workspace.solver;
+	vCells.sortByLocation();
+	system.setSamples( vCells );
+	bool isNeighborhoodReused = system.isSampleSetRepeated();
+	system.buildGammas( _variogram, variogramSill, cell._center );
+	const Eigen::VectorXd& gammaMat = system.getGammas();
+
+	//get the values of the samples (in the order of the kriging matrices)
+	Eigen::VectorXd& values = workspace.values;
+	values.resize( vCells.size() );
+	for( int i = 0; i < values.size(); ++i )
+		values(i) = vCells[i].value;
 
 	//The eta (after greek letter eta) number is the threshold below which the eigenvalues are rounded off to zero
 	//The eta number and the value are both in Mohammadi et al (2016) paper (see complete reference further below).
 	double eta = 0.001;
 
-	//test whether the covariance matrix is ill-conditioned (near-singular).
-	//an ill-conditioned matrix has a bad numerical invert.
-	bool is_cov_matrix_ill_conditioned = false;
-	int cov_matrix_rank = 0;
-	spectral::array eigenvectors, eigenvalues;
-	std::tie( eigenvectors, eigenvalues ) = spectral::eig( covMat.toSpectralArray() );
-	{
-		double smallestEigenValue = std::numeric_limits<double>::max();
-		double largestEigenValue = 0; //since the cov table is positive definite, the smallest value possible is zero.
-		for( int i = 0; i < eigenvalues.size(); ++i ){
-			double eigenvalue = eigenvalues(i);
-			//since the cov table is positive definite, there is no need to compute the absolute value.
-			if( eigenvalue < smallestEigenValue )
-				smallestEigenValue = eigenvalue;
-			if( eigenvalue > largestEigenValue )
-				largestEigenValue = eigenvalue;
-			if( eigenvalue > eta )
-				cov_matrix_rank = i;
-		}
-		++cov_matrix_rank;
-		double condition_number = largestEigenValue / smallestEigenValue;
-		if( condition_number > 10 ){
-			is_cov_matrix_ill_conditioned = true;
-			++nIllConditioned;
+	if( isNeighborhoodReused )
+		++nReused;
+	else {
+		system.buildCovariances( _variogram, variogramSill );
+		const Eigen::MatrixXd& covMat = system.getCovariances();
+		//factorize the covariance matrix and test whether it is ill-conditioned (near-singular).
+		//an ill-conditioned matrix yields unreliable kriging weights.
+		workspace.isIllConditioned = ! solver.factorizeCovariances( covMat ) ||
+									 solver.isIllConditioned( 10.0 );
+		workspace.rank = 0;
+		if( workspace.isIllConditioned ){
+			//only ill-conditioned matrices need the eigendecomposition (for the regularization further below).
+			spectral::array eigenvectors, eigenvalues;
+			std::tie( eigenvectors, eigenvalues ) = spectral::eig( spectral::to_array( covMat ) );
+			workspace.eigenvectors = spectral::to_2d( eigenvectors );
+			workspace.eigenvalues.resize( eigenvalues.size() );
+			for( int i = 0; i < eigenvalues.size(); ++i ){
+				workspace.eigenvalues(i) = eigenvalues(i);
+				if( eigenvalues(i) > eta )
+					workspace.rank = i;
+			}
+			++workspace.rank;
 		}
 	}
-
-	//make the kriging weights matrix (solve the kriging system).
-	MatrixNXM<double> weightsSK( vCells.size() );
-	if( is_cov_matrix_ill_conditioned ){
-		spectral::array weightsSKSpectral = weightsSK.toSpectralArray();
-		//make a spectral::array matrix from the data values (response values).
-		spectral::array y( vCells.size() );
-		{ //make the response-value (sample values) vector y.
-			GridCellPtrMultiset::iterator vit = vCells.begin();
-			for( int i = 0; vit != vCells.end(); ++vit, ++i )
-				y(i) = (*vit)->readValueFromGrid() - meanSK; //these values are actually the residuals with respect to the SK mean.
-		}
-		//Compute the kriging weights with the Pseudoinverse Regularization proposed by Mohammadi et al (2016) - Equation 12.
-		// "An analytic comparison of regularization methods for Gaussian Processes" - https://arxiv.org/pdf/1602.00853.pdf
-		for( int i = 0; i < cov_matrix_rank; ++i) {
-			spectral::array eigenvector = eigenvectors.getVectorColumn( i );
-			spectral::array eigenvectorT = spectral::transpose( eigenvector );
-			weightsSKSpectral += ( (eigenvectorT * y) / eigenvalues(i) )(0) * eigenvector; //the (0) is to take the single matrix element as a scalar an not as an product-incompatible matrix.
-		}
-		weightsSK = MatrixNXM<double>( weightsSKSpectral );
-	} else { // if the cov matrix is well conditioned, the kriging weights are computed the traditional way.
-		//invert the covariance matrix.
-		covMat.invertWithGaussJordan();
+	bool is_cov_matrix_ill_conditioned = workspace.isIllConditioned;
+	if( is_cov_matrix_ill_conditioned )
+		++nIllConditioned;
+	int cov_matrix_rank = workspace.rank;
+	const Eigen::MatrixXd& eigenvectors = workspace.eigenvectors;
+	const Eigen::VectorXd& eigenvalues = workspace.eigenvalues;
+
+	//Multiplies a vector by the pseudoinverse of the covariance matrix (truncated to its numerical rank).
+	auto applyPseudoinverse = [&]( const Eigen::VectorXd& v, Eigen::VectorXd& result ){
+		result.setZero( v.size() );
+		for( int i = 0; i < cov_matrix_rank; ++i )
+			result += ( eigenvectors.col( i ).dot( v ) / eigenvalues(i) ) * eigenvectors.col( i );
+	};
+
+	//Computes the kriging weights with the Pseudoinverse Regularization proposed by Mohammadi et al (2016) - Equation 12.
+	// "An analytic comparison of regularization methods for Gaussian Processes" - https://arxiv.org/pdf/1602.00853.pdf
+	//The response values are the residuals of the sample values with respect to the given mean.
+	auto computeRegularizedWeights = [&]( double mean, Eigen::VectorXd& weights ){
+		Eigen::VectorXd y = values.array() - mean;
+		applyPseudoinverse( y, weights );
+	};
+
+	//make the kriging weights vector (solve the kriging system).
+	Eigen::VectorXd weightsSK;
+	if( is_cov_matrix_ill_conditioned )
+		computeRegularizedWeights( meanSK, weightsSK );
+	else // if the cov matrix is well conditioned, the kriging weights are computed the traditional way.
 		//get the kriging weights vector: [w] = [Cov]^-1 * [gamma]
-		weightsSK = covMat * gammaMat;  //covMat is inverted
-	}
+		solver.solve( gammaMat, weightsSK );
 
     //finally, compute the kriging
     if( _ndvEstimation->ktype() == KrigingType::SK ){
@@ -277,49 +326,37 @@ double NDVEstimationRunner::krige(GridCell cell, double meanSK, bool hasNDV, dou
         result = meanSK;
 		if( is_cov_matrix_ill_conditioned ){
 			//see Mohammadi et al (2016) - Equation 13.
-			result += (gammaMat.getTranspose() * weightsSK)(0,0); //(0,0) is to get the single element as a scalar and not as a matrix object.
+			result += gammaMat.dot( weightsSK );
 		} else {
 			//computing SK the normal way.
-			GridCellPtrMultiset::iterator itSamples = vCells.begin();
-			for( uint i = 0; i < vCells.size(); ++i, ++itSamples){
-				result += weightsSK(i,0) * ( (*itSamples)->readValueFromGrid() - meanSK );
-			}
+			for( int i = 0; i < values.size(); ++i )
+				result += weightsSK(i) * ( values(i) - meanSK );
 		}
     } else {
 		//for OK mode
 
-		//get the OK gamma matrix (theoretical covariances between sample locations and estimation location)
-		//TODO: improve performance: Just append 1 to gammaMat.
-		MatrixNXM<double> gammaMatOK = GeostatsUtils::makeGammaMatrix( vDataCells, cell, _ndvEstimation->vmodel(), variogramSill, KrigingType::OK );
-
-		//make the OK cov matrix (theoretical covariances between sample locations and themselves)
-		//TODO: improve performance: Just expand SK matrices with the 1.0s and 0.0s instead of computing new ones.
-		// TODO PERFORMANCE: the cov matrix needs only to be computed once.
-		MatrixNXM<double> covMatOK = GeostatsUtils::makeCovMatrix( vDataCells,
-                                                                   _ndvEstimation->vmodel(),
-                                                                   variogramSill,
-                                                                   KrigingType::OK );
-
-		//get rank, eigenvalues and eigenvectors of the OK covariance matrix
-		int cov_matrix_rankOK = 0;
-		spectral::array eigenvectorsOK, eigenvaluesOK;
-		std::tie( eigenvectorsOK, eigenvaluesOK ) = spectral::eig( covMatOK.toSpectralArray() );
-		{
-			for( int i = 0; i < eigenvaluesOK.size(); ++i ){
-				double eigenvalue = eigenvaluesOK(i);
-				if( std::abs(eigenvalue) > eta )
-					cov_matrix_rankOK = i;
+		//make the OK kriging weights vector (solve the ordinary kriging system).
+		Eigen::VectorXd weightsOK;
+		if( is_cov_matrix_ill_conditioned ){
+			//the factorization is unreliable (or failed altogether), so the OK system is solved with the
+			//pseudoinverse of the covariance matrix: [w] = [Cov]+ * ( [gamma] + mu*[1] ), with the
+			//Lagrange multiplier mu set such that the weights sum up to 1.0.
+			Eigen::VectorXd weightsGamma, weightsOnes;
+			applyPseudoinverse( gammaMat, weightsGamma );
+			applyPseudoinverse( Eigen::VectorXd::Ones( values.size() ), weightsOnes );
+			double sumOfWeightsOnes = weightsOnes.sum();
+			if( std::abs( sumOfWeightsOnes ) < 1E-10 ){
+				++nFailed;
+				if( _ndvEstimation->useDefaultValue() )
+					return _ndvEstimation->defaultValue();
+				else
+					return _ndvEstimation->ndv();
 			}
-			++cov_matrix_rankOK;
-		}
-
-		//make the OK kriging weights matrix (solve the ordinary kriging system).
-		MatrixNXM<double> weightsOK( vCells.size()+1 ); //+1 is due to the extra lagrangean element in the cov matrix.
-		//invert the covariance matrix.
-		covMatOK.invertWithGaussJordan();
-		//compute the OK weights the normal way (follows the same rationale of SK)
-		weightsOK = covMatOK * gammaMatOK;  //covMatOK is inverted
-
+			double mu = ( 1.0 - weightsGamma.sum() ) / sumOfWeightsOnes;
+			weightsOK = weightsGamma + mu * weightsOnes;
+		} else
+			//The OK system is the SK system bordered with 1.0s, so it is solved with the same factorization.
+			solver.solveConstrained( gammaMat, 1.0, weightsOK );
 
 		//Correct OK weights according to Deutsch (1995) - "Correcting for negative weights in ordinary kriging"
 		{
@@ -328,47 +365,42 @@ double NDVEstimationRunner::krige(GridCell cell, double meanSK, bool hasNDV, dou
 			double mean_of_abs_value_of_neg_weights = 0.0;
 			double mean_of_cov_between_neg_weights_and_est_location = 0.0;
 			int n_neg_weights = 0;
-			for( int i = 0; i < weightsOK.getN()-1; ++i ){ //N-1 is to not "correct" the lagrangean (the last element in the weights matrix).
-				if( weightsOK(i,0) < 0.0 ){
-					mean_of_abs_value_of_neg_weights += std::abs( weightsOK(i,0) );
-					mean_of_cov_between_neg_weights_and_est_location += gammaMatOK(i,0);
+			for( int i = 0; i < weightsOK.size(); ++i ){
+				if( weightsOK(i) < 0.0 ){
+					mean_of_abs_value_of_neg_weights += std::abs( weightsOK(i) );
+					mean_of_cov_between_neg_weights_and_est_location += gammaMat(i);
 					++n_neg_weights;
 				}
 			}
 			if( n_neg_weights ){
-				MatrixNXM<double> weightsOKcorrected = weightsOK;
+				Eigen::VectorXd weightsOKcorrected = weightsOK;
 				mean_of_abs_value_of_neg_weights /= n_neg_weights;
 				mean_of_cov_between_neg_weights_and_est_location /= n_neg_weights;
 
 				// Zero off negative and small positive weights.
-				for( int i = 0; i < weightsOKcorrected.getN()-1; ++i ){
-					if( weightsOKcorrected(i,0) < 0.0 )
-						weightsOKcorrected(i,0) = 0.0;
-					else if( weightsOKcorrected(i,0) > 0.0 ){
-						double cov = gammaMatOK(i,0);
-						double weight = weightsOKcorrected(i,0);
+				for( int i = 0; i < weightsOKcorrected.size(); ++i ){
+					if( weightsOKcorrected(i) < 0.0 )
+						weightsOKcorrected(i) = 0.0;
+					else if( weightsOKcorrected(i) > 0.0 ){
+						double cov = gammaMat(i);
+						double weight = weightsOKcorrected(i);
 						if( cov < mean_of_cov_between_neg_weights_and_est_location &&
 							weight < mean_of_abs_value_of_neg_weights )
-							weightsOKcorrected(i,0) = 0.0;
+							weightsOKcorrected(i) = 0.0;
 					}
 				}
 				// Re-standardize weights so they sum up to 1.0 again.
-				double sum_from_i_to_end = 0.0;
-				for( int a = 0; a < weightsOKcorrected.getN()-1; ++a )
-					sum_from_i_to_end += weightsOKcorrected(a, 0);
-				for( int i = 0; i < weightsOKcorrected.getN()-1; ++i ){
+				double sum_from_i_to_end = weightsOKcorrected.sum();
+				for( int i = 0; i < weightsOKcorrected.size(); ++i ){
 					if( sum_from_i_to_end > 0.0 )
-						weightsOKcorrected(i, 0) /= sum_from_i_to_end;
+						weightsOKcorrected(i) /= sum_from_i_to_end;
 					else
-						weightsOKcorrected(i, 0) = 0.0;
+						weightsOKcorrected(i) = 0.0;
 				}
 				// Replace the original weights with the corrected ones.
 				weightsOK = weightsOKcorrected;
 				//Check
-				double sum = 0.0;
-				for( int i = 0; i < weightsOK.getN()-1; ++i )
-					sum += weightsOK(i, 0);
-				if( sum < 0.0001 ){
+				if( weightsOK.sum() < 0.0001 ){
 					if( _ndvEstimation->useDefaultValue() )
 						return _ndvEstimation->defaultValue();
 					else
@@ -378,52 +410,28 @@ double NDVEstimationRunner::krige(GridCell cell, double meanSK, bool hasNDV, dou
 		}
 
 		//Estimate the OK local mean (use OK weights)
-		double mOK = 0.0;
-		GridCellPtrMultiset::iterator itSamples = vCells.begin();
-		for( int i = 0; i < weightsOK.getN()-1; ++i, ++itSamples){ //the last element in weightsOK is the Lagrangian (mu)
-			mOK += weightsOK(i,0) * (*itSamples)->readValueFromGrid();
-		}
+		double mOK = weightsOK.dot( values );
 
-		// re-make the SK kriging weights matrix (solve the kriging system)
+		// re-make the SK kriging weights vector (solve the kriging system)
 		// but using mOK as the simple kriging mean.
-		if( is_cov_matrix_ill_conditioned ){
-			weightsSK = MatrixNXM<double>( vCells.size() );
-			spectral::array weightsSKSpectral = weightsSK.toSpectralArray();
-			//make a spectral::array matrix from the data values (response values).
-			spectral::array y( vCells.size() );
-			{ //make the response-value (sample values) vector y.
-				GridCellPtrMultiset::iterator vit = vCells.begin();
-				for( int i = 0; vit != vCells.end(); ++vit, ++i )
-					y(i) = (*vit)->readValueFromGrid() - mOK; //these values are actually the residuals with respect to the SK mean.
-			}
-			//Compute the kriging weights with the Pseudoinverse Regularization proposed by Mohammadi et al (2016) - Equation 12.
-			// "An analytic comparison of regularization methods for Gaussian Processes" - https://arxiv.org/pdf/1602.00853.pdf
-			for( int i = 0; i < cov_matrix_rank; ++i) {
-				spectral::array eigenvector = eigenvectors.getVectorColumn( i );
-				spectral::array eigenvectorT = spectral::transpose( eigenvector );
-				weightsSKSpectral += ( (eigenvectorT * y) / eigenvalues(i) )(0) * eigenvector; //the (0) is to take the single matrix element as a scalar an not as an product-incompatible matrix.
-			}
-			weightsSK = MatrixNXM<double>( weightsSKSpectral );
-		}
+		if( is_cov_matrix_ill_conditioned )
+			computeRegularizedWeights( mOK, weightsSK );
 
 		//compute the kriging weight for the local OK mean (use SK weights)
         double wmOK = 1.0;
-		//for( int i = 0; i < weightsSK.getN(); ++i){
-			//wmOK -= weightsSK(i,0);   //TODO: somehow only when the OK mean weight is 1.0, results are good.
+		//for( int i = 0; i < weightsSK.size(); ++i){
+			//wmOK -= weightsSK(i);   //TODO: somehow only when the OK mean weight is 1.0, results are good.
 		//}
 
 		//krige (with SK weights plus the OK mean (with OK mean weight))
 		result = 0.0;
 		if( is_cov_matrix_ill_conditioned ){
 			//see Mohammadi et al (2016) - Equation 13.
-			result += (gammaMat.getTranspose() * weightsSK)(0,0); //(0,0) is to get the single element as a scalar and not as a matrix object.
+			result += gammaMat.dot( weightsSK );
 			result += wmOK * mOK;
 		} else {
 			//computing kriging the normal way.
-			GridCellPtrMultiset::iterator itSamples = vCells.begin();
-			for( uint i = 0; i < vCells.size(); ++i, ++itSamples){
-				result += weightsSK(i,0) * ( (*itSamples)->readValueFromGrid() );
-			}
+			result += weightsSK.dot( values );
 			result += wmOK * mOK;
 		}
 	}
@@ -437,8 +445,7 @@ double NDVEstimationRunner::krige(GridCell cell, double meanSK, bool hasNDV, dou
 			failValue = _ndvEstimation->defaultValue();
 		else
 			failValue = _ndvEstimation->ndv();
-		Application::instance()->logWarn( "NDVEstimationRunner::krige(): at least one kriging operation failed (resulted in NaN or infinity).  Returning " +
-										  QString::number(failValue) + " to protect the output data file." );
+		//the failures are reported once by doRun(), since this runs in the worker threads.
 		result = failValue;
 	}
 
@@ -2,10 +2,53 @@
 #define NDVESTIMATIONRUNNER_H
 
 #include <QObject>
+#include "compiledvariogrammodel.h"
+#include "krigingsystem.h"
+#include "krigingsolver.h"
+#include "krigingneighborhood.h"
+#include <atomic>
+#include <vector>
 
 class Attribute;
 class GridCell;
 class NDVEstimation;
+class NeighborhoodMask;
+
+/** Work distribution and counters shared by the estimation threads of NDVEstimationRunner. */
+struct NDVEstimationProgress
+{
+    NDVEstimationProgress() : nextRow(0), nRowsDone(0), nCopies(0), nTrivial(0),
+                              nKriging(0), nReused(0), nIllConditioned(0), nFailed(0) {}
+    std::atomic<unsigned int> nextRow;
+    std::atomic<unsigned int> nRowsDone;
+    std::atomic<int> nCopies;
+    std::atomic<int> nTrivial;
+    std::atomic<int> nKriging;
+    /** Number of kriging operations that reused the covariance matrix of the previous cell. */
+    std::atomic<int> nReused;
+    std::atomic<int> nIllConditioned;
+    std::atomic<int> nFailed;
+};
+
+/** The neighborhood and kriging objects of one estimation thread of NDVEstimationRunner, reused for all of its cells.
+ * The factorization and the regularization data of the last covariance matrix are kept, so they
+ * are reused as is when the next cell has the same neighborhood.
+ */
+struct NDVKrigingWorkspace
+{
+    /** @param maxSamples The maximum number of samples of a neighborhood. */
+    explicit NDVKrigingWorkspace( int maxSamples ) : neighborhood( maxSamples ), isIllConditioned(false), rank(0) {}
+    KrigingNeighborhood neighborhood;
+    /** The values of the samples in the neighborhood. */
+    Eigen::VectorXd values;
+    KrigingSystem system;
+    KrigingSolver solver;
+    bool isIllConditioned;
+    /** The number of eigenpairs used in the regularization of an ill-conditioned matrix. */
+    int rank;
+    Eigen::MatrixXd eigenvectors;
+    Eigen::VectorXd eigenvalues;
+};
 
 /** This is an auxiliary class used in NDVEstimation::run() to enable the progress dialog.
  * The estimation takes place in a separate thread, so the progress bar updates.
@@ -34,13 +77,25 @@ private:
     Attribute* _at;
     NDVEstimation* _ndvEstimation;
     std::vector<double> _results;
+    /** The variogram model of the estimation, compiled at the start of doRun(). */
+    CompiledVariogramModel _variogram;
 
 	/** Estimate, by kriging, a single cell.
+	 * @param workspace The kriging matrices and their factorizations, reused by each thread for all of its cells.
+	 * @param nReused its value is increased if the covariance matrix of the previous cell was reused.
 	 * @param nIllConditioned its value is increased by the number of ill-conditioned kriging matrices encountered.
 	 * @param nFailed its value is increased by the number of kriging operations that failed (resulted in NaN or inifinity).
 	 */
 	double krige(GridCell cell , double meanSK, bool hasNDV, double NDV, double variogramSill,
-				 int& nIllConditioned, int & nFailed);
+				 NDVKrigingWorkspace& workspace,
+				 int& nReused, int& nIllConditioned, int & nFailed);
+
+	/** Estimates the grid rows (nI cells along I) taken from progressInfo->nextRow until all rows are
+	 * processed.  Runs in several threads at once, each writing the results of the rows it takes.
+	 * @param mask Flagged cells have at least one valued cell in the search neighborhood.
+	 */
+	void krigeRows( const NeighborhoodMask* mask, bool hasNDV, double NDV, double variogramSill,
+					NDVEstimationProgress* progressInfo );
 };
 
 #endif // NDVESTIMATIONRUNNER_H
@@ -0,0 +1,141 @@
+#include "neighborhoodmask.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+    /** Returns the next shift of the dilation by doubling: a span dilated by covered cells ORed with
+     * copies of itself shifted by +/-s is dilated by covered + s cells.  s must not exceed covered + 1,
+     * otherwise cells near the grid borders would miss flags that were shifted out of the grid. */
+    inline int nextShift( int covered, int radius ){
+        return std::min( covered + 1, radius - covered );
+    }
+
+    /** ORs into out the row in shifted by +s and -s bits (s > 0).  Bits shifted past the row are lost. */
+    void orShiftedRow( const uint64_t* in, uint64_t* out, unsigned int nWords, int s ){
+        const unsigned int q = s >> 6;
+        const unsigned int b = s & 63;
+        for( unsigned int w = 0; w < nWords; ++w ){
+            uint64_t toHigher = 0; //bit i of the result comes from bit i - s
+            uint64_t toLower = 0;  //bit i of the result comes from bit i + s
+            if( w >= q ){
+                toHigher = in[w - q] << b;
+                if( b && w >= q + 1 )
+                    toHigher |= in[w - q - 1] >> ( 64 - b );
+            }
+            if( w + q < nWords ){
+                toLower = in[w + q] >> b;
+                if( b && w + q + 1 < nWords )
+                    toLower |= in[w + q + 1] << ( 64 - b );
+            }
+            out[w] |= toHigher | toLower;
+        }
+    }
+}
+
+NeighborhoodMask::NeighborhoodMask(unsigned int nI, unsigned int nJ, unsigned int nK) :
+    _nI( nI ),
+    _nJ( nJ ),
+    _nK( nK ),
+    _wordsPerRow( ( nI + 63 ) / 64 ),
+    _words( (size_t)_wordsPerRow * nJ * nK, 0 )
+{
+}
+
+void NeighborhoodMask::dilate(int radius)
+{
+    if( radius <= 0 || _words.empty() )
+        return;
+    unsigned int nThreads = std::max( 1u, std::thread::hardware_concurrency() );
+
+    //dilate along I and J, distributing the slices among the threads
+    {
+        unsigned int nThreadsIJ = std::min( nThreads, _nK );
+        std::vector<std::thread> threads;
+        for( unsigned int iThread = 0; iThread < nThreadsIJ; ++iThread )
+            threads.push_back( std::thread( &NeighborhoodMask::dilateSlicesIJ, this, radius,
+                                            (unsigned int)( (size_t)_nK * iThread / nThreadsIJ ),
+                                            (unsigned int)( (size_t)_nK * ( iThread + 1 ) / nThreadsIJ ) ) );
+        for( std::thread& thread : threads )
+            thread.join();
+    }
+
+    //dilate along K, distributing the rows among the threads
+    if( _nK > 1 ){
+        unsigned int nThreadsK = std::min( nThreads, _nJ );
+        std::vector<std::thread> threads;
+        for( unsigned int iThread = 0; iThread < nThreadsK; ++iThread )
+            threads.push_back( std::thread( &NeighborhoodMask::dilateRowsK, this, radius,
+                                            (unsigned int)( (size_t)_nJ * iThread / nThreadsK ),
+                                            (unsigned int)( (size_t)_nJ * ( iThread + 1 ) / nThreadsK ) ) );
+        for( std::thread& thread : threads )
+            thread.join();
+    }
+}
+
+void NeighborhoodMask::dilateSlicesIJ(int radius, unsigned int firstK, unsigned int endK)
+{
+    //the unused bits of the last word of each row must stay cleared
+    const uint64_t lastWordMask = ( _nI % 64 ) ? ( 1ULL << ( _nI % 64 ) ) - 1 : ~0ULL;
+    std::vector<uint64_t> copy( (size_t)_wordsPerRow * _nJ );
+    for( unsigned int k = firstK; k < endK; ++k ){
+        uint64_t* slice = &_words[ rowOffset( 0, k ) ];
+        //along I: shift the bits within each row
+        for( unsigned int j = 0; j < _nJ; ++j ){
+            uint64_t* row = slice + (size_t)j * _wordsPerRow;
+            uint64_t* rowCopy = &copy[0];
+            for( int covered = 0, s; covered < radius; covered += s ){
+                s = nextShift( covered, radius );
+                std::copy( row, row + _wordsPerRow, rowCopy );
+                orShiftedRow( rowCopy, row, _wordsPerRow, s );
+                row[ _wordsPerRow - 1 ] &= lastWordMask;
+            }
+        }
+        //along J: OR whole rows
+        for( int covered = 0, s; covered < radius; covered += s ){
+            s = nextShift( covered, radius );
+            std::copy( slice, slice + copy.size(), copy.begin() );
+            for( unsigned int j = 0; j < _nJ; ++j ){
+                uint64_t* row = slice + (size_t)j * _wordsPerRow;
+                if( j >= (unsigned int)s ){
+                    const uint64_t* rowBefore = &copy[ (size_t)( j - s ) * _wordsPerRow ];
+                    for( unsigned int w = 0; w < _wordsPerRow; ++w )
+                        row[w] |= rowBefore[w];
+                }
+                if( j + s < _nJ ){
+                    const uint64_t* rowAfter = &copy[ (size_t)( j + s ) * _wordsPerRow ];
+                    for( unsigned int w = 0; w < _wordsPerRow; ++w )
+                        row[w] |= rowAfter[w];
+                }
+            }
+        }
+    }
+}
+
+void NeighborhoodMask::dilateRowsK(int radius, unsigned int firstJ, unsigned int endJ)
+{
+    //the rows of a given j across all slices are gathered in a contiguous buffer
+    std::vector<uint64_t> column( (size_t)_wordsPerRow * _nK );
+    for( unsigned int j = firstJ; j < endJ; ++j ){
+        for( int covered = 0, s; covered < radius; covered += s ){
+            s = nextShift( covered, radius );
+            for( unsigned int k = 0; k < _nK; ++k )
+                std::copy( &_words[ rowOffset( j, k ) ], &_words[ rowOffset( j, k ) ] + _wordsPerRow,
+                           &column[ (size_t)k * _wordsPerRow ] );
+            for( unsigned int k = 0; k < _nK; ++k ){
+                uint64_t* row = &_words[ rowOffset( j, k ) ];
+                if( k >= (unsigned int)s ){
+                    const uint64_t* rowBefore = &column[ (size_t)( k - s ) * _wordsPerRow ];
+                    for( unsigned int w = 0; w < _wordsPerRow; ++w )
+                        row[w] |= rowBefore[w];
+                }
+                if( k + s < _nK ){
+                    const uint64_t* rowAfter = &column[ (size_t)( k + s ) * _wordsPerRow ];
+                    for( unsigned int w = 0; w < _wordsPerRow; ++w )
+                        row[w] |= rowAfter[w];
+                }
+            }
+        }
+    }
+}
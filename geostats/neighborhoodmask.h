@@ -0,0 +1,55 @@
+#ifndef NEIGHBORHOODMASK_H
+#define NEIGHBORHOODMASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * The NeighborhoodMask class is a bit volume with one flag per grid cell.  The flags of each grid row
+ * (cells along I) are packed in 64-bit words, so whole rows are combined with a few bitwise operations.
+ * It is used in NDVEstimationRunner to flag the cells that have valued cells in their search neighborhood.
+ */
+class NeighborhoodMask
+{
+public:
+    /** Creates a mask for a grid with the given dimensions with all flags cleared. */
+    NeighborhoodMask( unsigned int nI, unsigned int nJ, unsigned int nK );
+
+    /** Sets the flag of the given cell. */
+    inline void set( unsigned int i, unsigned int j, unsigned int k ){
+        _words[ rowOffset( j, k ) + ( i >> 6 ) ] |= 1ULL << ( i & 63 );
+    }
+
+    /** Returns whether the flag of the given cell is set. */
+    inline bool isSet( unsigned int i, unsigned int j, unsigned int k ) const {
+        return ( _words[ rowOffset( j, k ) + ( i >> 6 ) ] >> ( i & 63 ) ) & 1;
+    }
+
+    /**
+     * Sets the flags of all cells within the given number of cells of a flagged cell along each axis
+     * (a box of 2*radius+1 cells per side), which is the same as repeating a 3x3x3 dilation radius times.
+     * The box is separable, so it is applied as three 1D passes (along I, J and K).  Each pass grows the
+     * dilated span by doubling, so the cost is proportional to log(radius) instead of radius.  The passes
+     * are run in parallel over slices (I and J) or rows (K).
+     */
+    void dilate( int radius );
+
+private:
+    unsigned int _nI, _nJ, _nK;
+    /** Number of 64-bit words per grid row. */
+    unsigned int _wordsPerRow;
+    std::vector< uint64_t > _words;
+
+    inline size_t rowOffset( unsigned int j, unsigned int k ) const {
+        return ( (size_t)k * _nJ + j ) * _wordsPerRow;
+    }
+
+    /** Dilates along I and then along J the slices from firstK to endK - 1. */
+    void dilateSlicesIJ( int radius, unsigned int firstK, unsigned int endK );
+
+    /** Dilates along K the rows from firstJ to endJ - 1 of all slices. */
+    void dilateRowsK( int radius, unsigned int firstJ, unsigned int endJ );
+};
+
+#endif // NEIGHBORHOODMASK_H
@@ -3,6 +3,8 @@
 #include "searchstrategy.h"
 #include <utility>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 typedef std::pair<IndexedSpatialLocationPtr, double> IndexedSpatialLocationPtr_and_Distance_Pair;
 
@@ -147,6 +149,12 @@ void SearchEllipsoid::getBBox( double centerX, double centerY, double centerZ,
 
 bool SearchEllipsoid::isInside( double centerX, double centerY, double centerZ,
 								double x,       double y,       double z        ) const
+{
+	return getNormalizedDistance( centerX, centerY, centerZ, x, y, z ) <= 1.0;
+}
+
+double SearchEllipsoid::getNormalizedDistance( double centerX, double centerY, double centerZ,
+											   double x,       double y,       double z        ) const
 {
 	double localX = x - centerX;
 	double localY = y - centerY;
@@ -156,27 +164,52 @@ bool SearchEllipsoid::isInside( double centerX, double centerY, double centerZ,
 	double dx = localX/m_hMin;
 	double dy = localY/m_hMax;
 	double dz = localZ/m_hVert;
-    return dx*dx + dy*dy + dz*dz <= 1.0;
+	return std::sqrt( dx*dx + dy*dy + dz*dz );
+}
+
+double SearchEllipsoid::getMinDistanceScale() const
+{
+	//the rotation preserves lengths, so the scaling by the longest semi-axis is the smallest possible.
+	return 1.0 / std::max( m_hMax, std::max( m_hMin, m_hVert ) );
+}
+
+void SearchEllipsoid::getSectorQuotas( uint & numberOfSectors, uint & minSamplesPerSector, uint & maxSamplesPerSector ) const
+{
+	numberOfSectors = m_numberOfSectors;
+	minSamplesPerSector = m_minSamplesPerSector;
+	maxSamplesPerSector = m_maxSamplesPerSector;
+}
+
+uint SearchEllipsoid::getSector( double centerX, double centerY, double centerZ,
+								 double x,       double y,       double z        ) const
+{
+	Q_UNUSED( centerZ );
+	Q_UNUSED( z );
+	if( m_numberOfSectors < 2 )
+		return 0;
+	//Compute the azimth span (it is the same for all the sectors).
+	double azimuthSpan = 360.0 / m_numberOfSectors;
+	//Get the azimuth of the location with respect to the reference location.
+	double azimuth = ImageJockeyUtils::getAzimuth( x, y, centerX, centerY );
+	//Compute the index of the sector corresponding to the azimuth.
+	uint sector = static_cast<int>(azimuth) / static_cast<int>(azimuthSpan); //integer division
+	//the truncation of the span (e.g. 7 sectors) may result in one sector too many near 360 degrees.
+	return std::min( sector, m_numberOfSectors - 1 );
 }
 
 void SearchEllipsoid::performSpatialFilter(double centerX, double centerY, double centerZ,
 										   std::vector<IndexedSpatialLocationPtr>& samplesLocations,
 										   const SearchStrategy & parentSearchStrategy) const
 {
-	Q_UNUSED( centerZ );
 	//Create the azimuth bins.
 	std::vector< std::vector<IndexedSpatialLocationPtr_and_Distance_Pair> > bins( m_numberOfSectors );
-	//Compute the azimth span (it is the same for all the bins).
-	double azimuthSpan = 360.0 / m_numberOfSectors;
 	//For each sample location.
 	{
 		std::vector<IndexedSpatialLocationPtr>::iterator it = samplesLocations.begin();
 		for( ; it != samplesLocations.end(); ++it ){
 			IndexedSpatialLocationPtr sampleLocation = *it;
-			//Get its azimuth with respect to the reference location.
-			double azimuth = ImageJockeyUtils::getAzimuth( sampleLocation->_x, sampleLocation->_y, centerX, centerY );
-			//Compute the index of the bin corresponding to the azimuth.
-			int binIndex = static_cast<int>(azimuth) / static_cast<int>(azimuthSpan); //integer division
+			//Get the index of the bin corresponding to its azimuth with respect to the reference location.
+			uint binIndex = getSector( centerX, centerY, centerZ, sampleLocation->_x, sampleLocation->_y, sampleLocation->_z );
 			//Compute the distance between the location and the reference location
 			double dx = sampleLocation->_x - centerX;
 			double dy = sampleLocation->_y - centerY;
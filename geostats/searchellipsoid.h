@@ -23,6 +23,14 @@ public:
 						  double& maxX, double& maxY, double& maxZ ) const;
 	virtual bool isInside(double centerX, double centerY, double centerZ,
 						  double x, double y, double z ) const;
+	virtual double getNormalizedDistance( double centerX, double centerY, double centerZ,
+										  double x, double y, double z ) const;
+	/** The inverse of the longest semi-axis. */
+	virtual double getMinDistanceScale() const;
+	virtual void getSectorQuotas( uint& numberOfSectors, uint& minSamplesPerSector, uint& maxSamplesPerSector ) const;
+	/** The sectors divide the azimuth range (in XY plane) into equal parts, starting from north (zero azimuth). */
+	virtual uint getSector( double centerX, double centerY, double centerZ,
+							double x, double y, double z ) const;
 
 	/** If the user set just one sector (entire azimuth span) then effectivelly there is no filtering. */
 	virtual bool hasSpatialFiltering() const { return m_numberOfSectors > 1; }
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <vector>
+#include <qglobal.h>
 #include "indexedspatiallocation.h"
 
 class SearchStrategy;
@@ -22,6 +23,29 @@ public:
 	virtual bool isInside(double centerX, double centerY, double centerZ,
 						  double x, double y, double z ) const = 0;
 
+	/** Returns the distance between the given point and the center of the neighborhood in the neighborhood's own
+	 * metric (e.g. anisotropic), such that the distance is 1.0 at the neighborhood's boundary.
+	 */
+	virtual double getNormalizedDistance( double centerX, double centerY, double centerZ,
+										  double x, double y, double z ) const = 0;
+
+	/** Returns a factor f such that getNormalizedDistance() >= f * (Euclidean distance) for any point.  This allows
+	 * searches that visit the points in increasing Euclidean distance to know when the remaining points are
+	 * either outside the neighborhood or farther than the ones already found.
+	 */
+	virtual double getMinDistanceScale() const = 0;
+
+	/** Returns the number of sectors the neighborhood is divided into and the minimum and maximum number of
+	 * samples each sector must have (see performSpatialFilter()).  Neighborhoods without sectors return one sector.
+	 */
+	virtual void getSectorQuotas( uint& numberOfSectors, uint& minSamplesPerSector, uint& maxSamplesPerSector ) const = 0;
+
+	/** Returns the sector (0 to number of sectors - 1) of the given point with respect to the neighborhood
+	 * centered at (centerX, centerY, centerZ).
+	 */
+	virtual uint getSector( double centerX, double centerY, double centerZ,
+							double x, double y, double z ) const = 0;
+
     /** Returns whether the search neighborhood has some additional spatial filtering
      * other than the simple n-nearest points (e.g. octant/sector search).  That is,
      * whether the implementation has something to do in performSpatialFilter() method.
@@ -0,0 +1,739 @@
+#include "sequentialgaussiansimulation.h"
+#include "krigingsolver.h"
+#include "gridcell.h"
+#include "domain/pointset.h"
+#include "domain/cartesiangrid.h"
+#include "domain/variogrammodel.h"
+#include "domain/application.h"
+#include "domain/auxiliary/columnardatastore.h"
+
+#include <QProgressDialog>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+    /** Same tolerance used in sgsim to detect coincident locations (squared distance). */
+    const double EPSLON = 0.000001;
+
+    /** Kriging matrices with larger condition numbers are deemed singular. */
+    const double MAX_CONDITION_NUMBER = 1.0E15;
+
+    /** Number of nodes simulated by a thread between updates of the shared progress counter. */
+    const unsigned int PROGRESS_UPDATE_INTERVAL = 4096;
+
+    /** Returns the standard normal quantile of a cumulative probability (GSLIB's gauinv). */
+    double gaussianQuantile( double p ){
+        const double lim = 1.0e-10;
+        const double p0 = -0.322232431088,   p1 = -1.0,               p2 = -0.342242088547,
+                     p3 = -0.0204231210245,  p4 = -0.0000453642210148;
+        const double q0 = 0.0993484626060,   q1 = 0.588581570495,     q2 = 0.531103462366,
+                     q3 = 0.103537752850,    q4 = 0.0038560700634;
+        if( p < lim )
+            return -1.0e10;
+        if( p > 1.0 - lim )
+            return 1.0e10;
+        if( p == 0.5 )
+            return 0.0;
+        double pp = p > 0.5 ? 1.0 - p : p;
+        double y = std::sqrt( std::log( 1.0 / ( pp * pp ) ) );
+        double xp = y + ((((y*p4+p3)*y+p2)*y+p1)*y+p0) / ((((y*q4+q3)*y+q2)*y+q1)*y+q0);
+        return p > 0.5 ? xp : -xp;
+    }
+
+    /** Returns a standard normal draw, by the inverse of the cumulative distribution (as sgsim does). */
+    double gaussianDraw( std::mt19937& randomEngine ){
+        return gaussianQuantile( SequentialSimulationUtils::uniformDraw( randomEngine ) );
+    }
+
+    /** Returns the standard normal cumulative probability of a value (GSLIB's gcum). */
+    double gaussianCumulative( double x ){
+        return 0.5 * std::erfc( -x / std::sqrt( 2.0 ) );
+    }
+
+    /** Power interpolation between (xLow, yLow) and (xHigh, yHigh) (GSLIB's powint). */
+    double powerInterpolation( double xLow, double xHigh, double yLow, double yHigh, double x, double power ){
+        if( xHigh - xLow < EPSLON )
+            return ( yHigh + yLow ) / 2.0;
+        return yLow + ( yHigh - yLow ) * std::pow( ( x - xLow ) / ( xHigh - xLow ), power );
+    }
+
+    /** Returns the linear interpolation of x in the increasing values xs, clamped to the end values ys. */
+    double interpolate( double x, const std::vector<double>& xs, const std::vector<double>& ys ){
+        if( x <= xs.front() )
+            return ys.front();
+        if( x >= xs.back() )
+            return ys.back();
+        size_t j = std::upper_bound( xs.begin(), xs.end(), x ) - xs.begin();
+        return powerInterpolation( xs[j-1], xs[j], ys[j-1], ys[j], x, 1.0 );
+    }
+
+    /**
+     * Builds a normal score transform table from the given values and weights: the distinct values in increasing
+     * order and the standard normal quantiles of their cumulative frequencies, taken at the middle of the frequency
+     * of each value (as GSLIB's nscore does).  Tied values share the middle of their total frequency.
+     * @return False if the total weight is not positive.
+     */
+    bool buildTransformTable( const std::vector<double>& values, const std::vector<double>& weights,
+                              std::vector<double>& tableValues, std::vector<double>& tableNormalScores ){
+        std::vector<size_t> order( values.size() );
+        std::iota( order.begin(), order.end(), 0 );
+        std::sort( order.begin(), order.end(), [&values]( size_t a, size_t b ){ return values[a] < values[b]; } );
+        std::vector<double> tableWeights;
+        tableValues.clear();
+        for( size_t index : order ){
+            double weight = std::max( 0.0, weights[index] );
+            if( ! tableValues.empty() && values[index] == tableValues.back() )
+                tableWeights.back() += weight;
+            else {
+                tableValues.push_back( values[index] );
+                tableWeights.push_back( weight );
+            }
+        }
+        double totalWeight = std::accumulate( tableWeights.begin(), tableWeights.end(), 0.0 );
+        if( totalWeight <= 0.0 )
+            return false;
+        tableNormalScores.resize( tableValues.size() );
+        double cumulativeWeight = 0.0;
+        for( size_t i = 0; i < tableValues.size(); ++i ){
+            tableNormalScores[i] = gaussianQuantile( ( cumulativeWeight + tableWeights[i] / 2.0 ) / totalWeight );
+            cumulativeWeight += tableWeights[i];
+        }
+        return true;
+    }
+}
+
+/** The path and kriging objects of one simulation thread of SequentialGaussianSimulation, reused for all of its nodes. */
+struct SequentialGaussianSimulationWorkspace
+{
+    /** The random path (cell indexes) of the current realization and a buffer to reorder it by multigrid. */
+    std::vector<uint> path, pathBuffer;
+    /** The normal scores of the current realization (NaN at the nodes not simulated yet).  Single precision halves
+     * the memory taken by each of the realizations simulated at once. */
+    std::vector<float> normalScores;
+    /** The data lines and the template entries of the simulated nodes used for the current node. */
+    std::vector<uint> data, nodes;
+    /** Number of simulated nodes found in each search sector. */
+    std::vector<uint> sectorCounts;
+    /** The locations, normal scores and secondary values of the conditioning data and nodes of the current node. */
+    std::vector<double> x, y, z, values, secondaryValues;
+    /** Scratch arrays for the separation vectors and the covariances of a matrix column. */
+    std::vector<double> dx, dy, dz, covariances;
+    /** The kriging matrix and its right-hand side. */
+    Eigen::MatrixXd lhs;
+    Eigen::VectorXd rhs;
+    Eigen::VectorXd weights;
+    KrigingSolver solver;
+};
+
+SequentialGaussianSimulation::SequentialGaussianSimulation(PointSet *pointSet, CartesianGrid *simulationGrid) :
+    m_pointSet( pointSet ),
+    m_grid( simulationGrid ),
+    m_column( 0 ),
+    m_weightColumn( 0 ),
+    m_secondaryColumn( 0 ),
+    m_secondaryGrid( nullptr ),
+    m_secondaryGridColumn( 0 ),
+    m_tmin( -1.0e21 ),
+    m_tmax( 1.0e21 ),
+    m_transform( true ),
+    m_zmin( 0.0 ),
+    m_zmax( 0.0 ),
+    m_lowerTailOption( 1 ),
+    m_upperTailOption( 1 ),
+    m_lowerTailParameter( 1.0 ),
+    m_upperTailParameter( 1.0 ),
+    m_nRealizations( 1 ),
+    m_seed( 69069 ),
+    m_maxSimulatedNodes( 12 ),
+    m_assignDataToNodes( false ),
+    m_nMultigridRefinements( 0 ),
+    m_covarianceTableNI( 25 ),
+    m_covarianceTableNJ( 25 ),
+    m_covarianceTableNK( 5 ),
+    m_variogramModel( nullptr ),
+    m_kType( SequentialGaussianSimulationType::SK ),
+    m_correlation( 0.0 ),
+    m_varianceReduction( 1.0 ),
+    m_covarianceScale( 1.0 ),
+    m_nDrifts( 0 )
+{
+}
+
+void SequentialGaussianSimulation::setVariable(uint column, uint weightColumn)
+{
+    m_column = column;
+    m_weightColumn = weightColumn;
+}
+
+void SequentialGaussianSimulation::setSecondaryVariable(uint column, CartesianGrid *secondaryGrid, uint secondaryGridColumn)
+{
+    m_secondaryColumn = column;
+    m_secondaryGrid = secondaryGrid;
+    m_secondaryGridColumn = secondaryGridColumn;
+}
+
+void SequentialGaussianSimulation::setTrimmingLimits(double tmin, double tmax)
+{
+    m_tmin = tmin;
+    m_tmax = tmax;
+}
+
+void SequentialGaussianSimulation::setTransform(bool transform)
+{
+    m_transform = transform;
+}
+
+void SequentialGaussianSimulation::setReferenceDistribution(const std::vector<double> &values, const std::vector<double> &weights)
+{
+    m_referenceValues = values;
+    m_referenceWeights = weights;
+    m_referenceWeights.resize( values.size(), 1.0 );
+}
+
+void SequentialGaussianSimulation::setTailExtrapolation(double zmin, double zmax,
+                                                        int lowerTailOption, double lowerTailParameter,
+                                                        int upperTailOption, double upperTailParameter)
+{
+    m_zmin = zmin;
+    m_zmax = zmax;
+    m_lowerTailOption = lowerTailOption;
+    m_lowerTailParameter = lowerTailParameter;
+    m_upperTailOption = upperTailOption;
+    m_upperTailParameter = upperTailParameter;
+}
+
+void SequentialGaussianSimulation::setNumberOfRealizations(uint nRealizations)
+{
+    m_nRealizations = nRealizations;
+}
+
+void SequentialGaussianSimulation::setSeed(uint seed)
+{
+    m_seed = seed;
+}
+
+void SequentialGaussianSimulation::setSearchStrategy(SearchStrategyPtr searchStrategy)
+{
+    m_searchStrategy = searchStrategy;
+}
+
+void SequentialGaussianSimulation::setMaxSimulatedNodes(uint maxSimulatedNodes)
+{
+    m_maxSimulatedNodes = maxSimulatedNodes;
+}
+
+void SequentialGaussianSimulation::setAssignDataToNodes(bool assignDataToNodes)
+{
+    m_assignDataToNodes = assignDataToNodes;
+}
+
+void SequentialGaussianSimulation::setMultigrid(uint nRefinements)
+{
+    m_nMultigridRefinements = nRefinements;
+}
+
+void SequentialGaussianSimulation::setCovarianceTableSize(uint nI, uint nJ, uint nK)
+{
+    m_covarianceTableNI = nI;
+    m_covarianceTableNJ = nJ;
+    m_covarianceTableNK = nK;
+}
+
+void SequentialGaussianSimulation::setVariogramModel(VariogramModel *variogramModel)
+{
+    m_variogramModel = variogramModel;
+}
+
+void SequentialGaussianSimulation::setKrigingType(SequentialGaussianSimulationType kType, double correlation, double varianceReduction)
+{
+    m_kType = kType;
+    m_correlation = correlation;
+    m_varianceReduction = varianceReduction;
+}
+
+bool SequentialGaussianSimulation::run(const QString outputPath)
+{
+    if( ! m_pointSet || ! m_grid || ! m_variogramModel || ! m_searchStrategy || m_column < 1 || m_nRealizations < 1 ||
+        m_grid->getNX() * m_grid->getNY() * m_grid->getNZ() == 0 ){
+        Application::instance()->logError( "SequentialGaussianSimulation::run(): the data set, the simulation grid, the variable,"
+                                           " the variogram model, the search strategy and the number of realizations must be set.", true );
+        return false;
+    }
+    bool usesSecondary = m_kType == SequentialGaussianSimulationType::LVM ||
+                         m_kType == SequentialGaussianSimulationType::KED ||
+                         m_kType == SequentialGaussianSimulationType::ColCoK;
+    if( usesSecondary && ( ! m_secondaryGrid || m_secondaryGridColumn < 1 ||
+                           ( m_kType != SequentialGaussianSimulationType::ColCoK && m_secondaryColumn < 1 ) ) ){
+        Application::instance()->logError( "SequentialGaussianSimulation::run(): simulation with a locally varying mean, with an"
+                                           " external drift or with collocated cokriging requires the secondary variable"
+                                           " in a grid (and in the data set, except for collocated cokriging).", true );
+        return false;
+    }
+
+    //compile the variogram model once for all kriging operations.
+    m_variogramModel->readParameters();
+    m_variogram = CompiledVariogramModel( m_variogramModel );
+    if( m_variogram.getSill() <= 0.0 ){
+        Application::instance()->logError( "SequentialGaussianSimulation::run(): the variogram model has no sill.", true );
+        return false;
+    }
+    m_covarianceScale = 1.0 / m_variogram.getSill();
+
+    if( ! prepareData() )
+        return false;
+    m_nodeTemplate.build( *m_grid, *m_searchStrategy->m_searchNB,
+                          m_covarianceTableNI, m_covarianceTableNJ, m_covarianceTableNK,
+                          { [this]( double dx, double dy, double dz ){ return covariance( dx, dy, dz ); } }, 0 );
+
+    //the unbiasedness condition (OK and KED) and the external drift (KED).
+    m_nDrifts = 0;
+    if( m_kType == SequentialGaussianSimulationType::OK )
+        m_nDrifts = 1;
+    else if( m_kType == SequentialGaussianSimulationType::KED )
+        m_nDrifts = 2;
+
+    //the realizations are simulated straight into the sidecar of the output file.
+    size_t nCells = (size_t)m_grid->getNX() * m_grid->getNY() * m_grid->getNZ();
+    size_t nValues = nCells * m_nRealizations;
+    ColumnarDataStore realizations;
+    bool isMapped = SequentialSimulationUtils::beginRealizations( outputPath, nValues, realizations );
+
+    QProgressDialog progressDialog;
+    progressDialog.show();
+    SequentialSimulationProgress progressInfo;
+    double* values = realizations.column( 0 );
+    SequentialSimulationUtils::simulateRealizations( progressDialog, "sequential Gaussian simulation",
+                                                     m_nRealizations, nValues, progressInfo,
+                                                     [this, &progressInfo, values](){
+        simulateRealizations( &progressInfo, values );
+    } );
+
+    if( progressInfo.nFailed ){
+        Application::instance()->logWarn( "SequentialGaussianSimulation::run(): " + QString::number(progressInfo.nFailed.load()) +
+                                          " kriging operation(s) failed (singular system).  The nodes were drawn from the"
+                                          " global distribution." );
+    }
+
+    m_spatialIndex.clear();
+
+    return SequentialSimulationUtils::saveRealizations( progressDialog, outputPath, "SGSIM realizations simulated by GammaRay",
+                                                        realizations, isMapped );
+}
+
+void SequentialGaussianSimulation::simulateRealizations(SequentialSimulationProgress *progressInfo, double *realizations)
+{
+    size_t nCells = (size_t)m_grid->getNX() * m_grid->getNY() * m_grid->getNZ();
+
+    //the buffers are reused for all realizations simulated by this thread
+    SequentialGaussianSimulationWorkspace workspace;
+    workspace.normalScores.resize( nCells );
+    workspace.sectorCounts.resize( m_nodeTemplate.getSectorCount() );
+
+    for( uint iReal = progressInfo->nextRealization++; iReal < m_nRealizations; iReal = progressInfo->nextRealization++ ){
+        simulateRealization( iReal, realizations + iReal * nCells, workspace, progressInfo );
+        ++progressInfo->nRealizationsDone;
+    }
+}
+
+void SequentialGaussianSimulation::simulateRealization(uint realization, double *values,
+                                                       SequentialGaussianSimulationWorkspace &workspace,
+                                                       SequentialSimulationProgress *progressInfo) const
+{
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    size_t nCells = (size_t)nI * nJ * m_grid->getNZ();
+
+    //each realization has its own random number sequence, regardless of the thread simulating it.
+    std::seed_seq seeds{ m_seed, realization };
+    std::mt19937 randomEngine( seeds );
+
+    //the nodes with data assigned to them are known from the start and are not in the path.
+    std::vector<uint>& path = workspace.path;
+    path.clear();
+    float* normalScores = workspace.normalScores.data();
+    for( size_t iCell = 0; iCell < nCells; ++iCell ){
+        if( m_nodeNormalScores.empty() || std::isnan( m_nodeNormalScores[iCell] ) ){
+            normalScores[iCell] = std::numeric_limits<float>::quiet_NaN();
+            path.push_back( iCell );
+        } else {
+            normalScores[iCell] = m_nodeNormalScores[iCell];
+            values[iCell] = m_nodeValues[iCell];
+        }
+    }
+    SequentialSimulationUtils::makeRandomPath( path, nI, nJ, m_nMultigridRefinements, randomEngine, workspace.pathBuffer );
+
+    int nFailed = 0;
+    unsigned int nNodes = 0;
+    for( uint iCell : path ){
+        uint i = iCell % nI;
+        uint j = ( iCell / nI ) % nJ;
+        uint k = iCell / nI / nJ;
+        double normalScore;
+        if( ! simulateNode( i, j, k, randomEngine, workspace, normalScore ) )
+            ++nFailed;
+        normalScores[iCell] = normalScore;
+        values[iCell] = m_transform ? fromNormalScore( normalScore ) : normalScore;
+        if( ++nNodes == PROGRESS_UPDATE_INTERVAL ){
+            progressInfo->nNodesDone += nNodes;
+            nNodes = 0;
+        }
+    }
+    progressInfo->nNodesDone += nNodes + ( nCells - path.size() );
+    progressInfo->nFailed += nFailed;
+}
+
+bool SequentialGaussianSimulation::simulateNode(uint i, uint j, uint k, std::mt19937 &randomEngine,
+                                                SequentialGaussianSimulationWorkspace &workspace, double &normalScore) const
+{
+    int nI = m_grid->getNX();
+    int nJ = m_grid->getNY();
+    size_t iCell = i + ( j + (size_t)k * nJ ) * nI;
+    GridCell simulationCell( m_grid, -1, i, j, k );
+    const SpatialLocation& center = simulationCell._center;
+    double secondaryAtCell = m_secondaryGridValues.empty() ? 0.0 : m_secondaryGridValues[iCell];
+    bool isCollocatedCokriging = m_kType == SequentialGaussianSimulationType::ColCoK;
+
+    //the nearest data
+    std::vector<uint>& data = workspace.data;
+    data.clear();
+    if( ! m_assignDataToNodes ){
+        QList<uint> dataLines = m_spatialIndex.getNearestWithin( simulationCell, *m_dataSearchStrategy );
+        data.assign( dataLines.begin(), dataLines.end() );
+    }
+
+    //the nearest simulated nodes, in the order of the search template (decreasing covariance).
+    const float* normalScores = workspace.normalScores.data();
+    std::vector<uint>& nodes = workspace.nodes;
+    m_nodeTemplate.findSimulatedNodes( i, j, k, m_maxSimulatedNodes,
+                                       [normalScores]( size_t iNode ){ return ! std::isnan( normalScores[iNode] ); },
+                                       workspace.sectorCounts, nodes );
+
+    int nData = data.size();
+    int n = nData + nodes.size();
+
+    //the locations, normal scores and secondary values of the data followed by those of the nodes.
+    workspace.x.resize( n );
+    workspace.y.resize( n );
+    workspace.z.resize( n );
+    workspace.values.resize( n );
+    workspace.secondaryValues.resize( n );
+    for( int a = 0; a < nData; ++a ){
+        uint line = data[a];
+        workspace.x[a] = m_x[line];
+        workspace.y[a] = m_y[line];
+        workspace.z[a] = m_z[line];
+        workspace.values[a] = m_normalScores[line];
+        workspace.secondaryValues[a] = m_secondaryValues[line];
+    }
+    for( int a = nData; a < n; ++a ){
+        uint t = nodes[a - nData];
+        int di = m_nodeTemplate.getDI( t );
+        int dj = m_nodeTemplate.getDJ( t );
+        int dk = m_nodeTemplate.getDK( t );
+        size_t iNode = ( i + di ) + ( ( j + dj ) + (size_t)( k + dk ) * nJ ) * nI;
+        workspace.x[a] = center._x + di * m_grid->getDX();
+        workspace.y[a] = center._y + dj * m_grid->getDY();
+        workspace.z[a] = center._z + dk * m_grid->getDZ();
+        workspace.values[a] = normalScores[iNode];
+        workspace.secondaryValues[a] = m_secondaryGridValues.empty() ? 0.0 : m_secondaryGridValues[iNode];
+    }
+
+    //the global distribution: the local mean (LVM) or zero with unit variance.  In collocated cokriging, the
+    //collocated secondary value is always used.
+    double mean = m_kType == SequentialGaussianSimulationType::LVM ? secondaryAtCell : 0.0;
+    double variance = 1.0;
+    if( isCollocatedCokriging ){
+        mean = m_correlation * secondaryAtCell;
+        variance = ( 1.0 - m_correlation * m_correlation ) * m_varianceReduction;
+    }
+    if( n == 0 || n < (int)m_searchStrategy->m_minNumberOfSamples || n < m_nDrifts ){
+        normalScore = mean + std::sqrt( std::max( 0.0, variance ) ) * gaussianDraw( randomEngine );
+        return true;
+    }
+
+    //the kriging matrix.  Covariances involving data are computed, those between nodes are looked up.
+    int nEquations = n + ( isCollocatedCokriging ? 1 : 0 );
+    bool isOrdinaryKriging = m_kType == SequentialGaussianSimulationType::OK;
+    bool isBordered = m_kType == SequentialGaussianSimulationType::KED;
+    if( isBordered )
+        nEquations += m_nDrifts;
+    Eigen::MatrixXd& lhs = workspace.lhs;
+    lhs.resize( nEquations, nEquations );
+    workspace.dx.resize( n );
+    workspace.dy.resize( n );
+    workspace.dz.resize( n );
+    workspace.covariances.resize( n );
+    double* dx = workspace.dx.data();
+    double* dy = workspace.dy.data();
+    double* dz = workspace.dz.data();
+    double* covariances = workspace.covariances.data();
+    for( int b = 0; b < n; ++b ){
+        int nComputed = std::min( b + 1, nData );
+        for( int a = 0; a < nComputed; ++a ){
+            dx[a] = workspace.x[b] - workspace.x[a];
+            dy[a] = workspace.y[b] - workspace.y[a];
+            dz[a] = workspace.z[b] - workspace.z[a];
+        }
+        m_variogram.covariance( dx, dy, dz, nComputed, covariances );
+        for( int a = 0; a < nComputed; ++a ){
+            double c = ( dx[a]*dx[a] + dy[a]*dy[a] + dz[a]*dz[a] < EPSLON ) ? 1.0 : covariances[a] * m_covarianceScale;
+            lhs( a, b ) = c;
+            lhs( b, a ) = c;
+        }
+        if( b >= nData ){
+            uint tb = nodes[b - nData];
+            for( int a = nData; a <= b; ++a ){
+                double c = m_nodeTemplate.getCovariance( 0, nodes[a - nData], tb );
+                lhs( a, b ) = c;
+                lhs( b, a ) = c;
+            }
+        }
+    }
+
+    //the right-hand side: the covariances between the node and the data (computed) and the nodes (from the template).
+    Eigen::VectorXd& rhs = workspace.rhs;
+    rhs.resize( nEquations );
+    for( int a = 0; a < nData; ++a ){
+        dx[a] = center._x - workspace.x[a];
+        dy[a] = center._y - workspace.y[a];
+        dz[a] = center._z - workspace.z[a];
+    }
+    m_variogram.covariance( dx, dy, dz, nData, covariances );
+    for( int a = 0; a < nData; ++a )
+        rhs[a] = ( dx[a]*dx[a] + dy[a]*dy[a] + dz[a]*dz[a] < EPSLON ) ? 1.0 : covariances[a] * m_covarianceScale;
+    for( int a = nData; a < n; ++a )
+        rhs[a] = m_nodeTemplate.getCovariance( 0, nodes[a - nData] );
+
+    //collocated cokriging (Markov model): the covariances with the collocated secondary value are those with
+    //the node scaled by the correlation coefficient.
+    if( isCollocatedCokriging ){
+        for( int a = 0; a < n; ++a ){
+            lhs( a, n ) = m_correlation * rhs[a];
+            lhs( n, a ) = lhs( a, n );
+        }
+        lhs( n, n ) = 1.0;
+        rhs[n] = m_correlation;
+    }
+
+    //external drift: border the matrix with the unbiasedness condition and the secondary values.
+    if( isBordered ){
+        for( int a = 0; a < n; ++a ){
+            lhs( a, n ) = 1.0;
+            lhs( n, a ) = 1.0;
+            lhs( a, n + 1 ) = workspace.secondaryValues[a];
+            lhs( n + 1, a ) = workspace.secondaryValues[a];
+        }
+        lhs.bottomRightCorner( m_nDrifts, m_nDrifts ).setZero();
+        rhs[n] = 1.0;
+        rhs[n + 1] = secondaryAtCell;
+    }
+
+    //a singular matrix (e.g. duplicate data) is reported as a failed kriging and the global distribution is used.
+    bool isFactorized = isBordered ? workspace.solver.factorizeGeneral( lhs ) :
+                                     workspace.solver.factorizeCovariances( lhs );
+    if( ! isFactorized || workspace.solver.isIllConditioned( MAX_CONDITION_NUMBER ) ){
+        normalScore = mean + std::sqrt( std::max( 0.0, variance ) ) * gaussianDraw( randomEngine );
+        return false;
+    }
+
+    Eigen::VectorXd& weights = workspace.weights;
+    if( isOrdinaryKriging ){
+        double mu = workspace.solver.solveConstrained( rhs, 1.0, weights );
+        variance = 1.0 - weights.dot( rhs ) - mu;
+    } else {
+        workspace.solver.solve( rhs, weights );
+        variance = 1.0 - weights.dot( rhs );
+    }
+    if( isCollocatedCokriging )
+        variance *= m_varianceReduction;
+
+    //the simple kriging weights apply to the residuals of the (zero or local) mean.
+    double estimate = 0.0;
+    if( m_kType == SequentialGaussianSimulationType::LVM ){
+        estimate = secondaryAtCell;
+        for( int a = 0; a < n; ++a )
+            estimate += weights[a] * ( workspace.values[a] - workspace.secondaryValues[a] );
+    } else {
+        for( int a = 0; a < n; ++a )
+            estimate += weights[a] * workspace.values[a];
+        if( isCollocatedCokriging )
+            estimate += weights[n] * secondaryAtCell;
+    }
+
+    normalScore = estimate + std::sqrt( std::max( 0.0, variance ) ) * gaussianDraw( randomEngine );
+    return true;
+}
+
+double SequentialGaussianSimulation::covariance(double dx, double dy, double dz) const
+{
+    if( dx*dx + dy*dy + dz*dz < EPSLON )
+        return 1.0;
+    return ( m_variogram.getSill() - m_variogram.gamma( dx, dy, dz ) ) * m_covarianceScale;
+}
+
+bool SequentialGaussianSimulation::prepareData()
+{
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    uint nK = m_grid->getNZ();
+    size_t nCells = (size_t)nI * nJ * nK;
+    bool usesSecondaryData = m_kType == SequentialGaussianSimulationType::LVM ||
+                             m_kType == SequentialGaussianSimulationType::KED;
+
+    //copy the data locations and values, so the threads do not access the data file.
+    //the data outside the trimming limits (or without the secondary value, if it is used) are ignored.
+    m_pointSet->loadData();
+    uint nData = m_pointSet->getDataLineCount();
+    bool is3D = m_pointSet->is3D();
+    m_x.assign( nData, 0.0 );
+    m_y.assign( nData, 0.0 );
+    m_z.assign( nData, m_grid->getZ0() ); //as in sgsim, 2D data are at the elevation of the grid
+    m_secondaryValues.assign( nData, 0.0 );
+    std::vector<double> values( nData, 0.0 );
+    std::vector<double> weights( nData, 1.0 );
+    std::vector<uint> validLines;
+    validLines.reserve( nData );
+    for( uint iLine = 0; iLine < nData; ++iLine ){
+        double value = m_pointSet->data( iLine, m_column - 1 );
+        if( m_pointSet->isNDV( value ) || value < m_tmin || value >= m_tmax )
+            continue;
+        if( usesSecondaryData ){
+            double secondaryValue = m_pointSet->data( iLine, m_secondaryColumn - 1 );
+            if( m_pointSet->isNDV( secondaryValue ) )
+                continue;
+            m_secondaryValues[iLine] = secondaryValue;
+        }
+        if( m_weightColumn > 0 ){
+            double weight = m_pointSet->data( iLine, m_weightColumn - 1 );
+            weights[iLine] = m_pointSet->isNDV( weight ) ? 0.0 : weight;
+        }
+        m_x[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::X );
+        m_y[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::Y );
+        if( is3D )
+            m_z[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::Z );
+        values[iLine] = value;
+        validLines.push_back( iLine );
+    }
+    Application::instance()->logInfo( "SequentialGaussianSimulation::run(): " + QString::number( validLines.size() ) + " of " +
+                                      QString::number( nData ) + " data are within the trimming limits." );
+
+    //the normal score transform table, from the reference distribution or from the (declustered) data.
+    m_normalScores.assign( nData, 0.0 );
+    if( m_transform ){
+        bool ok;
+        if( ! m_referenceValues.empty() )
+            ok = buildTransformTable( m_referenceValues, m_referenceWeights, m_tableValues, m_tableNormalScores );
+        else {
+            std::vector<double> validValues, validWeights;
+            for( uint iLine : validLines ){
+                validValues.push_back( values[iLine] );
+                validWeights.push_back( weights[iLine] );
+            }
+            ok = buildTransformTable( validValues, validWeights, m_tableValues, m_tableNormalScores );
+        }
+        if( ! ok ){
+            Application::instance()->logError( "SequentialGaussianSimulation::run(): the distribution to transform into normal"
+                                               " scores is empty or has no positive weights.", true );
+            return false;
+        }
+        //the tails are extrapolated to the minimum and maximum values, which cannot be within the table.
+        m_zmin = std::min( m_zmin, m_tableValues.front() );
+        m_zmax = std::max( m_zmax, m_tableValues.back() );
+        for( uint iLine : validLines )
+            m_normalScores[iLine] = toNormalScore( values[iLine] );
+    } else
+        for( uint iLine : validLines )
+            m_normalScores[iLine] = values[iLine];
+
+    //the secondary values at the cells
+    m_secondaryGridValues.clear();
+    if( m_kType == SequentialGaussianSimulationType::LVM || m_kType == SequentialGaussianSimulationType::KED ||
+        m_kType == SequentialGaussianSimulationType::ColCoK ){
+        m_secondaryGrid->loadData();
+        if( m_secondaryGrid->getNX() != nI || m_secondaryGrid->getNY() != nJ || m_secondaryGrid->getNZ() != nK ){
+            Application::instance()->logError( "SequentialGaussianSimulation::run(): the grid with the secondary variable must have"
+                                               " the same cells as the simulation grid.", true );
+            return false;
+        }
+        m_secondaryGridValues.resize( nCells );
+        for( uint k = 0; k < nK; ++k )
+            for( uint j = 0; j < nJ; ++j )
+                for( uint i = 0; i < nI; ++i ){
+                    double value = m_secondaryGrid->dataIJK( m_secondaryGridColumn - 1, i, j, k );
+                    if( m_secondaryGrid->isNDV( value ) ){
+                        Application::instance()->logError( "SequentialGaussianSimulation::run(): the secondary variable must"
+                                                           " be informed at all cells of the grid.", true );
+                        return false;
+                    }
+                    m_secondaryGridValues[ i + ( j + (size_t)k * nJ ) * nI ] = value;
+                }
+        //in collocated cokriging, the secondary variable is transformed into normal scores with its own distribution.
+        if( m_kType == SequentialGaussianSimulationType::ColCoK ){
+            std::vector<double> secondaryTableValues, secondaryTableNormalScores;
+            buildTransformTable( m_secondaryGridValues, std::vector<double>( nCells, 1.0 ),
+                                 secondaryTableValues, secondaryTableNormalScores );
+            for( double& value : m_secondaryGridValues )
+                value = interpolate( value, secondaryTableValues, secondaryTableNormalScores );
+        }
+    }
+
+    //with the data assigned to the grid nodes, each node keeps the nearest datum within its cell.
+    m_nodeNormalScores.clear();
+    m_nodeValues.clear();
+    if( m_assignDataToNodes ){
+        std::vector<uint> nodeLines;
+        uint nOutside = SequentialSimulationUtils::assignDataToNodes( *m_grid, m_x, m_y, m_z, validLines, nodeLines );
+        m_nodeNormalScores.assign( nCells, std::numeric_limits<float>::quiet_NaN() );
+        m_nodeValues.assign( nCells, std::numeric_limits<double>::quiet_NaN() );
+        for( size_t iCell = 0; iCell < nCells; ++iCell ){
+            uint iLine = nodeLines[iCell];
+            if( iLine != SequentialSimulationUtils::NO_DATA_LINE ){
+                m_nodeNormalScores[iCell] = m_normalScores[iLine];
+                m_nodeValues[iCell] = values[iLine];
+            }
+        }
+        if( nOutside )
+            Application::instance()->logInfo( "SequentialGaussianSimulation::run(): " + QString::number( nOutside ) +
+                                              " data outside the grid were ignored." );
+        validLines.clear();
+    }
+    m_spatialIndex.fill( m_pointSet, validLines );
+
+    //the minimum number of samples applies to the data and the nodes together, so the data search has none.
+    m_dataSearchStrategy.reset( new SearchStrategy( m_searchStrategy->m_searchNB,
+                                                    m_searchStrategy->m_nb_samples,
+                                                    m_searchStrategy->m_minDistanceBetweenSamples, 0 ) );
+    return true;
+}
+
+double SequentialGaussianSimulation::toNormalScore(double value) const
+{
+    return interpolate( value, m_tableValues, m_tableNormalScores );
+}
+
+double SequentialGaussianSimulation::fromNormalScore(double normalScore) const
+{
+    //GSLIB's backtr: linear interpolation within the table, tail extrapolation beyond it.
+    double result;
+    if( normalScore <= m_tableNormalScores.front() ){
+        double cdfLow = gaussianCumulative( m_tableNormalScores.front() );
+        double power = m_lowerTailOption == 2 ? 1.0 / std::max( EPSLON, m_lowerTailParameter ) : 1.0;
+        result = powerInterpolation( 0.0, cdfLow, m_zmin, m_tableValues.front(), gaussianCumulative( normalScore ), power );
+    } else if( normalScore >= m_tableNormalScores.back() ){
+        double cdfHigh = gaussianCumulative( m_tableNormalScores.back() );
+        double cdf = gaussianCumulative( normalScore );
+        if( m_upperTailOption == 4 ){
+            double omega = std::max( EPSLON, m_upperTailParameter );
+            double lambda = std::pow( m_tableValues.back(), omega ) * ( 1.0 - cdfHigh );
+            result = std::pow( lambda / std::max( 1.0 - cdf, EPSLON ), 1.0 / omega );
+        } else {
+            double power = m_upperTailOption == 2 ? 1.0 / std::max( EPSLON, m_upperTailParameter ) : 1.0;
+            result = powerInterpolation( cdfHigh, 1.0, m_tableValues.back(), m_zmax, cdf, power );
+        }
+    } else
+        result = interpolate( normalScore, m_tableNormalScores, m_tableValues );
+    return std::min( m_zmax, std::max( m_zmin, result ) );
+}
@@ -0,0 +1,171 @@
+#ifndef SEQUENTIALGAUSSIANSIMULATION_H
+#define SEQUENTIALGAUSSIANSIMULATION_H
+
+#include "searchstrategy.h"
+#include "compiledvariogrammodel.h"
+#include "sequentialsimulationutils.h"
+#include "simulatednodetemplate.h"
+#include "spatialindex/spatialindexpoints.h"
+#include <QString>
+#include <random>
+#include <vector>
+
+class PointSet;
+class CartesianGrid;
+class VariogramModel;
+struct SequentialGaussianSimulationWorkspace;
+
+/** The kriging types of SequentialGaussianSimulation (the same codes of GSLIB's sgsim). */
+enum class SequentialGaussianSimulationType : int {
+    SK = 0,  /*!< Simple kriging (the mean of the normal scores is zero). */
+    OK,      /*!< Ordinary kriging. */
+    LVM,     /*!< Simple kriging with a locally varying mean (given by the secondary variable). */
+    KED,     /*!< Kriging with an external drift (given by the secondary variable). */
+    ColCoK   /*!< Collocated cokriging with the secondary variable (Markov model). */
+};
+
+/**
+ * The SequentialGaussianSimulation class simulates realizations of a variable on the cells of a Cartesian grid
+ * conditioned to point set samples in process, as an alternative to running GSLIB's sgsim program.  It follows
+ * sgsim's formulation: the data are transformed into normal scores (optionally with a reference distribution), the
+ * nodes are visited along a random path, optionally coarse multigrids first, and each node is drawn from the normal
+ * distribution given by kriging from the nearest data and previously simulated nodes, then the results are
+ * back-transformed with sgsim's tail extrapolation options.  The variogram model is standardized to a unit sill.
+ * The realizations are simulated concurrently, one per processor core.  Each realization has its own random number
+ * generator, seeded from the seed and the realization number, so the results do not depend on the number of threads.
+ * The random path and the Gaussian draws are computed from the generator's raw output, so they do not depend on the
+ * standard library either.
+ * The previously simulated nodes are searched with a template of grid offsets inside the search ellipsoid (see
+ * SimulatedNodeTemplate), built once and shared by all realizations.
+ */
+class SequentialGaussianSimulation
+{
+public:
+    /**
+     * @param pointSet The point set with the conditioning data.
+     * @param simulationGrid The grid whose cells are simulated.  Only its geometry is used.
+     */
+    SequentialGaussianSimulation( PointSet* pointSet, CartesianGrid* simulationGrid );
+
+    //@{
+    /** Set the simulation parameters (see GSLIB's sgsim documentation). */
+    /** The GEO-EAS indexes (first is 1) of the variable and of the declustering weights (zero if none) in the point set. */
+    void setVariable( uint column, uint weightColumn );
+    /** The GEO-EAS index of the local mean (LVM) or of the external drift (KED) in the point set and in the
+     * grid with its values at the simulation cells, which must have the same cells as the simulation grid.
+     * The local means must be in normal score units.  Collocated cokriging uses only the grid, whose values
+     * are transformed into normal scores. */
+    void setSecondaryVariable( uint column, CartesianGrid* secondaryGrid, uint secondaryGridColumn );
+    void setTrimmingLimits( double tmin, double tmax );
+    /** Whether the data are transformed into normal scores (and the results back-transformed).
+     * If not, the data must already be normal scores. */
+    void setTransform( bool transform );
+    /** The distribution to transform into normal scores instead of that of the data. */
+    void setReferenceDistribution( const std::vector<double>& values, const std::vector<double>& weights );
+    /** The back-transform tail extrapolation: the minimum and maximum values, the lower tail option
+     * (1 = linear, 2 = power) and the upper tail option (1 = linear, 2 = power, 4 = hyperbolic) with their parameters. */
+    void setTailExtrapolation( double zmin, double zmax,
+                               int lowerTailOption, double lowerTailParameter,
+                               int upperTailOption, double upperTailParameter );
+    void setNumberOfRealizations( uint nRealizations );
+    void setSeed( uint seed );
+    /** The search for the data.  The neighborhood also limits the search for previously simulated nodes.  The minimum
+     * number of samples applies to the data and the nodes together: nodes with fewer are drawn from the global distribution. */
+    void setSearchStrategy( SearchStrategyPtr searchStrategy );
+    /** The maximum number of previously simulated nodes used to simulate a node. */
+    void setMaxSimulatedNodes( uint maxSimulatedNodes );
+    /** Whether the data are moved to the nearest grid nodes and searched with the simulated nodes. */
+    void setAssignDataToNodes( bool assignDataToNodes );
+    /** The number of multigrid refinements (zero to not simulate coarser grids first). */
+    void setMultigrid( uint nRefinements );
+    /** The size in nodes along I, J and K of the covariance lookup table, which bounds the simulated node search. */
+    void setCovarianceTableSize( uint nI, uint nJ, uint nK );
+    void setVariogramModel( VariogramModel* variogramModel );
+    /** @param correlation The correlation coefficient of collocated cokriging.
+     * @param varianceReduction The factor applied to the kriging variances of collocated cokriging. */
+    void setKrigingType( SequentialGaussianSimulationType kType, double correlation, double varianceReduction );
+    //@}
+
+    /**
+     * Simulates the realizations, showing a progress dialog, and saves them to a GEO-EAS grid file at the given path,
+     * one realization after the other (as sgsim does).  The values are written as they are simulated into the file's
+     * binary sidecar (see DataFileBinaryCache), which is memory-mapped meanwhile, so the realizations do not need to fit
+     * in memory at once and the file is loaded from the sidecar afterwards without being parsed.  The GEO-EAS file is
+     * still written, as the GSLib programs that post-process the realizations (e.g. postsim) read it.
+     * @return False if the parameters are invalid or the file could not be written (the reason is logged as an error).
+     */
+    bool run( const QString outputPath );
+
+private:
+    /** Simulates the realizations taken from progressInfo->nextRealization until all are simulated.  Runs in several
+     * threads at once, each writing the values of the realizations it takes from realizations + realization * cells. */
+    void simulateRealizations( SequentialSimulationProgress* progressInfo, double* realizations );
+
+    /** Simulates one realization into the given array of grid values. */
+    void simulateRealization( uint realization, double* values, SequentialGaussianSimulationWorkspace& workspace,
+                              SequentialSimulationProgress* progressInfo ) const;
+
+    /** Simulates the normal score of one node from the data and the normal scores of the realization simulated so far
+     * (in the workspace).  Returns false if the kriging system could not be solved (the global distribution is used). */
+    bool simulateNode( uint i, uint j, uint k, std::mt19937& randomEngine,
+                       SequentialGaussianSimulationWorkspace& workspace, double& normalScore ) const;
+
+    /** Returns the standardized covariance between two locations, which is one if they coincide (as in sgsim). */
+    double covariance( double dx, double dy, double dz ) const;
+
+    /** Prepares the transform table, the data normal scores and the secondary values.  Returns false on errors. */
+    bool prepareData();
+
+    /** Returns the normal score of a value, interpolated in the transform table. */
+    double toNormalScore( double value ) const;
+
+    /** Returns the value of a normal score, interpolated in the transform table with the tail extrapolation options. */
+    double fromNormalScore( double normalScore ) const;
+
+    PointSet* m_pointSet;
+    CartesianGrid* m_grid;
+    uint m_column, m_weightColumn;
+    uint m_secondaryColumn;
+    CartesianGrid* m_secondaryGrid;
+    uint m_secondaryGridColumn;
+    double m_tmin, m_tmax;
+    bool m_transform;
+    std::vector<double> m_referenceValues, m_referenceWeights;
+    double m_zmin, m_zmax;
+    int m_lowerTailOption, m_upperTailOption;
+    double m_lowerTailParameter, m_upperTailParameter;
+    uint m_nRealizations;
+    uint m_seed;
+    SearchStrategyPtr m_searchStrategy;
+    uint m_maxSimulatedNodes;
+    bool m_assignDataToNodes;
+    uint m_nMultigridRefinements;
+    uint m_covarianceTableNI, m_covarianceTableNJ, m_covarianceTableNK;
+    VariogramModel* m_variogramModel;
+    SequentialGaussianSimulationType m_kType;
+    double m_correlation, m_varianceReduction;
+
+    //@{
+    /** Data prepared by run() before starting the threads. */
+    CompiledVariogramModel m_variogram;
+    /** The inverse of the variogram sill, which standardizes the covariances. */
+    double m_covarianceScale;
+    /** The transform table: values and their normal scores, both increasing. */
+    std::vector<double> m_tableValues, m_tableNormalScores;
+    /** The data (only those not assigned to nodes are indexed for search). */
+    SpatialIndexPoints m_spatialIndex;
+    SearchStrategyPtr m_dataSearchStrategy;
+    std::vector<double> m_x, m_y, m_z, m_normalScores, m_secondaryValues;
+    /** The secondary values (normal scores in collocated cokriging) at the grid cells. */
+    std::vector<double> m_secondaryGridValues;
+    /** The data assigned to nodes: their normal scores and original values by cell (NaN if none). */
+    std::vector<float> m_nodeNormalScores;
+    std::vector<double> m_nodeValues;
+    /** The simulated node search template, with the covariances of the standardized variogram model. */
+    SimulatedNodeTemplate m_nodeTemplate;
+    /** The number of drift functions (the unbiasedness condition and the external drift in KED). */
+    int m_nDrifts;
+    //@}
+};
+
+#endif // SEQUENTIALGAUSSIANSIMULATION_H
@@ -0,0 +1,696 @@
+#include "sequentialindicatorsimulation.h"
+#include "krigingsolver.h"
+#include "gridcell.h"
+#include "domain/pointset.h"
+#include "domain/cartesiangrid.h"
+#include "domain/variogrammodel.h"
+#include "domain/application.h"
+#include "domain/auxiliary/columnardatastore.h"
+
+#include <QCoreApplication>
+#include <QProgressDialog>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace {
+
+    /** Same tolerance used in sisim to detect coincident locations (squared distance). */
+    const double EPSLON = 0.000001;
+
+    /** Kriging matrices with larger condition numbers are deemed singular. */
+    const double MAX_CONDITION_NUMBER = 1.0E15;
+
+    /** Number of nodes simulated by a thread between updates of the shared progress counter. */
+    const unsigned int PROGRESS_UPDATE_INTERVAL = 4096;
+
+    /** The class of the nodes not simulated yet. */
+    const unsigned short NO_CLASS = std::numeric_limits<unsigned short>::max();
+
+}
+
+/** The path and kriging objects of one simulation thread of SequentialIndicatorSimulation, reused for all of its nodes. */
+struct SequentialIndicatorSimulationWorkspace
+{
+    /** The random path (cell indexes) of the current realization and a buffer to reorder it by multigrid. */
+    std::vector<uint> path, pathBuffer;
+    /** The classes of the current realization (NO_CLASS at the nodes not simulated yet). */
+    std::vector<unsigned short> classes;
+    /** The data lines, the soft data lines and the template entries of the simulated nodes used for the current node. */
+    std::vector<uint> data, softData, nodes;
+    /** Number of simulated nodes found in each search sector. */
+    std::vector<uint> sectorCounts;
+    /** The locations of the data, soft data and nodes of the current node and the classes of the data and nodes. */
+    std::vector<double> x, y, z;
+    std::vector<int> sampleClasses;
+    /** Scratch arrays for the separation vectors and the covariances of a matrix column. */
+    std::vector<double> dx, dy, dz, covariances;
+    /** The kriging matrix, the right-hand side, the weights and the solver of each kriging system. */
+    std::vector<Eigen::MatrixXd> lhs;
+    std::vector<Eigen::VectorXd> rhs;
+    std::vector<Eigen::VectorXd> weights;
+    std::vector<KrigingSolver> solvers;
+    /** The conditional distribution of the current node. */
+    std::vector<double> probabilities;
+    /** Number of nodes of the current realization whose order relations were corrected. */
+    unsigned long long nCorrected;
+};
+
+SequentialIndicatorSimulation::SequentialIndicatorSimulation(PointSet *pointSet, CartesianGrid *simulationGrid) :
+    m_pointSet( pointSet ),
+    m_grid( simulationGrid ),
+    m_column( 0 ),
+    m_softData( nullptr ),
+    m_markovBayes( false ),
+    m_tmin( -1.0e21 ),
+    m_tmax( 1.0e21 ),
+    m_nRealizations( 1 ),
+    m_seed( 69069 ),
+    m_maxSimulatedNodes( 12 ),
+    m_maxSoftData( 0 ),
+    m_assignDataToNodes( false ),
+    m_nMultigridRefinements( 0 ),
+    m_covarianceTableNI( 25 ),
+    m_covarianceTableNJ( 25 ),
+    m_covarianceTableNK( 5 ),
+    m_kType( SequentialIndicatorSimulationType::SK ),
+    m_nDataLines( 0 )
+{
+}
+
+void SequentialIndicatorSimulation::setVariable(uint column)
+{
+    m_column = column;
+}
+
+void SequentialIndicatorSimulation::setSoftIndicators(PointSet *softData, const std::vector<uint> &indicatorColumns)
+{
+    m_softData = softData;
+    m_softIndicatorColumns = indicatorColumns;
+}
+
+void SequentialIndicatorSimulation::setMarkovBayes(bool markovBayes, const std::vector<double> &calibrations)
+{
+    m_markovBayes = markovBayes;
+    m_calibrations = calibrations;
+}
+
+void SequentialIndicatorSimulation::setTrimmingLimits(double tmin, double tmax)
+{
+    m_tmin = tmin;
+    m_tmax = tmax;
+}
+
+void SequentialIndicatorSimulation::setDistribution(const IndicatorDistribution &distribution)
+{
+    m_distribution = distribution;
+}
+
+void SequentialIndicatorSimulation::setNumberOfRealizations(uint nRealizations)
+{
+    m_nRealizations = nRealizations;
+}
+
+void SequentialIndicatorSimulation::setSeed(uint seed)
+{
+    m_seed = seed;
+}
+
+void SequentialIndicatorSimulation::setSearchStrategy(SearchStrategyPtr searchStrategy)
+{
+    m_searchStrategy = searchStrategy;
+}
+
+void SequentialIndicatorSimulation::setMaxSimulatedNodes(uint maxSimulatedNodes)
+{
+    m_maxSimulatedNodes = maxSimulatedNodes;
+}
+
+void SequentialIndicatorSimulation::setMaxSoftData(uint maxSoftData)
+{
+    m_maxSoftData = maxSoftData;
+}
+
+void SequentialIndicatorSimulation::setAssignDataToNodes(bool assignDataToNodes)
+{
+    m_assignDataToNodes = assignDataToNodes;
+}
+
+void SequentialIndicatorSimulation::setMultigrid(uint nRefinements)
+{
+    m_nMultigridRefinements = nRefinements;
+}
+
+void SequentialIndicatorSimulation::setCovarianceTableSize(uint nI, uint nJ, uint nK)
+{
+    m_covarianceTableNI = nI;
+    m_covarianceTableNJ = nJ;
+    m_covarianceTableNK = nK;
+}
+
+void SequentialIndicatorSimulation::setVariogramModels(const std::vector<VariogramModel *> &variogramModels)
+{
+    m_variogramModels = variogramModels;
+}
+
+void SequentialIndicatorSimulation::setKrigingType(SequentialIndicatorSimulationType kType)
+{
+    m_kType = kType;
+}
+
+bool SequentialIndicatorSimulation::run(const QString outputPath)
+{
+    uint nThresholds = m_distribution.getThresholdCount();
+    if( ! m_pointSet || ! m_grid || ! m_searchStrategy || m_column < 1 || m_nRealizations < 1 ||
+        nThresholds == 0 || m_grid->getNX() * m_grid->getNY() * m_grid->getNZ() == 0 ){
+        Application::instance()->logError( "SequentialIndicatorSimulation::run(): the data set, the simulation grid, the variable,"
+                                           " the thresholds, the search strategy and the number of realizations must be set.", true );
+        return false;
+    }
+    if( nThresholds >= NO_CLASS ){
+        Application::instance()->logError( "SequentialIndicatorSimulation::run(): too many thresholds.", true );
+        return false;
+    }
+    if( m_variogramModels.size() != 1 && m_variogramModels.size() != nThresholds ){
+        Application::instance()->logError( "SequentialIndicatorSimulation::run(): there must be either one variogram model per"
+                                           " threshold or a single variogram model (median indicator simulation).", true );
+        return false;
+    }
+    if( m_softData && ( m_softIndicatorColumns.size() != nThresholds ||
+                        ( m_markovBayes && m_calibrations.size() != nThresholds ) ) ){
+        Application::instance()->logError( "SequentialIndicatorSimulation::run(): the soft data must have one indicator"
+                                           " (and one Markov-Bayes calibration) per threshold.", true );
+        return false;
+    }
+
+    //compile each distinct variogram model once for all kriging operations.  Thresholds with the same model share
+    //a kriging system, unless there are soft data calibrated with different B(z) values.
+    m_variograms.clear();
+    m_systems.clear();
+    m_softSystems.clear();
+    m_thresholdSystems.clear();
+    m_thresholdSoftSystems.clear();
+    std::vector<VariogramModel*> distinctModels;
+    for( uint t = 0; t < nThresholds; ++t ){
+        VariogramModel* model = m_variogramModels[ m_variogramModels.size() == 1 ? 0 : t ];
+        if( ! model ){
+            Application::instance()->logError( "SequentialIndicatorSimulation::run(): missing variogram model for threshold " +
+                                               QString::number( t + 1 ) + ".", true );
+            return false;
+        }
+        auto it = std::find( distinctModels.begin(), distinctModels.end(), model );
+        if( it == distinctModels.end() ){
+            model->readParameters();
+            distinctModels.push_back( model );
+            m_variograms.push_back( CompiledVariogramModel( model ) );
+            m_systems.push_back( { (uint)m_variograms.size() - 1, 1.0 } );
+            it = distinctModels.end() - 1;
+        }
+        uint variogram = it - distinctModels.begin();
+        m_thresholdSystems.push_back( variogram );
+        double calibration = m_markovBayes ? m_calibrations[t] : 1.0;
+        auto softIt = std::find_if( m_softSystems.begin(), m_softSystems.end(), [&]( const KrigingSystem& system ){
+            return system.variogram == variogram && system.calibration == calibration;
+        } );
+        if( softIt == m_softSystems.end() ){
+            m_softSystems.push_back( { variogram, calibration } );
+            softIt = m_softSystems.end() - 1;
+        }
+        m_thresholdSoftSystems.push_back( softIt - m_softSystems.begin() );
+    }
+
+    if( ! prepareData() )
+        return false;
+    //the template is sorted by the covariance of the median threshold.
+    std::vector<SimulatedNodeTemplate::CovarianceFunction> covariances;
+    for( uint v = 0; v < m_variograms.size(); ++v )
+        covariances.push_back( [this, v]( double dx, double dy, double dz ){ return covariance( v, dx, dy, dz ); } );
+    m_nodeTemplate.build( *m_grid, *m_searchStrategy->m_searchNB,
+                          m_covarianceTableNI, m_covarianceTableNJ, m_covarianceTableNK,
+                          covariances, m_systems[ m_thresholdSystems[ nThresholds / 2 ] ].variogram );
+
+    //the realizations are simulated straight into the sidecar of the output file.
+    size_t nCells = (size_t)m_grid->getNX() * m_grid->getNY() * m_grid->getNZ();
+    size_t nValues = nCells * m_nRealizations;
+    ColumnarDataStore realizations;
+    bool isMapped = SequentialSimulationUtils::beginRealizations( outputPath, nValues, realizations );
+
+    QProgressDialog progressDialog;
+    progressDialog.show();
+    SequentialIndicatorSimulationProgress progressInfo;
+    double* values = realizations.column( 0 );
+    SequentialSimulationUtils::simulateRealizations( progressDialog, "sequential indicator simulation",
+                                                     m_nRealizations, nValues, progressInfo,
+                                                     [this, &progressInfo, values](){
+        simulateRealizations( &progressInfo, values );
+    } );
+
+    if( progressInfo.nFailed ){
+        Application::instance()->logWarn( "SequentialIndicatorSimulation::run(): " + QString::number(progressInfo.nFailed.load()) +
+                                          " kriging operation(s) failed (singular system).  The nodes were drawn from the"
+                                          " global distribution." );
+    }
+    if( progressInfo.nCorrected ){
+        Application::instance()->logInfo( "SequentialIndicatorSimulation::run(): the order relations of " +
+                                          QString::number(progressInfo.nCorrected.load()) + " simulated nodes were corrected." );
+    }
+
+    m_spatialIndex.clear();
+    m_softSpatialIndex.clear();
+
+    //the statistics of the realizations (what postsim computes), the grid rows divided among the threads.
+    uint nRows = m_grid->getNY() * m_grid->getNZ();
+    bool isContinuous = ! m_distribution.isCategorical();
+    m_means.assign( isContinuous ? nCells : 0, 0.0 );
+    m_variances.assign( isContinuous ? nCells : 0, 0.0 );
+    m_frequencies.assign( isContinuous ? 0 : nCells * nThresholds, 0.0 );
+    progressDialog.setLabelText("Computing the statistics of the realizations...");
+    progressDialog.setValue( 0 );
+    progressDialog.setMaximum( nRows );
+    std::vector<std::thread> threads;
+    unsigned int nThreads = std::max( 1u, std::min( std::thread::hardware_concurrency(), nRows ) );
+    for( unsigned int iThread = 0; iThread < nThreads; ++iThread )
+        threads.push_back( std::thread( &SequentialIndicatorSimulation::computeStatistics, this,
+                                        &progressInfo, values ) );
+    while( progressInfo.nRowsDone < nRows ){
+        progressDialog.setValue( progressInfo.nRowsDone.load() );
+        QCoreApplication::processEvents(); //let Qt repaint widgets
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    }
+    for( std::thread& thread : threads )
+        thread.join();
+
+    progressDialog.setMaximum( 1000 );
+    return SequentialSimulationUtils::saveRealizations( progressDialog, outputPath, "SISIM realizations simulated by GammaRay",
+                                                        realizations, isMapped );
+}
+
+void SequentialIndicatorSimulation::simulateRealizations(SequentialIndicatorSimulationProgress *progressInfo, double *realizations)
+{
+    size_t nCells = (size_t)m_grid->getNX() * m_grid->getNY() * m_grid->getNZ();
+    size_t nSystems = std::max( m_systems.size(), m_softSystems.size() );
+
+    //the buffers are reused for all realizations simulated by this thread
+    SequentialIndicatorSimulationWorkspace workspace;
+    workspace.classes.resize( nCells );
+    workspace.sectorCounts.resize( m_nodeTemplate.getSectorCount() );
+    workspace.lhs.resize( nSystems );
+    workspace.rhs.resize( nSystems );
+    workspace.weights.resize( nSystems );
+    workspace.solvers.resize( nSystems );
+    workspace.probabilities.resize( m_distribution.getThresholdCount() );
+
+    for( uint iReal = progressInfo->nextRealization++; iReal < m_nRealizations; iReal = progressInfo->nextRealization++ ){
+        simulateRealization( iReal, realizations + iReal * nCells, workspace, progressInfo );
+        ++progressInfo->nRealizationsDone;
+    }
+}
+
+void SequentialIndicatorSimulation::simulateRealization(uint realization, double *values,
+                                                        SequentialIndicatorSimulationWorkspace &workspace,
+                                                        SequentialIndicatorSimulationProgress *progressInfo) const
+{
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    size_t nCells = (size_t)nI * nJ * m_grid->getNZ();
+    bool isCategorical = m_distribution.isCategorical();
+
+    //each realization has its own random number sequence, regardless of the thread simulating it.
+    std::seed_seq seeds{ m_seed, realization };
+    std::mt19937 randomEngine( seeds );
+    workspace.nCorrected = 0;
+
+    //the nodes with data assigned to them are known from the start and are not in the path.
+    std::vector<uint>& path = workspace.path;
+    path.clear();
+    unsigned short* classes = workspace.classes.data();
+    for( size_t iCell = 0; iCell < nCells; ++iCell ){
+        if( m_nodeClasses.empty() || m_nodeClasses[iCell] == NO_CLASS ){
+            classes[iCell] = NO_CLASS;
+            path.push_back( iCell );
+        } else {
+            classes[iCell] = m_nodeClasses[iCell];
+            values[iCell] = m_nodeValues[iCell];
+        }
+    }
+    SequentialSimulationUtils::makeRandomPath( path, nI, nJ, m_nMultigridRefinements, randomEngine, workspace.pathBuffer );
+
+    //each node draws a class from its conditional distribution, then a value within the class.
+    double* probabilities = workspace.probabilities.data();
+    int nFailed = 0;
+    unsigned int nNodes = 0;
+    for( uint iCell : path ){
+        uint i = iCell % nI;
+        uint j = ( iCell / nI ) % nJ;
+        uint k = iCell / nI / nJ;
+        if( ! estimateNode( i, j, k, workspace, probabilities ) )
+            ++nFailed;
+        double p = SequentialSimulationUtils::uniformDraw( randomEngine );
+        uint valueClass = m_distribution.drawClass( probabilities, p );
+        classes[iCell] = valueClass;
+        values[iCell] = isCategorical ? m_distribution.getThreshold( valueClass ) :
+                                        m_distribution.getValue( probabilities, valueClass, p );
+        if( ++nNodes == PROGRESS_UPDATE_INTERVAL ){
+            progressInfo->nNodesDone += nNodes;
+            nNodes = 0;
+        }
+    }
+    progressInfo->nNodesDone += nNodes + ( nCells - path.size() );
+    progressInfo->nFailed += nFailed;
+    progressInfo->nCorrected += workspace.nCorrected;
+}
+
+bool SequentialIndicatorSimulation::estimateNode(uint i, uint j, uint k, SequentialIndicatorSimulationWorkspace &workspace,
+                                                 double *probabilities) const
+{
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    uint nThresholds = m_distribution.getThresholdCount();
+    GridCell simulationCell( m_grid, -1, i, j, k );
+    const SpatialLocation& center = simulationCell._center;
+    bool isOrdinaryKriging = m_kType == SequentialIndicatorSimulationType::OK;
+
+    //the nearest data and soft data
+    std::vector<uint>& data = workspace.data;
+    data.clear();
+    if( ! m_assignDataToNodes ){
+        QList<uint> dataLines = m_spatialIndex.getNearestWithin( simulationCell, *m_dataSearchStrategy );
+        data.assign( dataLines.begin(), dataLines.end() );
+    }
+    std::vector<uint>& softData = workspace.softData;
+    softData.clear();
+    if( ! m_softSpatialIndex.isEmpty() && m_maxSoftData ){
+        QList<uint> softLines = m_softSpatialIndex.getNearestWithin( simulationCell, *m_softSearchStrategy );
+        softData.assign( softLines.begin(), softLines.end() );
+    }
+
+    //the nearest simulated nodes, in the order of the search template (decreasing covariance).
+    const unsigned short* classes = workspace.classes.data();
+    std::vector<uint>& nodes = workspace.nodes;
+    m_nodeTemplate.findSimulatedNodes( i, j, k, m_maxSimulatedNodes, [classes]( size_t iCell ){ return classes[iCell] != NO_CLASS; },
+                                       workspace.sectorCounts, nodes );
+
+    int nData = data.size();
+    int nSoft = softData.size();
+    int nPoints = nData + nSoft;
+    int n = nPoints + nodes.size();
+
+    //the global distribution is used for nodes with too few samples.
+    if( n == 0 || n < (int)m_searchStrategy->m_minNumberOfSamples ){
+        for( uint t = 0; t < nThresholds; ++t )
+            probabilities[t] = m_distribution.getGlobalProbability( t );
+        return true;
+    }
+
+    //the locations and classes of the data, followed by those of the soft data and of the nodes.
+    workspace.x.resize( n );
+    workspace.y.resize( n );
+    workspace.z.resize( n );
+    workspace.sampleClasses.resize( n );
+    for( int a = 0; a < nData; ++a ){
+        uint line = data[a];
+        workspace.x[a] = m_x[line];
+        workspace.y[a] = m_y[line];
+        workspace.z[a] = m_z[line];
+        workspace.sampleClasses[a] = m_classes[line];
+    }
+    for( int a = nData; a < nPoints; ++a ){
+        uint sample = m_nDataLines + softData[a - nData];
+        workspace.x[a] = m_x[sample];
+        workspace.y[a] = m_y[sample];
+        workspace.z[a] = m_z[sample];
+        workspace.sampleClasses[a] = -1;
+    }
+    for( int a = nPoints; a < n; ++a ){
+        uint t = nodes[a - nPoints];
+        int di = m_nodeTemplate.getDI( t );
+        int dj = m_nodeTemplate.getDJ( t );
+        int dk = m_nodeTemplate.getDK( t );
+        size_t iNode = ( i + di ) + ( ( j + dj ) + (size_t)( k + dk ) * nJ ) * nI;
+        workspace.x[a] = center._x + di * m_grid->getDX();
+        workspace.y[a] = center._y + dj * m_grid->getDY();
+        workspace.z[a] = center._z + dk * m_grid->getDZ();
+        workspace.sampleClasses[a] = classes[iNode];
+    }
+
+    //with soft data, the thresholds with different Markov-Bayes calibrations have different kriging systems.
+    const std::vector<KrigingSystem>& systems = nSoft ? m_softSystems : m_systems;
+    const std::vector<uint>& thresholdSystems = nSoft ? m_thresholdSoftSystems : m_thresholdSystems;
+    size_t nSystems = systems.size();
+    auto isSoft = [nData, nPoints]( int a ){ return a >= nData && a < nPoints; };
+
+    //the kriging matrices.  Covariances involving data or soft data are computed, those between nodes are looked up.
+    //The separation vectors are shared by all systems.  With the Markov-Bayes model, the covariances with soft data
+    //are scaled by B(z), those between soft data by B(z)² (|B(z)| times the sill on the diagonal).
+    workspace.dx.resize( n );
+    workspace.dy.resize( n );
+    workspace.dz.resize( n );
+    workspace.covariances.resize( n );
+    double* dx = workspace.dx.data();
+    double* dy = workspace.dy.data();
+    double* dz = workspace.dz.data();
+    double* covariances = workspace.covariances.data();
+    for( size_t s = 0; s < nSystems; ++s )
+        workspace.lhs[s].resize( n, n );
+    for( int b = 0; b < n; ++b ){
+        int nComputed = std::min( b + 1, nPoints );
+        for( int a = 0; a < nComputed; ++a ){
+            dx[a] = workspace.x[b] - workspace.x[a];
+            dy[a] = workspace.y[b] - workspace.y[a];
+            dz[a] = workspace.z[b] - workspace.z[a];
+        }
+        for( size_t s = 0; s < nSystems; ++s ){
+            const KrigingSystem& system = systems[s];
+            const CompiledVariogramModel& variogram = m_variograms[system.variogram];
+            Eigen::MatrixXd& lhs = workspace.lhs[s];
+            variogram.covariance( dx, dy, dz, nComputed, covariances );
+            for( int a = 0; a < nComputed; ++a ){
+                double c = ( dx[a]*dx[a] + dy[a]*dy[a] + dz[a]*dz[a] < EPSLON ) ? variogram.getSill() : covariances[a];
+                if( m_markovBayes ){
+                    if( isSoft( a ) && isSoft( b ) )
+                        c = a == b ? std::abs( system.calibration ) * variogram.getSill() :
+                                     system.calibration * system.calibration * c;
+                    else if( isSoft( a ) || isSoft( b ) )
+                        c *= system.calibration;
+                }
+                lhs( a, b ) = c;
+                lhs( b, a ) = c;
+            }
+            if( b >= nPoints ){
+                uint tb = nodes[b - nPoints];
+                for( int a = nPoints; a <= b; ++a ){
+                    double c = m_nodeTemplate.getCovariance( system.variogram, nodes[a - nPoints], tb );
+                    lhs( a, b ) = c;
+                    lhs( b, a ) = c;
+                }
+            }
+        }
+    }
+
+    //the right-hand sides: the covariances between the node and the data and soft data (computed) and the nodes
+    //(from the template), then the weights.  A singular matrix (e.g. duplicate data) is reported as a failed kriging
+    //and the global distribution is used.
+    for( int a = 0; a < nPoints; ++a ){
+        dx[a] = center._x - workspace.x[a];
+        dy[a] = center._y - workspace.y[a];
+        dz[a] = center._z - workspace.z[a];
+    }
+    for( size_t s = 0; s < nSystems; ++s ){
+        const KrigingSystem& system = systems[s];
+        const CompiledVariogramModel& variogram = m_variograms[system.variogram];
+        KrigingSolver& solver = workspace.solvers[s];
+        if( ! solver.factorizeCovariances( workspace.lhs[s] ) || solver.isIllConditioned( MAX_CONDITION_NUMBER ) ){
+            for( uint t = 0; t < nThresholds; ++t )
+                probabilities[t] = m_distribution.getGlobalProbability( t );
+            return false;
+        }
+        Eigen::VectorXd& rhs = workspace.rhs[s];
+        rhs.resize( n );
+        variogram.covariance( dx, dy, dz, nPoints, covariances );
+        for( int a = 0; a < nPoints; ++a ){
+            rhs[a] = ( dx[a]*dx[a] + dy[a]*dy[a] + dz[a]*dz[a] < EPSLON ) ? variogram.getSill() : covariances[a];
+            if( m_markovBayes && isSoft( a ) )
+                rhs[a] *= system.calibration;
+        }
+        for( int a = nPoints; a < n; ++a )
+            rhs[a] = m_nodeTemplate.getCovariance( system.variogram, nodes[a - nPoints] );
+        if( isOrdinaryKriging )
+            solver.solveConstrained( rhs, 1.0, workspace.weights[s] );
+        else
+            solver.solve( rhs, workspace.weights[s] );
+    }
+
+    //the simple kriging weights apply to the residuals of the global probabilities.
+    for( uint t = 0; t < nThresholds; ++t ){
+        const Eigen::VectorXd& weights = workspace.weights[ thresholdSystems[t] ];
+        double mean = isOrdinaryKriging ? 0.0 : m_distribution.getGlobalProbability( t );
+        double estimate = mean;
+        for( int a = 0; a < n; ++a ){
+            double indicator = isSoft( a ) ? m_softIndicators[ (size_t)softData[a - nData] * nThresholds + t ] :
+                                             m_distribution.getIndicator( workspace.sampleClasses[a], t );
+            estimate += weights[a] * ( indicator - mean );
+        }
+        probabilities[t] = estimate;
+    }
+    //rarely, kriging may result in NaN or infinity values.
+    if( std::any_of( probabilities, probabilities + nThresholds, []( double p ){ return ! std::isfinite( p ); } ) ){
+        for( uint t = 0; t < nThresholds; ++t )
+            probabilities[t] = m_distribution.getGlobalProbability( t );
+        return false;
+    }
+    if( m_distribution.correctOrderRelations( probabilities ) )
+        ++workspace.nCorrected;
+    return true;
+}
+
+void SequentialIndicatorSimulation::computeStatistics(SequentialIndicatorSimulationProgress *progressInfo,
+                                                      const double *realizations)
+{
+    uint nI = m_grid->getNX();
+    uint nRows = m_grid->getNY() * m_grid->getNZ();
+    size_t nCells = (size_t)nI * nRows;
+    uint nThresholds = m_distribution.getThresholdCount();
+    bool isCategorical = m_distribution.isCategorical();
+
+    for( uint iRow = progressInfo->nextRow++; iRow < nRows; iRow = progressInfo->nextRow++ ){
+        for( uint i = 0; i < nI; ++i ){
+            size_t iCell = i + (size_t)iRow * nI;
+            if( isCategorical ){
+                double* frequencies = m_frequencies.data() + iCell * nThresholds;
+                for( uint iReal = 0; iReal < m_nRealizations; ++iReal ){
+                    int category = m_distribution.getClass( realizations[ iCell + iReal * nCells ] );
+                    if( category >= 0 )
+                        frequencies[category] += 1.0;
+                }
+                for( uint t = 0; t < nThresholds; ++t )
+                    frequencies[t] /= m_nRealizations;
+            } else {
+                double sum = 0.0;
+                double sumOfSquares = 0.0;
+                for( uint iReal = 0; iReal < m_nRealizations; ++iReal ){
+                    double value = realizations[ iCell + iReal * nCells ];
+                    sum += value;
+                    sumOfSquares += value * value;
+                }
+                double mean = sum / m_nRealizations;
+                m_means[iCell] = mean;
+                m_variances[iCell] = std::max( 0.0, sumOfSquares / m_nRealizations - mean * mean );
+            }
+        }
+        ++progressInfo->nRowsDone;
+    }
+}
+
+double SequentialIndicatorSimulation::covariance(uint variogram, double dx, double dy, double dz) const
+{
+    const CompiledVariogramModel& model = m_variograms[variogram];
+    if( dx*dx + dy*dy + dz*dz < EPSLON )
+        return model.getSill();
+    return model.getSill() - model.gamma( dx, dy, dz );
+}
+
+bool SequentialIndicatorSimulation::prepareData()
+{
+    uint nI = m_grid->getNX();
+    uint nJ = m_grid->getNY();
+    uint nK = m_grid->getNZ();
+    size_t nCells = (size_t)nI * nJ * nK;
+    uint nThresholds = m_distribution.getThresholdCount();
+
+    //copy the data locations and classes, so the threads do not access the data file.
+    //the data outside the trimming limits (or not of any category) are ignored.
+    m_pointSet->loadData();
+    m_nDataLines = m_pointSet->getDataLineCount();
+    bool is3D = m_pointSet->is3D();
+    m_x.assign( m_nDataLines, 0.0 );
+    m_y.assign( m_nDataLines, 0.0 );
+    m_z.assign( m_nDataLines, m_grid->getZ0() ); //as in sisim, 2D data are at the elevation of the grid
+    m_classes.assign( m_nDataLines, -1 );
+    std::vector<double> values( m_nDataLines, 0.0 );
+    std::vector<uint> validLines;
+    validLines.reserve( m_nDataLines );
+    for( uint iLine = 0; iLine < m_nDataLines; ++iLine ){
+        double value = m_pointSet->data( iLine, m_column - 1 );
+        if( m_pointSet->isNDV( value ) || value < m_tmin || value >= m_tmax )
+            continue;
+        int valueClass = m_distribution.getClass( value );
+        if( valueClass < 0 )
+            continue;
+        m_x[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::X );
+        m_y[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::Y );
+        if( is3D )
+            m_z[iLine] = m_pointSet->getDataSpatialLocation( iLine, CartesianCoord::Z );
+        m_classes[iLine] = valueClass;
+        values[iLine] = value;
+        validLines.push_back( iLine );
+    }
+    Application::instance()->logInfo( "SequentialIndicatorSimulation::run(): " + QString::number( validLines.size() ) + " of " +
+                                      QString::number( m_nDataLines ) + " data are within the trimming limits"
+                                      + ( m_distribution.isCategorical() ? " and of the categories." : "." ) );
+
+    //the soft data locations follow those of the data.
+    m_softIndicators.clear();
+    m_softSpatialIndex.clear();
+    if( m_softData ){
+        m_softData->loadData();
+        uint nSoftLines = m_softData->getDataLineCount();
+        bool isSoft3D = m_softData->is3D();
+        m_softIndicators.assign( (size_t)nSoftLines * nThresholds, 0.0 );
+        m_x.resize( m_nDataLines + nSoftLines, 0.0 );
+        m_y.resize( m_nDataLines + nSoftLines, 0.0 );
+        m_z.resize( m_nDataLines + nSoftLines, m_grid->getZ0() );
+        std::vector<uint> validSoftLines;
+        for( uint iLine = 0; iLine < nSoftLines; ++iLine ){
+            bool isValid = true;
+            for( uint t = 0; t < nThresholds && isValid; ++t ){
+                double value = m_softData->data( iLine, m_softIndicatorColumns[t] - 1 );
+                isValid = ! m_softData->isNDV( value ) && value >= 0.0 && value <= 1.0;
+                m_softIndicators[ (size_t)iLine * nThresholds + t ] = value;
+            }
+            if( ! isValid )
+                continue;
+            uint sample = m_nDataLines + iLine;
+            m_x[sample] = m_softData->getDataSpatialLocation( iLine, CartesianCoord::X );
+            m_y[sample] = m_softData->getDataSpatialLocation( iLine, CartesianCoord::Y );
+            if( isSoft3D )
+                m_z[sample] = m_softData->getDataSpatialLocation( iLine, CartesianCoord::Z );
+            validSoftLines.push_back( iLine );
+        }
+        m_softSpatialIndex.fill( m_softData, validSoftLines );
+        Application::instance()->logInfo( "SequentialIndicatorSimulation::run(): " + QString::number( validSoftLines.size() ) +
+                                          " of " + QString::number( nSoftLines ) + " soft data have all indicators informed." );
+    }
+
+    //with the data assigned to the grid nodes, each node keeps the nearest datum within its cell.
+    m_nodeClasses.clear();
+    m_nodeValues.clear();
+    if( m_assignDataToNodes ){
+        m_nodeClasses.assign( nCells, NO_CLASS );
+        m_nodeValues.assign( nCells, std::numeric_limits<double>::quiet_NaN() );
+        std::vector<uint> nodeLines;
+        uint nOutside = SequentialSimulationUtils::assignDataToNodes( *m_grid, m_x, m_y, m_z, validLines, nodeLines );
+        for( size_t iCell = 0; iCell < nCells; ++iCell ){
+            uint iLine = nodeLines[iCell];
+            if( iLine != SequentialSimulationUtils::NO_DATA_LINE ){
+                m_nodeClasses[iCell] = m_classes[iLine];
+                m_nodeValues[iCell] = values[iLine];
+            }
+        }
+        if( nOutside )
+            Application::instance()->logInfo( "SequentialIndicatorSimulation::run(): " + QString::number( nOutside ) +
+                                              " data outside the grid were ignored." );
+        validLines.clear();
+    }
+    m_spatialIndex.fill( m_pointSet, validLines );
+
+    //the minimum number of samples applies to the data, the soft data and the nodes together, so the searches have none.
+    m_dataSearchStrategy.reset( new SearchStrategy( m_searchStrategy->m_searchNB,
+                                                    m_searchStrategy->m_nb_samples,
+                                                    m_searchStrategy->m_minDistanceBetweenSamples, 0 ) );
+    m_softSearchStrategy.reset( new SearchStrategy( m_searchStrategy->m_searchNB,
+                                                    m_maxSoftData,
+                                                    m_searchStrategy->m_minDistanceBetweenSamples, 0 ) );
+    return true;
+}
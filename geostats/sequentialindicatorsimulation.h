@@ -0,0 +1,200 @@
+#ifndef SEQUENTIALINDICATORSIMULATION_H
+#define SEQUENTIALINDICATORSIMULATION_H
+
+#include "searchstrategy.h"
+#include "compiledvariogrammodel.h"
+#include "indicatordistribution.h"
+#include "sequentialsimulationutils.h"
+#include "simulatednodetemplate.h"
+#include "spatialindex/spatialindexpoints.h"
+#include <QString>
+#include <atomic>
+#include <random>
+#include <vector>
+
+class PointSet;
+class CartesianGrid;
+class VariogramModel;
+struct SequentialIndicatorSimulationWorkspace;
+
+/** The kriging types of SequentialIndicatorSimulation (the same codes of GSLIB's sisim). */
+enum class SequentialIndicatorSimulationType : int {
+    SK = 0,  /*!< Simple kriging with the global probabilities as means. */
+    OK       /*!< Ordinary kriging. */
+};
+
+/** Work distribution and counters shared by the threads of SequentialIndicatorSimulation. */
+struct SequentialIndicatorSimulationProgress : public SequentialSimulationProgress
+{
+    SequentialIndicatorSimulationProgress() : nCorrected(0), nextRow(0), nRowsDone(0) {}
+    /** Number of nodes whose order relations were corrected. */
+    std::atomic<unsigned long long> nCorrected;
+    /** The grid rows of the statistics of the realizations. */
+    std::atomic<unsigned int> nextRow;
+    std::atomic<unsigned int> nRowsDone;
+};
+
+/**
+ * The SequentialIndicatorSimulation class simulates realizations of a continuous or categorical variable on the cells
+ * of a Cartesian grid conditioned to point set samples in process, as an alternative to running GSLIB's sisim program
+ * followed by postsim.  It follows sisim's formulation: the data are coded into indicators of thresholds (or
+ * categories), the nodes are visited along a random path, optionally coarse multigrids first, and at each node the
+ * conditional distribution is estimated by indicator kriging of all thresholds from the nearest data, soft data and
+ * previously simulated nodes, its order relations are corrected and a value is drawn from it (interpolated within
+ * the classes with sisim's options for continuous variables).  Soft indicator data may be used as such or calibrated
+ * with the Markov-Bayes model.  The samples of a node are searched once and each distinct variogram model has its
+ * kriging matrix factorized once for all the thresholds using it (median indicator simulation factorizes one per node).
+ * The realizations are simulated concurrently, one per processor core, each with its own random number generator
+ * seeded from the seed and the realization number, so the results do not depend on the number of threads.
+ * The previously simulated nodes are searched with a template of grid offsets inside the search ellipsoid (see
+ * SimulatedNodeTemplate) sorted by the covariance of the median threshold, built once and shared by all realizations
+ * with the covariances of each variogram model.  The simulated nodes hold class indexes, so their indicators are exact.
+ * After the realizations are simulated, the E-type estimates and the conditional variances (continuous variables) or
+ * the frequencies of the categories (categorical variables) are computed from them, as postsim does.
+ */
+class SequentialIndicatorSimulation
+{
+public:
+    /**
+     * @param pointSet The point set with the conditioning data.
+     * @param simulationGrid The grid whose cells are simulated.  Only its geometry is used.
+     */
+    SequentialIndicatorSimulation( PointSet* pointSet, CartesianGrid* simulationGrid );
+
+    //@{
+    /** Set the simulation parameters (see GSLIB's sisim documentation). */
+    /** The GEO-EAS index (first is 1) of the variable in the point set. */
+    void setVariable( uint column );
+    /** The point set with soft indicator data and the GEO-EAS indexes of its indicator columns, one per threshold.
+     * Those with any indicator uninformed or out of [0, 1] are ignored. */
+    void setSoftIndicators( PointSet* softData, const std::vector<uint>& indicatorColumns );
+    /** Whether the soft indicators are calibrated with the Markov-Bayes model, with the given B(z) values,
+     * one per threshold.  Otherwise, the soft indicators are kriged as hard indicators. */
+    void setMarkovBayes( bool markovBayes, const std::vector<double>& calibrations );
+    void setTrimmingLimits( double tmin, double tmax );
+    /** The thresholds (or categories), the global probabilities and, for continuous variables, how values
+     * are drawn within the classes. */
+    void setDistribution( const IndicatorDistribution& distribution );
+    void setNumberOfRealizations( uint nRealizations );
+    void setSeed( uint seed );
+    /** The search for the data.  The neighborhood also limits the search for soft data and previously simulated nodes.
+     * The minimum number of samples applies to all of them together: nodes with fewer are drawn from the global
+     * distribution. */
+    void setSearchStrategy( SearchStrategyPtr searchStrategy );
+    /** The maximum number of previously simulated nodes used to simulate a node. */
+    void setMaxSimulatedNodes( uint maxSimulatedNodes );
+    /** The maximum number of soft data used to simulate a node. */
+    void setMaxSoftData( uint maxSoftData );
+    /** Whether the data are moved to the nearest grid nodes and searched with the simulated nodes. */
+    void setAssignDataToNodes( bool assignDataToNodes );
+    /** The number of multigrid refinements (zero to not simulate coarser grids first). */
+    void setMultigrid( uint nRefinements );
+    /** The size in nodes along I, J and K of the covariance lookup table, which bounds the simulated node search. */
+    void setCovarianceTableSize( uint nI, uint nJ, uint nK );
+    /** The variogram models of the indicators, one per threshold, or a single model for all thresholds (median
+     * indicator simulation).  Thresholds with the same model object share the kriging matrix. */
+    void setVariogramModels( const std::vector<VariogramModel*>& variogramModels );
+    void setKrigingType( SequentialIndicatorSimulationType kType );
+    //@}
+
+    /**
+     * Simulates the realizations, showing a progress dialog, and saves them to a GEO-EAS grid file at the given path,
+     * one realization after the other (as sisim does).  The values are written as they are simulated into the file's
+     * binary sidecar (see DataFileBinaryCache), which is memory-mapped meanwhile, so the realizations do not need to fit
+     * in memory at once and the file is loaded from the sidecar afterwards without being parsed.
+     * @return False if the parameters are invalid or the file could not be written (the reason is logged as an error).
+     */
+    bool run( const QString outputPath );
+
+    /** Returns the E-type estimates (the means of the realizations) of continuous variables computed by run(),
+     * in the GEO-EAS grid scan order. */
+    const std::vector<double>& getMeans() const { return m_means; }
+
+    /** Returns the conditional variances (the variances of the realizations) of continuous variables computed by run(),
+     * in the GEO-EAS grid scan order. */
+    const std::vector<double>& getVariances() const { return m_variances; }
+
+    /** Returns the frequencies of the categories in the realizations of categorical variables computed by run():
+     * the frequencies of all categories of the first cell, then those of the second cell and so on, the cells in the
+     * GEO-EAS grid scan order. */
+    const std::vector<double>& getFrequencies() const { return m_frequencies; }
+
+private:
+    /** A kriging system shared by thresholds: its variogram model and the Markov-Bayes calibration of the soft data. */
+    struct KrigingSystem { uint variogram; double calibration; };
+
+    /** Simulates the realizations taken from progressInfo->nextRealization until all are simulated.  Runs in several
+     * threads at once, each writing the values of the realizations it takes from realizations + realization * cells. */
+    void simulateRealizations( SequentialIndicatorSimulationProgress* progressInfo, double* realizations );
+
+    /** Simulates one realization into the given array of grid values. */
+    void simulateRealization( uint realization, double* values, SequentialIndicatorSimulationWorkspace& workspace,
+                              SequentialIndicatorSimulationProgress* progressInfo ) const;
+
+    /** Estimates the conditional distribution of one node from the data, the soft data and the classes of the
+     * realization simulated so far (in the workspace).  Returns false if a kriging system could not be solved
+     * (the global distribution is used). */
+    bool estimateNode( uint i, uint j, uint k, SequentialIndicatorSimulationWorkspace& workspace,
+                       double* probabilities ) const;
+
+    /** Computes the statistics of the grid rows taken from progressInfo->nextRow over all realizations. */
+    void computeStatistics( SequentialIndicatorSimulationProgress* progressInfo, const double* realizations );
+
+    /** Returns the covariance of a variogram model between two locations, which is the total sill if they coincide. */
+    double covariance( uint variogram, double dx, double dy, double dz ) const;
+
+    /** Prepares the data classes, the soft data and the data assigned to nodes.  Returns false on errors. */
+    bool prepareData();
+
+
+    PointSet* m_pointSet;
+    CartesianGrid* m_grid;
+    uint m_column;
+    PointSet* m_softData;
+    std::vector<uint> m_softIndicatorColumns;
+    bool m_markovBayes;
+    std::vector<double> m_calibrations;
+    double m_tmin, m_tmax;
+    IndicatorDistribution m_distribution;
+    uint m_nRealizations;
+    uint m_seed;
+    SearchStrategyPtr m_searchStrategy;
+    uint m_maxSimulatedNodes;
+    uint m_maxSoftData;
+    bool m_assignDataToNodes;
+    uint m_nMultigridRefinements;
+    uint m_covarianceTableNI, m_covarianceTableNJ, m_covarianceTableNK;
+    std::vector<VariogramModel*> m_variogramModels;
+    SequentialIndicatorSimulationType m_kType;
+
+    //@{
+    /** Data prepared by run() before starting the threads. */
+    /** The distinct variogram models. */
+    std::vector<CompiledVariogramModel> m_variograms;
+    /** The kriging systems of the nodes without soft data (one per variogram model) and of the nodes with soft data
+     * (one per variogram model and calibration), and the system of each threshold in each case. */
+    std::vector<KrigingSystem> m_systems, m_softSystems;
+    std::vector<uint> m_thresholdSystems, m_thresholdSoftSystems;
+    /** The data (only those not assigned to nodes are indexed for search) and the soft data. */
+    SpatialIndexPoints m_spatialIndex, m_softSpatialIndex;
+    SearchStrategyPtr m_dataSearchStrategy, m_softSearchStrategy;
+    /** Data coordinates by data line, followed by those of the soft data (from m_nDataLines on). */
+    std::vector<double> m_x, m_y, m_z;
+    uint m_nDataLines;
+    /** The classes of the data (see IndicatorDistribution::getClass()) by data line. */
+    std::vector<int> m_classes;
+    /** The indicators of the soft data, all thresholds of a soft datum together. */
+    std::vector<double> m_softIndicators;
+    /** The data assigned to nodes: their classes (NO_CLASS if none) and values by cell. */
+    std::vector<unsigned short> m_nodeClasses;
+    std::vector<double> m_nodeValues;
+    /** The simulated node search template, with the covariances of each variogram model. */
+    SimulatedNodeTemplate m_nodeTemplate;
+    //@}
+
+    std::vector<double> m_means;
+    std::vector<double> m_variances;
+    std::vector<double> m_frequencies;
+};
+
+#endif // SEQUENTIALINDICATORSIMULATION_H
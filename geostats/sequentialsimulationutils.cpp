@@ -0,0 +1,168 @@
+#include "sequentialsimulationutils.h"
+#include "domain/cartesiangrid.h"
+#include "domain/application.h"
+#include "domain/auxiliary/columnardatastore.h"
+#include "domain/auxiliary/datafilebinarycache.h"
+#include "domain/auxiliary/datasaver.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QProgressDialog>
+#include <QTextStream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+const uint SequentialSimulationUtils::NO_DATA_LINE;
+
+void SequentialSimulationUtils::makeRandomPath(std::vector<uint> &path, uint nI, uint nJ, uint nMultigridRefinements,
+                                               std::mt19937 &randomEngine, std::vector<uint> &pathBuffer)
+{
+    //std::shuffle's order differs between standard libraries.
+    for( size_t n = path.size(); n > 1; --n ){
+        size_t r = std::min( (size_t)( uniformDraw( randomEngine ) * n ), n - 1 );
+        std::swap( path[n - 1], path[r] );
+    }
+
+    if( nMultigridRefinements == 0 )
+        return;
+    auto level = [&]( uint iCell ){
+        uint i = iCell % nI;
+        uint j = ( iCell / nI ) % nJ;
+        uint k = iCell / nI / nJ;
+        uint ijk = i | j | k;
+        uint l = 0;
+        while( l < nMultigridRefinements && ! ( ijk & ( 1u << l ) ) )
+            ++l;
+        return l;
+    };
+    std::vector<size_t> starts( nMultigridRefinements + 2, 0 );
+    for( uint iCell : path )
+        ++starts[ nMultigridRefinements - level( iCell ) + 1 ];
+    std::partial_sum( starts.begin(), starts.end(), starts.begin() );
+    pathBuffer.resize( path.size() );
+    for( uint iCell : path )
+        pathBuffer[ starts[ nMultigridRefinements - level( iCell ) ]++ ] = iCell;
+    path.swap( pathBuffer );
+}
+
+uint SequentialSimulationUtils::assignDataToNodes(const CartesianGrid &grid, const std::vector<double> &x,
+                                                  const std::vector<double> &y, const std::vector<double> &z,
+                                                  const std::vector<uint> &lines, std::vector<uint> &nodeLines)
+{
+    uint nI = grid.getNX();
+    uint nJ = grid.getNY();
+    uint nK = grid.getNZ();
+    size_t nCells = (size_t)nI * nJ * nK;
+    nodeLines.assign( nCells, NO_DATA_LINE );
+    std::vector<double> distances( nCells, std::numeric_limits<double>::max() );
+    uint nOutside = 0;
+    for( uint iLine : lines ){
+        double fi = std::floor( ( x[iLine] - grid.getX0() ) / grid.getDX() + 0.5 );
+        double fj = std::floor( ( y[iLine] - grid.getY0() ) / grid.getDY() + 0.5 );
+        double fk = std::floor( ( z[iLine] - grid.getZ0() ) / grid.getDZ() + 0.5 );
+        if( fi < 0 || fj < 0 || fk < 0 || fi >= nI || fj >= nJ || fk >= nK ){
+            ++nOutside;
+            continue;
+        }
+        uint i = fi, j = fj, k = fk;
+        size_t iCell = i + ( j + (size_t)k * nJ ) * nI;
+        double dx = x[iLine] - ( grid.getX0() + i * grid.getDX() );
+        double dy = y[iLine] - ( grid.getY0() + j * grid.getDY() );
+        double dz = z[iLine] - ( grid.getZ0() + k * grid.getDZ() );
+        double distance = dx*dx + dy*dy + dz*dz;
+        if( distance < distances[iCell] ){
+            distances[iCell] = distance;
+            nodeLines[iCell] = iLine;
+        }
+    }
+    return nOutside;
+}
+
+bool SequentialSimulationUtils::beginRealizations(const QString outputPath, size_t nValues, ColumnarDataStore &realizations)
+{
+    if( DataFileBinaryCache::beginBuild( outputPath, 1, nValues, realizations ) )
+        return true;
+    realizations.reset( 1, nValues );
+    realizations.resizeRows( nValues );
+    return false;
+}
+
+void SequentialSimulationUtils::simulateRealizations(QProgressDialog &progressDialog, const QString title,
+                                                     uint nRealizations, size_t nValues,
+                                                     SequentialSimulationProgress &progressInfo,
+                                                     const std::function<void ()> &worker)
+{
+    unsigned int nThreads = std::max( 1u, std::min( std::thread::hardware_concurrency(), nRealizations ) );
+
+    progressDialog.setLabelText("Running " + title + "...");
+    progressDialog.setMinimum( 0 );
+    progressDialog.setValue( 0 );
+    progressDialog.setMaximum( 1000 );
+
+    std::vector<std::thread> threads;
+    for( unsigned int iThread = 0; iThread < nThreads; ++iThread )
+        threads.push_back( std::thread( worker ) );
+
+    //report progress while the workers run
+    while( progressInfo.nRealizationsDone < nRealizations ){
+        unsigned long long nNodesDone = progressInfo.nNodesDone.load();
+        progressDialog.setLabelText("Running " + title + ":\n" +
+                                    QString::number(progressInfo.nRealizationsDone.load()) + " of " +
+                                    QString::number(nRealizations) + " realizations completed (" +
+                                    QString::number(nNodesDone) + " nodes simulated) in " +
+                                    QString::number(nThreads) + " threads. " );
+        progressDialog.setValue( (int)( nNodesDone * 1000 / nValues ) );
+        QCoreApplication::processEvents(); //let Qt repaint widgets
+        std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+    }
+
+    for( std::thread& thread : threads )
+        thread.join();
+}
+
+bool SequentialSimulationUtils::saveRealizations(QProgressDialog &progressDialog, const QString outputPath,
+                                                 const QString title, ColumnarDataStore &realizations, bool isMapped)
+{
+    progressDialog.setLabelText("Saving realizations to " + outputPath + "...");
+    progressDialog.setValue( 0 );
+    QCoreApplication::processEvents();
+
+    bool ok = false;
+    QFile outputFile( outputPath );
+    if( outputFile.open( QFile::WriteOnly | QFile::Truncate | QFile::Text ) ){
+        QTextStream out( &outputFile );
+        out << title << endl;
+        out << 1 << endl;
+        out << "value" << endl;
+
+        //the values are formatted in parallel by DataSaver, in another thread, so the progress dialog keeps updating.
+        DataSaver dataSaver( realizations, out );
+        std::thread thread( &DataSaver::doSave, &dataSaver );
+        while( ! dataSaver.isFinished() ){
+            QCoreApplication::processEvents(); //let Qt repaint widgets
+            std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+        }
+        thread.join();
+
+        ok = outputFile.error() == QFile::NoError;
+        outputFile.close();
+    }
+    if( ! ok )
+        Application::instance()->logError( "SequentialSimulationUtils::saveRealizations(): failed to write " + outputPath + ".", true );
+
+    //the sidecar describes the file just written.
+    if( isMapped ){
+        if( ok )
+            DataFileBinaryCache::finishBuild( outputPath, realizations, std::nan("") );
+        else {
+            realizations.clear();
+            QFile::remove( DataFileBinaryCache::getCachePath( outputPath ).append(".new") );
+        }
+    } else if( ok )
+        DataFileBinaryCache::save( outputPath, realizations, std::nan("") );
+    realizations.clear();
+    return ok;
+}
@@ -0,0 +1,98 @@
+#ifndef SEQUENTIALSIMULATIONUTILS_H
+#define SEQUENTIALSIMULATIONUTILS_H
+
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <random>
+#include <vector>
+
+class CartesianGrid;
+class ColumnarDataStore;
+class QProgressDialog;
+
+/** Work distribution and counters shared by the threads of a sequential simulation (see
+ * SequentialSimulationUtils::simulateRealizations()). */
+struct SequentialSimulationProgress
+{
+    SequentialSimulationProgress() : nextRealization(0), nRealizationsDone(0), nNodesDone(0), nFailed(0) {}
+    std::atomic<unsigned int> nextRealization;
+    std::atomic<unsigned int> nRealizationsDone;
+    std::atomic<unsigned long long> nNodesDone;
+    /** Number of nodes whose kriging system could not be solved (drawn from the global distribution instead). */
+    std::atomic<int> nFailed;
+};
+
+/**
+ * The SequentialSimulationUtils class contains static utilitary functions common to the sequential simulation
+ * engines (SequentialGaussianSimulation and SequentialIndicatorSimulation): the random path, the assignment of
+ * the data to the grid nodes and the storage of the realizations.
+ */
+class SequentialSimulationUtils
+{
+public:
+    /** The data line of the nodes without data assigned to them (see assignDataToNodes()). */
+    static const uint NO_DATA_LINE = std::numeric_limits<uint>::max();
+
+    /** Returns a uniform draw in the open interval (0, 1) from the next output of the engine.  The standard
+     * distributions are not used because their algorithms differ between standard libraries, which would
+     * make the realizations depend on the compiler. */
+    static double uniformDraw( std::mt19937& randomEngine ){
+        return ( randomEngine() + 0.5 ) / 4294967296.0;
+    }
+
+    /**
+     * Shuffles the given cell indexes (in GEO-EAS scan order) into a random path with the Fisher-Yates algorithm
+     * on uniformDraw().  With multigrids, the nodes of the coarsest grid (every 2^n nodes) are then moved to the
+     * beginning of the path, followed by those of the next finer grid and so on, keeping the random order within
+     * each grid.
+     * @param nI, nJ The grid dimensions along I and J.
+     * @param nMultigridRefinements The number of multigrid refinements (zero to not simulate coarser grids first).
+     * @param pathBuffer A buffer to reorder the path, reused between calls.
+     */
+    static void makeRandomPath( std::vector<uint>& path, uint nI, uint nJ, uint nMultigridRefinements,
+                                std::mt19937& randomEngine, std::vector<uint>& pathBuffer );
+
+    /**
+     * Assigns the given data to the nearest grid nodes, each node keeping the nearest datum within its cell.
+     * @param lines The data lines to assign, whose locations are given by x, y and z.
+     * @param nodeLines Output parameter: the data line assigned to each cell (NO_DATA_LINE if none).
+     * @return The number of data outside the grid, which are not assigned.
+     */
+    static uint assignDataToNodes( const CartesianGrid& grid, const std::vector<double>& x,
+                                   const std::vector<double>& y, const std::vector<double>& z,
+                                   const std::vector<uint>& lines, std::vector<uint>& nodeLines );
+
+    /**
+     * Creates the storage of the realizations to be saved to the given GEO-EAS file with saveRealizations(): its
+     * binary sidecar (see DataFileBinaryCache), memory-mapped, so the realizations do not need to fit in memory at
+     * once.  If the sidecar cannot be created, the realizations are kept in memory.
+     * @return Whether the realizations are stored in the sidecar.
+     */
+    static bool beginRealizations( const QString outputPath, size_t nValues, ColumnarDataStore& realizations );
+
+    /**
+     * Runs the given worker in one thread per processor core (but not more than the realizations), showing their
+     * progress in the dialog until all realizations are done.  The workers take the realizations from
+     * progressInfo.nextRealization and update the other counters.
+     * @param title The name of the simulation shown in the dialog (e.g. "sequential Gaussian simulation").
+     * @param nValues The number of nodes of all realizations together.
+     */
+    static void simulateRealizations( QProgressDialog& progressDialog, const QString title,
+                                      uint nRealizations, size_t nValues,
+                                      SequentialSimulationProgress& progressInfo,
+                                      const std::function<void()>& worker );
+
+    /**
+     * Writes the realizations to the GEO-EAS file (a single "value" column, one realization after the other, as
+     * GSLIB's simulation programs do), then completes its sidecar from the realizations (see beginRealizations()),
+     * so the file is loaded afterwards without being parsed.  The realizations are cleared.
+     * @param title The title line of the file.
+     * @return False if the file could not be written (logged as an error).
+     */
+    static bool saveRealizations( QProgressDialog& progressDialog, const QString outputPath, const QString title,
+                                  ColumnarDataStore& realizations, bool isMapped );
+};
+
+#endif // SEQUENTIALSIMULATIONUTILS_H
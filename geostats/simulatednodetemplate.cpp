@@ -0,0 +1,94 @@
+#include "simulatednodetemplate.h"
+#include "searchneighborhood.h"
+#include "domain/cartesiangrid.h"
+
+#include <algorithm>
+
+SimulatedNodeTemplate::SimulatedNodeTemplate() :
+    m_nI( 0 ),
+    m_nJ( 0 ),
+    m_nK( 0 ),
+    m_tableHalfSizeI( 0 ),
+    m_tableHalfSizeJ( 0 ),
+    m_tableHalfSizeK( 0 ),
+    m_tableNI( 1 ),
+    m_tableNJ( 1 ),
+    m_tableSize( 1 ),
+    m_nSectors( 1 ),
+    m_maxPerSector( 0 )
+{
+}
+
+void SimulatedNodeTemplate::build(const CartesianGrid &grid, const SearchNeighborhood &neighborhood,
+                                  uint tableNI, uint tableNJ, uint tableNK,
+                                  const std::vector<CovarianceFunction> &covariances, uint sortingCovariance)
+{
+    m_nI = grid.getNX();
+    m_nJ = grid.getNY();
+    m_nK = grid.getNZ();
+    double dX = grid.getDX();
+    double dY = grid.getDY();
+    double dZ = grid.getDZ();
+
+    //the template spans the covariance lookup table size, limited to the grid.
+    int halfSizeI = std::min<int>( ( std::max( 1u, tableNI ) - 1 ) / 2, m_nI - 1 );
+    int halfSizeJ = std::min<int>( ( std::max( 1u, tableNJ ) - 1 ) / 2, m_nJ - 1 );
+    int halfSizeK = std::min<int>( ( std::max( 1u, tableNK ) - 1 ) / 2, m_nK - 1 );
+
+    //the offsets inside the search neighborhood, sorted by decreasing covariance, then by increasing distance.
+    const CovarianceFunction& sortingFunction = covariances[sortingCovariance];
+    struct TemplateNode { int di, dj, dk; uint sector; double covariance, distance; };
+    std::vector<TemplateNode> templateNodes;
+    for( int dk = -halfSizeK; dk <= halfSizeK; ++dk )
+        for( int dj = -halfSizeJ; dj <= halfSizeJ; ++dj )
+            for( int di = -halfSizeI; di <= halfSizeI; ++di ){
+                if( di == 0 && dj == 0 && dk == 0 )
+                    continue;
+                if( ! neighborhood.isInside( 0.0, 0.0, 0.0, di * dX, dj * dY, dk * dZ ) )
+                    continue;
+                templateNodes.push_back( { di, dj, dk,
+                                           neighborhood.getSector( 0.0, 0.0, 0.0, di * dX, dj * dY, dk * dZ ),
+                                           sortingFunction( di * dX, dj * dY, dk * dZ ),
+                                           neighborhood.getNormalizedDistance( 0.0, 0.0, 0.0, di * dX, dj * dY, dk * dZ ) } );
+            }
+    std::stable_sort( templateNodes.begin(), templateNodes.end(), []( const TemplateNode& a, const TemplateNode& b ){
+        return a.covariance > b.covariance || ( a.covariance == b.covariance && a.distance < b.distance );
+    } );
+    m_templateDI.clear();
+    m_templateDJ.clear();
+    m_templateDK.clear();
+    m_templateSectors.clear();
+    for( const TemplateNode& node : templateNodes ){
+        m_templateDI.push_back( node.di );
+        m_templateDJ.push_back( node.dj );
+        m_templateDK.push_back( node.dk );
+        m_templateSectors.push_back( node.sector );
+    }
+    m_templateCovariances.clear();
+    for( const CovarianceFunction& covariance : covariances )
+        for( const TemplateNode& node : templateNodes )
+            m_templateCovariances.push_back( covariance( node.di * dX, node.dj * dY, node.dk * dZ ) );
+
+    //the covariances between any two template nodes, whose offsets differ by up to twice the template size.
+    m_tableHalfSizeI = 2 * halfSizeI;
+    m_tableHalfSizeJ = 2 * halfSizeJ;
+    m_tableHalfSizeK = 2 * halfSizeK;
+    m_tableNI = 2 * m_tableHalfSizeI + 1;
+    m_tableNJ = 2 * m_tableHalfSizeJ + 1;
+    m_tableSize = (size_t)m_tableNI * m_tableNJ * ( 2 * m_tableHalfSizeK + 1 );
+    m_covarianceTables.clear();
+    m_covarianceTables.reserve( m_tableSize * covariances.size() );
+    for( const CovarianceFunction& covariance : covariances )
+        for( int dk = -m_tableHalfSizeK; dk <= m_tableHalfSizeK; ++dk )
+            for( int dj = -m_tableHalfSizeJ; dj <= m_tableHalfSizeJ; ++dj )
+                for( int di = -m_tableHalfSizeI; di <= m_tableHalfSizeI; ++di )
+                    m_covarianceTables.push_back( covariance( di * dX, dj * dY, dk * dZ ) );
+
+    //the octant search also limits the number of simulated nodes per sector.
+    uint minPerSector;
+    neighborhood.getSectorQuotas( m_nSectors, minPerSector, m_maxPerSector );
+    if( m_nSectors <= 1 ){
+        m_nSectors = 1;
+        m_maxPerSector = 0;
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef SIMULATEDNODETEMPLATE_H
+#define SIMULATEDNODETEMPLATE_H
+
+#include <QtGlobal>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+class CartesianGrid;
+class SearchNeighborhood;
+
+/**
+ * The SimulatedNodeTemplate class searches the previously simulated nodes of sequential simulations (e.g.
+ * SequentialGaussianSimulation) with a template of grid offsets inside the search neighborhood, as GSLIB's simulation
+ * programs do with their spiral search.  The template is sorted by decreasing covariance (then increasing distance),
+ * so the first simulated nodes found are the most correlated ones.  It holds the covariances between the template
+ * offsets and the center node and a lookup table of the covariances between any two template offsets, for each of
+ * one or more covariance functions (e.g. one per indicator variogram model), so the kriging matrices between
+ * simulated nodes need no variogram evaluation.  The template is built once and shared by all simulation threads.
+ */
+class SimulatedNodeTemplate
+{
+public:
+    /** A covariance between two locations given their separation along X, Y and Z. */
+    typedef std::function<double( double dx, double dy, double dz )> CovarianceFunction;
+
+    SimulatedNodeTemplate();
+
+    /**
+     * Builds the template and the covariance tables.
+     * @param tableNI, tableNJ, tableNK The size in nodes of the covariance lookup table (as in GSLIB's programs), which
+     *        bounds the template.  The template is also limited to the grid.
+     * @param covariances The covariance functions, all of which get their covariances tabulated.
+     * @param sortingCovariance The index of the covariance function that sorts the template.
+     */
+    void build( const CartesianGrid& grid, const SearchNeighborhood& neighborhood,
+                uint tableNI, uint tableNJ, uint tableNK,
+                const std::vector<CovarianceFunction>& covariances, uint sortingCovariance );
+
+    /** Returns the number of search sectors (one if the neighborhood has no sectors). */
+    uint getSectorCount() const { return m_nSectors; }
+
+    /** Returns the offsets along I, J and K of a template entry. */
+    int getDI( uint t ) const { return m_templateDI[t]; }
+    int getDJ( uint t ) const { return m_templateDJ[t]; }
+    int getDK( uint t ) const { return m_templateDK[t]; }
+
+    /** Returns the covariance between the center node and a template entry. */
+    double getCovariance( uint covariance, uint t ) const {
+        return m_templateCovariances[ covariance * m_templateDI.size() + t ];
+    }
+
+    /** Returns the covariance between two template entries. */
+    double getCovariance( uint covariance, uint ta, uint tb ) const {
+        int di = m_templateDI[tb] - m_templateDI[ta] + m_tableHalfSizeI;
+        int dj = m_templateDJ[tb] - m_templateDJ[ta] + m_tableHalfSizeJ;
+        int dk = m_templateDK[tb] - m_templateDK[ta] + m_tableHalfSizeK;
+        return m_covarianceTables[ covariance * m_tableSize + di + ( dj + (size_t)dk * m_tableNJ ) * m_tableNI ];
+    }
+
+    /**
+     * Fills nodes with the template entries of the simulated nodes around the node at (i, j, k), in template order,
+     * up to the given maximum and honoring the maximum number per search sector.
+     * @param isSimulated Returns whether the node with the given cell index (GEO-EAS scan order) was simulated.
+     * @param sectorCounts Scratch buffer with room for getSectorCount() entries.
+     */
+    template< typename IsSimulated >
+    void findSimulatedNodes( uint i, uint j, uint k, uint maxNodes, const IsSimulated& isSimulated,
+                             std::vector<uint>& sectorCounts, std::vector<uint>& nodes ) const {
+        nodes.clear();
+        std::fill( sectorCounts.begin(), sectorCounts.end(), 0 );
+        for( uint t = 0; t < m_templateDI.size() && nodes.size() < maxNodes; ++t ){
+            int ii = (int)i + m_templateDI[t];
+            int jj = (int)j + m_templateDJ[t];
+            int kk = (int)k + m_templateDK[t];
+            if( ii < 0 || jj < 0 || kk < 0 || ii >= m_nI || jj >= m_nJ || kk >= m_nK )
+                continue;
+            if( ! isSimulated( ii + ( jj + (size_t)kk * m_nJ ) * m_nI ) )
+                continue;
+            if( m_maxPerSector ){
+                uint& sectorCount = sectorCounts[ m_templateSectors[t] ];
+                if( sectorCount >= m_maxPerSector )
+                    continue;
+                ++sectorCount;
+            }
+            nodes.push_back( t );
+        }
+    }
+
+private:
+    /** The grid dimensions. */
+    int m_nI, m_nJ, m_nK;
+    /** The offsets along I, J and K, their search sectors and their covariances with the center node
+     * (all of a covariance function together). */
+    std::vector<int> m_templateDI, m_templateDJ, m_templateDK;
+    std::vector<uint> m_templateSectors;
+    std::vector<double> m_templateCovariances;
+    /** The covariances between grid offsets from -m_tableHalfSize to +m_tableHalfSize along each axis
+     * (all of a covariance function together). */
+    int m_tableHalfSizeI, m_tableHalfSizeJ, m_tableHalfSizeK;
+    int m_tableNI, m_tableNJ;
+    size_t m_tableSize;
+    std::vector<double> m_covarianceTables;
+    /** The search sectors and the maximum number of nodes per sector (zero if there are no sectors). */
+    uint m_nSectors, m_maxPerSector;
+};
+
+#endif // SIMULATEDNODETEMPLATE_H
@@ -4,6 +4,7 @@
 #include <QTextStream>
 #include <QDir>
 #include <QRegularExpression>
+#include <algorithm>
 #include "../../domain/application.h"
 #include "../../domain/project.h"
 #include "../../domain/variogrammodel.h"
@@ -11,6 +12,7 @@
 #include "gslibparamtypes.h"
 #include "../igslibparameterfinder.h"
 #include "geostats/geostatsutils.h"
+#include "geostats/searchellipsoid.h"
 
 GSLibParameterFile::GSLibParameterFile(const QString program_name)
 {
@@ -309,7 +311,7 @@ void GSLibParameterFile::setVariogramModel(VariogramModel *vm)
 
 void GSLibParameterFile::saveVariogramModel(const QString vmodel_par_path)
 {
-    if( _program_name == "kt3d" )
+    if( _program_name == "kt3d" || _program_name == "sgsim" )
     {
         //make a default vmodel parameters file
         GSLibParameterFile gpf_vmodel( "vmodel" );
@@ -331,35 +333,21 @@ void GSLibParameterFile::saveVariogramModel(const QString vmodel_par_path)
 
 void GSLibParameterFile::copyVariogramModel(GSLibParameterFile *gpf_from)
 {
-    if( _program_name == "vmodel" && gpf_from->getProgramName() == "kt3d" )
+    if( _program_name == "vmodel" && ( gpf_from->getProgramName() == "kt3d" || gpf_from->getProgramName() == "sgsim" ) )
     {
         //get the variogram number of structures and nugget effect variance contribution
-        GSLibParMultiValuedFixed *from_par20 = gpf_from->getParameter<GSLibParMultiValuedFixed*>(20);
-        GSLibParMultiValuedFixed *my_par3 = getParameter<GSLibParMultiValuedFixed*>(3);
-        my_par3->getParameter<GSLibParUInt*>(0)->_value = from_par20->getParameter<GSLibParUInt*>(0)->_value; //nst
-        my_par3->getParameter<GSLibParDouble*>(1)->_value = from_par20->getParameter<GSLibParDouble*>(1)->_value;
-
-        //make the necessary copies of variogram structures
-        GSLibParRepeat *my_par4 = getParameter<GSLibParRepeat*>(4); //repeat nst-times
-        my_par4->setCount( my_par3->getParameter<GSLibParUInt*>(0)->_value );
-
-        //set each variogram structure parameters
-        GSLibParRepeat *from_par21 = gpf_from->getParameter<GSLibParRepeat*>(21); //repeated nst-times
-        for( uint ist = 0; ist < my_par3->getParameter<GSLibParUInt*>(0)->_value; ++ist)
-        {
-            GSLibParMultiValuedFixed *from_par21_0 = from_par21->getParameter<GSLibParMultiValuedFixed*>(ist, 0);
-            GSLibParMultiValuedFixed *my_par4_0 = my_par4->getParameter<GSLibParMultiValuedFixed*>(ist, 0);
-            my_par4_0->getParameter<GSLibParOption*>(0)->_selected_value = from_par21_0->getParameter<GSLibParOption*>(0)->_selected_value;
-            my_par4_0->getParameter<GSLibParDouble*>(1)->_value = from_par21_0->getParameter<GSLibParDouble*>(1)->_value;
-            my_par4_0->getParameter<GSLibParDouble*>(2)->_value = from_par21_0->getParameter<GSLibParDouble*>(2)->_value;
-            my_par4_0->getParameter<GSLibParDouble*>(3)->_value = from_par21_0->getParameter<GSLibParDouble*>(3)->_value;
-            my_par4_0->getParameter<GSLibParDouble*>(4)->_value = from_par21_0->getParameter<GSLibParDouble*>(4)->_value;
-            GSLibParMultiValuedFixed *from_par21_1 = from_par21->getParameter<GSLibParMultiValuedFixed*>(ist, 1);
-            GSLibParMultiValuedFixed *my_par4_1 = my_par4->getParameter<GSLibParMultiValuedFixed*>(ist, 1);
-            my_par4_1->getParameter<GSLibParDouble*>(0)->_value = from_par21_1->getParameter<GSLibParDouble*>(0)->_value;
-            my_par4_1->getParameter<GSLibParDouble*>(1)->_value = from_par21_1->getParameter<GSLibParDouble*>(1)->_value;
-            my_par4_1->getParameter<GSLibParDouble*>(2)->_value = from_par21_1->getParameter<GSLibParDouble*>(2)->_value;
+        //kt3d has them in separate parameters, sgsim has them in a variogram model parameter.
+        GSLibParMultiValuedFixed *from_par20;
+        GSLibParRepeat *from_par21;
+        if( gpf_from->getProgramName() == "kt3d" ){
+            from_par20 = gpf_from->getParameter<GSLibParMultiValuedFixed*>(20);
+            from_par21 = gpf_from->getParameter<GSLibParRepeat*>(21); //repeated nst-times
+        } else {
+            GSLibParVModel *from_par28 = gpf_from->getParameter<GSLibParVModel*>(28);
+            from_par20 = from_par28->_nst_and_nugget;
+            from_par21 = from_par28->_variogram_structures;
         }
+        copyVariogramModel( from_par20, from_par21 );
     } else {
         QString msg("GSLibParameterFile::copyVariogramModel(): variogram model copy from a ");
         msg.append( gpf_from->getProgramName() );
@@ -370,6 +358,86 @@ void GSLibParameterFile::copyVariogramModel(GSLibParameterFile *gpf_from)
     }
 }
 
+void GSLibParameterFile::copyVariogramModel(GSLibParMultiValuedFixed *from_nst_and_nugget, GSLibParRepeat *from_structures)
+{
+    GSLibParMultiValuedFixed *my_par3 = getParameter<GSLibParMultiValuedFixed*>(3);
+    my_par3->getParameter<GSLibParUInt*>(0)->_value = from_nst_and_nugget->getParameter<GSLibParUInt*>(0)->_value; //nst
+    my_par3->getParameter<GSLibParDouble*>(1)->_value = from_nst_and_nugget->getParameter<GSLibParDouble*>(1)->_value;
+
+    //make the necessary copies of variogram structures
+    GSLibParRepeat *my_par4 = getParameter<GSLibParRepeat*>(4); //repeat nst-times
+    my_par4->setCount( my_par3->getParameter<GSLibParUInt*>(0)->_value );
+
+    //set each variogram structure parameters
+    for( uint ist = 0; ist < my_par3->getParameter<GSLibParUInt*>(0)->_value; ++ist)
+    {
+        GSLibParMultiValuedFixed *from_structures_0 = from_structures->getParameter<GSLibParMultiValuedFixed*>(ist, 0);
+        GSLibParMultiValuedFixed *my_par4_0 = my_par4->getParameter<GSLibParMultiValuedFixed*>(ist, 0);
+        my_par4_0->getParameter<GSLibParOption*>(0)->_selected_value = from_structures_0->getParameter<GSLibParOption*>(0)->_selected_value;
+        my_par4_0->getParameter<GSLibParDouble*>(1)->_value = from_structures_0->getParameter<GSLibParDouble*>(1)->_value;
+        my_par4_0->getParameter<GSLibParDouble*>(2)->_value = from_structures_0->getParameter<GSLibParDouble*>(2)->_value;
+        my_par4_0->getParameter<GSLibParDouble*>(3)->_value = from_structures_0->getParameter<GSLibParDouble*>(3)->_value;
+        my_par4_0->getParameter<GSLibParDouble*>(4)->_value = from_structures_0->getParameter<GSLibParDouble*>(4)->_value;
+        GSLibParMultiValuedFixed *from_structures_1 = from_structures->getParameter<GSLibParMultiValuedFixed*>(ist, 1);
+        GSLibParMultiValuedFixed *my_par4_1 = my_par4->getParameter<GSLibParMultiValuedFixed*>(ist, 1);
+        my_par4_1->getParameter<GSLibParDouble*>(0)->_value = from_structures_1->getParameter<GSLibParDouble*>(0)->_value;
+        my_par4_1->getParameter<GSLibParDouble*>(1)->_value = from_structures_1->getParameter<GSLibParDouble*>(1)->_value;
+        my_par4_1->getParameter<GSLibParDouble*>(2)->_value = from_structures_1->getParameter<GSLibParDouble*>(2)->_value;
+    }
+}
+
+void GSLibParameterFile::saveVariogramModel(GSLibParVModel *par_vmodel, const QString vmodel_par_path)
+{
+    //make a default vmodel parameters file
+    GSLibParameterFile gpf_vmodel( "vmodel" );
+    gpf_vmodel.setDefaultValues();
+
+    //copy the variogram model parameters to it
+    gpf_vmodel.copyVariogramModel( par_vmodel->_nst_and_nugget, par_vmodel->_variogram_structures );
+
+    //save the vmodel par file
+    gpf_vmodel.save( vmodel_par_path );
+}
+
+std::vector<VariogramModel *> GSLibParameterFile::makeVariogramModels(GSLibParRepeat *par_vmodels, uint first, uint count,
+                                                                     std::vector<VariogramModel *> &distinctModels)
+{
+    std::vector<VariogramModel*> models;
+    std::vector<GSLibParVModel*> distinctParameters;
+    distinctModels.clear();
+    for( uint i = first; i < first + count; ++i ){
+        GSLibParVModel* par_vmodel = par_vmodels->getParameter<GSLibParVModel*>(i, 0);
+        auto it = std::find_if( distinctParameters.begin(), distinctParameters.end(), [par_vmodel]( GSLibParVModel* par ){
+            return par->isSameModel( par_vmodel );
+        } );
+        if( it == distinctParameters.end() ){
+            //VariogramModel reads its parameters from a vmodel parameter file.
+            QString vmodel_par_path = Application::instance()->getProject()->generateUniqueTmpFilePath("par");
+            saveVariogramModel( par_vmodel, vmodel_par_path );
+            distinctParameters.push_back( par_vmodel );
+            distinctModels.push_back( new VariogramModel( vmodel_par_path ) );
+            models.push_back( distinctModels.back() );
+        } else
+            models.push_back( distinctModels[ it - distinctParameters.begin() ] );
+    }
+    return models;
+}
+
+SearchStrategyPtr GSLibParameterFile::makeSearchStrategy(GSLibParMultiValuedFixed *par_radii, GSLibParMultiValuedFixed *par_angles,
+                                                         uint noct, uint ndmax, uint ndmin)
+{
+    SearchNeighborhoodPtr searchNeighborhood(
+                new SearchEllipsoid( par_radii->getParameter<GSLibParDouble*>(0)->_value,
+                                     par_radii->getParameter<GSLibParDouble*>(1)->_value,
+                                     par_radii->getParameter<GSLibParDouble*>(2)->_value,
+                                     par_angles->getParameter<GSLibParDouble*>(0)->_value,
+                                     par_angles->getParameter<GSLibParDouble*>(1)->_value,
+                                     par_angles->getParameter<GSLibParDouble*>(2)->_value,
+                                     noct > 0 ? 8 : 1, 0, noct > 0 ? noct : ndmax )
+                );
+    return SearchStrategyPtr( new SearchStrategy( searchNeighborhood, ndmax, 0.0, ndmin ) );
+}
+
 void GSLibParameterFile::setGridParameters(CartesianGrid *cg)
 {
     QList<GSLibParType*>::iterator it = _params.begin();
@@ -4,10 +4,14 @@
 #include <QList>
 #include <QString>
 #include <QStringList>
+#include <vector>
 #include "../gslibparams/gslibpartype.h"
+#include "geostats/searchstrategy.h"
 
 class QTextStream;
 class GSLibParRepeat;
+class GSLibParMultiValuedFixed;
+class GSLibParVModel;
 class VariogramModel;
 class CartesianGrid;
 
@@ -139,6 +143,32 @@ public: //-------static functions---------------
       */
     static void generateParameterFileTemplates( const QString directory_path );
 
+    /**
+     * Saves the given variogram model parameter (e.g. one of the repeated models of ik3d or sisim)
+     * as a vmodel program parameter file given a full path to it.
+     */
+    static void saveVariogramModel( GSLibParVModel* par_vmodel, const QString vmodel_par_path );
+
+    /**
+     * Makes a VariogramModel object for each of count repeated variogram model parameters starting at the first one
+     * (e.g. the models per threshold of ik3d or sisim, or just the model of the median IK threshold).  Parameters with
+     * the same values (see GSLibParVModel::isSameModel()) share the same object, so the thresholds with identical
+     * models can be kriged with the same matrix.
+     * @param distinctModels Output parameter: the distinct objects, which the caller must delete.
+     */
+    static std::vector<VariogramModel*> makeVariogramModels( GSLibParRepeat* par_vmodels, uint first, uint count,
+                                                             std::vector<VariogramModel*>& distinctModels );
+
+    /**
+     * Makes the search strategy of GSLib's kriging and simulation programs from their search parameters: the search
+     * ellipsoid, with eight sectors (the octant search) if noct is greater than zero.
+     * @param par_radii The maximum search radii (hmax, hmin, vert).
+     * @param par_angles The search ellipsoid angles (azimuth, dip, roll).
+     * @param noct The maximum number of samples per octant (zero to not use the octant search).
+     */
+    static SearchStrategyPtr makeSearchStrategy( GSLibParMultiValuedFixed* par_radii, GSLibParMultiValuedFixed* par_angles,
+                                                 uint noct, uint ndmax, uint ndmin );
+
 private:
     /**
       * the header of the parameter file
@@ -300,6 +330,12 @@ private:
      */
     void addAsMultiValued(QList<GSLibParType*>* params, GSLibParType *parameter );
 
+    /**
+     * Called by copyVariogramModel() and saveVariogramModel() to copy the number of structures, the nugget effect
+     * and the variogram structures to this vmodel parameter set.
+     */
+    void copyVariogramModel( GSLibParMultiValuedFixed* from_nst_and_nugget, GSLibParRepeat* from_structures );
+
     /**
      * Called in generateParameterFileTemplates() to generate the parts in common with the
      * three SISIM programs (sisim, sisim_gs and sisim_lm).
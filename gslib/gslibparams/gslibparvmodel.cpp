@@ -95,6 +95,31 @@ void GSLibParVModel::makeNull()
     par1->getParameter<GSLibParDouble*>(2)->_value = 1.0; //range along vertical
 }
 
+bool GSLibParVModel::isSameModel(GSLibParVModel *other)
+{
+    uint nst = _nst_and_nugget->getParameter<GSLibParUInt*>(0)->_value;
+    if( other->_nst_and_nugget->getParameter<GSLibParUInt*>(0)->_value != nst ||
+        other->_nst_and_nugget->getParameter<GSLibParDouble*>(1)->_value != _nst_and_nugget->getParameter<GSLibParDouble*>(1)->_value )
+        return false;
+    if( _variogram_structures->getCount() < nst || other->_variogram_structures->getCount() < nst )
+        return false;
+    for(uint i = 0; i < nst; ++i){ //for each variogram structure
+        GSLibParMultiValuedFixed* par0 = _variogram_structures->getParameter<GSLibParMultiValuedFixed*>(i, 0);
+        GSLibParMultiValuedFixed* other_par0 = other->_variogram_structures->getParameter<GSLibParMultiValuedFixed*>(i, 0);
+        if( other_par0->getParameter<GSLibParOption*>(0)->_selected_value != par0->getParameter<GSLibParOption*>(0)->_selected_value )
+            return false; //structure type
+        for(uint j = 1; j < 5; ++j) //covariance contribution and angles
+            if( other_par0->getParameter<GSLibParDouble*>(j)->_value != par0->getParameter<GSLibParDouble*>(j)->_value )
+                return false;
+        GSLibParMultiValuedFixed* par1 = _variogram_structures->getParameter<GSLibParMultiValuedFixed*>(i, 1);
+        GSLibParMultiValuedFixed* other_par1 = other->_variogram_structures->getParameter<GSLibParMultiValuedFixed*>(i, 1);
+        for(uint j = 0; j < 3; ++j) //ranges
+            if( other_par1->getParameter<GSLibParDouble*>(j)->_value != par1->getParameter<GSLibParDouble*>(j)->_value )
+                return false;
+    }
+    return true;
+}
+
 void GSLibParVModel::save(QTextStream *out)
 {
     _nst_and_nugget->save( out );
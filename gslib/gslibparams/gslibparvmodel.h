@@ -25,6 +25,9 @@ public:
     /** Sets parameters of a variogram with zero sill. */
     void makeNull();
 
+    /** Returns whether the given variogram model parameter has the same nugget effect and structures as this one. */
+    bool isSameModel( GSLibParVModel* other );
+
     // GSLibParType interface
 public:
     void save(QTextStream *out);
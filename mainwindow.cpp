@@ -1338,12 +1338,24 @@ void MainWindow::onLookForDuplicates()
 		sip.fill( ps, tolerance );
         uint totFileDataLines = ps->getDataLineCount();
         uint headerLineCount = Util::getHeaderLineCount( ps->getPath() );
+		//query the neighbors of all samples at once (the batch query runs in parallel).
+		std::vector<double> x( totFileDataLines ), y( totFileDataLines ), z( totFileDataLines );
+		for( uint iFileDataLine = 0; iFileDataLine < totFileDataLines; ++iFileDataLine){
+			x[iFileDataLine] = ps->getDataSpatialLocation( iFileDataLine, CartesianCoord::X );
+			y[iFileDataLine] = ps->getDataSpatialLocation( iFileDataLine, CartesianCoord::Y );
+			z[iFileDataLine] = ps->getDataSpatialLocation( iFileDataLine, CartesianCoord::Z );
+		}
+		SpatialQueryResults nearSamples;
+		sip.getNearestWithin( x.data(), y.data(), z.data(), totFileDataLines, 5, distance, nearSamples );
         Application::instance()->logInfo( "=======BEGIN OF REPORT============" );
         QStringList messages;
         for( uint iFileDataLine = 0; iFileDataLine < totFileDataLines; ++iFileDataLine){
-			QList<uint> nearSamples = sip.getNearestWithin( iFileDataLine, 5, distance);
-            QList<uint>::iterator it = nearSamples.begin();
-            for(; it != nearSamples.end(); ++it){
+			const uint* it = nearSamples.begin( iFileDataLine );
+			const uint* end = it + nearSamples.count( iFileDataLine );
+            for(; it != end; ++it){
+                //the sample itself is among its nearest samples
+                if( *it == iFileDataLine )
+                    continue;
                 uint lineNumber1 = iFileDataLine + 1 + headerLineCount;
                 uint lineNumber2 = *it + 1 + headerLineCount;
                 //do not report symmetrical occurences.
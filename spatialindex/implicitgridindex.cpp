@@ -0,0 +1,258 @@
+#include "implicitgridindex.h"
+#include "neighborvisitor.h"
+
+#include "domain/cartesiangrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+ImplicitGridIndex::ImplicitGridIndex() :
+    m_origin{ 0.0, 0.0, 0.0 },
+    m_cellSize{ 0.0, 0.0, 0.0 },
+    m_nI( 0 ), m_nJ( 0 ), m_nK( 0 )
+{
+}
+
+void ImplicitGridIndex::setGrid(CartesianGrid *cg)
+{
+    m_cellSize[0] = cg->getDX();
+    m_cellSize[1] = cg->getDY();
+    m_cellSize[2] = cg->getDZ();
+    m_origin[0] = cg->getX0();
+    m_origin[1] = cg->getY0();
+    //2D grids are positioned at Z=0.0 by convention (see CartesianGrid::IJKtoXYZ())
+    m_origin[2] = cg->getNZ() > 1 ? cg->getZ0() : -m_cellSize[2] / 2.0;
+    m_nI = cg->getNX();
+    m_nJ = cg->getNY();
+    m_nK = cg->getNZ();
+}
+
+void ImplicitGridIndex::clear()
+{
+    m_nI = m_nJ = m_nK = 0;
+}
+
+void ImplicitGridIndex::getCellBox(size_t index, double &minX, double &minY, double &minZ,
+                                   double &maxX, double &maxY, double &maxZ) const
+{
+    size_t nIJ = (size_t)m_nI * m_nJ;
+    size_t k = index / nIJ;
+    size_t j = ( index - k * nIJ ) / m_nI;
+    size_t i = index % m_nI;
+    minX = m_origin[0] + i * m_cellSize[0];
+    minY = m_origin[1] + j * m_cellSize[1];
+    minZ = m_origin[2] + k * m_cellSize[2];
+    maxX = minX + m_cellSize[0];
+    maxY = minY + m_cellSize[1];
+    maxZ = minZ + m_cellSize[2];
+}
+
+int ImplicitGridIndex::clampedCell(double coord, double origin, double cellSize, int nCells)
+{
+    double cell = std::floor( ( coord - origin ) / cellSize );
+    if( ! ( cell > 0.0 ) ) //also catches NaN
+        return 0;
+    if( cell >= nCells )
+        return nCells - 1;
+    return (int)cell;
+}
+
+void ImplicitGridIndex::queryBox(double minX, double minY, double minZ,
+                                 double maxX, double maxY, double maxZ,
+                                 std::vector<size_t> &result) const
+{
+    if( empty() )
+        return;
+    double boxMin[3] = { minX, minY, minZ };
+    double boxMax[3] = { maxX, maxY, maxZ };
+    int nCells[3] = { m_nI, m_nJ, m_nK };
+    int first[3], last[3];
+    for( int d = 0; d < 3; ++d ){
+        //the box is entirely outside the grid along this axis
+        if( boxMax[d] < m_origin[d] || boxMin[d] > m_origin[d] + nCells[d] * m_cellSize[d] )
+            return;
+        first[d] = clampedCell( boxMin[d], m_origin[d], m_cellSize[d], nCells[d] );
+        last[d]  = clampedCell( boxMax[d], m_origin[d], m_cellSize[d], nCells[d] );
+        //a box touching the lower face of a cell also intersects the cell before it
+        if( first[d] > 0 && boxMin[d] <= m_origin[d] + first[d] * m_cellSize[d] )
+            --first[d];
+    }
+    result.reserve( result.size() + (size_t)( last[0] - first[0] + 1 ) *
+                                    ( last[1] - first[1] + 1 ) * ( last[2] - first[2] + 1 ) );
+    for( int k = first[2]; k <= last[2]; ++k )
+        for( int j = first[1]; j <= last[1]; ++j ){
+            size_t rowStart = (size_t)k * m_nI * m_nJ + (size_t)j * m_nI;
+            for( int i = first[0]; i <= last[0]; ++i )
+                result.push_back( rowStart + i );
+        }
+}
+
+double ImplicitGridIndex::squaredDistanceToCell(const double *location, int i, int j, int k) const
+{
+    int ijk[3] = { i, j, k };
+    double d2 = 0.0;
+    for( int d = 0; d < 3; ++d ){
+        double cellMin = m_origin[d] + ijk[d] * m_cellSize[d];
+        double cellMax = cellMin + m_cellSize[d];
+        double delta = 0.0;
+        if( location[d] < cellMin )
+            delta = cellMin - location[d];
+        else if( location[d] > cellMax )
+            delta = location[d] - cellMax;
+        d2 += delta * delta;
+    }
+    return d2;
+}
+
+void ImplicitGridIndex::queryNearest(double x, double y, double z, size_t n, std::vector<size_t> &result) const
+{
+    if( empty() || n == 0 )
+        return;
+    double location[3] = { x, y, z };
+    int nCells[3] = { m_nI, m_nJ, m_nK };
+
+    //the cell nearest to the location is the start of the search
+    int center[3];
+    for( int d = 0; d < 3; ++d )
+        center[d] = clampedCell( location[d], m_origin[d], m_cellSize[d], nCells[d] );
+
+    //a cell k shells away from the start cell is at least (k-1) cells away from the location along some axis
+    //with more than one cell.
+    double minCellSize = std::numeric_limits<double>::max();
+    int maxShell = 0;
+    for( int d = 0; d < 3; ++d )
+        if( nCells[d] > 1 ){
+            minCellSize = std::min( minCellSize, m_cellSize[d] );
+            maxShell = std::max( maxShell, std::max( center[d], nCells[d] - 1 - center[d] ) );
+        }
+
+    //max-heap of the n nearest cells found so far: (squared distance, cell index)
+    typedef std::pair<double, size_t> Candidate;
+    std::vector<Candidate> candidates;
+    candidates.reserve( n + 1 );
+    auto offer = [&]( int i, int j, int k ){
+        double d2 = squaredDistanceToCell( location, i, j, k );
+        if( candidates.size() < n ){
+            candidates.push_back( Candidate( d2, (size_t)k * m_nI * m_nJ + (size_t)j * m_nI + i ) );
+            std::push_heap( candidates.begin(), candidates.end() );
+        } else if( d2 < candidates.front().first ){
+            std::pop_heap( candidates.begin(), candidates.end() );
+            candidates.back() = Candidate( d2, (size_t)k * m_nI * m_nJ + (size_t)j * m_nI + i );
+            std::push_heap( candidates.begin(), candidates.end() );
+        }
+    };
+
+    for( int shell = 0; shell <= maxShell; ++shell ){
+        if( shell > 1 && candidates.size() == n ){
+            double lowerBound = ( shell - 1 ) * minCellSize;
+            if( lowerBound * lowerBound > candidates.front().first )
+                break;
+        }
+        int kMin = std::max( center[2] - shell, 0 ), kMax = std::min( center[2] + shell, m_nK - 1 );
+        int jMin = std::max( center[1] - shell, 0 ), jMax = std::min( center[1] + shell, m_nJ - 1 );
+        int iLow = center[0] - shell, iHigh = center[0] + shell;
+        for( int k = kMin; k <= kMax; ++k )
+            for( int j = jMin; j <= jMax; ++j ){
+                //rows on the faces of the shell along J or K are entirely in the shell...
+                if( std::abs( k - center[2] ) == shell || std::abs( j - center[1] ) == shell ){
+                    for( int i = std::max( iLow, 0 ); i <= std::min( iHigh, m_nI - 1 ); ++i )
+                        offer( i, j, k );
+                //...other rows only have their two ends in it.
+                } else {
+                    if( iLow >= 0 )
+                        offer( iLow, j, k );
+                    if( iHigh < m_nI && iHigh != iLow )
+                        offer( iHigh, j, k );
+                }
+            }
+    }
+
+    std::sort_heap( candidates.begin(), candidates.end() );
+    for( const Candidate& candidate : candidates )
+        result.push_back( candidate.second );
+}
+
+void ImplicitGridIndex::visitNearest(double x, double y, double z,
+                                     double minX, double minY, double minZ,
+                                     double maxX, double maxY, double maxZ,
+                                     NeighborVisitor &visitor) const
+{
+    if( empty() )
+        return;
+    double location[3] = { x, y, z };
+    double boxMin[3] = { minX, minY, minZ };
+    double boxMax[3] = { maxX, maxY, maxZ };
+    int nCells[3] = { m_nI, m_nJ, m_nK };
+
+    //the ranges of cells whose centers are inside the box
+    int first[3], last[3];
+    for( int d = 0; d < 3; ++d ){
+        first[d] = (int)std::max( 0.0, std::ceil( ( boxMin[d] - m_origin[d] ) / m_cellSize[d] - 0.5 ) );
+        last[d]  = (int)std::min( nCells[d] - 1.0, std::floor( ( boxMax[d] - m_origin[d] ) / m_cellSize[d] - 0.5 ) );
+        if( ! ( first[d] <= last[d] ) )
+            return;
+    }
+
+    //the search starts at the cell of the range nearest to the location
+    int center[3];
+    double minCellSize = std::numeric_limits<double>::max();
+    int maxShell = 0;
+    for( int d = 0; d < 3; ++d ){
+        center[d] = std::min( std::max( clampedCell( location[d], m_origin[d], m_cellSize[d], nCells[d] ), first[d] ), last[d] );
+        if( last[d] > first[d] ){
+            minCellSize = std::min( minCellSize, m_cellSize[d] );
+            maxShell = std::max( maxShell, std::max( center[d] - first[d], last[d] - center[d] ) );
+        }
+    }
+
+    //min-heap of the cells found but not yet visited: (distance, cell index)
+    typedef std::pair<double, size_t> Candidate;
+    std::priority_queue< Candidate, std::vector<Candidate>, std::greater<Candidate> > candidates;
+    auto offer = [&]( int i, int j, int k ){
+        double dx = m_origin[0] + ( i + 0.5 ) * m_cellSize[0] - location[0];
+        double dy = m_origin[1] + ( j + 0.5 ) * m_cellSize[1] - location[1];
+        double dz = m_origin[2] + ( k + 0.5 ) * m_cellSize[2] - location[2];
+        candidates.push( Candidate( std::sqrt( dx*dx + dy*dy + dz*dz ), (size_t)k * m_nI * m_nJ + (size_t)j * m_nI + i ) );
+    };
+    //visits the candidates not farther than the given distance, returns false if the visitor stops the traversal.
+    auto visitUpTo = [&]( double maxDistance ){
+        while( ! candidates.empty() && candidates.top().first <= maxDistance ){
+            size_t cell = candidates.top().second;
+            double distance = candidates.top().first;
+            candidates.pop();
+            size_t k = cell / ( (size_t)m_nI * m_nJ );
+            size_t j = ( cell / m_nI ) % m_nJ;
+            size_t i = cell % m_nI;
+            if( ! visitor.visit( cell, m_origin[0] + ( i + 0.5 ) * m_cellSize[0],
+                                       m_origin[1] + ( j + 0.5 ) * m_cellSize[1],
+                                       m_origin[2] + ( k + 0.5 ) * m_cellSize[2], distance ) )
+                return false;
+        }
+        return true;
+    };
+
+    for( int shell = 0; shell <= maxShell; ++shell ){
+        //the cells of this shell and of the following ones are at least (shell-1) cells away from the location.
+        if( shell > 1 && ! visitUpTo( ( shell - 1 ) * minCellSize ) )
+            return;
+        int kMin = std::max( center[2] - shell, first[2] ), kMax = std::min( center[2] + shell, last[2] );
+        int jMin = std::max( center[1] - shell, first[1] ), jMax = std::min( center[1] + shell, last[1] );
+        int iLow = center[0] - shell, iHigh = center[0] + shell;
+        for( int k = kMin; k <= kMax; ++k )
+            for( int j = jMin; j <= jMax; ++j ){
+                if( std::abs( k - center[2] ) == shell || std::abs( j - center[1] ) == shell ){
+                    for( int i = std::max( iLow, first[0] ); i <= std::min( iHigh, last[0] ); ++i )
+                        offer( i, j, k );
+                } else {
+                    if( iLow >= first[0] )
+                        offer( iLow, j, k );
+                    if( iHigh <= last[0] && iHigh != iLow )
+                        offer( iHigh, j, k );
+                }
+            }
+    }
+    visitUpTo( std::numeric_limits<double>::infinity() );
+}
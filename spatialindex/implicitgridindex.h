@@ -0,0 +1,67 @@
+#ifndef IMPLICITGRIDINDEX_H
+#define IMPLICITGRIDINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+class CartesianGrid;
+class NeighborVisitor;
+
+/**
+ * The ImplicitGridIndex class answers spatial queries on the cells of a regular grid in closed form from
+ * the grid geometry, so, unlike an R-tree of the cell boxes, it has no build step and takes no memory per cell.
+ * The cell locations are those given by CartesianGrid::getDataSpatialLocation(), that is, cell (i,j,k) spans
+ * [X0 + i*DX, X0 + (i+1)*DX] along X (likewise for Y and Z) and 2D grids span [-DZ/2, DZ/2] along Z.
+ * The query methods are const, so the index can be queried from several threads at once.
+ */
+class ImplicitGridIndex
+{
+public:
+    ImplicitGridIndex();
+
+    /** Takes the geometry of the given grid.  The grid is not referenced afterwards. */
+    void setGrid( CartesianGrid* cg );
+
+    /** Forgets the grid geometry. */
+    void clear();
+
+    bool empty() const { return m_nI == 0; }
+
+    /** Returns the bounding box of the cell with the given data record index (file data line). */
+    void getCellBox( size_t index, double& minX, double& minY, double& minZ,
+                     double& maxX, double& maxY, double& maxZ ) const;
+
+    /** Appends to result the data record indexes of the cells whose boxes intersect the given box. */
+    void queryBox( double minX, double minY, double minZ,
+                   double maxX, double maxY, double maxZ,
+                   std::vector<size_t>& result ) const;
+
+    /** Appends to result the data record indexes of the n cells nearest to the given location, closest first.
+     * The distances are to the cell boxes, so the cell containing the location is at zero distance.
+     * The cells are enumerated in shells of IJK offsets of increasing size around the cell nearest to the location,
+     * until no cell of the next shell may be closer than the n-th cell found. */
+    void queryNearest( double x, double y, double z, size_t n, std::vector<size_t>& result ) const;
+
+    /** Passes the cells whose centers are inside the given box to the visitor in increasing distance between their
+     * centers and the given location, until the visitor returns false or all the cells in the box are visited.
+     * The cells are enumerated in shells like in queryNearest(), each cell being passed once no cell of the
+     * following shells may be nearer. */
+    void visitNearest( double x, double y, double z,
+                       double minX, double minY, double minZ,
+                       double maxX, double maxY, double maxZ,
+                       NeighborVisitor& visitor ) const;
+
+private:
+    /** Returns the cell index along an axis of the given coordinate, clamped to the grid. */
+    static int clampedCell( double coord, double origin, double cellSize, int nCells );
+
+    /** Returns the squared distance between the given location and the box of the given cell. */
+    double squaredDistanceToCell( const double* location, int i, int j, int k ) const;
+
+    /** The lower corner of the grid, the cell sizes and the cell counts. */
+    double m_origin[3];
+    double m_cellSize[3];
+    int m_nI, m_nJ, m_nK;
+};
+
+#endif // IMPLICITGRIDINDEX_H
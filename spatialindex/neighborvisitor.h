@@ -0,0 +1,27 @@
+#ifndef NEIGHBORVISITOR_H
+#define NEIGHBORVISITOR_H
+
+#include <cstddef>
+
+/**
+ * The NeighborVisitor class is the interface of the objects that receive the entries of a spatial index one by one
+ * in increasing distance from a location, so a search can stop as soon as it has what it needs instead of
+ * getting all the candidates first (see SpatialIndexPoints::getNearestWithin()).
+ */
+class NeighborVisitor
+{
+public:
+    virtual ~NeighborVisitor(){}
+
+    /** Receives the next entry of the traversal.
+     * @param index The data record index (file data line) of the entry.
+     * @param x, y, z The location of the entry.
+     * @param distance A lower bound of the Euclidean distances from the query location to this and to all
+     *                 the entries not yet visited (e.g. the distance to the entry itself or to its bounding box).
+     *                 It never decreases along the traversal.
+     * @return false to stop the traversal.
+     */
+    virtual bool visit( size_t index, double x, double y, double z, double distance ) = 0;
+};
+
+#endif // NEIGHBORVISITOR_H
@@ -0,0 +1,252 @@
+#include "pointkdtree.h"
+#include "neighborvisitor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+PointKDTree::PointKDTree()
+{
+}
+
+void PointKDTree::build(std::vector<KDTreePoint> &points)
+{
+    m_points.swap( points );
+    points.clear();
+    m_splitAxes.assign( m_points.size(), 0 );
+    buildRange( 0, m_points.size() );
+}
+
+void PointKDTree::clear()
+{
+    m_points.clear();
+    m_points.shrink_to_fit();
+    m_splitAxes.clear();
+    m_splitAxes.shrink_to_fit();
+}
+
+void PointKDTree::buildRange(size_t begin, size_t end)
+{
+    if( end - begin <= LEAF_SIZE )
+        return;
+
+    //split along the axis with the largest spread, which keeps the cells of the tree compact
+    double min[3] = { m_points[begin].coords[0], m_points[begin].coords[1], m_points[begin].coords[2] };
+    double max[3] = { min[0], min[1], min[2] };
+    for( size_t i = begin + 1; i < end; ++i )
+        for( int d = 0; d < 3; ++d ){
+            min[d] = std::min( min[d], m_points[i].coords[d] );
+            max[d] = std::max( max[d], m_points[i].coords[d] );
+        }
+    unsigned char axis = 0;
+    for( unsigned char d = 1; d < 3; ++d )
+        if( max[d] - min[d] > max[axis] - min[axis] )
+            axis = d;
+
+    //the median is the node of this range: the points before it are not greater and the points after it
+    //are not less along the splitting axis.
+    size_t mid = begin + ( end - begin ) / 2;
+    std::nth_element( m_points.begin() + begin, m_points.begin() + mid, m_points.begin() + end,
+                      [axis]( const KDTreePoint& a, const KDTreePoint& b ){ return a.coords[axis] < b.coords[axis]; } );
+    m_splitAxes[mid] = axis;
+
+    buildRange( begin, mid );
+    buildRange( mid + 1, end );
+}
+
+void PointKDTree::queryBox(double minX, double minY, double minZ,
+                           double maxX, double maxY, double maxZ,
+                           std::vector<size_t> &result) const
+{
+    double boxMin[3] = { minX, minY, minZ };
+    double boxMax[3] = { maxX, maxY, maxZ };
+    queryBoxRange( 0, m_points.size(), boxMin, boxMax, result );
+}
+
+void PointKDTree::queryBoxRange(size_t begin, size_t end, const double *boxMin, const double *boxMax,
+                                std::vector<size_t> &result) const
+{
+    if( end - begin <= LEAF_SIZE ){
+        for( size_t i = begin; i < end; ++i ){
+            const double* p = m_points[i].coords;
+            if( p[0] >= boxMin[0] && p[0] <= boxMax[0] &&
+                p[1] >= boxMin[1] && p[1] <= boxMax[1] &&
+                p[2] >= boxMin[2] && p[2] <= boxMax[2] )
+                result.push_back( i );
+        }
+        return;
+    }
+    size_t mid = begin + ( end - begin ) / 2;
+    int axis = m_splitAxes[mid];
+    const double* p = m_points[mid].coords;
+    if( p[0] >= boxMin[0] && p[0] <= boxMax[0] &&
+        p[1] >= boxMin[1] && p[1] <= boxMax[1] &&
+        p[2] >= boxMin[2] && p[2] <= boxMax[2] )
+        result.push_back( mid );
+    if( boxMin[axis] <= p[axis] )
+        queryBoxRange( begin, mid, boxMin, boxMax, result );
+    if( boxMax[axis] >= p[axis] )
+        queryBoxRange( mid + 1, end, boxMin, boxMax, result );
+}
+
+void PointKDTree::queryNearest(double x, double y, double z, size_t n, std::vector<size_t> &result) const
+{
+    if( n == 0 )
+        return;
+    double location[3] = { x, y, z };
+    std::vector<Candidate> candidates;
+    candidates.reserve( n + 1 );
+    queryNearestRange( 0, m_points.size(), location, n, candidates );
+    std::sort_heap( candidates.begin(), candidates.end() );
+    for( const Candidate& candidate : candidates )
+        result.push_back( candidate.second );
+}
+
+void PointKDTree::offerCandidate(size_t position, const double *location, size_t n,
+                                 std::vector<Candidate> &candidates) const
+{
+    const double* p = m_points[position].coords;
+    double dx = p[0] - location[0];
+    double dy = p[1] - location[1];
+    double dz = p[2] - location[2];
+    double d2 = dx*dx + dy*dy + dz*dz;
+    if( candidates.size() < n ){
+        candidates.push_back( Candidate( d2, position ) );
+        std::push_heap( candidates.begin(), candidates.end() );
+    } else if( d2 < candidates.front().first ){
+        std::pop_heap( candidates.begin(), candidates.end() );
+        candidates.back() = Candidate( d2, position );
+        std::push_heap( candidates.begin(), candidates.end() );
+    }
+}
+
+void PointKDTree::queryNearestRange(size_t begin, size_t end, const double *location, size_t n,
+                                    std::vector<Candidate> &candidates) const
+{
+    if( end - begin <= LEAF_SIZE ){
+        for( size_t i = begin; i < end; ++i )
+            offerCandidate( i, location, n, candidates );
+        return;
+    }
+    size_t mid = begin + ( end - begin ) / 2;
+    int axis = m_splitAxes[mid];
+    offerCandidate( mid, location, n, candidates );
+    //visit first the side of the splitting plane containing the location...
+    double diff = location[axis] - m_points[mid].coords[axis];
+    if( diff < 0.0 )
+        queryNearestRange( begin, mid, location, n, candidates );
+    else
+        queryNearestRange( mid + 1, end, location, n, candidates );
+    //...then the other side, only if it may have points closer than the farthest candidate.
+    if( candidates.size() < n || diff * diff < candidates.front().first ){
+        if( diff < 0.0 )
+            queryNearestRange( mid + 1, end, location, n, candidates );
+        else
+            queryNearestRange( begin, mid, location, n, candidates );
+    }
+}
+
+namespace {
+    /** An entry of the queue of PointKDTree::visitNearest(): either a range of the tree with its bounds
+     * or a single point (end == 0). */
+    struct TraversalEntry
+    {
+        double distance;
+        size_t begin, end;
+        double min[3], max[3];
+        bool operator>( const TraversalEntry& other ) const { return distance > other.distance; }
+    };
+
+    /** Returns the distance between a location and a box (zero if inside). */
+    double distanceToBox( const double* location, const double* min, const double* max )
+    {
+        double d2 = 0.0;
+        for( int d = 0; d < 3; ++d ){
+            double delta = 0.0;
+            if( location[d] < min[d] )
+                delta = min[d] - location[d];
+            else if( location[d] > max[d] )
+                delta = location[d] - max[d];
+            d2 += delta * delta;
+        }
+        return std::sqrt( d2 );
+    }
+}
+
+void PointKDTree::visitNearest(double x, double y, double z,
+                               double minX, double minY, double minZ,
+                               double maxX, double maxY, double maxZ,
+                               NeighborVisitor &visitor) const
+{
+    if( m_points.empty() )
+        return;
+    double location[3] = { x, y, z };
+    double boxMin[3] = { minX, minY, minZ };
+    double boxMax[3] = { maxX, maxY, maxZ };
+
+    std::priority_queue< TraversalEntry, std::vector<TraversalEntry>, std::greater<TraversalEntry> > queue;
+
+    auto pushPoint = [&]( size_t position ){
+        const double* p = m_points[position].coords;
+        if( p[0] < boxMin[0] || p[0] > boxMax[0] ||
+            p[1] < boxMin[1] || p[1] > boxMax[1] ||
+            p[2] < boxMin[2] || p[2] > boxMax[2] )
+            return;
+        TraversalEntry entry;
+        entry.distance = distanceToBox( location, p, p );
+        entry.begin = position;
+        entry.end = 0;
+        queue.push( entry );
+    };
+    auto pushRange = [&]( size_t begin, size_t end, const double* min, const double* max ){
+        if( begin >= end )
+            return;
+        //skip ranges entirely outside the box
+        for( int d = 0; d < 3; ++d )
+            if( max[d] < boxMin[d] || min[d] > boxMax[d] )
+                return;
+        TraversalEntry entry;
+        entry.distance = distanceToBox( location, min, max );
+        entry.begin = begin;
+        entry.end = end;
+        std::copy( min, min + 3, entry.min );
+        std::copy( max, max + 3, entry.max );
+        queue.push( entry );
+    };
+
+    double infinity = std::numeric_limits<double>::infinity();
+    double rootMin[3] = { -infinity, -infinity, -infinity };
+    double rootMax[3] = {  infinity,  infinity,  infinity };
+    pushRange( 0, m_points.size(), rootMin, rootMax );
+
+    while( ! queue.empty() ){
+        TraversalEntry entry = queue.top();
+        queue.pop();
+        //a point: as it is the nearest entry in the queue, no point not yet visited is nearer.
+        if( entry.end == 0 ){
+            const KDTreePoint& p = m_points[entry.begin];
+            if( ! visitor.visit( p.index, p.coords[0], p.coords[1], p.coords[2], entry.distance ) )
+                return;
+            continue;
+        }
+        //a leaf range: queue its points
+        if( entry.end - entry.begin <= LEAF_SIZE ){
+            for( size_t i = entry.begin; i < entry.end; ++i )
+                pushPoint( i );
+            continue;
+        }
+        //a split range: queue the median and the two halves with their bounds
+        size_t mid = entry.begin + ( entry.end - entry.begin ) / 2;
+        int axis = m_splitAxes[mid];
+        double split = m_points[mid].coords[axis];
+        pushPoint( mid );
+        double lowMax[3] = { entry.max[0], entry.max[1], entry.max[2] };
+        lowMax[axis] = split;
+        pushRange( entry.begin, mid, entry.min, lowMax );
+        double highMin[3] = { entry.min[0], entry.min[1], entry.min[2] };
+        highMin[axis] = split;
+        pushRange( mid + 1, entry.end, highMin, entry.max );
+    }
+}
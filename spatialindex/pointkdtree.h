@@ -0,0 +1,87 @@
+#ifndef POINTKDTREE_H
+#define POINTKDTREE_H
+
+#include <cstddef>
+#include <vector>
+
+class NeighborVisitor;
+
+/** One point stored in a PointKDTree. */
+struct KDTreePoint
+{
+    double coords[3];
+    /** The data record index (file data line) of the point. */
+    size_t index;
+};
+
+/**
+ * The PointKDTree class is a static, balanced k-d tree of 3D points.  It is meant for point sets, whose
+ * samples have no extent, so the bounding boxes stored by an R-tree are superfluous.  The tree is built
+ * once, in O(n log n), from all the points (no insertions or removals afterwards).  It is implicit: the
+ * points are reordered in place so the median of each range is the splitting node of that range, hence
+ * the tree takes no memory besides the points and one byte per point for the splitting axes.
+ * The query methods are const and do not change the tree, so a built tree can be queried from
+ * several threads at once.
+ */
+class PointKDTree
+{
+public:
+    PointKDTree();
+
+    /** Builds the tree with the passed points, discarding any previous content.
+     * The passed vector is moved into the tree, so it is empty after the call. */
+    void build( std::vector<KDTreePoint>& points );
+
+    /** Removes all points. */
+    void clear();
+
+    bool empty() const { return m_points.empty(); }
+
+    size_t size() const { return m_points.size(); }
+
+    /** Returns the point at the given position (not the data record index) in the tree. */
+    const KDTreePoint& getPoint( size_t position ) const { return m_points[position]; }
+
+    /** Appends to result the positions of the points inside the given box (boundaries included). */
+    void queryBox( double minX, double minY, double minZ,
+                   double maxX, double maxY, double maxZ,
+                   std::vector<size_t>& result ) const;
+
+    /** Appends to result the positions of the n points nearest to the given location, closest first.
+     * Fewer positions are appended if the tree has less than n points. */
+    void queryNearest( double x, double y, double z, size_t n, std::vector<size_t>& result ) const;
+
+    /** Passes the points inside the given box to the visitor in increasing distance to the given location,
+     * until the visitor returns false or all the points in the box are visited.  The traversal is best-first:
+     * only the parts of the tree that may hold the next nearest point are expanded. */
+    void visitNearest( double x, double y, double z,
+                       double minX, double minY, double minZ,
+                       double maxX, double maxY, double maxZ,
+                       NeighborVisitor& visitor ) const;
+
+private:
+    /** Ranges with this number of points or less are not split further, but scanned. */
+    static const size_t LEAF_SIZE = 8;
+
+    /** A point found in a nearest neighbor search: squared distance and position in the tree. */
+    typedef std::pair<double, size_t> Candidate;
+
+    void buildRange( size_t begin, size_t end );
+
+    void queryBoxRange( size_t begin, size_t end, const double* boxMin, const double* boxMax,
+                        std::vector<size_t>& result ) const;
+
+    /** @param candidates A max-heap with the n nearest points found so far. */
+    void queryNearestRange( size_t begin, size_t end, const double* location, size_t n,
+                            std::vector<Candidate>& candidates ) const;
+
+    /** Adds the point at the given position to the heap of candidates, if it is among the n nearest. */
+    void offerCandidate( size_t position, const double* location, size_t n,
+                         std::vector<Candidate>& candidates ) const;
+
+    std::vector<KDTreePoint> m_points;
+    /** The splitting axis (0, 1 or 2) of the range whose median is at the same position. */
+    std::vector<unsigned char> m_splitAxes;
+};
+
+#endif // POINTKDTREE_H
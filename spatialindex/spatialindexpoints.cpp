@@ -7,8 +7,15 @@
 #include "geostats/searchstrategy.h"
 #include "domain/cartesiangrid.h"
 #include "domain/geogrid.h"
+#include "neighborvisitor.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <thread>
 
 
 void SpatialIndexPoints::setDataFile( DataFile* df ){
@@ -17,7 +24,9 @@ void SpatialIndexPoints::setDataFile( DataFile* df ){
 	df->loadData();
 }
 
-SpatialIndexPoints::SpatialIndexPoints() :
+SpatialIndexPoints::SpatialIndexPoints( size_t maxNodeElements ) :
+	m_maxNodeElements( std::max<size_t>( maxNodeElements, 4 ) ),
+	m_rtree( bgi::dynamic_rstar( m_maxNodeElements ) ),
 	m_dataFile( nullptr )
 {
 }
@@ -28,15 +37,39 @@ SpatialIndexPoints::~SpatialIndexPoints()
     clear();
 }
 
-void SpatialIndexPoints::fill(PointSet *ps, double tolerance)
+void SpatialIndexPoints::bulkLoad(std::vector<Value> &values)
+{
+	//the range constructor packs the tree (top-down, sort-tile-recursive like), filling the nodes to capacity.
+	m_rtree = RTree( values.begin(), values.end(), bgi::dynamic_rstar( m_maxNodeElements ) );
+	values.clear();
+	values.shrink_to_fit();
+}
+
+void SpatialIndexPoints::fill(PointSet *ps, double tolerance, SpatialIndexStructure structure)
 {
     //first clear the index.
     clear();
 
 	setDataFile( ps );
 
-    //for each data line...
     uint totlines = ps->getDataLineCount();
+
+	//the k-d tree stores the points themselves.
+	if( structure == SpatialIndexStructure::KD_TREE ){
+		std::vector<KDTreePoint> points( totlines );
+		for( uint iLine = 0; iLine < totlines; ++iLine){
+			points[iLine].coords[0] = ps->getDataSpatialLocation( iLine, CartesianCoord::X );
+			points[iLine].coords[1] = ps->getDataSpatialLocation( iLine, CartesianCoord::Y );
+			points[iLine].coords[2] = ps->getDataSpatialLocation( iLine, CartesianCoord::Z );
+			points[iLine].index = iLine;
+		}
+		m_kdtree.build( points );
+		return;
+	}
+
+	std::vector<Value> values;
+	values.reserve( totlines );
+    //for each data line...
     for( uint iLine = 0; iLine < totlines; ++iLine){
         //...make a Point3D for the index
 		double x = ps->getDataSpatialLocation( iLine, CartesianCoord::X );
@@ -45,9 +78,26 @@ void SpatialIndexPoints::fill(PointSet *ps, double tolerance)
         //make a bounding box around the point.
         Box box( Point3D(x-tolerance, y-tolerance, z-tolerance),
                  Point3D(x+tolerance, y+tolerance, z+tolerance));
-        //insert the box representing the point into the spatial index.
-		m_rtree.insert( std::make_pair(box, iLine) );
+        //collect the box representing the point for the spatial index.
+		values.push_back( std::make_pair(box, iLine) );
 	}
+	bulkLoad( values );
+}
+
+void SpatialIndexPoints::fill(PointSet *ps, const std::vector<uint> &dataLines)
+{
+	clear();
+
+	setDataFile( ps );
+
+	std::vector<KDTreePoint> points( dataLines.size() );
+	for( size_t i = 0; i < dataLines.size(); ++i ){
+		points[i].coords[0] = ps->getDataSpatialLocation( dataLines[i], CartesianCoord::X );
+		points[i].coords[1] = ps->getDataSpatialLocation( dataLines[i], CartesianCoord::Y );
+		points[i].coords[2] = ps->getDataSpatialLocation( dataLines[i], CartesianCoord::Z );
+		points[i].index = dataLines[i];
+	}
+	m_kdtree.build( points );
 }
 
 void SpatialIndexPoints::fill(CartesianGrid * cg)
@@ -57,24 +107,8 @@ void SpatialIndexPoints::fill(CartesianGrid * cg)
 
 	setDataFile( cg );
 
-	//the search tolerance is half of cell sizes.
-	double tX = cg->getDX() / 2;
-	double tY = cg->getDY() / 2;
-	double tZ = cg->getDZ() / 2;
-
-	//for each data line...
-	uint totlines = cg->getDataLineCount();
-	for( uint iLine = 0; iLine < totlines; ++iLine){
-		//...make a Point3D for the index
-		double x = cg->getDataSpatialLocation( iLine, CartesianCoord::X );
-		double y = cg->getDataSpatialLocation( iLine, CartesianCoord::Y );
-		double z = cg->getDataSpatialLocation( iLine, CartesianCoord::Z );
-		//make a bounding box around the point.
-		Box box( Point3D(x-tX, y-tY, z-tZ),
-				 Point3D(x+tX, y+tY, z+tZ) );
-		//insert the box representing the point into the spatial index.
-		m_rtree.insert( std::make_pair(box, iLine) );
-	}
+	//the cells of a regular grid are found in closed form from the grid geometry, so there is nothing to build.
+	m_gridIndex.setGrid( cg );
 }
 
 void SpatialIndexPoints::fill(GeoGrid * gg)
@@ -90,6 +124,8 @@ void SpatialIndexPoints::fill(GeoGrid * gg)
 
 	//for each data line...
 	uint totlines = gg->getDataLineCount();
+	std::vector<Value> values;
+	values.reserve( totlines );
 	for( uint iLine = 0; iLine < totlines; ++iLine){
 		//get the cell's bounding box (each line corresponds to a cell)
 		double minX, minY, minZ, maxX, maxY, maxZ;
@@ -97,12 +133,58 @@ void SpatialIndexPoints::fill(GeoGrid * gg)
 		//make the bounding box object
 		Box box( Point3D(minX, minY, minZ),
 				 Point3D(maxX, maxY, maxZ) );
-		//insert the box representing the point into the spatial index.
-		m_rtree.insert( std::make_pair(box, iLine) );
+		//collect the box representing the cell for the spatial index.
+		values.push_back( std::make_pair(box, iLine) );
+	}
+	bulkLoad( values );
+}
+
+void SpatialIndexPoints::queryBox(const Box &box, std::vector<Value> &result) const
+{
+	if( ! m_gridIndex.empty() ){
+		std::vector<size_t> cells;
+		m_gridIndex.queryBox( box.min_corner().get<0>(), box.min_corner().get<1>(), box.min_corner().get<2>(),
+							  box.max_corner().get<0>(), box.max_corner().get<1>(), box.max_corner().get<2>(),
+							  cells );
+		result.reserve( result.size() + cells.size() );
+		for( size_t cell : cells ){
+			double minX, minY, minZ, maxX, maxY, maxZ;
+			m_gridIndex.getCellBox( cell, minX, minY, minZ, maxX, maxY, maxZ );
+			result.push_back( std::make_pair( Box( Point3D(minX, minY, minZ), Point3D(maxX, maxY, maxZ) ), cell ) );
+		}
+	} else if( ! m_kdtree.empty() ){
+		std::vector<size_t> positions;
+		m_kdtree.queryBox( box.min_corner().get<0>(), box.min_corner().get<1>(), box.min_corner().get<2>(),
+						   box.max_corner().get<0>(), box.max_corner().get<1>(), box.max_corner().get<2>(),
+						   positions );
+		result.reserve( result.size() + positions.size() );
+		for( size_t position : positions ){
+			const KDTreePoint& p = m_kdtree.getPoint( position );
+			Point3D point( p.coords[0], p.coords[1], p.coords[2] );
+			result.push_back( std::make_pair( Box( point, point ), p.index ) );
+		}
+	} else
+		m_rtree.query( bgi::intersects( box ), std::back_inserter( result ) );
+}
+
+void SpatialIndexPoints::queryNearest(double x, double y, double z, uint n, std::vector<size_t> &result) const
+{
+	if( ! m_gridIndex.empty() )
+		m_gridIndex.queryNearest( x, y, z, n, result );
+	else if( ! m_kdtree.empty() ){
+		std::vector<size_t> positions;
+		m_kdtree.queryNearest( x, y, z, n, positions );
+		for( size_t position : positions )
+			result.push_back( m_kdtree.getPoint( position ).index );
+	} else {
+		std::vector<Value> result_n;
+		m_rtree.query( bgi::nearest( Point3D(x, y, z), n ), std::back_inserter( result_n ) );
+		for( const Value& value : result_n )
+			result.push_back( value.second );
 	}
 }
 
-QList<uint> SpatialIndexPoints::getNearest(uint index, uint n)
+QList<uint> SpatialIndexPoints::getNearest(uint index, uint n) const
 {
 	assert( m_dataFile && "SpatialIndexPoints::getNearest(): No data file.  Make sure you have made a call to fill() prior to making queries.");
 
@@ -114,42 +196,42 @@ QList<uint> SpatialIndexPoints::getNearest(uint index, uint n)
 	double z = m_dataFile->getDataSpatialLocation( index, CartesianCoord::Z );
 
     // find n nearest values to a point
-    std::vector<Value> result_n;
-	m_rtree.query(bgi::nearest(Point3D(x, y, z), n), std::back_inserter(result_n));
+    std::vector<size_t> result_n;
+	queryNearest( x, y, z, n, result_n );
 
     // collect the point indexes
-    std::vector<Value>::iterator it = result_n.begin();
+    std::vector<size_t>::iterator it = result_n.begin();
     for(; it != result_n.end(); ++it){
         //do not return itself
-        if( index != (*it).second )
-            result.push_back( (*it).second );
+        if( index != *it )
+            result.push_back( *it );
     }
 
     //return the point indexes
 	return result;
 }
 
-QList<uint> SpatialIndexPoints::getNearest(double x, double y, double z, uint n)
+QList<uint> SpatialIndexPoints::getNearest(double x, double y, double z, uint n) const
 {
 	assert( m_dataFile && "SpatialIndexPoints::getNearest(): No data file.  Make sure you have made a call to fill() prior to making queries.");
 
 	QList<uint> result;
 
 	// find n nearest values to a point
-	std::vector<Value> result_n;
-	m_rtree.query(bgi::nearest(Point3D(x, y, z), n), std::back_inserter(result_n));
+	std::vector<size_t> result_n;
+	queryNearest( x, y, z, n, result_n );
 
 	// collect the point indexes
-	std::vector<Value>::iterator it = result_n.begin();
+	std::vector<size_t>::iterator it = result_n.begin();
 	for(; it != result_n.end(); ++it){
-		result.push_back( (*it).second );
+		result.push_back( *it );
 	}
 
 	//return the point indexes
 	return result;
 }
 
-QList<uint> SpatialIndexPoints::getNearestWithin(uint index, uint n, double distance )
+QList<uint> SpatialIndexPoints::getNearestWithin(uint index, uint n, double distance ) const
 {
 	assert( m_dataFile && "SpatialIndexPoints::getNearestWithin(): No data file.  Make sure you have made a call to fill() prior to making queries.");
 
@@ -181,25 +263,168 @@ QList<uint> SpatialIndexPoints::getNearestWithin(uint index, uint n, double dist
 	return result;
 }
 
-QList<uint> SpatialIndexPoints::getNearestWithin(const DataCell& dataCell, const SearchStrategy & searchStrategy)
+void SpatialIndexPoints::visitNearest(double x, double y, double z, const Box &box, NeighborVisitor &visitor) const
+{
+	double minX = box.min_corner().get<0>(), minY = box.min_corner().get<1>(), minZ = box.min_corner().get<2>();
+	double maxX = box.max_corner().get<0>(), maxY = box.max_corner().get<1>(), maxZ = box.max_corner().get<2>();
+	if( ! m_gridIndex.empty() )
+		m_gridIndex.visitNearest( x, y, z, minX, minY, minZ, maxX, maxY, maxZ, visitor );
+	else if( ! m_kdtree.empty() )
+		m_kdtree.visitNearest( x, y, z, minX, minY, minZ, maxX, maxY, maxZ, visitor );
+	else if( ! m_rtree.empty() ){
+		//the incremental nearest query of the R-tree returns the entries in increasing distance to their boxes.
+		Point3D location( x, y, z );
+		for( auto it = m_rtree.qbegin( bgi::intersects( box ) && bgi::nearest( location, m_rtree.size() ) );
+			 it != m_rtree.qend(); ++it ){
+			size_t index = (*it).second;
+			if( ! visitor.visit( index,
+								 m_dataFile->getDataSpatialLocation( index, CartesianCoord::X ),
+								 m_dataFile->getDataSpatialLocation( index, CartesianCoord::Y ),
+								 m_dataFile->getDataSpatialLocation( index, CartesianCoord::Z ),
+								 bg::distance( location, (*it).first ) ) )
+				return;
+		}
+	}
+}
+
+namespace {
+
+	/** A sample found inside the search neighborhood by SectorSearchVisitor. */
+	struct SearchCandidate
+	{
+		double normalizedDistance;
+		size_t index;
+		double x, y, z;
+		bool operator>( const SearchCandidate& other ) const { return normalizedDistance > other.normalizedDistance; }
+	};
+
+	/**
+	 * The SectorSearchVisitor class fills the sectors of a search neighborhood (a single sector if the neighborhood
+	 * has no spatial filtering) with the samples nearest to its center in the neighborhood's own metric (e.g. the
+	 * anisotropic distance of an ellipsoid).  The samples are received in increasing Euclidean distance and kept
+	 * in a queue until no sample not yet received may be nearer in the neighborhood's metric, when they are taken
+	 * in increasing order of that metric.  The traversal stops as soon as all sectors are full or the remaining
+	 * samples are all outside the neighborhood.
+	 */
+	class SectorSearchVisitor : public NeighborVisitor
+	{
+	public:
+		SectorSearchVisitor( const SearchStrategy& searchStrategy, double centerX, double centerY, double centerZ ) :
+			m_searchNeighborhood( *searchStrategy.m_searchNB ),
+			m_centerX( centerX ), m_centerY( centerY ), m_centerZ( centerZ ),
+			m_minDistanceScale( searchStrategy.m_searchNB->getMinDistanceScale() ),
+			m_minDistanceBetweenSamples( searchStrategy.m_minDistanceBetweenSamples ),
+			m_nFullSectors( 0 )
+		{
+			if( searchStrategy.NBhasSpatialFiltering() )
+				m_searchNeighborhood.getSectorQuotas( m_numberOfSectors, m_minSamplesPerSector, m_maxSamplesPerSector );
+			else {
+				m_numberOfSectors = 1;
+				m_minSamplesPerSector = 0;
+				m_maxSamplesPerSector = searchStrategy.m_nb_samples;
+			}
+			m_sectors.resize( m_numberOfSectors );
+			for( std::vector<SearchCandidate>& sector : m_sectors )
+				sector.reserve( m_maxSamplesPerSector );
+			if( m_maxSamplesPerSector == 0 )
+				m_nFullSectors = m_numberOfSectors;
+		}
+
+		virtual bool visit( size_t index, double x, double y, double z, double distance ) override
+		{
+			double normalizedDistance = m_searchNeighborhood.getNormalizedDistance( m_centerX, m_centerY, m_centerZ, x, y, z );
+			if( normalizedDistance <= 1.0 )
+				m_queue.push( SearchCandidate{ normalizedDistance, index, x, y, z } );
+			//no sample not yet visited is nearer than this in the neighborhood's metric.
+			double lowerBound = distance * m_minDistanceScale;
+			takeUpTo( lowerBound );
+			return m_nFullSectors < m_numberOfSectors && lowerBound <= 1.0;
+		}
+
+		/** Takes the samples remaining in the queue.  To be called after the traversal. */
+		void finish()
+		{
+			takeUpTo( std::numeric_limits<double>::infinity() );
+		}
+
+		/** Fills the list with the indexes of the samples found, interleaving the sectors (the nearest sample of each
+		 * sector, then the second nearest of each sector and so on), up to the maximum number of samples.
+		 * The list is left empty if the minimum number of samples (of the search or per sector) is not met.
+		 */
+		void getResult( const SearchStrategy& searchStrategy, QList<uint>& result ) const
+		{
+			size_t total = 0;
+			for( const std::vector<SearchCandidate>& sector : m_sectors ){
+				if( sector.size() < m_minSamplesPerSector )
+					return;
+				total += sector.size();
+			}
+			if( total < searchStrategy.m_minNumberOfSamples )
+				return;
+			for( size_t nthElement = 0; nthElement < m_maxSamplesPerSector; ++nthElement )
+				for( const std::vector<SearchCandidate>& sector : m_sectors )
+					if( nthElement < sector.size() ){
+						result.push_back( sector[nthElement].index );
+						if( (uint)result.size() == searchStrategy.m_nb_samples )
+							return;
+					}
+		}
+
+	private:
+		/** Takes the samples in the queue up to the given normalized distance. */
+		void takeUpTo( double maxNormalizedDistance )
+		{
+			while( ! m_queue.empty() && m_queue.top().normalizedDistance <= maxNormalizedDistance ){
+				take( m_queue.top() );
+				m_queue.pop();
+			}
+		}
+
+		/** Adds the sample to its sector, unless the sector is full or the sample is too close to a sample already taken. */
+		void take( const SearchCandidate& candidate )
+		{
+			uint iSector = 0;
+			if( m_numberOfSectors > 1 )
+				iSector = m_searchNeighborhood.getSector( m_centerX, m_centerY, m_centerZ, candidate.x, candidate.y, candidate.z );
+			std::vector<SearchCandidate>& sector = m_sectors[iSector];
+			if( sector.size() >= m_maxSamplesPerSector )
+				return;
+			if( m_minDistanceBetweenSamples > 0.0 )
+				for( const std::vector<SearchCandidate>& otherSector : m_sectors )
+					for( const SearchCandidate& taken : otherSector ){
+						double dx = taken.x - candidate.x;
+						double dy = taken.y - candidate.y;
+						double dz = taken.z - candidate.z;
+						if( std::sqrt( dx*dx + dy*dy + dz*dz ) < m_minDistanceBetweenSamples )
+							return;
+					}
+			sector.push_back( candidate );
+			if( sector.size() == m_maxSamplesPerSector )
+				++m_nFullSectors;
+		}
+
+		const SearchNeighborhood& m_searchNeighborhood;
+		double m_centerX, m_centerY, m_centerZ;
+		double m_minDistanceScale;
+		double m_minDistanceBetweenSamples;
+		uint m_numberOfSectors, m_minSamplesPerSector, m_maxSamplesPerSector;
+		uint m_nFullSectors;
+		/** The samples taken in each sector, in increasing normalized distance. */
+		std::vector< std::vector<SearchCandidate> > m_sectors;
+		/** The samples received but not yet taken, nearest first. */
+		std::priority_queue< SearchCandidate, std::vector<SearchCandidate>, std::greater<SearchCandidate> > m_queue;
+	};
+}
+
+QList<uint> SpatialIndexPoints::getNearestWithin(const DataCell& dataCell, const SearchStrategy & searchStrategy) const
 {
 	assert( m_dataFile && "SpatialIndexPoints::getNearestWithin(): No data file.  Make sure you have made a call to fill() prior to making queries.");
-	//TODO: Possible Refactoring: some of the logic in here may in fact belong to the SearchStrategy class.
 
 	QList<uint> result;
 
-	//get the desired number of samples.
-	uint n = searchStrategy.m_nb_samples;
-
 	//get the search neighboorhood (e.g. an ellipsoid).
 	const SearchNeighborhood& searchNeighborhood = *(searchStrategy.m_searchNB);
 
-	//get the minimum distance between samples. (0.0 == not used)
-	double minDist = searchStrategy.m_minDistanceBetweenSamples;
-
-	//set a flag to avoid computing distances unnecessarily (performance reason).
-	bool useMinDist = minDist > 0.0;
-
 	//Get the location of the data cell.
 	double x = dataCell._center._x;
 	double y = dataCell._center._y;
@@ -213,97 +438,82 @@ QList<uint> SpatialIndexPoints::getNearestWithin(const DataCell& dataCell, const
     Box searchBB( Point3D( minX, minY, minZ ),
 				  Point3D( maxX, maxY, maxZ ));
 
-    //Get all the points within the bounding box of the search neighborhood.
-    //This step improves performance because the actual inside/outside test of the search
-    //neighborhood implementation may be slow.
-	std::vector<Value> poinsInSearchBB;
-	m_rtree.query( bgi::intersects( searchBB ), std::back_inserter(poinsInSearchBB) );
-
-    //Get all the samples actually inside the search neighborhood.
-	std::vector<Value>::iterator it = poinsInSearchBB.begin();
-    typedef bgi::rtree< Value, bgi::rstar<16,5,5,32> > RTreeLocal;
-    RTreeLocal rtreeLocal;
-	std::vector<Value> resultMinDist;
-	resultMinDist.reserve( 1 );
-	for(; it != poinsInSearchBB.end(); ++it){
-		uint indexP = (*it).second;
-		//get the location of the point in the result set.
-		double xP = m_dataFile->getDataSpatialLocation( indexP, CartesianCoord::X );
-		double yP = m_dataFile->getDataSpatialLocation( indexP, CartesianCoord::Y );
-		double zP = m_dataFile->getDataSpatialLocation( indexP, CartesianCoord::Z );
-		//Test whether the point is actually inside the ellipsoid.
-		if( searchNeighborhood.isInside( x, y, z, xP, yP, zP ) ){
-			//if it necessary to impose a minimum distance between samples...
-			if( useMinDist ){
-				//...and if there is at least a sample already collected...
-				if( ! rtreeLocal.empty() ){
-					//...then query the local r-tree for the closest sample to the current sample so far.
-					rtreeLocal.query(bgi::nearest(Point3D(xP, yP, zP), 1), std::back_inserter(resultMinDist));
-					//get the location of the closest sample already collected.
-					uint indexClosestP = resultMinDist[0].second;
-					double xClosestP = m_dataFile->getDataSpatialLocation( indexClosestP, CartesianCoord::X );
-					double yClosestP = m_dataFile->getDataSpatialLocation( indexClosestP, CartesianCoord::Y );
-					double zClosestP = m_dataFile->getDataSpatialLocation( indexClosestP, CartesianCoord::Z );
-					//reset the vector used to collect the nearest sample already collected
-					resultMinDist.clear();
-					//compute the distance between the current sample and the nearest sample collected
-					double dist = boost::geometry::distance( Point3D(xP, yP, zP), Point3D(xClosestP, yClosestP, zClosestP) );
-					//if the current sample is closer to a sample previously collected than allowed...
-					if( dist < minDist ){
-						//...skip to the next sample (current sample is not collected).
-						continue;
+	//Visit the samples in the bounding box of the search neighborhood from the nearest to the farthest,
+	//filling the sectors (e.g. octants) incrementally until they are full or no remaining sample is inside
+	//the neighborhood.
+	SectorSearchVisitor visitor( searchStrategy, x, y, z );
+	visitNearest( x, y, z, searchBB, visitor );
+	visitor.finish();
+	visitor.getResult( searchStrategy, result );
+
+	return result;
+}
+
+void SpatialIndexPoints::getNearestWithin(const double *x, const double *y, const double *z, size_t nQueries,
+										  uint n, double maxDistance, SpatialQueryResults &results) const
+{
+	assert( m_dataFile && "SpatialIndexPoints::getNearestWithin(): No data file.  Make sure you have made a call to fill() prior to making queries.");
+
+	//The queries are processed in blocks taken in turn by the threads.  The indexes found for each block are
+	//kept apart, so they can be concatenated in the order of the queries at the end.
+	const size_t BLOCK_SIZE = 1024;
+	size_t nBlocks = ( nQueries + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+	std::vector< std::vector<uint> > blockIndexes( nBlocks );
+	results.offsets.assign( nQueries + 1, 0 );
+	std::atomic<size_t> nextBlock( 0 );
+
+	auto queryBlocks = [&](){
+		//buffer reused by all the queries of a thread
+		std::vector<size_t> nearest;
+		nearest.reserve( n );
+		for( size_t iBlock = nextBlock++; iBlock < nBlocks; iBlock = nextBlock++ ){
+			std::vector<uint>& indexes = blockIndexes[iBlock];
+			indexes.reserve( BLOCK_SIZE * n );
+			size_t end = std::min( nQueries, ( iBlock + 1 ) * BLOCK_SIZE );
+			for( size_t iQuery = iBlock * BLOCK_SIZE; iQuery < end; ++iQuery ){
+				nearest.clear();
+				queryNearest( x[iQuery], y[iQuery], z[iQuery], n, nearest );
+				uint count = 0;
+				for( size_t index : nearest ){
+					//the distance is to the location of the point, not to its bounding box
+					double dx = m_dataFile->getDataSpatialLocation( index, CartesianCoord::X ) - x[iQuery];
+					double dy = m_dataFile->getDataSpatialLocation( index, CartesianCoord::Y ) - y[iQuery];
+					double dz = m_dataFile->getDataSpatialLocation( index, CartesianCoord::Z ) - z[iQuery];
+					if( std::sqrt( dx*dx + dy*dy + dz*dz ) < maxDistance ){
+						indexes.push_back( index );
+						++count;
 					}
 				}
+				//the counts are turned into offsets once all the queries are done.
+				results.offsets[iQuery + 1] = count;
 			}
-			//Adds the current sample to a local r-tree for the ensuing n-nearest search.
-			rtreeLocal.insert( *it );
 		}
-	}
-
-	//The search strategy may need to perform spatial filtering (e.g. octant/sector search) of the samples found
-	//in the search neighborhood.
-	if( searchStrategy.NBhasSpatialFiltering() ){
-        //Copy all sample locations found inside the neighborhood to a vector.
-		std::vector<IndexedSpatialLocationPtr> locationsToFilter;
-        locationsToFilter.reserve( rtreeLocal.size() );
-        for ( RTreeLocal::const_iterator it = rtreeLocal.begin() ; it != rtreeLocal.end() ; ++it ){
-            //Get sample's location given the index stored in the r-tree.
-			double x = m_dataFile->getDataSpatialLocation( (*it).second, CartesianCoord::X );
-			double y = m_dataFile->getDataSpatialLocation( (*it).second, CartesianCoord::Y );
-			double z = m_dataFile->getDataSpatialLocation( (*it).second, CartesianCoord::Z );
-			locationsToFilter.push_back( IndexedSpatialLocationPtr( new IndexedSpatialLocation( x, y, z, (*it).second ) ) );
-        }
-		//Perform spatial filter with respect to the center of the current estimation cell.
-		searchStrategy.m_searchNB->performSpatialFilter( x, y, z, locationsToFilter, searchStrategy );
-		//...Collect the indexes of the samples spatially filtered.
-		std::vector<IndexedSpatialLocationPtr>::iterator it = locationsToFilter.begin();
-		for(; it != locationsToFilter.end(); ++it)
-			result.push_back( (*it)->_index );
-	//Otherwise, simply get the n-nearest of those found inside the neighborhood.
-	} else {
-		std::vector<Value> resultNNearest;
-		rtreeLocal.query(bgi::nearest(Point3D(x, y, z), n), std::back_inserter(resultNNearest));
-		//If the number of n-neares samples found is greater than or equal the minimum number of samples
-		//set in search strategy...
-		if( resultNNearest.size() >= searchStrategy.m_minNumberOfSamples ) {
-			//...Collect the n-nearest point indexes found inside the ellipsoid.
-			it = resultNNearest.begin();
-			for(; it != resultNNearest.end(); ++it)
-				result.push_back( (*it).second );
-		}
-	}
-
-
-	return result;
+	};
+
+	unsigned int nThreads = std::max<size_t>( 1, std::min<size_t>( std::thread::hardware_concurrency(), nBlocks ) );
+	std::vector<std::thread> threads;
+	for( unsigned int iThread = 0; iThread < nThreads; ++iThread )
+		threads.push_back( std::thread( queryBlocks ) );
+	for( std::thread& thread : threads )
+		thread.join();
+
+	for( size_t iQuery = 0; iQuery < nQueries; ++iQuery )
+		results.offsets[iQuery + 1] += results.offsets[iQuery];
+	results.indexes.clear();
+	results.indexes.reserve( results.offsets[nQueries] );
+	for( const std::vector<uint>& indexes : blockIndexes )
+		results.indexes.insert( results.indexes.end(), indexes.begin(), indexes.end() );
 }
 
 void SpatialIndexPoints::clear()
 {
 	m_rtree.clear();
+	m_kdtree.clear();
+	m_gridIndex.clear();
 	m_dataFile = nullptr;
 }
 
-bool SpatialIndexPoints::isEmpty()
+bool SpatialIndexPoints::isEmpty() const
 {
-	return m_rtree.empty();
+	return m_rtree.empty() && m_kdtree.empty() && m_gridIndex.empty();
 }
@@ -5,6 +5,8 @@
 #include <vector>
 #include <boost/geometry.hpp>
 #include <boost/geometry/index/rtree.hpp>
+#include "pointkdtree.h"
+#include "implicitgridindex.h"
 
 class PointSet;
 class CartesianGrid;
@@ -12,6 +14,7 @@ class DataCell;
 class SearchStrategy;
 class DataFile;
 class GeoGrid;
+class NeighborVisitor;
 
 namespace bg = boost::geometry;
 namespace bgi = boost::geometry::index;
@@ -19,6 +22,24 @@ typedef bg::model::point<double, 3, bg::cs::cartesian> Point3D;
 typedef bg::model::box<Point3D> Box;
 typedef std::pair<Box, size_t> Value;
 
+/** The results of a batch query to SpatialIndexPoints in compressed sparse row layout: the data record
+ * indexes found for the i-th query location are indexes[offsets[i]] to indexes[offsets[i+1]-1].
+ */
+struct SpatialQueryResults
+{
+	std::vector<size_t> offsets;
+	std::vector<uint> indexes;
+	/** Returns the number of indexes found for the given query location. */
+	size_t count( size_t query ) const { return offsets[query+1] - offsets[query]; }
+	/** Returns the first of the indexes found for the given query location. */
+	const uint* begin( size_t query ) const { return indexes.data() + offsets[query]; }
+};
+
+/** The data structures available to SpatialIndexPoints. */
+enum class SpatialIndexStructure : int {
+	RSTAR_TREE, //R*-tree of bounding boxes, works with all kinds of data files.
+	KD_TREE     //k-d tree of points, for point sets only (no tolerance box around the points).
+};
 
 /**
  * This class exposes functionalities related to spatial indexes and queries with GammaRay objects.
@@ -27,16 +48,29 @@ typedef std::pair<Box, size_t> Value;
 class SpatialIndexPoints
 {
 public:
-    SpatialIndexPoints();
+	/**
+	 * @param maxNodeElements The maximum number of entries in an R-tree node (4 or more).  Larger nodes make
+	 *                        the tree shallower, which favors large query results over small ones.
+	 */
+	explicit SpatialIndexPoints( size_t maxNodeElements = 16 );
 	virtual ~SpatialIndexPoints();
 
     /** Fills the index with the PointSet points (bulk load).
      * It erases any previously indexed points.
-     * @param tolerance Sets the size of the bouding boxes around each point.
+     * @param tolerance Sets the size of the bouding boxes around each point.  Not used by the k-d tree.
+     * @param structure The k-d tree is smaller and faster to build and query, but it ignores the tolerance.
      */
-	void fill( PointSet* ps, double tolerance );
+	void fill( PointSet* ps, double tolerance,
+			   SpatialIndexStructure structure = SpatialIndexStructure::RSTAR_TREE );
+
+	/** Fills the index with only the given data lines of the PointSet (e.g. the samples with valid values),
+	 * so the searches never return the others.  The k-d tree is used.
+	 * It erases any previously indexed points.
+	 */
+	void fill( PointSet* ps, const std::vector<uint>& dataLines );
 
-	/** Fills the index with the CartesianGrid cells (bulk load).
+	/** Fills the index with the CartesianGrid cells.  No index is actually built: the cells are found
+	 * from the grid geometry (see ImplicitGridIndex).
 	 * It erases any previously indexed points.
 	 */
 	void fill( CartesianGrid* cg );
@@ -51,14 +85,14 @@ public:
 	 * The indexes are the data record indexes (file data lines) of the DataFile used to fill
      * the index.
      */
-	QList<uint> getNearest( uint index, uint n );
+	QList<uint> getNearest( uint index, uint n ) const;
 
 	/**
 	 * Returns the indexes of the n-nearest points to a point in space.
 	 * The indexes are the data record indexes (file data lines) of the DataFile used to fill
 	 * the index.
 	 */
-	QList<uint> getNearest( double x, double y, double z, uint n );
+	QList<uint> getNearest( double x, double y, double z, uint n ) const;
 
     /**
 	 * Returns the data line indexes of the n-nearest points within the given distance
@@ -67,31 +101,73 @@ public:
      * an empty list.
      * @param distance The distance the returned points must be within.
      */
-	QList<uint> getNearestWithin(uint index, uint n, double distance);
+	QList<uint> getNearestWithin(uint index, uint n, double distance) const;
 
 	/**
 	 * Returns the data line indexes of the n-nearest points within the given neighborhood
 	 * centered at given data cell (e.g. grid cell). The indexes are the point indexes
      * (file data lines) of the DataFile used fill the index.  May return
 	 * an empty list.
+	 * The distances are measured in the neighborhood's own metric (e.g. anisotropic for an ellipsoid).  If the
+	 * neighborhood has sectors (e.g. octant search), they are filled while the index is traversed, which stops
+	 * as soon as every sector is full or exhausted.
 	 */
 	QList<uint> getNearestWithin(const DataCell& dataCell,
-										const SearchStrategy & searchStrategy );
+										const SearchStrategy & searchStrategy ) const;
+
+	/**
+	 * Batch version of getNearestWithin(): finds the data line indexes of the n-nearest points within the
+	 * given distance to each of the nQueries locations given in x, y and z.  The queries are distributed
+	 * among as many threads as there are processor cores.  Unlike the single query methods, points at the
+	 * query locations themselves are not excluded.
+	 * This method is const and does not change the index, so it is safe to call it concurrently, including
+	 * with the other query methods, as long as the index is not refilled or cleared meanwhile.
+	 * @param maxDistance The distance the returned points must be within (use infinity for no limit).
+	 * @param results Receives the indexes found, nearest first for each location.
+	 */
+	void getNearestWithin( const double* x, const double* y, const double* z, size_t nQueries,
+						   uint n, double maxDistance, SpatialQueryResults& results ) const;
 
 
     /** Clears the spatial index. */
 	void clear();
 
 	/** Returns whether the spatial index has not been built. */
-	bool isEmpty();
+	bool isEmpty() const;
 
 private:
+	typedef bgi::rtree< Value, bgi::dynamic_rstar > RTree;
+
 	void setDataFile( DataFile* df );
 
-	/** The R* variant of the rtree
-	* WARNING: incorrect R-Tree parameter may lead to crashes with element insertions
-	*/
-	bgi::rtree< Value, bgi::rstar<16,5,5,32> > m_rtree; //TODO: make these parameters variable (passed in the constructor?)
+	/** Builds the R-tree at once from all the entries with the packing algorithm, which is much faster than
+	 * inserting them one by one and results in nodes with less overlap.  The vector is cleared.
+	 */
+	void bulkLoad( std::vector<Value>& values );
+
+	/** Appends to result the entries intersecting the given box.  The k-d tree entries have
+	 * degenerate boxes (the points themselves) and the grid entries have the cell boxes.
+	 */
+	void queryBox( const Box& box, std::vector<Value>& result ) const;
+
+	/** Passes the entries inside the given box to the visitor in increasing distance to the given location
+	 * until the visitor stops the traversal. */
+	void visitNearest( double x, double y, double z, const Box& box, NeighborVisitor& visitor ) const;
+
+	/** Appends to result the data record indexes of the n entries nearest to the given location. */
+	void queryNearest( double x, double y, double z, uint n, std::vector<size_t>& result ) const;
+
+	/** The maximum number of entries in an R-tree node. */
+	size_t m_maxNodeElements;
+
+	/** The R* variant of the rtree, with the node capacity set at run time. */
+	RTree m_rtree;
+
+	/** The k-d tree, used instead of the R-tree if so requested when filling with a point set. */
+	PointKDTree m_kdtree;
+
+	/** The closed-form lookup used instead of the R-tree when filling with a Cartesian grid. */
+	ImplicitGridIndex m_gridIndex;
 
 	/** The data file which is being indexed. */
 	DataFile* m_dataFile;
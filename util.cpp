@@ -566,6 +566,20 @@ void Util::createGEOEASGridFile(const QString gridDescription,
     file.close();
 }
 
+void Util::saveGridColumns(CartesianGrid *cg,
+                           const std::vector<QString> &columnNames,
+                           const std::vector<std::vector<double> > &columns)
+{
+    size_t nCells = (size_t)cg->getNX() * cg->getNY() * cg->getNZ();
+    for( size_t iColumn = 0; iColumn < columns.size(); ++iColumn ){
+        long column = cg->addEmptyDataColumn( columnNames[iColumn], nCells );
+        const std::vector<double>& values = columns[iColumn];
+        for( size_t iCell = 0; iCell < nCells && iCell < values.size(); ++iCell )
+            cg->setData( iCell, column, values[iCell] );
+    }
+    cg->writeToFS();
+}
+
 bool Util::viewGrid(Attribute *variable, QWidget* parent = 0, bool modal, CategoryDefinition *cd)
 {
     //get input data file
@@ -1101,6 +1115,31 @@ QString Util::getGEOEAScomment(QString file_path)
     return result;
 }
 
+bool Util::readGEOEASValuesAndWeights(const QString file_path, uint values_column, uint weights_column,
+                                      std::vector<double> &values, std::vector<double> &weights)
+{
+    values.clear();
+    weights.clear();
+    QFile file( file_path );
+    if( values_column < 1 || ! file.open( QFile::ReadOnly | QFile::Text ) )
+        return false;
+    QTextStream in( &file );
+    uint n_header_lines = Util::getHeaderLineCount( file_path );
+    QStringList fields;
+    for( uint i = 0; ! in.atEnd(); ++i ){
+        QString line = in.readLine();
+        if( i < n_header_lines )
+            continue;
+        Util::fastSplit( line, fields );
+        if( fields.size() < (int)values_column || fields.size() < (int)weights_column )
+            continue;
+        values.push_back( fields[values_column - 1].toDouble() );
+        weights.push_back( weights_column > 0 ? fields[weights_column - 1].toDouble() : 1.0 );
+    }
+    file.close();
+    return ! values.empty();
+}
+
 QFrame *Util::createHorizontalLine()
 {
     QFrame *line;
@@ -283,6 +283,16 @@ public:
                                      std::vector<std::vector<double>> &array,
                                      QString path);
 
+    /**
+     * Adds the given columns to the data of the given grid object, whose geometry must be set, then writes them to
+     * its GEO-EAS file.  The values are written from memory, with the file's binary sidecar, so the grid is loaded
+     * afterwards without parsing the file (unlike createGEOEASGridFile()).
+     * @param columns The values of each column, one per grid cell in GEO-EAS scan order.
+     */
+    static void saveGridColumns( CartesianGrid* cg,
+                                 const std::vector<QString>& columnNames,
+                                 const std::vector<std::vector<double>>& columns );
+
     /**
      * Runs the GSLib program pixelplt and opens the plot dialog to view a
      * variable in a regular grid.
@@ -410,6 +420,14 @@ public:
       */
     static QString getGEOEAScomment(QString file_path);
 
+    /**
+     * Reads the values and their weights (e.g. declustering weights) of a distribution from the given
+     * columns (GEO-EAS indexes, first is 1) of a GEO-EAS file.  The weights are ones if weights_column is zero.
+     * @return False if the file could not be read or has no values.
+     */
+    static bool readGEOEASValuesAndWeights( const QString file_path, uint values_column, uint weights_column,
+                                            std::vector<double>& values, std::vector<double>& weights );
+
     /**
      * Creates a widget with the appearance of a horizontal line, normally used as a
      * separator.